@@ -1,9 +1,15 @@
 #include "common.h"
-#include <libtwl/ipc/ipcSync.h>
 #include <string.h>
+#ifdef GBAR3_FS_STATS
+#include <libtwl/timer/timer.h>
+#include <libtwl/gfx/gfxStatus.h>
+#endif
 #include "dldi.h"
 #include "FsIpcService.h"
 
+/// @brief The number of frames to wait for the arm9 to dump the statistics before exiting.
+#define FS_STATS_EXIT_DUMP_TIMEOUT_FRAMES   120
+
 extern "C" int sdmmc_sd_startup();
 
 void FsIpcService::Start()
@@ -12,9 +18,81 @@ void FsIpcService::Start()
     {
         sdmmc_sd_startup();
     }
+#ifdef GBAR3_FS_STATS
+    for (u32 i = 0; i < FS_IPC_RING_SIZE; i++)
+    {
+        // no arrival was recorded yet for any sequence number of the slots
+        _arrivalSequences[i] = i - FS_IPC_RING_SIZE;
+    }
+    tmr_configure(FS_STATS_ARM7_TIMER, TMCNT_H_CLK_SYS_DIV_256, 0, false);
+    tmr_start(FS_STATS_ARM7_TIMER);
+#endif
     ThreadIpcService::Start();
 }
 
+#ifdef GBAR3_FS_STATS
+
+/// @brief Converts ticks of the statistics timer (sys / 256) to microseconds.
+static u32 ticksToMicroseconds(u16 ticks)
+{
+    return (ticks * 489) >> 6;
+}
+
+void FsIpcService::OnMessageReceived(u32 data)
+{
+    auto ring = reinterpret_cast<const fs_ipc_ring_t*>(data << 2);
+    if (ring->cmd == FS_IPC_CMD_PROCESS_RING)
+    {
+        RecordArrivals(ring);
+    }
+    ThreadIpcService::OnMessageReceived(data);
+}
+
+void FsIpcService::RecordArrivals(const fs_ipc_ring_t* ring)
+{
+    // runs in the fifo irq, right after the arm9 sent the message
+    _stats = ring->stats;
+    u16 ticks = tmr_getCounter(FS_STATS_ARM7_TIMER);
+    for (u32 slot = 0; slot < FS_IPC_RING_SIZE; slot++)
+    {
+        u32 sequence = ring->commands[slot].sequence;
+        if (_arrivalSequences[slot] != sequence && IsCommandPending(ring, slot))
+        {
+            _arrivalTicks[slot] = ticks;
+            _arrivalSequences[slot] = sequence;
+        }
+    }
+}
+
+void FsIpcService::RecordLatencies(u32 slot, u16 startTicks)
+{
+    u16 completeTicks = tmr_getCounter(FS_STATS_ARM7_TIMER);
+    // the thread can pick up a command before the irq of its message ran
+    u16 arrivalTicks = _arrivalSequences[slot] == _ring->commands[slot].sequence ? _arrivalTicks[slot] : startTicks;
+    u32 queueTime = ticksToMicroseconds(startTicks - arrivalTicks);
+    // includes the time of preempting commands
+    u32 driverTime = ticksToMicroseconds(completeTicks - startTicks);
+
+    fs_ipc_stats_t* stats = _ring->stats;
+    u32 cmd = _ring->commands[slot].cmd;
+    stats->arm7Histograms[FS_STATS_STAGE_QUEUE][cmd][fs_statsGetBucket(queueTime)]++;
+    stats->arm7Histograms[FS_STATS_STAGE_DRIVER][cmd][fs_statsGetBucket(driverTime)]++;
+    stats->serviceTimes[slot] = queueTime + driverTime;
+    stats->completeScanlines[slot] = gfx_getVCount();
+}
+
+bool FsIpcService::IsStatsDumpCompleteForExit()
+{
+    if (!_stats || _stats->dumpComplete)
+    {
+        return true;
+    }
+    _stats->dumpRequested = true;
+    return ++_exitDumpWaitFrames >= FS_STATS_EXIT_DUMP_TIMEOUT_FRAMES;
+}
+
+#endif
+
 void FsIpcService::HandleMessage(u32 data)
 {
     auto cmd = reinterpret_cast<const fs_ipc_cmd_t*>(data << 2);
@@ -25,24 +103,159 @@ void FsIpcService::HandleMessage(u32 data)
             SetupDldi(cmd);
             break;
         }
+        case FS_IPC_CMD_PROCESS_RING:
+        {
+            ProcessRing(reinterpret_cast<fs_ipc_ring_t*>(data << 2));
+            break;
+        }
+    }
+}
+
+void FsIpcService::ProcessRing(fs_ipc_ring_t* ring)
+{
+    _ring = ring;
+    // messages that arrive while processing replace each other, so keep going
+    // until all commands are processed that were submitted in the meantime
+    u32 slot;
+    while (FindNextCommand(FS_IPC_PRIORITY_LOW, slot))
+    {
+        ExecuteRingCommand(slot);
+    }
+}
+
+bool FsIpcService::IsCommandPending(const fs_ipc_ring_t* ring, u32 slot) const
+{
+    // the arm9 fills a free slot before advancing submitSequence past its command,
+    // and a completed command stays in its slot until the arm9 reuses the slot
+    u32 sequence = ring->commands[slot].sequence;
+    return (s32)(sequence - ring->submitSequence) < 0 && ring->completeSequences[slot] != sequence &&
+        !(_startedSlots & (1 << slot));
+}
+
+bool FsIpcService::FindNextCommand(u32 minPriority, u32& slot) const
+{
+    bool found = false;
+    u32 foundSequence = 0;
+    for (u32 i = 0; i < FS_IPC_RING_SIZE; i++)
+    {
+        if (!IsCommandPending(_ring, i))
+        {
+            continue;
+        }
+        const fs_ipc_cmd_t* cmd = &_ring->commands[i];
+        // commands with the same priority are executed in submission order
+        if (cmd->priority > minPriority ||
+            (cmd->priority == minPriority && (!found || (s32)(cmd->sequence - foundSequence) < 0)))
+        {
+            slot = i;
+            foundSequence = cmd->sequence;
+            found = true;
+            minPriority = cmd->priority;
+        }
+    }
+    return found;
+}
+
+void FsIpcService::ExecuteRingCommand(u32 slot)
+{
+    const fs_ipc_cmd_t* cmd = &_ring->commands[slot];
+    u32 sequence = cmd->sequence;
+    _startedSlots |= 1 << slot;
+    u32 previousPriority = _currentPriority;
+    _currentPriority = cmd->priority;
+#ifdef GBAR3_FS_STATS
+    u16 startTicks = tmr_getCounter(FS_STATS_ARM7_TIMER);
+#endif
+    ExecuteCommand(cmd);
+#ifdef GBAR3_FS_STATS
+    RecordLatencies(slot, startTicks);
+#endif
+    _currentPriority = previousPriority;
+    _startedSlots &= ~(1 << slot);
+    // the arm9 can reuse the slot from here on
+    _ring->completeSequences[slot] = sequence;
+}
+
+void FsIpcService::ExecutePreemptingCommands()
+{
+    u32 slot;
+    while (FindNextCommand(_currentPriority + 1, slot))
+    {
+        ExecuteRingCommand(slot);
+    }
+}
+
+u32 FsIpcService::GetPreemptionChunkCount(u32 count) const
+{
+    if (_currentPriority == FS_IPC_PRIORITY_HIGHEST || count <= FS_IPC_PREEMPTION_SECTOR_COUNT)
+    {
+        return count;
+    }
+    return FS_IPC_PREEMPTION_SECTOR_COUNT;
+}
+
+static void dldiReadSectors(u32 sector, u32 count, void* buffer)
+{
+    _DLDI_readSectors_ptr(sector, count, buffer);
+}
+
+static void dldiWriteSectors(u32 sector, u32 count, void* buffer)
+{
+    _DLDI_writeSectors_ptr(sector, count, buffer);
+}
+
+static void dsiSdReadSectors(u32 sector, u32 count, void* buffer)
+{
+    sdmmc_sdcard_readsectors(sector, count, buffer);
+}
+
+static void dsiSdWriteSectors(u32 sector, u32 count, void* buffer)
+{
+    sdmmc_sdcard_writesectors(sector, count, buffer);
+}
+
+void FsIpcService::ExecuteCommand(const fs_ipc_cmd_t* cmd)
+{
+    switch (cmd->cmd)
+    {
         case FS_IPC_CMD_DLDI_READ_SECTORS:
         {
-            DldiReadSectors(cmd);
+            ReadSectors(cmd->sector, cmd->count, cmd->buffer, dldiReadSectors);
             break;
         }
         case FS_IPC_CMD_DLDI_WRITE_SECTORS:
         {
-            DldiWriteSectors(cmd);
+            WriteSectors(cmd->sector, cmd->count, cmd->buffer, dldiWriteSectors);
             break;
         }
         case FS_IPC_CMD_DSI_SD_READ_SECTORS:
         {
-            DsiSdReadSectors(cmd);
+            ReadSectors(cmd->sector, cmd->count, cmd->buffer, dsiSdReadSectors);
             break;
         }
         case FS_IPC_CMD_DSI_SD_WRITE_SECTORS:
         {
-            DsiSdWriteSectors(cmd);
+            WriteSectors(cmd->sector, cmd->count, cmd->buffer, dsiSdWriteSectors);
+            break;
+        }
+        case FS_IPC_CMD_DLDI_READV:
+        {
+            ReadSectorsV(cmd, dldiReadSectors);
+            break;
+        }
+        case FS_IPC_CMD_DLDI_WRITEV:
+        {
+            WriteSectorsV(cmd, dldiWriteSectors);
+            break;
+        }
+        case FS_IPC_CMD_DSI_SD_READV:
+        {
+            ReadSectorsV(cmd, dsiSdReadSectors);
+            break;
+        }
+        case FS_IPC_CMD_DSI_SD_WRITEV:
+        {
+            WriteSectorsV(cmd, dsiSdWriteSectors);
             break;
         }
     }
@@ -55,26 +268,88 @@ void FsIpcService::SetupDldi(const fs_ipc_cmd_t* cmd) const
     SendResponseMessage(result);
 }
 
-void FsIpcService::DldiReadSectors(const fs_ipc_cmd_t* cmd) const
+void FsIpcService::ReadSectors(u32 sector, u32 count, void* buffer, SectorTransferFunc readFunc)
 {
-    _DLDI_readSectors_ptr(cmd->sector, cmd->count, cmd->buffer);
-    ipc_setArm7SyncBits(ipc_getArm9SyncBits());
+    u8* dst = static_cast<u8*>(buffer);
+    bool isAligned = ((u32)(uintptr_t)buffer & 3) == 0;
+    while (true)
+    {
+        u32 chunkCount;
+        if (isAligned)
+        {
+            chunkCount = GetPreemptionChunkCount(count);
+            readFunc(sector, chunkCount, dst);
+        }
+        else
+        {
+            // the drivers need word aligned buffers, read in chunks through the staging buffer
+            chunkCount = count < FS_STAGING_SECTOR_COUNT ? count : FS_STAGING_SECTOR_COUNT;
+            readFunc(sector, chunkCount, _stagingBuffer);
+            memcpy(dst, _stagingBuffer, chunkCount * 512);
+        }
+        count -= chunkCount;
+        if (count == 0)
+        {
+            return;
+        }
+        dst += chunkCount * 512;
+        sector += chunkCount;
+        ExecutePreemptingCommands();
+    }
 }
 
-void FsIpcService::DldiWriteSectors(const fs_ipc_cmd_t* cmd) const
+void FsIpcService::WriteSectors(u32 sector, u32 count, const void* buffer, SectorTransferFunc writeFunc)
 {
-    _DLDI_writeSectors_ptr(cmd->sector, cmd->count, cmd->buffer);
-    ipc_setArm7SyncBits(ipc_getArm9SyncBits());
+    const u8* src = static_cast<const u8*>(buffer);
+    bool isAligned = ((u32)(uintptr_t)buffer & 3) == 0;
+    while (true)
+    {
+        u32 chunkCount;
+        if (isAligned)
+        {
+            chunkCount = GetPreemptionChunkCount(count);
+            writeFunc(sector, chunkCount, const_cast<u8*>(src));
+        }
+        else
+        {
+            // the drivers need word aligned buffers, write in chunks through the staging buffer
+            chunkCount = count < FS_STAGING_SECTOR_COUNT ? count : FS_STAGING_SECTOR_COUNT;
+            memcpy(_stagingBuffer, src, chunkCount * 512);
+            writeFunc(sector, chunkCount, _stagingBuffer);
+        }
+        count -= chunkCount;
+        if (count == 0)
+        {
+            return;
+        }
+        src += chunkCount * 512;
+        sector += chunkCount;
+        ExecutePreemptingCommands();
+    }
 }
 
-void FsIpcService::DsiSdReadSectors(const fs_ipc_cmd_t* cmd) const
+void FsIpcService::ReadSectorsV(const fs_ipc_cmd_t* cmd, SectorTransferFunc readFunc)
 {
-    sdmmc_sdcard_readsectors(cmd->sector, cmd->count, cmd->buffer);
-    ipc_setArm7SyncBits(ipc_getArm9SyncBits());
+    auto segments = static_cast<const fs_ipc_segment_t*>(cmd->buffer);
+    for (u32 i = 0; i < cmd->count; i++)
+    {
+        if (i != 0)
+        {
+            ExecutePreemptingCommands();
+        }
+        ReadSectors(segments[i].sector, segments[i].count, segments[i].buffer, readFunc);
+    }
 }
 
-void FsIpcService::DsiSdWriteSectors(const fs_ipc_cmd_t* cmd) const
+void FsIpcService::WriteSectorsV(const fs_ipc_cmd_t* cmd, SectorTransferFunc writeFunc)
 {
-    sdmmc_sdcard_writesectors(cmd->sector, cmd->count, cmd->buffer);
-    ipc_setArm7SyncBits(ipc_getArm9SyncBits());
+    auto segments = static_cast<const fs_ipc_segment_t*>(cmd->buffer);
+    for (u32 i = 0; i < cmd->count; i++)
+    {
+        if (i != 0)
+        {
+            ExecutePreemptingCommands();
+        }
+        WriteSectors(segments[i].sector, segments[i].count, segments[i].buffer, writeFunc);
+    }
 }
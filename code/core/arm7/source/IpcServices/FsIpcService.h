@@ -1,17 +1,65 @@
 #pragma once
 #include "ThreadIpcService.h"
 #include "FsIpcCommand.h"
+#ifdef GBAR3_FS_STATS
+#include "FsIpcStats.h"
+#endif
 #include "IpcChannels.h"
 
+/// @brief The number of sectors of the staging buffer, which is used for buffers that are not word aligned.
+#define FS_STAGING_SECTOR_COUNT     4
+
 class FsIpcService : public ThreadIpcService
 {
-    u32 _threadStack[128];
+    using SectorTransferFunc = void (*)(u32 sector, u32 count, void* buffer);
+
+    u32 _threadStack[256];
+    u32 _stagingBuffer[FS_STAGING_SECTOR_COUNT * 512 / 4];
+
+    fs_ipc_ring_t* _ring = nullptr;
+
+    /// @brief Bit mask of the slots of the commands that were started and did not complete yet.
+    u32 _startedSlots = 0;
+
+    /// @brief The priority of the command that is being executed.
+    u32 _currentPriority = FS_IPC_PRIORITY_LOW;
+
+#ifdef GBAR3_FS_STATS
+    fs_ipc_stats_t* _stats = nullptr;
+
+    u32 _arrivalSequences[FS_IPC_RING_SIZE];
+    u16 _arrivalTicks[FS_IPC_RING_SIZE];
+    u32 _exitDumpWaitFrames = 0;
+
+    void RecordArrivals(const fs_ipc_ring_t* ring);
+    void RecordLatencies(u32 slot, u16 startTicks);
+#endif
 
+    void ProcessRing(fs_ipc_ring_t* ring);
+
+    /// @brief Returns whether the command in the given slot of the ring was submitted and not started yet.
+    bool IsCommandPending(const fs_ipc_ring_t* ring, u32 slot) const;
+
+    /// @brief Finds the oldest pending command of the ring with the highest priority.
+    /// @param minPriority The minimum priority of the command.
+    /// @param slot Receives the slot of the command.
+    /// @return True if a command was found, or false otherwise.
+    bool FindNextCommand(u32 minPriority, u32& slot) const;
+
+    void ExecuteRingCommand(u32 slot);
+
+    /// @brief Executes the pending commands with a higher priority than the current command.
+    void ExecutePreemptingCommands();
+
+    /// @brief Returns the number of sectors to transfer before checking for preempting commands.
+    u32 GetPreemptionChunkCount(u32 count) const;
+
+    void ExecuteCommand(const fs_ipc_cmd_t* cmd);
     void SetupDldi(const fs_ipc_cmd_t* cmd) const;
-    void DldiReadSectors(const fs_ipc_cmd_t* cmd) const;
-    void DldiWriteSectors(const fs_ipc_cmd_t* cmd) const;
-    void DsiSdReadSectors(const fs_ipc_cmd_t* cmd) const;
-    void DsiSdWriteSectors(const fs_ipc_cmd_t* cmd) const;
+    void ReadSectors(u32 sector, u32 count, void* buffer, SectorTransferFunc readFunc);
+    void WriteSectors(u32 sector, u32 count, const void* buffer, SectorTransferFunc writeFunc);
+    void ReadSectorsV(const fs_ipc_cmd_t* cmd, SectorTransferFunc readFunc);
+    void WriteSectorsV(const fs_ipc_cmd_t* cmd, SectorTransferFunc writeFunc);
 
 public:
     FsIpcService()
@@ -19,4 +67,12 @@ public:
 
     void Start() override;
     void HandleMessage(u32 data) override;
+
+#ifdef GBAR3_FS_STATS
+    void OnMessageReceived(u32 data) override;
+
+    /// @brief Requests the arm9 to dump the fs ipc statistics, should be called once per frame before exiting.
+    /// @return True when the statistics were dumped or the arm9 did not respond in time.
+    bool IsStatsDumpCompleteForExit();
+#endif
 };
@@ -1,7 +1,20 @@
 #include "common.h"
 #include "GbaSaveIpcService.h"
 
-#define SAVE_WAIT_FRAMES    10
+/// @brief The number of frames without save writes after which a dirty save is written back,
+///        when the game wrote its save only occasionally.
+#define SAVE_MIN_QUIET_FRAMES       10
+
+/// @brief The number of frames without save writes after which a dirty save is written back,
+///        when the game wrote its save in every recent frame. Such games tend to continue writing.
+#define SAVE_MAX_QUIET_FRAMES       60
+
+/// @brief The maximum number of frames for which a save write is kept in memory only,
+///        for games that never stop writing their save.
+#define SAVE_MAX_STALE_FRAMES       300
+
+/// @brief The smoothing of the write rate, as a shift. The rate follows about the last 1 << shift frames.
+#define SAVE_WRITE_RATE_SHIFT       3
 
 void GbaSaveIpcService::OnMessageReceived(u32 data)
 {
@@ -17,34 +30,52 @@ void GbaSaveIpcService::OnMessageReceived(u32 data)
     }
 }
 
+u32 GbaSaveIpcService::GetQuietFrameCount() const
+{
+    return SAVE_MIN_QUIET_FRAMES + (((SAVE_MAX_QUIET_FRAMES - SAVE_MIN_QUIET_FRAMES) * _writeRate) >> 8);
+}
+
 void GbaSaveIpcService::Update()
 {
     if (!_saveShared || _saveShared->saveDataSize == 0 || isDSiMode())
         return;
 
-    switch (_saveShared->saveState)
+    u32 saveState = _saveShared->saveState;
+    int frameRate = saveState == GBA_SAVE_STATE_DIRTY ? 256 : 0;
+    _writeRate += (frameRate - _writeRate) >> SAVE_WRITE_RATE_SHIFT;
+
+    switch (saveState)
     {
         case GBA_SAVE_STATE_CLEAN:
         {
             break;
         }
         case GBA_SAVE_STATE_DIRTY:
-        {
-            _saveShared->saveState = GBA_SAVE_STATE_WAIT;
-            _saveWaitCounter = SAVE_WAIT_FRAMES;
-            break;
-        }
         case GBA_SAVE_STATE_WAIT:
         {
-            if (--_saveWaitCounter == 0)
+            if (saveState == GBA_SAVE_STATE_DIRTY)
+            {
+                _quietFrameCount = 0;
+            }
+            else
+            {
+                _quietFrameCount++;
+            }
+
+            if (++_staleFrameCount >= SAVE_MAX_STALE_FRAMES || _quietFrameCount >= GetQuietFrameCount())
             {
                 _saveShared->saveState = GBA_SAVE_STATE_WRITE;
+                _staleFrameCount = 0;
+            }
+            else if (saveState == GBA_SAVE_STATE_DIRTY)
+            {
+                _saveShared->saveState = GBA_SAVE_STATE_WAIT;
             }
             break;
         }
         case GBA_SAVE_STATE_WRITE:
         {
-            // arm9 will set the state back to GBA_SAVE_STATE_CLEAN
+            // arm9 will set the state back to GBA_SAVE_STATE_CLEAN when it starts the write-back
             break;
         }
     }
@@ -64,7 +95,8 @@ bool GbaSaveIpcService::FlushSaveIfDirty()
         {
             case GBA_SAVE_STATE_CLEAN:
             {
-                saveIsClean = true;
+                // the arm9 may still be writing back the save
+                saveIsClean = !_saveShared->isWriteBackActive;
                 break;
             }
             case GBA_SAVE_STATE_DIRTY:
@@ -7,7 +7,16 @@
 class GbaSaveIpcService : public IpcService
 {
     gba_save_shared_t* _saveShared = nullptr;
-    u32 _saveWaitCounter;
+    /// @brief The number of frames since the last save write.
+    u32 _quietFrameCount = 0;
+
+    /// @brief The number of frames since the save became dirty after the last write-back.
+    u32 _staleFrameCount = 0;
+
+    /// @brief The fraction of recent frames in which the game wrote its save, in 1/256.
+    int _writeRate = 0;
+
+    u32 GetQuietFrameCount() const;
 
 public:
     GbaSaveIpcService()
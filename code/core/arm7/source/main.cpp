@@ -159,10 +159,17 @@ static bool performExit(ExitMode exitMode)
 
 static void updateArm7ExitRequestedState()
 {
-    if (sGbaSaveIpcService.FlushSaveIfDirty())
+    if (!sGbaSaveIpcService.FlushSaveIfDirty())
     {
-        performExit(sExitMode);
+        return;
+    }
+#ifdef GBAR3_FS_STATS
+    if (!sFsIpcService.IsStatsDumpCompleteForExit())
+    {
+        return;
     }
+#endif
+    performExit(sExitMode);
 }
 
 static void updateArm7()
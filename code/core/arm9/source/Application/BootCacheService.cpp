@@ -0,0 +1,166 @@
+#include "common.h"
+#include <memory>
+#include <stddef.h>
+#include <string.h>
+#include "Fat/File.h"
+#include "MemFastSearch.h"
+#include "Save/SaveTagScanner.h"
+#include "Settings/AppSettings.h"
+#include "Settings/Binary/BinaryAppSettingsSerializer.h"
+#include "BootCacheService.h"
+
+[[gnu::section(".ewram.bss")]]
+BootCacheService gBootCacheService;
+
+void BootCacheService::GetFileStamp(const char* path, boot_cache_file_stamp_t& stamp)
+{
+    auto fileInfo = std::make_unique<FILINFO>();
+    if (f_stat(path, fileInfo.get()) != FR_OK)
+    {
+        memset(&stamp, 0, sizeof(stamp));
+        return;
+    }
+    stamp.size = fileInfo->fsize;
+    stamp.date = fileInfo->fdate;
+    stamp.time = fileInfo->ftime;
+}
+
+void BootCacheService::Reset(const GbaHeader& romHeader, u32 romSize, const boot_cache_file_stamp_t* settingsFileStamps)
+{
+    memset(&_cache, 0, offsetof(boot_cache_t, settings));
+    _cache.magic = BOOT_CACHE_MAGIC;
+    _cache.version = BOOT_CACHE_VERSION;
+    _cache.settingsVersion = BINARY_APP_SETTINGS_VERSION;
+    _cache.gameCode = romHeader.gameCode;
+    _cache.softwareVersion = romHeader.softwareVersion;
+    _cache.headerChecksum = romHeader.headerChecksum;
+    _cache.saveTypeInfoIndex = BOOT_CACHE_SAVE_TYPE_UNKNOWN;
+    _cache.romSize = romSize;
+    memcpy(_cache.settingsFileStamps, settingsFileStamps, sizeof(_cache.settingsFileStamps));
+    _isDirty = true;
+}
+
+void BootCacheService::Open(const char* path, const GbaHeader& romHeader, u32 romSize, const char* const* settingsPaths)
+{
+    _isOpen = strlen(path) < sizeof(_path);
+    if (_isOpen)
+    {
+        strcpy(_path, path);
+    }
+    _isDirty = false;
+    _signatureSearchCount = 0;
+
+    boot_cache_file_stamp_t settingsFileStamps[BOOT_CACHE_SETTINGS_FILE_COUNT];
+    for (u32 i = 0; i < BOOT_CACHE_SETTINGS_FILE_COUNT; i++)
+    {
+        GetFileStamp(settingsPaths[i], settingsFileStamps[i]);
+    }
+
+    auto file = std::make_unique<File>();
+    u32 bytesRead = 0;
+    if (!_isOpen || file->Open(path, FA_OPEN_EXISTING | FA_READ) != FR_OK ||
+        file->Read(&_cache, sizeof(_cache), bytesRead) != FR_OK ||
+        bytesRead < offsetof(boot_cache_t, settings) ||
+        _cache.magic != BOOT_CACHE_MAGIC || _cache.version != BOOT_CACHE_VERSION ||
+        _cache.settingsVersion != BINARY_APP_SETTINGS_VERSION ||
+        _cache.gameCode != romHeader.gameCode || _cache.softwareVersion != romHeader.softwareVersion ||
+        _cache.headerChecksum != romHeader.headerChecksum || _cache.romSize != romSize ||
+        memcmp(_cache.settingsFileStamps, settingsFileStamps, sizeof(settingsFileStamps)) != 0 ||
+        _cache.signatureCount > BOOT_CACHE_MAX_SIGNATURES ||
+        _cache.settingsSize > BOOT_CACHE_MAX_SETTINGS_SIZE ||
+        bytesRead < offsetof(boot_cache_t, settings) + _cache.settingsSize)
+    {
+        // no cache yet, a cache of a different rom or the settings changed
+        Reset(romHeader, romSize, settingsFileStamps);
+    }
+}
+
+bool BootCacheService::TryRestoreAppSettings(AppSettings& appSettings) const
+{
+    return _cache.settingsSize != 0 &&
+        BinaryAppSettingsSerializer().TryDeserialize(_cache.settings, _cache.settingsSize, appSettings);
+}
+
+void BootCacheService::StoreAppSettings(const AppSettings& appSettings)
+{
+    _cache.settingsSize = BinaryAppSettingsSerializer().Serialize(appSettings, _cache.settings, sizeof(_cache.settings));
+    _isDirty = true;
+}
+
+bool BootCacheService::TryGetSaveType(const SaveTypeInfo*& saveTypeInfo, u32& tagRomAddress) const
+{
+    if (_cache.saveTypeInfoIndex == BOOT_CACHE_SAVE_TYPE_UNKNOWN)
+    {
+        return false;
+    }
+    if (_cache.saveTypeInfoIndex == BOOT_CACHE_SAVE_TYPE_NONE)
+    {
+        saveTypeInfo = nullptr;
+        tagRomAddress = 0;
+        return true;
+    }
+    saveTypeInfo = SaveTagScanner::GetSaveTypeInfo(_cache.saveTypeInfoIndex);
+    tagRomAddress = _cache.tagRomAddress;
+    return saveTypeInfo != nullptr;
+}
+
+void BootCacheService::StoreSaveType(const SaveTypeInfo* saveTypeInfo, u32 tagRomAddress)
+{
+    _cache.saveTypeInfoIndex = saveTypeInfo
+        ? SaveTagScanner::GetSaveTypeInfoIndex(saveTypeInfo)
+        : BOOT_CACHE_SAVE_TYPE_NONE;
+    _cache.tagRomAddress = tagRomAddress;
+    _isDirty = true;
+}
+
+const u32* BootCacheService::FindSignature16(const u32* data, u32 dataLength, const u32* signature)
+{
+    u32 index = _signatureSearchCount++;
+    if (index < _cache.signatureCount && _cache.signatureDataLength == dataLength &&
+        memcmp(_cache.signatures[index].signature, signature, 16) == 0)
+    {
+        u32 offset = _cache.signatures[index].offset;
+        if (offset == BOOT_CACHE_SIGNATURE_NOT_FOUND)
+        {
+            return nullptr;
+        }
+        const u32* result = (const u32*)((const u8*)data + offset);
+        if (offset <= dataLength - 16 && memcmp(result, signature, 16) == 0)
+        {
+            return result;
+        }
+    }
+
+    // the searches of this boot differ from the cached ones from here on
+    const u32* result = mem_fastSearch16(data, dataLength, signature);
+    if (index == 0)
+    {
+        _cache.signatureDataLength = dataLength;
+    }
+    if (index < BOOT_CACHE_MAX_SIGNATURES && _cache.signatureDataLength == dataLength)
+    {
+        memcpy(_cache.signatures[index].signature, signature, 16);
+        _cache.signatures[index].offset = result ? (const u8*)result - (const u8*)data : BOOT_CACHE_SIGNATURE_NOT_FOUND;
+        _cache.signatureCount = index + 1;
+        _isDirty = true;
+    }
+    return result;
+}
+
+void BootCacheService::Save()
+{
+    if (!_isOpen || !_isDirty)
+    {
+        return;
+    }
+
+    auto file = std::make_unique<File>();
+    if (file->Open(_path, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK)
+    {
+        return;
+    }
+    u32 bytesWritten = 0;
+    file->Write(&_cache, offsetof(boot_cache_t, settings) + _cache.settingsSize, bytesWritten);
+    file->Close();
+    _isDirty = false;
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include "common.h"
+#include "GbaHeader.h"
+#include "Save/SaveTypeInfo.h"
+
+class AppSettings;
+
+// The boot cache stores the results of the boot steps that only depend on the rom and the settings
+// files: the resolved settings, the detected save type and the offsets found by the signature searches
+// of the save and rom patches. On a warm boot these are applied directly. The cache of a rom is keyed
+// by its game code, header checksum and size, and is discarded when a settings file changed.
+
+#define BOOT_CACHE_MAGIC                0x544F4F42 // BOOT
+#define BOOT_CACHE_VERSION              1
+#define BOOT_CACHE_SETTINGS_FILE_COUNT  2
+#define BOOT_CACHE_MAX_SIGNATURES       16
+#define BOOT_CACHE_MAX_SETTINGS_SIZE    1024
+
+/// @brief The save type of a cache that has not been detected yet.
+#define BOOT_CACHE_SAVE_TYPE_UNKNOWN    0xFFFF
+/// @brief The save type of a rom without save tag.
+#define BOOT_CACHE_SAVE_TYPE_NONE       0xFFFE
+/// @brief The offset of a signature that was not found.
+#define BOOT_CACHE_SIGNATURE_NOT_FOUND  0xFFFFFFFF
+
+/// @brief Identifies the version of a settings file. All zero when the file does not exist.
+typedef struct
+{
+    u32 size;
+    u16 date;
+    u16 time;
+} boot_cache_file_stamp_t;
+
+/// @brief The result of a signature search.
+typedef struct
+{
+    u32 signature[4];
+    /// @brief The offset of the signature in the searched data, or BOOT_CACHE_SIGNATURE_NOT_FOUND.
+    u32 offset;
+} boot_cache_signature_t;
+
+/// @brief The boot cache file.
+typedef struct
+{
+    u32 magic;
+    u16 version;
+    u16 settingsVersion;
+    u32 gameCode;
+    u8 softwareVersion;
+    u8 headerChecksum;
+    u16 saveTypeInfoIndex;
+    u32 romSize;
+    boot_cache_file_stamp_t settingsFileStamps[BOOT_CACHE_SETTINGS_FILE_COUNT];
+    u32 tagRomAddress;
+    /// @brief The length of the data that was searched for the signatures.
+    u32 signatureDataLength;
+    u32 signatureCount;
+    boot_cache_signature_t signatures[BOOT_CACHE_MAX_SIGNATURES];
+    /// @brief The size of the serialized settings, or 0 when they are not cached.
+    u32 settingsSize;
+    u8 settings[BOOT_CACHE_MAX_SETTINGS_SIZE];
+} boot_cache_t;
+
+class BootCacheService
+{
+    boot_cache_t _cache;
+    char _path[32];
+    bool _isOpen = false;
+    bool _isDirty = false;
+    /// @brief The number of signature searches since Open, which is the index of the next search in the cache.
+    u32 _signatureSearchCount = 0;
+
+    static void GetFileStamp(const char* path, boot_cache_file_stamp_t& stamp);
+    void Reset(const GbaHeader& romHeader, u32 romSize, const boot_cache_file_stamp_t* settingsFileStamps);
+
+public:
+    /// @brief Loads the boot cache of the given rom from the given path. The cache is
+    ///        started anew when it does not exist, belongs to a different rom or when
+    ///        one of the settings files changed.
+    /// @param path The path of the boot cache file.
+    /// @param romHeader The header of the rom.
+    /// @param romSize The size of the rom in bytes.
+    /// @param settingsPaths The paths of the BOOT_CACHE_SETTINGS_FILE_COUNT settings files.
+    void Open(const char* path, const GbaHeader& romHeader, u32 romSize, const char* const* settingsPaths);
+
+    /// @brief Restores the cached settings.
+    /// @return True if successful, or false when no settings were cached.
+    bool TryRestoreAppSettings(AppSettings& appSettings) const;
+
+    /// @brief Stores the resolved settings in the cache.
+    void StoreAppSettings(const AppSettings& appSettings);
+
+    /// @brief Gets the cached save type.
+    /// @param saveTypeInfo Set to the save type information, or nullptr when the rom has no save tag.
+    /// @param tagRomAddress Set to the rom address of the save tag.
+    /// @return True if the save type was cached.
+    bool TryGetSaveType(const SaveTypeInfo*& saveTypeInfo, u32& tagRomAddress) const;
+
+    /// @brief Stores the detected save type in the cache.
+    void StoreSaveType(const SaveTypeInfo* saveTypeInfo, u32 tagRomAddress);
+
+    /// @brief Searches for the given 16 byte signature like mem_fastSearch16. The signature searches of
+    ///        a boot are replayed from the cache in the same order, a cached offset is only used when the
+    ///        signature is still at that offset.
+    /// @param data A 32 bit aligned pointer to the data to search in.
+    /// @param dataLength The length of the data to search in in bytes.
+    /// @param signature The 16 byte signature to search for.
+    /// @return When successful returns a pointer to the found signature in data, or nullptr otherwise.
+    const u32* FindSignature16(const u32* data, u32 dataLength, const u32* signature);
+
+    /// @brief Writes the cache to its file when it changed since Open.
+    void Save();
+};
+
+extern BootCacheService gBootCacheService;
@@ -0,0 +1,133 @@
+#include "common.h"
+#include <memory>
+#include <string.h>
+#include <type_traits>
+#include "../AppSettings.h"
+#include "BinaryAppSettingsSerializer.h"
+
+static_assert(std::is_trivially_copyable_v<DisplaySettings>);
+static_assert(std::is_trivially_copyable_v<GameSettings>);
+
+class BinaryWriter
+{
+    u8* _buffer;
+    u32 _bufferSize;
+    u32 _position = 0;
+    bool _isOverflow = false;
+
+public:
+    BinaryWriter(u8* buffer, u32 bufferSize)
+        : _buffer(buffer), _bufferSize(bufferSize) { }
+
+    void WriteBytes(const void* data, u32 length)
+    {
+        if (_isOverflow || length > _bufferSize - _position)
+        {
+            _isOverflow = true;
+            return;
+        }
+        memcpy(_buffer + _position, data, length);
+        _position += length;
+    }
+
+    template <typename T>
+    void Write(const T& value) { WriteBytes(&value, sizeof(T)); }
+
+    u32 GetLength() const { return _isOverflow ? 0 : _position; }
+};
+
+class BinaryReader
+{
+    const u8* _data;
+    u32 _length;
+    u32 _position = 0;
+
+public:
+    BinaryReader(const u8* data, u32 length)
+        : _data(data), _length(length) { }
+
+    bool TryReadBytes(void* data, u32 length)
+    {
+        if (length > _length - _position)
+        {
+            return false;
+        }
+        memcpy(data, _data + _position, length);
+        _position += length;
+        return true;
+    }
+
+    template <typename T>
+    bool TryRead(T& value) { return TryReadBytes(&value, sizeof(T)); }
+};
+
+static void writeAddresses(BinaryWriter& writer, const std::unique_ptr<u32[]>& addresses, u32 addressCount)
+{
+    writer.Write(addressCount);
+    if (addressCount != 0)
+    {
+        writer.WriteBytes(addresses.get(), addressCount * sizeof(u32));
+    }
+}
+
+static bool tryReadAddresses(BinaryReader& reader, std::unique_ptr<u32[]>& addresses, u32& addressCount)
+{
+    u32 count;
+    if (!reader.TryRead(count))
+    {
+        return false;
+    }
+    if (count == 0)
+    {
+        addresses.reset();
+        addressCount = 0;
+        return true;
+    }
+    auto newAddresses = std::make_unique<u32[]>(count);
+    if (!reader.TryReadBytes(newAddresses.get(), count * sizeof(u32)))
+    {
+        return false;
+    }
+    addresses = std::move(newAddresses);
+    addressCount = count;
+    return true;
+}
+
+u32 BinaryAppSettingsSerializer::Serialize(const AppSettings& appSettings, u8* buffer, u32 bufferSize) const
+{
+    BinaryWriter writer(buffer, bufferSize);
+    writer.Write(appSettings.displaySettings);
+
+    const auto& runSettings = appSettings.runSettings;
+    writeAddresses(writer, runSettings.jitPatchAddresses, runSettings.jitPatchAddressCount);
+    writer.Write(runSettings.enableWramInstructionCache);
+    writer.Write(runSettings.enableEWramDataCache);
+    writeAddresses(writer, runSettings.selfModifyingPatchAddresses, runSettings.selfModifyingPatchAddressCount);
+    writer.Write(runSettings.skipBiosIntro);
+    writer.Write(runSettings.sdCacheReplacementPolicy);
+    writer.Write(runSettings.enableSdCacheReadAhead);
+    writer.Write(runSettings.sdCacheReadAheadDepth);
+    writer.Write(runSettings.enableSdCacheProfile);
+    writer.Write(runSettings.sdCacheSize);
+
+    writer.Write(appSettings.gameSettings);
+    return writer.GetLength();
+}
+
+bool BinaryAppSettingsSerializer::TryDeserialize(const u8* data, u32 length, AppSettings& appSettings) const
+{
+    BinaryReader reader(data, length);
+    auto& runSettings = appSettings.runSettings;
+    return reader.TryRead(appSettings.displaySettings)
+        && tryReadAddresses(reader, runSettings.jitPatchAddresses, runSettings.jitPatchAddressCount)
+        && reader.TryRead(runSettings.enableWramInstructionCache)
+        && reader.TryRead(runSettings.enableEWramDataCache)
+        && tryReadAddresses(reader, runSettings.selfModifyingPatchAddresses, runSettings.selfModifyingPatchAddressCount)
+        && reader.TryRead(runSettings.skipBiosIntro)
+        && reader.TryRead(runSettings.sdCacheReplacementPolicy)
+        && reader.TryRead(runSettings.enableSdCacheReadAhead)
+        && reader.TryRead(runSettings.sdCacheReadAheadDepth)
+        && reader.TryRead(runSettings.enableSdCacheProfile)
+        && reader.TryRead(runSettings.sdCacheSize)
+        && reader.TryRead(appSettings.gameSettings);
+}
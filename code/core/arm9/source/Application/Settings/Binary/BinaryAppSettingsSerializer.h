@@ -0,0 +1,26 @@
+#pragma once
+
+class AppSettings;
+
+/// @brief The version of the binary settings format, which must be increased when a setting is added.
+#define BINARY_APP_SETTINGS_VERSION 1
+
+/// @brief Serializes resolved settings to a compact binary form, such that they can be cached
+///        without parsing the json settings files again.
+class BinaryAppSettingsSerializer
+{
+public:
+    /// @brief Serializes the given settings.
+    /// @param appSettings The settings to serialize.
+    /// @param buffer The buffer to serialize to.
+    /// @param bufferSize The size of the buffer in bytes.
+    /// @return The number of bytes that were written, or 0 when the buffer is too small.
+    u32 Serialize(const AppSettings& appSettings, u8* buffer, u32 bufferSize) const;
+
+    /// @brief Deserializes settings that were serialized with Serialize.
+    /// @param data The serialized settings.
+    /// @param length The length of the serialized settings in bytes.
+    /// @param appSettings The settings to deserialize to.
+    /// @return True if successful, or false when the data is incomplete.
+    bool TryDeserialize(const u8* data, u32 length, AppSettings& appSettings) const;
+};
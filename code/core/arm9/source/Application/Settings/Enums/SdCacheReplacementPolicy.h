@@ -0,0 +1,14 @@
+#pragma once
+
+/// @brief Enum representing the replacement policy used by the sd cache.
+enum class SdCacheReplacementPolicy
+{
+    /// @brief Cache blocks are replaced pseudo-randomly.
+    Random,
+
+    /// @brief Cache blocks are replaced using the CLOCK (second-chance) algorithm.
+    Clock,
+
+    /// @brief Cache blocks are replaced using segmented LRU.
+    SegmentedLru
+};
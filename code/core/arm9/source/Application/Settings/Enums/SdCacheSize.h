@@ -0,0 +1,19 @@
+#pragma once
+
+/// @brief Enum representing the size of the sd cache. The sd cache and the linear part
+///        of the rom share 3MB of main memory, so a larger sd cache shrinks the linear part.
+enum class SdCacheSize
+{
+    /// @brief Selects the split from the rom size. Roms up to 3MB are loaded completely with either
+    ///        split, so the 2MB linear part is used, which is accessed without sd cache lookups.
+    ///        That split is kept up to 8MB, as the code at the start of the rom then stays linear.
+    ///        Roms larger than 8MB typically stream large assets, such as audio and video, through
+    ///        the sd cache, so they get the 2MB sd cache to keep more of those blocks cached.
+    Auto,
+
+    /// @brief A 1MB sd cache and a 2MB linear part of the rom.
+    OneMegabyte,
+
+    /// @brief A 2MB sd cache and a 1MB linear part of the rom.
+    TwoMegabytes
+};
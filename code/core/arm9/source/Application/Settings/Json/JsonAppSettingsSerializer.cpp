@@ -25,6 +25,11 @@
 #define KEY_RUN_SETTINGS_ENABLE_EWRAM_DCACHE                "enableEWramDCache"
 #define KEY_RUN_SETTINGS_SELF_MODIFYING_PATCH_ADDRESSES     "selfModifyingPatchAddresses"
 #define KEY_RUN_SETTINGS_SKIP_BIOS_INTRO                    "skipBiosIntro"
+#define KEY_RUN_SETTINGS_SD_CACHE_REPLACEMENT_POLICY        "sdCacheReplacementPolicy"
+#define KEY_RUN_SETTINGS_ENABLE_SD_CACHE_READ_AHEAD         "enableSdCacheReadAhead"
+#define KEY_RUN_SETTINGS_SD_CACHE_READ_AHEAD_DEPTH          "sdCacheReadAheadDepth"
+#define KEY_RUN_SETTINGS_ENABLE_SD_CACHE_PROFILE           "enableSdCacheProfile"
+#define KEY_RUN_SETTINGS_SD_CACHE_SIZE                      "sdCacheSize"
 
 #define KEY_GAME_SETTINGS                           "gameSettings"
 #define KEY_GAME_SETTINGS_SAVE_TYPE                 "saveType"
@@ -42,6 +47,14 @@
 #define ENUM_STRING_GBA_SAVE_TYPE_AUTO              "auto"
 #define ENUM_STRING_GBA_SAVE_TYPE_NONE              "none"
 
+#define ENUM_STRING_SD_CACHE_REPLACEMENT_POLICY_RANDOM          "random"
+#define ENUM_STRING_SD_CACHE_REPLACEMENT_POLICY_CLOCK           "clock"
+#define ENUM_STRING_SD_CACHE_REPLACEMENT_POLICY_SEGMENTED_LRU   "slru"
+
+#define ENUM_STRING_SD_CACHE_SIZE_AUTO              "auto"
+#define ENUM_STRING_SD_CACHE_SIZE_1MB               "1mb"
+#define ENUM_STRING_SD_CACHE_SIZE_2MB               "2mb"
+
 static bool tryParseGbaScreen(const char* gbaScreenString, GbaScreen& gbaScreen)
 {
     if (!gbaScreenString)
@@ -104,6 +117,40 @@ static bool tryParseGbaSaveType(const char* gbaSaveTypeString, GbaSaveType& gbaS
     return true;
 }
 
+static bool tryParseSdCacheReplacementPolicy(const char* policyString, SdCacheReplacementPolicy& policy)
+{
+    if (!policyString)
+        return false;
+
+    if (!strcasecmp(policyString, ENUM_STRING_SD_CACHE_REPLACEMENT_POLICY_RANDOM))
+        policy = SdCacheReplacementPolicy::Random;
+    else if (!strcasecmp(policyString, ENUM_STRING_SD_CACHE_REPLACEMENT_POLICY_CLOCK))
+        policy = SdCacheReplacementPolicy::Clock;
+    else if (!strcasecmp(policyString, ENUM_STRING_SD_CACHE_REPLACEMENT_POLICY_SEGMENTED_LRU))
+        policy = SdCacheReplacementPolicy::SegmentedLru;
+    else
+        return false;
+
+    return true;
+}
+
+static bool tryParseSdCacheSize(const char* sizeString, SdCacheSize& size)
+{
+    if (!sizeString)
+        return false;
+
+    if (!strcasecmp(sizeString, ENUM_STRING_SD_CACHE_SIZE_AUTO))
+        size = SdCacheSize::Auto;
+    else if (!strcasecmp(sizeString, ENUM_STRING_SD_CACHE_SIZE_1MB))
+        size = SdCacheSize::OneMegabyte;
+    else if (!strcasecmp(sizeString, ENUM_STRING_SD_CACHE_SIZE_2MB))
+        size = SdCacheSize::TwoMegabytes;
+    else
+        return false;
+
+    return true;
+}
+
 static void readBoolSetting(const JsonVariantConst& jsonValue, bool16& setting)
 {
     setting = jsonValue | static_cast<bool>(setting);
@@ -200,6 +247,15 @@ static void readRunSettings(const JsonObjectConst& json, RunSettings& runSetting
     readBoolSetting(json[KEY_RUN_SETTINGS_ENABLE_EWRAM_DCACHE], runSettings.enableEWramDataCache);
     tryParseSelfModifyingPatchAddresses(json[KEY_RUN_SETTINGS_SELF_MODIFYING_PATCH_ADDRESSES], runSettings);
     readBoolSetting(json[KEY_RUN_SETTINGS_SKIP_BIOS_INTRO], runSettings.skipBiosIntro);
+    tryParseSdCacheReplacementPolicy(json[KEY_RUN_SETTINGS_SD_CACHE_REPLACEMENT_POLICY], runSettings.sdCacheReplacementPolicy);
+    readBoolSetting(json[KEY_RUN_SETTINGS_ENABLE_SD_CACHE_READ_AHEAD], runSettings.enableSdCacheReadAhead);
+    if (json[KEY_RUN_SETTINGS_SD_CACHE_READ_AHEAD_DEPTH].is<int>())
+    {
+        runSettings.sdCacheReadAheadDepth = std::clamp(json[KEY_RUN_SETTINGS_SD_CACHE_READ_AHEAD_DEPTH].as<int>(),
+            RUN_SETTINGS_SD_CACHE_READ_AHEAD_DEPTH_MIN, RUN_SETTINGS_SD_CACHE_READ_AHEAD_DEPTH_MAX);
+    }
+    readBoolSetting(json[KEY_RUN_SETTINGS_ENABLE_SD_CACHE_PROFILE], runSettings.enableSdCacheProfile);
+    tryParseSdCacheSize(json[KEY_RUN_SETTINGS_SD_CACHE_SIZE], runSettings.sdCacheSize);
 }
 
 static void readGameSettings(const JsonObjectConst& json, GameSettings& gameSettings)
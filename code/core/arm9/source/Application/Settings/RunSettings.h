@@ -1,6 +1,11 @@
 #pragma once
 #include "common.h"
 #include <memory>
+#include "Enums/SdCacheReplacementPolicy.h"
+#include "Enums/SdCacheSize.h"
+
+#define RUN_SETTINGS_SD_CACHE_READ_AHEAD_DEPTH_MIN  1
+#define RUN_SETTINGS_SD_CACHE_READ_AHEAD_DEPTH_MAX  8
 
 class RunSettings
 {
@@ -25,4 +30,21 @@ public:
 
     /// @brief Specifies whether the bios boot animation should be skipped.
     bool16 skipBiosIntro = false;
+
+    /// @brief Specifies the replacement policy of the sd cache.
+    SdCacheReplacementPolicy sdCacheReplacementPolicy = SdCacheReplacementPolicy::Clock;
+
+    /// @brief Specifies whether the sd cache should read ahead when rom blocks are accessed sequentially.
+    bool16 enableSdCacheReadAhead = true;
+
+    /// @brief Specifies the maximum number of rom blocks the sd cache reads ahead of a sequential stream.
+    ///        Should be a value between 1 and 8.
+    u16 sdCacheReadAheadDepth = 2;
+
+    /// @brief Specifies whether a per-game profile of frequently accessed rom blocks should be
+    ///        recorded and used to fill the sd cache at boot.
+    bool16 enableSdCacheProfile = true;
+
+    /// @brief Specifies the size of the sd cache, which determines the size of the linear part of the rom.
+    SdCacheSize sdCacheSize = SdCacheSize::Auto;
 };
@@ -15,6 +15,21 @@ static bool detectIsNitroEmulator()
     return true;
 }
 
+static bool detectExtendedMainMemory()
+{
+    // with 4MB of main memory both addresses are mirrors of 0x02000000 (uncached at this point)
+    vu32* const first = (vu32*)0x02400000;
+    vu32* const second = (vu32*)0x02C00000;
+    u32 firstValue = *first;
+    u32 secondValue = *second;
+    *first = 0x3152454D; // MER1
+    *second = 0x3252454D; // MER2
+    bool isExtended = *first == 0x3152454D;
+    *second = secondValue;
+    *first = firstValue;
+    return isExtended;
+}
+
 static bool detectNocashPrintSuppport()
 {
     u32 nocashIdentifier = *(vu32*)0x04FFFA00;
@@ -27,6 +42,8 @@ void Environment::Initialize()
     if (((*(vu32*)0x04004000) & 3) == 1)
     {
         _flags |= ENVIRONMENT_FLAGS_DSI_MODE;
+        if (detectExtendedMainMemory())
+            _flags |= ENVIRONMENT_FLAGS_EXTENDED_MAIN_MEMORY;
     }
     else
     {
@@ -29,21 +29,47 @@ updateDisplayCaptureVramD:
 
 checkSaveWrite:
     str r13, jumpToCaptureUpdate
+#ifdef GBAR3_SDC_TRACE
+    ldr sp,= dtcmIrqStackEnd
+    push {r0-r3,r12}
+    bl sdc_traceVBlank
+    pop {r0-r3,r12}
+#endif
+#ifdef GBAR3_FS_STATS
+    ldr sp,= dtcmIrqStackEnd
+    push {r0-r3,r12}
+    bl fs_statsVBlank
+    pop {r0-r3,r12}
+#endif
+#ifndef GBAR3_TEST
+    ldr r13,= gSdcProfileWritePending
+    ldrb lr, [r13]
+    cmp lr, #0
+    bne writeSdCacheProfile
+#endif
 .global emu_vblankIrqSkipSaveCheckInstruction
 emu_vblankIrqSkipSaveCheckInstruction:
     b emu_vblankIrqReturn
 #ifndef GBAR3_TEST
     ldr r13,= gGbaSaveShared
     mcr p15, 0, r13, c7, c6, 1 // invalidate range
-    ldrb lr, [r13]
+    ldrh lr, [r13] // saveState | isWriteBackActive << 8
     cmp lr, #3 // GBA_SAVE_STATE_WRITE
-    bne emu_vblankIrqReturn
+    cmpne lr, #0x100 // write-back in progress
+    blo emu_vblankIrqReturn
 
     ldr sp,= dtcmIrqStackEnd
     push {r0-r3,r12}
-    bl sav_writeSaveToFile
+    bl sav_updateWriteBack
     pop {r0-r3,r12}
     b emu_vblankIrqReturn
+
+writeSdCacheProfile:
+    ldr sp,= dtcmIrqStackEnd
+    push {r0-r3,r12}
+    bl sdc_writeProfileFromVBlank
+    pop {r0-r3,r12}
+    b emu_vblankIrqSkipSaveCheckInstruction
 #endif
 
 jumpToUpdateDisplayCaptureVramDInstruction:
@@ -1,56 +1,158 @@
 #include "common.h"
 #include <libtwl/ipc/ipcFifoSystem.h>
 #include <libtwl/ipc/ipcFifo.h>
-#include <libtwl/ipc/ipcSync.h>
 #include <string.h>
 #include "IpcChannels.h"
 #include "FsIpcCommand.h"
 #include "cp15.h"
 #include "Cpsr.h"
 #include "VirtualMachine/VMNestedIrq.h"
+#include "SdCache/SdCacheStats.h"
 #include "FsIpc.h"
+#include "FsStats.h"
 
 [[gnu::section(".ewram.bss")]]
-alignas(32) static fs_ipc_cmd_t sIpcCommand;
+static fs_ipc_ring_t sIpcRing;
 [[gnu::section(".ewram.bss")]]
 alignas(32) static u8 sTempBuffers[2][512];
 
-static FsWaitToken* volatile sCurrentWaitToken = nullptr;
+/// @brief The sequence number of the next command to submit.
+static u32 sNextSequence;
 
-static bool isArm7FsOperationComplete()
+/// @brief The sequence number of the most recent command of each slot.
+static u32 sSlotSequences[FS_IPC_RING_SIZE];
+
+/// @brief Bit mask of the slots of which the arm9 did not observe the completion of the command yet.
+static u32 sBusySlots;
+
+static bool sIsIpcRingInitialized;
+
+static void initializeIpcRing()
 {
-    u32 ipcSync = REG_IPCSYNC;
-    return ((ipcSync >> IPCSYNC_LOCAL_DATA_SHIFT) & 0xF) == (ipcSync & IPCSYNC_REMOTE_DATA_MASK);
+    sIpcRing.cmd = FS_IPC_CMD_PROCESS_RING;
+    sIpcRing.submitSequence = 0;
+#ifdef GBAR3_FS_STATS
+    sIpcRing.stats = fs_statsInitialize();
+#endif
+    for (u32 i = 0; i < FS_IPC_RING_SIZE; i++)
+    {
+        // the slots are free, as if they held commands before sequence number 0 that completed
+        sIpcRing.commands[i].sequence = i - FS_IPC_RING_SIZE;
+        sIpcRing.completeSequences[i] = i - FS_IPC_RING_SIZE;
+        sSlotSequences[i] = i - FS_IPC_RING_SIZE;
+    }
+    dc_flushRange(&sIpcRing, sizeof(sIpcRing));
+    sNextSequence = 0;
+    sBusySlots = 0;
+    sIsIpcRingInitialized = true;
 }
 
-extern "C"
-[[gnu::noinline]]
-u32 fs_waitForCompletion(FsWaitToken* waitToken, bool keepIrqsDisabled)
+/// @brief Returns whether the command with the given sequence number in the given slot completed.
+///        The completion sequences must have been invalidated in the data cache.
+static bool isSequenceComplete(u32 slot, u32 sequence)
 {
-    u32 irqs = arm_disableIrqs();
-    while (true)
+    // a slot is only reused once its command completed, so later completions of the slot are later commands
+    return (s32)(sIpcRing.completeSequences[slot] - sequence) >= 0;
+}
+
+/// @brief Frees the slots of which the command completed since the last check. The arm7 completes
+///        the commands by priority, so they can complete out of submission order.
+///        The completion sequences must have been invalidated in the data cache.
+static void updateBusySlots()
+{
+    u32 busySlots = sBusySlots;
+    while (busySlots != 0)
     {
-        if (waitToken && waitToken->transactionComplete)
-        {
-            break;
-        }
-        FsWaitToken* currentWaitToken = sCurrentWaitToken;
-        if (!currentWaitToken)
+        u32 slot = __builtin_ctz(busySlots);
+        busySlots &= busySlots - 1;
+        if (isSequenceComplete(slot, sSlotSequences[slot]))
         {
-            break;
-        }
-        else if (isArm7FsOperationComplete())
-        {
-            currentWaitToken->transactionComplete = true;
-            sCurrentWaitToken = nullptr;
-            break;
+#ifdef GBAR3_FS_STATS
+            fs_statsRecordObservation(sIpcRing.commands[slot].cmd, slot);
+#endif
+            sBusySlots &= ~(1 << slot);
         }
+    }
+}
+
+/// @brief Returns whether the given wait condition holds. Irqs must be disabled.
+/// @param waitToken The wait token of a transaction, or null to check whether all submitted transactions completed.
+static bool isWaitComplete(FsWaitToken* waitToken)
+{
+    if (waitToken && waitToken->transactionComplete)
+    {
+        return true;
+    }
+    if (!sIsIpcRingInitialized)
+    {
+        // nothing was submitted yet
+        return true;
+    }
+    dc_invalidateRange((void*)sIpcRing.completeSequences, sizeof(sIpcRing.completeSequences));
+    updateBusySlots();
+    if (!waitToken)
+    {
+        return sBusySlots == 0;
+    }
+    if (!isSequenceComplete(waitToken->slot, waitToken->sequence))
+    {
+        return false;
+    }
+    waitToken->transactionComplete = true;
+    return true;
+}
+
+/// @brief Returns whether a slot of the ring is free. Irqs must be disabled.
+static bool isSlotFree(FsWaitToken* waitToken)
+{
+    if (sBusySlots != (1 << FS_IPC_RING_SIZE) - 1)
+    {
+        return true;
+    }
+    dc_invalidateRange((void*)sIpcRing.completeSequences, sizeof(sIpcRing.completeSequences));
+    updateBusySlots();
+    return sBusySlots != (1 << FS_IPC_RING_SIZE) - 1;
+}
+
+/// @brief Waits until the given wait condition holds. Gba irqs are handled in the meantime
+///        when irqs were enabled.
+/// @param isWaitConditionMet The wait condition, which is checked with irqs disabled.
+/// @param waitToken The argument of the wait condition.
+/// @return The irq state to restore. Irqs are disabled when this function returns.
+static u32 waitUntil(bool (*isWaitConditionMet)(FsWaitToken*), FsWaitToken* waitToken)
+{
+    u32 irqs = arm_disableIrqs();
+#ifdef GBAR3_SDC_STATS
+    bool waited = false;
+    u32 startTime = sdc_statsGetTime();
+#endif
+    while (!isWaitConditionMet(waitToken))
+    {
+#ifdef GBAR3_SDC_STATS
+        waited = true;
+        sdc_statsGetTime(); // keep the time base advancing during long waits
+#endif
         if (!(irqs & 0x80) && !vm_yieldGbaIrqs())
         {
             arm_restoreIrqs(irqs);
             irqs = arm_disableIrqs();
         }
     }
+#ifdef GBAR3_SDC_STATS
+    if (waited)
+    {
+        gSdcStats.fsWaitCount++;
+        gSdcStats.fsWaitTime += sdc_statsGetTime() - startTime;
+    }
+#endif
+    return irqs;
+}
+
+extern "C"
+[[gnu::noinline]]
+u32 fs_waitForCompletion(FsWaitToken* waitToken, bool keepIrqsDisabled)
+{
+    u32 irqs = waitUntil(isWaitComplete, waitToken);
     if (!keepIrqsDisabled)
     {
         arm_restoreIrqs(irqs);
@@ -63,54 +165,113 @@ extern "C" u32 fs_waitForCompletionOfCurrentTransaction(bool keepIrqsDisabled)
     return fs_waitForCompletion(nullptr, keepIrqsDisabled);
 }
 
-static void sendIpcCommand()
+extern "C" bool fs_isTransactionComplete(FsWaitToken* waitToken)
 {
-    dc_flushRange(&sIpcCommand, sizeof(sIpcCommand));
-    ipc_setArm9SyncBits(ipc_getArm7SyncBits() + 1);
-    ipc_sendWordDirect(((((u32)&sIpcCommand) >> 2) << IPC_FIFO_MSG_CHANNEL_BITS) | IPC_CHANNEL_FS);
+    if (waitToken->transactionComplete)
+    {
+        return true;
+    }
+    u32 irqs = arm_disableIrqs();
+    bool isComplete = isWaitComplete(waitToken);
+    arm_restoreIrqs(irqs);
+    return isComplete;
 }
 
-static void executeIpcCommandAsync(u32 cmd, void* buffer, u32 sector, u32 count, FsWaitToken* waitToken)
+static void executeIpcCommandAsync(u32 cmd, void* buffer, u32 sector, u32 count, FsPriority priority, FsWaitToken* waitToken)
 {
     waitToken->transactionComplete = false;
-    u32 irqs = fs_waitForCompletion(nullptr, true);
+    u32 irqs = arm_disableIrqs();
+    if (!sIsIpcRingInitialized)
+    {
+        initializeIpcRing();
+    }
+    arm_restoreIrqs(irqs);
+
+    // any slot will do, the arm7 orders the commands by their sequence numbers
+    irqs = waitUntil(isSlotFree, nullptr);
     {
-        sIpcCommand.cmd = cmd;
-        sIpcCommand.buffer = buffer;
-        sIpcCommand.sector = sector;
-        sIpcCommand.count = count;
-        sendIpcCommand();
-        sCurrentWaitToken = waitToken;
+        // no other command can take the slot while irqs are disabled
+        u32 slot = __builtin_ctz(~sBusySlots);
+        u32 sequence = sNextSequence++;
+        sBusySlots |= 1 << slot;
+        sSlotSequences[slot] = sequence;
+        fs_ipc_cmd_t* ipcCommand = &sIpcRing.commands[slot];
+        ipcCommand->cmd = cmd;
+        ipcCommand->buffer = buffer;
+        ipcCommand->sector = sector;
+        ipcCommand->count = count;
+        ipcCommand->priority = priority;
+        ipcCommand->sequence = sequence;
+        dc_flushRange(ipcCommand, sizeof(fs_ipc_cmd_t));
+        waitToken->sequence = sequence;
+        waitToken->slot = slot;
+        sIpcRing.submitSequence = sNextSequence;
+        dc_flushRange(&sIpcRing, 32);
+        // the arm7 processes all submitted commands for a single message
+        ipc_sendWordDirect(((((u32)(uintptr_t)&sIpcRing) >> 2) << IPC_FIFO_MSG_CHANNEL_BITS) | IPC_CHANNEL_FS);
     }
     arm_restoreIrqs(irqs);
 }
 
-extern "C" void fs_readCacheAlignedSectorsAsync(FsDevice device, void* buffer, u32 sector, u32 count, FsWaitToken* waitToken)
+extern "C" void fs_readCacheAlignedSectorsAsync(FsDevice device, void* buffer, u32 sector, u32 count, FsPriority priority, FsWaitToken* waitToken)
 {
     dc_invalidateRange(buffer, 512 * count);
     executeIpcCommandAsync(
         device == FS_DEVICE_DLDI ? FS_IPC_CMD_DLDI_READ_SECTORS : FS_IPC_CMD_DSI_SD_READ_SECTORS,
-        buffer, sector, count, waitToken);
+        buffer, sector, count, priority, waitToken);
+}
+
+static bool isInMainMemory(const void* buffer)
+{
+    return ((u32)(uintptr_t)buffer >> 24) == 2;
 }
 
-static void readSectorsNotCacheAligned(FsDevice device, void* buffer, u32 sector, u32 count)
+static void readSectorsThroughTempBuffers(FsDevice device, void* buffer, u32 sector, u32 count)
 {
-    sIpcCommand.cmd = device == FS_DEVICE_DLDI ? FS_IPC_CMD_DLDI_READ_SECTORS : FS_IPC_CMD_DSI_SD_READ_SECTORS;
-    sIpcCommand.count = 1;
-    // not cache aligned, use a temp buffer
+    u32 cmd = device == FS_DEVICE_DLDI ? FS_IPC_CMD_DLDI_READ_SECTORS : FS_IPC_CMD_DSI_SD_READ_SECTORS;
+    // the next sector is read while copying the previous one
+    FsWaitToken waitTokens[2];
     dc_invalidateRange(sTempBuffers[0], 512);
+    executeIpcCommandAsync(cmd, sTempBuffers[0], sector, 1, FS_PRIORITY_LOW, &waitTokens[0]);
     for (u32 i = 0; i < count; i++)
     {
-        sIpcCommand.buffer = sTempBuffers[i & 1];
-        sIpcCommand.sector = sector + i;
-        sendIpcCommand();
-        if (i != 0)
-            memcpy((u8*)buffer + 512 * (i - 1), sTempBuffers[(i - 1) & 1], 512);
         if (i != count - 1)
+        {
             dc_invalidateRange(sTempBuffers[(i + 1) & 1], 512);
-        while (!isArm7FsOperationComplete());
+            executeIpcCommandAsync(cmd, sTempBuffers[(i + 1) & 1], sector + i + 1, 1, FS_PRIORITY_LOW, &waitTokens[(i + 1) & 1]);
+        }
+        fs_waitForCompletion(&waitTokens[i & 1], false);
+        memcpy((u8*)buffer + 512 * i, sTempBuffers[i & 1], 512);
     }
-    memcpy((u8*)buffer + 512 * (count - 1), sTempBuffers[(count - 1) & 1], 512);
+}
+
+static void readSectorsToUnalignedBuffer(FsDevice device, void* buffer, u32 sector, u32 count)
+{
+    if (count <= 2)
+    {
+        // every sector shares a cache line with the memory around the buffer
+        readSectorsThroughTempBuffers(device, buffer, sector, count);
+        return;
+    }
+
+    // Only the first and last sector share a cache line with the memory around the buffer. Those lines
+    // may be dirty or be written during the read, so the arm7 must not write them behind the back of the
+    // cache and these sectors are bounced through the temp buffers. The cache lines of the sectors in
+    // between are entirely inside the buffer, the arm7 writes those directly.
+    u32 cmd = device == FS_DEVICE_DLDI ? FS_IPC_CMD_DLDI_READ_SECTORS : FS_IPC_CMD_DSI_SD_READ_SECTORS;
+    u8* middle = (u8*)buffer + 512;
+    FsWaitToken waitTokens[3];
+    dc_invalidateRange(sTempBuffers[0], 512);
+    dc_invalidateRange(sTempBuffers[1], 512);
+    dc_invalidateRange(middle, 512 * (count - 2));
+    executeIpcCommandAsync(cmd, sTempBuffers[0], sector, 1, FS_PRIORITY_LOW, &waitTokens[0]);
+    executeIpcCommandAsync(cmd, middle, sector + 1, count - 2, FS_PRIORITY_LOW, &waitTokens[1]);
+    executeIpcCommandAsync(cmd, sTempBuffers[1], sector + count - 1, 1, FS_PRIORITY_LOW, &waitTokens[2]);
+    fs_waitForCompletion(&waitTokens[0], false);
+    memcpy(buffer, sTempBuffers[0], 512);
+    fs_waitForCompletion(&waitTokens[2], false);
+    memcpy(middle + 512 * (count - 2), sTempBuffers[1], 512);
+    fs_waitForCompletion(&waitTokens[1], false);
 }
 
 extern "C" void fs_readSectors(FsDevice device, void* buffer, u32 sector, u32 count)
@@ -118,60 +279,95 @@ extern "C" void fs_readSectors(FsDevice device, void* buffer, u32 sector, u32 co
     if (count == 0)
         return;
 
-    if (((u32)buffer >> 24) != 2 || ((u32)buffer & 0x1F))
+    if (!isInMainMemory(buffer))
     {
-        readSectorsNotCacheAligned(device, buffer, sector, count);
+        // the arm7 cannot access the buffer
+        readSectorsThroughTempBuffers(device, buffer, sector, count);
+    }
+    else if ((u32)(uintptr_t)buffer & 0x1F)
+    {
+        readSectorsToUnalignedBuffer(device, buffer, sector, count);
     }
     else
     {
         FsWaitToken waitToken;
-        fs_readCacheAlignedSectorsAsync(device, buffer, sector, count, &waitToken);
+        fs_readCacheAlignedSectorsAsync(device, buffer, sector, count, FS_PRIORITY_LOW, &waitToken);
         fs_waitForCompletion(&waitToken, false);
     }
 }
 
-extern "C" void fs_writeCacheAlignedSectorsAsync(FsDevice device, const void* buffer, u32 sector, u32 count, FsWaitToken* waitToken)
+extern "C" void fs_writeCacheAlignedSectorsAsync(FsDevice device, const void* buffer, u32 sector, u32 count, FsPriority priority, FsWaitToken* waitToken)
 {
     dc_flushRange(buffer, 512 * count);
     executeIpcCommandAsync(
         device == FS_DEVICE_DLDI ? FS_IPC_CMD_DLDI_WRITE_SECTORS : FS_IPC_CMD_DSI_SD_WRITE_SECTORS,
-        (void*)buffer, sector, count, waitToken);
+        (void*)buffer, sector, count, priority, waitToken);
 }
 
-static void writeSectorsNotCacheAligned(FsDevice device, const void* buffer, u32 sector, u32 count)
+static_assert(sizeof(FsSegment) == sizeof(fs_ipc_segment_t), "FsSegment must match fs_ipc_segment_t");
+static_assert((u32)FS_PRIORITY_LOW == (u32)FS_IPC_PRIORITY_LOW, "FsPriority must match FsIpcPriority");
+static_assert((u32)FS_PRIORITY_PREFETCH == (u32)FS_IPC_PRIORITY_PREFETCH, "FsPriority must match FsIpcPriority");
+static_assert((u32)FS_PRIORITY_ROM_MISS == (u32)FS_IPC_PRIORITY_ROM_MISS, "FsPriority must match FsIpcPriority");
+
+extern "C" void fs_readCacheAlignedSectorsVAsync(FsDevice device, const FsSegment* segments, u32 segmentCount, FsPriority priority, FsWaitToken* waitToken)
 {
-    sIpcCommand.cmd = device == FS_DEVICE_DLDI ? FS_IPC_CMD_DLDI_WRITE_SECTORS : FS_IPC_CMD_DSI_SD_WRITE_SECTORS;
-    sIpcCommand.count = 1;
-    // not cache aligned, use a temp buffer
-    memcpy(sTempBuffers[0], (u8*)buffer, 512);
-    dc_flushRange(sTempBuffers[0], 512);
+    for (u32 i = 0; i < segmentCount; i++)
+    {
+        dc_invalidateRange(segments[i].buffer, 512 * segments[i].count);
+    }
+    dc_flushRange(segments, sizeof(FsSegment) * segmentCount);
+    executeIpcCommandAsync(
+        device == FS_DEVICE_DLDI ? FS_IPC_CMD_DLDI_READV : FS_IPC_CMD_DSI_SD_READV,
+        (void*)segments, 0, segmentCount, priority, waitToken);
+}
+
+extern "C" void fs_writeCacheAlignedSectorsVAsync(FsDevice device, const FsSegment* segments, u32 segmentCount, FsPriority priority, FsWaitToken* waitToken)
+{
+    for (u32 i = 0; i < segmentCount; i++)
+    {
+        dc_flushRange(segments[i].buffer, 512 * segments[i].count);
+    }
+    dc_flushRange(segments, sizeof(FsSegment) * segmentCount);
+    executeIpcCommandAsync(
+        device == FS_DEVICE_DLDI ? FS_IPC_CMD_DLDI_WRITEV : FS_IPC_CMD_DSI_SD_WRITEV,
+        (void*)segments, 0, segmentCount, priority, waitToken);
+}
+
+static void writeSectorsOutsideMainMemory(FsDevice device, const void* buffer, u32 sector, u32 count)
+{
+    u32 cmd = device == FS_DEVICE_DLDI ? FS_IPC_CMD_DLDI_WRITE_SECTORS : FS_IPC_CMD_DSI_SD_WRITE_SECTORS;
+    // the arm7 cannot access the buffer, use a temp buffer, the next sector is copied while writing the previous one
+    FsWaitToken waitTokens[2];
     for (u32 i = 0; i < count; i++)
     {
-        sIpcCommand.buffer = sTempBuffers[i & 1];
-        sIpcCommand.sector = sector + i;
-        sendIpcCommand();
-        if (i != count - 1)
+        if (i >= 2)
         {
-            memcpy(sTempBuffers[(i + 1) & 1], (u8*)buffer + 512 * (i + 1), 512);
-            dc_flushRange(sTempBuffers[(i + 1) & 1], 512);
+            // the temp buffer is still in use by the write of sector i - 2
+            fs_waitForCompletion(&waitTokens[i & 1], false);
         }
-        while (!isArm7FsOperationComplete());
+        memcpy(sTempBuffers[i & 1], (const u8*)buffer + 512 * i, 512);
+        dc_flushRange(sTempBuffers[i & 1], 512);
+        executeIpcCommandAsync(cmd, sTempBuffers[i & 1], sector + i, 1, FS_PRIORITY_LOW, &waitTokens[i & 1]);
+    }
+    for (u32 i = count >= 2 ? count - 2 : 0; i < count; i++)
+    {
+        fs_waitForCompletion(&waitTokens[i & 1], false);
     }
-    memcpy((u8*)buffer + 512 * (count - 1), sTempBuffers[(count - 1) & 1], 512);
 }
 
 extern "C" void fs_writeSectors(FsDevice device, const void* buffer, u32 sector, u32 count)
 {
     if (count == 0)
         return;
-    if (((u32)buffer >> 24) != 2 || ((u32)buffer & 0x1F))
+    if (!isInMainMemory(buffer))
     {
-        writeSectorsNotCacheAligned(device, buffer, sector, count);
+        writeSectorsOutsideMainMemory(device, buffer, sector, count);
     }
     else
     {
+        // cleaning the cache is fine for unaligned buffers, the arm7 stages them itself
         FsWaitToken waitToken;
-        fs_writeCacheAlignedSectorsAsync(device, buffer, sector, count, &waitToken);
+        fs_writeCacheAlignedSectorsAsync(device, buffer, sector, count, FS_PRIORITY_LOW, &waitToken);
         fs_waitForCompletion(&waitToken, false);
     }
 }
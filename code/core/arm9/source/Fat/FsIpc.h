@@ -6,24 +6,92 @@ typedef enum
     FS_DEVICE_DSI_SD
 } FsDevice;
 
+/// @brief Priorities of sd transactions. Pending transactions with a higher priority are executed first
+///        and long transactions with a lower priority are interrupted for them. Transactions with
+///        different priorities must not access the same sectors.
+typedef enum
+{
+    /// @brief File system traffic, such as save, log and settings writes.
+    FS_PRIORITY_LOW,
+
+    /// @brief Speculative rom reads, such as read-ahead and profile warmup.
+    FS_PRIORITY_PREFETCH,
+
+    /// @brief Rom reads on which the emulation is stalled.
+    FS_PRIORITY_ROM_MISS
+} FsPriority;
+
 /// @brief Struct used to track completion of an async sd read or write.
 typedef struct
 {
+    /// @brief The sequence number of the fs ipc command of the transaction.
+    u32 sequence;
+
+    /// @brief Set once the completion of the transaction was observed.
     vu16 transactionComplete;
+
+    /// @brief The slot of the fs ipc command of the transaction in the fs ipc ring.
+    u16 slot;
 } FsWaitToken;
 
+/// @brief A run of consecutive sd sectors of a scatter-gather transfer.
+typedef struct
+{
+    u32 sector;
+    u32 count;
+    void* buffer;
+} FsSegment;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/// @brief Reads sectors synchronously with FS_PRIORITY_LOW. Buffers in main memory are accessed by the arm7 directly,
+///        except for sectors that share a cache line with the memory around the buffer. Those sectors
+///        and buffers outside main memory are bounced through main memory.
 void fs_readSectors(FsDevice device, void* buffer, u32 sector, u32 count);
+
+/// @brief Writes sectors synchronously with FS_PRIORITY_LOW. Buffers in main memory are accessed by the arm7 directly,
+///        also when they are not cache aligned. Other buffers are bounced through main memory.
 void fs_writeSectors(FsDevice device, const void* buffer, u32 sector, u32 count);
 
-void fs_readCacheAlignedSectorsAsync(FsDevice device, void* buffer, u32 sector, u32 count, FsWaitToken* waitToken);
-void fs_writeCacheAlignedSectorsAsync(FsDevice device, const void* buffer, u32 sector, u32 count, FsWaitToken* waitToken);
+void fs_readCacheAlignedSectorsAsync(FsDevice device, void* buffer, u32 sector, u32 count, FsPriority priority, FsWaitToken* waitToken);
+void fs_writeCacheAlignedSectorsAsync(FsDevice device, const void* buffer, u32 sector, u32 count, FsPriority priority, FsWaitToken* waitToken);
+
+/// @brief Starts reading a list of sector runs with a single transaction, which the arm7
+///        executes without involving the arm9 in between.
+/// @param device The device to read from.
+/// @param segments The sector runs and their cache aligned buffers. The list must be in
+///                 main memory as well and stay valid until the transaction completed.
+/// @param segmentCount The number of segments.
+/// @param priority The priority of the transaction.
+/// @param waitToken The wait token of the transaction.
+void fs_readCacheAlignedSectorsVAsync(FsDevice device, const FsSegment* segments, u32 segmentCount, FsPriority priority, FsWaitToken* waitToken);
+
+/// @brief Starts writing a list of sector runs with a single transaction, which the arm7
+///        executes without involving the arm9 in between.
+/// @param device The device to write to.
+/// @param segments The sector runs and their cache aligned buffers. The list must be in
+///                 main memory as well and stay valid until the transaction completed.
+/// @param segmentCount The number of segments.
+/// @param priority The priority of the transaction.
+/// @param waitToken The wait token of the transaction.
+void fs_writeCacheAlignedSectorsVAsync(FsDevice device, const FsSegment* segments, u32 segmentCount, FsPriority priority, FsWaitToken* waitToken);
+/// @brief Waits for the completion of the transaction of the given wait token. Transactions can
+///        complete in any order, other transactions may still be pending when this function returns.
+/// @param waitToken The wait token of the transaction, or null to wait for all submitted transactions.
+/// @param keepIrqsDisabled True to return with irqs disabled.
+/// @return The irq state to restore when keepIrqsDisabled is true.
 u32 fs_waitForCompletion(FsWaitToken* waitToken, bool keepIrqsDisabled);
+
+/// @brief Waits for the completion of all submitted transactions.
 u32 fs_waitForCompletionOfCurrentTransaction(bool keepIrqsDisabled);
 
+/// @brief Returns whether the transaction of the given wait token completed, without waiting for it.
+/// @param waitToken The wait token of the transaction.
+/// @return True if the transaction completed.
+bool fs_isTransactionComplete(FsWaitToken* waitToken);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,172 @@
+#include "common.h"
+
+#ifdef GBAR3_FS_STATS
+
+#include <memory>
+#include <string.h>
+#include <mini-printf.h>
+#include "cp15.h"
+#include "SdCache/SdCacheProfile.h"
+#include "FsIpcStats.h"
+#include "ff.h"
+#include "FsStats.h"
+
+#define FS_STATS_FILE_PATH      "/_gba/cache/fsstats.txt"
+#define FS_STATS_BUFFER_SIZE    4096
+
+#define REG_VCOUNT              (*(vu16*)0x04000006)
+#define REG_KEYINPUT            (*(vu16*)0x04000130)
+#define SCANLINES_PER_FRAME     263
+
+/// @brief L + R + Select + Down, in the bit order of REG_KEYINPUT.
+#define FS_STATS_DUMP_KEYS      ((1 << 9) | (1 << 8) | (1 << 7) | (1 << 2))
+
+/// @brief The statistics shared with the arm7.
+[[gnu::section(".ewram.bss")]]
+static fs_ipc_stats_t sFsIpcStats;
+
+/// @brief The histograms of the observe and total stages, which are measured by the arm9.
+[[gnu::section(".ewram.bss")]]
+static fs_stats_histogram_t sArm9Histograms[FS_STATS_STAGE_COUNT - FS_STATS_STAGE_OBSERVE];
+
+[[gnu::section(".ewram.bss"), gnu::aligned(32)]]
+static FIL sStatsFile;
+
+static bool sDumpKeysHeld;
+static bool sExitDumpPending;
+
+static const char* const sStageNames[FS_STATS_STAGE_COUNT] =
+{
+    "queue (arm7 message arrival to start)",
+    "driver (start to completion)",
+    "observe (completion to arm9 observation)",
+    "total (arm7 message arrival to arm9 observation)"
+};
+
+static const char* const sCommandNames[FS_STATS_COMMAND_COUNT] =
+{
+    "dldi setup",
+    "dldi read",
+    "dldi write",
+    "dsi sd read",
+    "dsi sd write",
+    "process ring",
+    "dldi readv",
+    "dldi writev",
+    "dsi sd readv",
+    "dsi sd writev"
+};
+
+extern "C" fs_ipc_stats_t* fs_statsInitialize(void)
+{
+    memset(&sFsIpcStats, 0, sizeof(sFsIpcStats));
+    memset(sArm9Histograms, 0, sizeof(sArm9Histograms));
+    // from now on only the arm7 writes to the shared part
+    dc_flushRange(&sFsIpcStats, sizeof(sFsIpcStats));
+    return &sFsIpcStats;
+}
+
+extern "C" void fs_statsRecordObservation(u32 cmd, u32 slot)
+{
+    dc_invalidateRange(&sFsIpcStats, 64);
+    u32 scanlines = REG_VCOUNT + SCANLINES_PER_FRAME - sFsIpcStats.completeScanlines[slot];
+    if (scanlines >= SCANLINES_PER_FRAME)
+    {
+        scanlines -= SCANLINES_PER_FRAME;
+    }
+    // 63.56 microseconds per scanline, completions observed more than a frame later wrap around
+    u32 observeTime = (scanlines * 1017) >> 4;
+    u32 totalTime = sFsIpcStats.serviceTimes[slot] + observeTime;
+    sArm9Histograms[FS_STATS_STAGE_OBSERVE - FS_STATS_STAGE_OBSERVE][cmd][fs_statsGetBucket(observeTime)]++;
+    sArm9Histograms[FS_STATS_STAGE_TOTAL - FS_STATS_STAGE_OBSERVE][cmd][fs_statsGetBucket(totalTime)]++;
+}
+
+extern "C" void fs_statsVBlank(void)
+{
+    bool dumpKeysHeld = (~REG_KEYINPUT & FS_STATS_DUMP_KEYS) == FS_STATS_DUMP_KEYS;
+    if (dumpKeysHeld && !sDumpKeysHeld)
+    {
+        gSdcProfileWritePending = true;
+    }
+    sDumpKeysHeld = dumpKeysHeld;
+
+    if (!sExitDumpPending)
+    {
+        dc_invalidateRange(&sFsIpcStats, 64);
+        if (sFsIpcStats.dumpRequested)
+        {
+            sExitDumpPending = true;
+            gSdcProfileWritePending = true;
+        }
+    }
+}
+
+static const fs_stats_histogram_t& getHistogram(u32 stage)
+{
+    return stage < FS_STATS_STAGE_OBSERVE
+        ? sFsIpcStats.arm7Histograms[stage]
+        : sArm9Histograms[stage - FS_STATS_STAGE_OBSERVE];
+}
+
+static u32 formatStats(char* buffer, u32 bufferSize)
+{
+    u32 length = 0;
+    for (u32 stage = 0; stage < FS_STATS_STAGE_COUNT && length < bufferSize; stage++)
+    {
+        length += mini_snprintf(buffer + length, bufferSize - length, "%s:\n", sStageNames[stage]);
+        const auto& histogram = getHistogram(stage);
+        for (u32 cmd = 0; cmd < FS_STATS_COMMAND_COUNT && length < bufferSize; cmd++)
+        {
+            u32 count = 0;
+            for (u32 bucket = 0; bucket < FS_STATS_BUCKET_COUNT; bucket++)
+            {
+                count += histogram[cmd][bucket];
+            }
+            if (count == 0)
+            {
+                continue;
+            }
+
+            // bucket i starts at 2^i microseconds
+            length += mini_snprintf(buffer + length, bufferSize - length, "  %s: %u\n   ", sCommandNames[cmd], count);
+            for (u32 bucket = 0; bucket < FS_STATS_BUCKET_COUNT && length < bufferSize; bucket++)
+            {
+                if (histogram[cmd][bucket] != 0)
+                {
+                    length += mini_snprintf(buffer + length, bufferSize - length,
+                        " %uus: %u", bucket == 0 ? 0 : 1u << bucket, histogram[cmd][bucket]);
+                }
+            }
+            if (length < bufferSize)
+            {
+                length += mini_snprintf(buffer + length, bufferSize - length, "\n");
+            }
+        }
+    }
+
+    return length < bufferSize ? length : bufferSize - 1;
+}
+
+extern "C" void fs_dumpStats(void)
+{
+    dc_invalidateRange(&sFsIpcStats, sizeof(sFsIpcStats));
+    auto buffer = std::make_unique<char[]>(FS_STATS_BUFFER_SIZE);
+    u32 length = formatStats(buffer.get(), FS_STATS_BUFFER_SIZE);
+    gLogger->Log(LogLevel::Info, "%s", buffer.get());
+
+    if (f_open(&sStatsFile, FS_STATS_FILE_PATH, FA_CREATE_ALWAYS | FA_WRITE) == FR_OK)
+    {
+        UINT bytesWritten = 0;
+        f_write(&sStatsFile, buffer.get(), length, &bytesWritten);
+        f_close(&sStatsFile);
+    }
+
+    if (sExitDumpPending)
+    {
+        // let the arm7 continue exiting
+        sFsIpcStats.dumpComplete = true;
+        dc_flushRange((const void*)&sFsIpcStats.dumpComplete, 32);
+    }
+}
+
+#endif
@@ -0,0 +1,31 @@
+#pragma once
+
+// Fs ipc latency statistics are only compiled in when building with GBAR3_FS_STATS (make FS_STATS=1)
+
+#ifdef GBAR3_FS_STATS
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Clears the statistics, must be called before the arm7 can access them.
+/// @return The statistics to share with the arm7 through the fs ipc ring.
+struct fs_ipc_stats_t* fs_statsInitialize(void);
+
+/// @brief Records the arm9 side latencies of a command of which the arm9 observed the completion.
+/// @param cmd The fs ipc command.
+/// @param slot The slot of the command in the fs ipc ring.
+void fs_statsRecordObservation(u32 cmd, u32 slot);
+
+/// @brief Requests a dump of the statistics when the dump key combo was pressed
+///        or the arm7 is about to exit. Called from the vblank irq.
+void fs_statsVBlank(void);
+
+/// @brief Writes the statistics to the log and to a file on the sd card.
+void fs_dumpStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -8,8 +8,217 @@
 #include "FsIpc.h"
 #include "diskio.h"
 
+/// @brief The number of sectors of the sector cache of the dldi and dsi sd devices.
+#define DISK_CACHE_SECTOR_COUNT     16
+
+/// @brief A sector of the sector cache.
+struct DiskCacheEntry
+{
+    DWORD sector;
+    u32 lastAccess;
+    BYTE pdrv;
+    bool isValid;
+    bool isDirty;
+    bool isFat;
+};
+
 static u32 sAgbMem;
 
+[[gnu::section(".ewram.bss"), gnu::aligned(32)]]
+static u8 sDiskCacheData[DISK_CACHE_SECTOR_COUNT][512];
+
+static DiskCacheEntry sDiskCacheEntries[DISK_CACHE_SECTOR_COUNT];
+static u32 sDiskCacheAccessCounter;
+
+/// @brief The sectors of the FATs of DEV_FAT and DEV_SD.
+static DWORD sFatStart[2];
+static DWORD sFatEnd[2];
+
+DiskCacheStats gDiskCacheStats;
+
+static bool isCachedDevice(BYTE pdrv)
+{
+    return pdrv == DEV_FAT || pdrv == DEV_SD;
+}
+
+static FsDevice getFsDevice(BYTE pdrv)
+{
+    return pdrv == DEV_FAT ? FS_DEVICE_DLDI : FS_DEVICE_DSI_SD;
+}
+
+static int findCacheEntry(BYTE pdrv, DWORD sector)
+{
+    for (int i = 0; i < DISK_CACHE_SECTOR_COUNT; i++)
+    {
+        const auto& entry = sDiskCacheEntries[i];
+        if (entry.isValid && entry.pdrv == pdrv && entry.sector == sector)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void writeBackCacheEntry(int index)
+{
+    auto& entry = sDiskCacheEntries[index];
+    if (entry.isValid && entry.isDirty)
+    {
+        fs_writeSectors(getFsDevice(entry.pdrv), sDiskCacheData[index], entry.sector, 1);
+        entry.isDirty = false;
+    }
+}
+
+/// @brief Returns the cache entry to replace. This is the least recently used entry,
+///        where entries that hold a sector of a FAT are only replaced if all entries do.
+static int selectCacheEntryToReplace()
+{
+    int leastRecentlyUsed = -1;
+    int leastRecentlyUsedFat = -1;
+    for (int i = 0; i < DISK_CACHE_SECTOR_COUNT; i++)
+    {
+        const auto& entry = sDiskCacheEntries[i];
+        if (!entry.isValid)
+        {
+            return i;
+        }
+
+        int& candidate = entry.isFat ? leastRecentlyUsedFat : leastRecentlyUsed;
+        if (candidate == -1 || (s32)(entry.lastAccess - sDiskCacheEntries[candidate].lastAccess) < 0)
+        {
+            candidate = i;
+        }
+    }
+    return leastRecentlyUsed != -1 ? leastRecentlyUsed : leastRecentlyUsedFat;
+}
+
+static int allocateCacheEntry(BYTE pdrv, DWORD sector)
+{
+    int index = selectCacheEntryToReplace();
+    writeBackCacheEntry(index);
+    auto& entry = sDiskCacheEntries[index];
+    entry.sector = sector;
+    entry.pdrv = pdrv;
+    entry.isValid = true;
+    entry.isDirty = false;
+    entry.isFat = sector >= sFatStart[pdrv] && sector < sFatEnd[pdrv];
+    return index;
+}
+
+static void touchCacheEntry(int index)
+{
+    sDiskCacheEntries[index].lastAccess = ++sDiskCacheAccessCounter;
+}
+
+static void readSectorsCached(BYTE pdrv, BYTE* buff, DWORD sector, UINT count)
+{
+    gDiskCacheStats.readCount++;
+    if (count == 1)
+    {
+        // single sectors are mostly FAT and directory sectors, that are read repeatedly
+        int index = findCacheEntry(pdrv, sector);
+        if (index == -1)
+        {
+            index = allocateCacheEntry(pdrv, sector);
+            fs_readSectors(getFsDevice(pdrv), sDiskCacheData[index], sector, 1);
+            gDiskCacheStats.ipcReadCount++;
+        }
+        touchCacheEntry(index);
+        memcpy(buff, sDiskCacheData[index], 512);
+        return;
+    }
+
+    // larger reads are file data, which bypasses the cache
+    fs_readSectors(getFsDevice(pdrv), buff, sector, count);
+    gDiskCacheStats.ipcReadCount++;
+    for (int i = 0; i < DISK_CACHE_SECTOR_COUNT; i++)
+    {
+        const auto& entry = sDiskCacheEntries[i];
+        if (entry.isValid && entry.isDirty && entry.pdrv == pdrv && entry.sector - sector < count)
+        {
+            // not written back yet, so newer than the sector on the disk
+            memcpy(buff + (entry.sector - sector) * 512, sDiskCacheData[i], 512);
+        }
+    }
+}
+
+static void writeSectorsCached(BYTE pdrv, const BYTE* buff, DWORD sector, UINT count)
+{
+    if (count == 1)
+    {
+        int index = findCacheEntry(pdrv, sector);
+        if (index == -1)
+        {
+            // the whole sector is overwritten, so there is no need to read it
+            index = allocateCacheEntry(pdrv, sector);
+        }
+        touchCacheEntry(index);
+        memcpy(sDiskCacheData[index], buff, 512);
+        sDiskCacheEntries[index].isDirty = true;
+        return;
+    }
+
+    fs_writeSectors(getFsDevice(pdrv), buff, sector, count);
+    for (int i = 0; i < DISK_CACHE_SECTOR_COUNT; i++)
+    {
+        auto& entry = sDiskCacheEntries[i];
+        if (entry.isValid && entry.pdrv == pdrv && entry.sector - sector < count)
+        {
+            // superseded by the write
+            entry.isValid = false;
+        }
+    }
+}
+
+/// @brief Drops the cached sectors of the given drive without writing them back.
+static void invalidateCache(BYTE pdrv)
+{
+    for (int i = 0; i < DISK_CACHE_SECTOR_COUNT; i++)
+    {
+        if (sDiskCacheEntries[i].pdrv == pdrv)
+        {
+            sDiskCacheEntries[i].isValid = false;
+        }
+    }
+}
+
+static void flushCache(BYTE pdrv)
+{
+    for (int i = 0; i < DISK_CACHE_SECTOR_COUNT; i++)
+    {
+        if (sDiskCacheEntries[i].pdrv == pdrv)
+        {
+            writeBackCacheEntry(i);
+        }
+    }
+}
+
+extern "C" void disk_setFatRegion(BYTE pdrv, DWORD sector, DWORD count)
+{
+    if (isCachedDevice(pdrv))
+    {
+        sFatStart[pdrv] = sector;
+        sFatEnd[pdrv] = sector + count;
+    }
+}
+
+extern "C" void disk_writeSegmentsAsync(BYTE pdrv, const FsSegment* segments, UINT count, FsPriority priority, FsWaitToken* waitToken)
+{
+    for (u32 i = 0; i < count; i++)
+    {
+        for (int j = 0; j < DISK_CACHE_SECTOR_COUNT; j++)
+        {
+            auto& entry = sDiskCacheEntries[j];
+            if (entry.isValid && entry.pdrv == pdrv && entry.sector - segments[i].sector < segments[i].count)
+            {
+                // superseded by the write
+                entry.isValid = false;
+            }
+        }
+    }
+    fs_writeCacheAlignedSectorsVAsync(getFsDevice(pdrv), segments, count, priority, waitToken);
+}
+
 extern "C" DSTATUS disk_status(BYTE pdrv)
 {
     return 0;
@@ -17,6 +226,12 @@ extern "C" DSTATUS disk_status(BYTE pdrv)
 
 extern "C" DSTATUS disk_initialize(BYTE pdrv)
 {
+    if (isCachedDevice(pdrv))
+    {
+        // the drive may hold a different medium when it is mounted again
+        invalidateCache(pdrv);
+    }
+
     if (pdrv == DEV_FAT)
     {
         // already initialized by the bootstrapper
@@ -38,14 +253,9 @@ extern "C" DSTATUS disk_initialize(BYTE pdrv)
 
 extern "C" DRESULT disk_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
 {
-    if (pdrv == DEV_FAT)
+    if (isCachedDevice(pdrv))
     {
-        fs_readSectors(FS_DEVICE_DLDI, buff, sector, count);
-        return RES_OK;
-    }
-    else if (pdrv == DEV_SD)
-    {
-        fs_readSectors(FS_DEVICE_DSI_SD, buff, sector, count);
+        readSectorsCached(pdrv, buff, sector, count);
         return RES_OK;
     }
     else if (pdrv == DEV_PC)
@@ -71,14 +281,9 @@ extern "C" DRESULT disk_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
 
 extern "C" DRESULT disk_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
 {
-    if (pdrv == DEV_FAT)
-    {
-        fs_writeSectors(FS_DEVICE_DLDI, buff, sector, count);
-        return RES_OK;
-    }
-    else if (pdrv == DEV_SD)
+    if (isCachedDevice(pdrv))
     {
-        fs_writeSectors(FS_DEVICE_DSI_SD, buff, sector, count);
+        writeSectorsCached(pdrv, buff, sector, count);
         return RES_OK;
     }
     else if (pdrv == DEV_PC)
@@ -104,5 +309,9 @@ extern "C" DRESULT disk_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT co
 
 extern "C" DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff)
 {
+    if (cmd == CTRL_SYNC && isCachedDevice(pdrv))
+    {
+        flushCache(pdrv);
+    }
     return RES_OK;
 }
@@ -5,6 +5,8 @@
 #ifndef _DISKIO_DEFINED
 #define _DISKIO_DEFINED
 
+#include "FsIpc.h"
+
 #define DEV_FAT     0 //dldi
 #define DEV_SD      1 //dsi sd
 #define DEV_PC      2 //image on pc via agb semihosting
@@ -36,6 +38,22 @@ DRESULT disk_read (BYTE pdrv, BYTE* buff, DWORD sector, UINT count);
 DRESULT disk_write (BYTE pdrv, const BYTE* buff, DWORD sector, UINT count);
 DRESULT disk_ioctl (BYTE pdrv, BYTE cmd, void* buff);
 
+/* Marks the sectors of the FATs, which the sector cache keeps preferentially */
+void disk_setFatRegion (BYTE pdrv, DWORD sector, DWORD count);
+
+/* Starts writing a list of sector runs of the dldi or dsi sd device past the sector cache.
+   Cached copies of the sectors are dropped, the segments and buffers must stay valid until
+   the write completed. Used for sectors that are not accessed through FatFs meanwhile. */
+void disk_writeSegmentsAsync (BYTE pdrv, const FsSegment* segments, UINT count, FsPriority priority, FsWaitToken* waitToken);
+
+/* Statistics of the sector cache of the dldi and dsi sd devices */
+typedef struct {
+	DWORD readCount;		/* Number of disk_read calls */
+	DWORD ipcReadCount;		/* Number of reads that were sent to the arm7 */
+} DiskCacheStats;
+
+extern DiskCacheStats gDiskCacheStats;
+
 
 /* Disk Status Bits (DSTATUS) */
 
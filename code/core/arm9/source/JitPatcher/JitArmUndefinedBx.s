@@ -33,6 +33,7 @@ ensureJittedCommon:
     tst r8, #1
         orrne r10, r10, #0x20 // thumb bit
     sub r9, r8, #ROM_LINEAR_DS_ADDRESS
+    rom_linear_end_patch
     cmp r9, #ROM_LINEAR_SIZE
     blo ensureJittedStaticRom
     mov r9, r8, lsr #24
@@ -19,6 +19,7 @@
             add r8, r11, #4
             cmp r11, #ROM_LINEAR_DS_ADDRESS
             blo jit_armUndefinedLdrPcImmCommon
+            rom_linear_end_patch
             cmp r11, #ROM_LINEAR_END_DS_ADDRESS
             bhs jit_armUndefinedLdrPcImmCommon
             add r8, r8, #(ROM_LINEAR_GBA_ADDRESS - ROM_LINEAR_DS_ADDRESS)
@@ -17,9 +17,9 @@ u32 jit_getJitBitsOffset(const void* ptr)
     u32 jitBitsOffset;
     u32 offset;
 
-    if ((u32)ptr >= ROM_LINEAR_DS_ADDRESS && (u32)ptr < ROM_LINEAR_END_DS_ADDRESS)
+    if ((u32)ptr >= ROM_LINEAR_DS_ADDRESS && (u32)ptr < ROM_LINEAR_MAX_END_DS_ADDRESS)
     {
-        // static rom region
+        // static rom region, including the sd cache extension behind the linear part of the rom
         jitBitsOffset = offsetof(jit_state_t, staticRomJitBits);
         offset = (u32)ptr - ROM_LINEAR_DS_ADDRESS;
     }
@@ -68,6 +68,11 @@ void* jit_findBlockStart(const void* ptr)
         // static rom region
         return (void*)ROM_LINEAR_DS_ADDRESS;
     }
+    else if ((u32)ptr >= ROM_LINEAR_END_DS_ADDRESS && (u32)ptr < ROM_LINEAR_MAX_END_DS_ADDRESS)
+    {
+        // sd cache extension
+        return (void*)((u32)ptr & ~SDC_BLOCK_MASK);
+    }
     // no significant block boundary
     return (void*)0;
 }
@@ -84,6 +89,11 @@ void* jit_findBlockEnd(const void* ptr)
         // static rom region
         return (void*)ROM_LINEAR_END_DS_ADDRESS;
     }
+    else if ((u32)ptr >= ROM_LINEAR_END_DS_ADDRESS && (u32)ptr < ROM_LINEAR_MAX_END_DS_ADDRESS)
+    {
+        // sd cache extension
+        return (void*)(((u32)ptr & ~SDC_BLOCK_MASK) + SDC_BLOCK_SIZE);
+    }
     // no significant block boundary
     return (void*)0xFFFFFFFF;
 }
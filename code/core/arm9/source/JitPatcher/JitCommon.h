@@ -3,7 +3,8 @@
 typedef struct
 {
     /// @brief Stores for each halfword in the statically loaded part of the rom
-    ///        whether it was processed by the JIT (1) or not (0).
+    ///        whether it was processed by the JIT (1) or not (0). When the linear
+    ///        part of the rom is smaller than 2MB, the remainder covers the sd cache extension.
     u32 staticRomJitBits[(2 * 1024 * 1024) / 2 / 32];
 
     /// @brief Stores for each halfword in IWRAM whether it was processed by the JIT (1) or not (0).
@@ -12,6 +12,7 @@ arm_func jit_thumbEnsureJitted
     cmp r8, #ROM_LINEAR_GBA_ADDRESS
         addhs r8, r8, #(ROM_LINEAR_DS_ADDRESS - ROM_LINEAR_GBA_ADDRESS)
     sub lr, r8, #ROM_LINEAR_DS_ADDRESS
+    rom_linear_end_patch
     cmp lr, #ROM_LINEAR_SIZE
     bhs 1f
 
@@ -12,6 +12,13 @@ extern "C" {
 /// @return When successful returns a pointer to the found pattern in data, or nullptr otherwise.
 extern const u32* mem_fastSearch16(const u32* data, u32 dataLength, const u32* pattern);
 
+/// @brief Searches for the first word in the given data that equals any of the 3 given words.
+/// @param data A 32 bit aligned pointer to the data to search in.
+/// @param dataLength The length of the data to search in in bytes, a multiple of 4.
+/// @param words The 3 words to search for.
+/// @return When successful returns a pointer to the found word in data, or nullptr otherwise.
+extern const u32* mem_fastSearchAny3(const u32* data, u32 dataLength, const u32* words);
+
 #ifdef __cplusplus
 }
 #endif
@@ -139,3 +139,49 @@ fastSearch16_firstWordMatch_r12:
     bne fastSearch16_continueFastSearch
     sub r0, r0, #16
     pop {r4-r11,pc}
+
+// r0: data
+// r1: size
+// r2: words (3 words)
+.global mem_fastSearchAny3
+.type mem_fastSearchAny3, %function
+mem_fastSearchAny3:
+    push {r4-r11,lr}
+    add r1, r1, r0
+    sub lr, r1, #32 // 32 bytes to load at once
+    ldmia r2, {r2-r4}
+
+.macro searchAny3_checkWord reg, index
+    cmp \reg, r2
+    cmpne \reg, r3
+    cmpne \reg, r4
+    subeq r0, r0, #(32 - 4 * \index)
+    popeq {r4-r11,pc}
+.endm
+
+1:
+    cmp r0, lr
+    bhi 2f
+    ldmia r0!, {r5-r12}
+    searchAny3_checkWord r5, 0
+    searchAny3_checkWord r6, 1
+    searchAny3_checkWord r7, 2
+    searchAny3_checkWord r8, 3
+    searchAny3_checkWord r9, 4
+    searchAny3_checkWord r10, 5
+    searchAny3_checkWord r11, 6
+    searchAny3_checkWord r12, 7
+    b 1b
+
+    // only need to handle the last couple of words now
+2:
+    cmp r0, r1
+    movhs r0, #0
+    pophs {r4-r11,pc}
+    ldr r5, [r0], #4
+    cmp r5, r2
+    cmpne r5, r3
+    cmpne r5, r4
+    bne 2b
+    sub r0, r0, #4
+    pop {r4-r11,pc}
@@ -4,6 +4,7 @@
 #include "VirtualMachine/VMDtcmDefs.inc"
 #include "GbaIoRegOffsets.h"
 #include "SdCache/SdCacheDefs.h"
+#include "SdCache/SdCacheStats.h"
 #include "MemoryEmulator/RomDefs.h"
 #include "MemoryEmulator/MemoryLoadStoreTableDefs.inc"
 
@@ -70,6 +71,7 @@ arm_func memu_load16Bios
     bx lr
 
 arm_func memu_load16Ewram
+    rom_linear_end_patch
     cmp r8, #ROM_LINEAR_END_DS_ADDRESS
         addhs r9, r8, #(ROM_LINEAR_GBA_ADDRESS - ROM_LINEAR_DS_ADDRESS)
         bhs memu_load16RomHiContinue
@@ -163,6 +165,12 @@ memu_load16RomHiContinue:
 
 arm_func memu_load16RomCacheMiss
     push {r0-r3,lr}
+#ifdef GBAR3_SDC_STATS
+    ldr r0,= (gSdcStats + SDC_STATS_LOAD16_MISS_COUNT_OFFSET)
+    ldr r1, [r0]
+    add r1, r1, #1
+    str r1, [r0]
+#endif
     mov r0, r12, lsl #SDC_BLOCK_SHIFT
     bl sdc_loadRomBlockDirect
     ldrh r9, [r0, r9]
@@ -4,6 +4,7 @@
 #include "VirtualMachine/VMDtcmDefs.inc"
 #include "GbaIoRegOffsets.h"
 #include "SdCache/SdCacheDefs.h"
+#include "SdCache/SdCacheStats.h"
 #include "MemoryEmulator/RomDefs.h"
 #include "MemoryEmulator/MemoryLoadStoreTableDefs.inc"
 
@@ -91,6 +92,7 @@ arm_func memu_load32BiosContinue
     bx lr
 
 arm_func memu_load32Ewram
+    rom_linear_end_patch
     cmp r8, #ROM_LINEAR_END_DS_ADDRESS
         addhs r9, r8, #(ROM_LINEAR_GBA_ADDRESS - ROM_LINEAR_DS_ADDRESS)
         bhs memu_load32RomHiContinue
@@ -157,6 +159,12 @@ arm_func memu_load32Oam
 
 arm_func memu_load32RomCacheMiss
     push {r0-r3,lr}
+#ifdef GBAR3_SDC_STATS
+    ldr r0,= (gSdcStats + SDC_STATS_LOAD32_MISS_COUNT_OFFSET)
+    ldr r1, [r0]
+    add r1, r1, #1
+    str r1, [r0]
+#endif
     mov r0, r12
     bl sdc_loadRomBlockDirect
     ldr r9, [r0, r9, lsr #(32 - SDC_BLOCK_SHIFT)]
@@ -121,6 +121,9 @@ arm_func memu_store8Sram
     strb r9, [r10]
     mov r11, #1 // GBA_SAVE_STATE_DIRTY
     strb r11, [r12]
+    ldr r12,= gSaveSramDirtySectors
+    mov r10, r8, lsl #17
+    strb r11, [r12, r10, lsr #26] // mark the sector dirty
     mov r11, #0
     ldr r12,= emu_vblankIrqSkipSaveCheckInstruction
     mcr p15, 0, r11, c7, c10, 4 // drain write buffer
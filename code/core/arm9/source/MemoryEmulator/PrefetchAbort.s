@@ -15,6 +15,7 @@ arm_func memu_prefetchAbort
     cmp lr, #ROM_LINEAR_GBA_ADDRESS
         blo 1f
 #endif
+    rom_linear_end_patch
     cmp lr, #ROM_LINEAR_END_GBA_ADDRESS
         addlos pc, lr, #(ROM_LINEAR_DS_ADDRESS - ROM_LINEAR_GBA_ADDRESS) // absolute rom
 
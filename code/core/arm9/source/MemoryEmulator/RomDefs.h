@@ -2,6 +2,48 @@
 
 #define ROM_LINEAR_GBA_ADDRESS          0x08000000
 #define ROM_LINEAR_DS_ADDRESS           0x02200000
-#define ROM_LINEAR_SIZE                 0x00200000
+#define ROM_LINEAR_MIN_SIZE             0x00100000
+#define ROM_LINEAR_MAX_SIZE             0x00200000
+#define ROM_LINEAR_MAX_END_DS_ADDRESS   (ROM_LINEAR_DS_ADDRESS + ROM_LINEAR_MAX_SIZE)
+
+// In DSi mode with 16MB of main memory, the rom after the linear part is loaded at boot
+// to the extended main memory, up to the memory that is used by the system and arm7.
+// It is not accessed directly by gba code, but through sdc_romBlockToCacheBlock.
+#define ROM_EXTENDED_DS_ADDRESS         ROM_LINEAR_MAX_END_DS_ADDRESS
+#define ROM_EXTENDED_MAX_SIZE           (0x02E80000 - ROM_EXTENDED_DS_ADDRESS)
+
+#ifdef __ASSEMBLER__
+
+// The asm code is assembled for the maximum size of the linear part of the rom.
+// Instructions that depend on the end of the linear part must be marked with
+// rom_linear_end_patch, such that memu_setRomLinearSize can adjust their immediate.
+#define ROM_LINEAR_SIZE                 ROM_LINEAR_MAX_SIZE
+
+/// @brief Marks the next instruction, which has an immediate operand that
+///        is relative to the end of the linear part of the rom.
+.macro rom_linear_end_patch
+    .pushsection ".romLinearEndPatches", "a"
+    .word 9999f
+    .popsection
+9999:
+.endm
+
+#else
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief The size of the linear part of the rom, chosen at boot by memu_setRomLinearSize.
+extern u32 gRomLinearSize;
+
+#ifdef __cplusplus
+}
+#endif
+
+#define ROM_LINEAR_SIZE                 gRomLinearSize
+
+#endif
+
 #define ROM_LINEAR_END_GBA_ADDRESS      (ROM_LINEAR_GBA_ADDRESS + ROM_LINEAR_SIZE)
 #define ROM_LINEAR_END_DS_ADDRESS       (ROM_LINEAR_DS_ADDRESS + ROM_LINEAR_SIZE)
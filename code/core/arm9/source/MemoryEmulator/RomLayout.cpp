@@ -0,0 +1,79 @@
+#include "common.h"
+#include "cp15.h"
+#include "MemoryProtectionConfiguration.h"
+#include "RomDefs.h"
+#include "RomLayout.h"
+
+extern u32* __rom_linear_end_patches_start[];
+extern u32* __rom_linear_end_patches_end[];
+
+u32 gRomLinearSize = ROM_LINEAR_MAX_SIZE;
+
+static constexpr u32 rotateLeft(u32 value, u32 amount)
+{
+    return amount == 0 ? value : (value << amount) | (value >> (32 - amount));
+}
+
+/// @brief Adds the given delta to the immediate operand of an arm data processing instruction.
+/// @param instruction The instruction to patch.
+/// @param delta The value to add to the immediate.
+/// @param patchedInstruction Receives the patched instruction.
+/// @return True if the result could be encoded as an arm immediate, or false otherwise.
+static bool tryAddToImmediate(u32 instruction, s32 delta, u32& patchedInstruction)
+{
+    if ((instruction & 0x0E000000) != 0x02000000)
+    {
+        // not a data processing instruction with an immediate operand
+        return false;
+    }
+
+    u32 rotation = ((instruction >> 8) & 0xF) * 2;
+    u32 value = rotateLeft(instruction & 0xFF, (32 - rotation) & 31) + delta;
+    for (u32 newRotation = 0; newRotation < 32; newRotation += 2)
+    {
+        u32 immediate = rotateLeft(value, newRotation);
+        if (immediate < 0x100)
+        {
+            patchedInstruction = (instruction & ~0xFFF) | ((newRotation / 2) << 8) | immediate;
+            return true;
+        }
+    }
+    return false;
+}
+
+extern "C" bool memu_setRomLinearSize(u32 size)
+{
+    if (size != ROM_LINEAR_MIN_SIZE && size != ROM_LINEAR_MAX_SIZE)
+    {
+        // the mpu requires a power of two and the sd cache extension a multiple of its size
+        return false;
+    }
+
+    s32 delta = size - gRomLinearSize;
+    if (delta == 0)
+    {
+        return true;
+    }
+
+    // validate all instructions first, such that the code is never left half patched
+    u32 patchedInstruction;
+    for (u32** patch = __rom_linear_end_patches_start; patch != __rom_linear_end_patches_end; patch++)
+    {
+        if (!tryAddToImmediate(**patch, delta, patchedInstruction))
+        {
+            return false;
+        }
+    }
+
+    for (u32** patch = __rom_linear_end_patches_start; patch != __rom_linear_end_patches_end; patch++)
+    {
+        tryAddToImmediate(**patch, delta, patchedInstruction);
+        **patch = patchedInstruction;
+        dc_flushRange(*patch, 4);
+    }
+    ic_invalidateAll();
+
+    gRomLinearSize = size;
+    setupRomLinearMemoryProtection();
+    return true;
+}
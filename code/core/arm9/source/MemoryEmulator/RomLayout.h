@@ -0,0 +1,17 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Sets the size of the linear part of the rom. The remainder of the linear
+///        rom region is then free to be used as sd cache extension. This patches the
+///        memory emulation code and reconfigures the memory protection, so it must be
+///        called before the rom is loaded.
+/// @param size The size of the linear part of the rom, either ROM_LINEAR_MIN_SIZE or ROM_LINEAR_MAX_SIZE.
+/// @return True if the size was applied, or false if the code could not be patched for it.
+bool memu_setRomLinearSize(u32 size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -2,6 +2,27 @@
 #include "MemoryEmulator/RomDefs.h"
 #include "MemoryProtectionConfiguration.h"
 
+void setupRomLinearMemoryProtection()
+{
+    // the remainder of the linear rom region is sd cache extension, which is covered by region 1
+    MemoryProtectionRegionBuilder(ROM_LINEAR_DS_ADDRESS,
+            ROM_LINEAR_SIZE == ROM_LINEAR_MIN_SIZE ? MPU_REGION_SIZE_1MB : MPU_REGION_SIZE_2MB)
+        .WithDataAccessPermission(MPU_ACCESS_PERMISSION_USER_READ_PRIV_WRITE)
+        .WithInstructionAccessPermission(MPU_ACCESS_PERMISSION_USER_READ_PRIV_WRITE)
+        .WithDataCache()
+        .WithInstructionCache()
+        .ApplyToRegion(MPU_REGION_3);
+}
+
+void setupExtendedMainMemoryProtection()
+{
+    // mpu region 1: Cached Main Memory, including the DSi extended main memory
+    MemoryProtectionRegionBuilder(0x02000000, MPU_REGION_SIZE_16MB)
+        .WithDataAccessPermission(MPU_ACCESS_PERMISSION_PRIV_READ_WRITE)
+        .WithDataCache()
+        .ApplyToRegion(MPU_REGION_1);
+}
+
 extern "C" void setupMemoryProtection()
 {
     // mpu region 0: ITCM, DTCM, uncached mmem, IO, GBA slot
@@ -24,12 +45,7 @@ extern "C" void setupMemoryProtection()
         .ApplyToRegion(MPU_REGION_2);
 
     // mpu region 3: Linear part of GBA rom
-    MemoryProtectionRegionBuilder(ROM_LINEAR_DS_ADDRESS, MPU_REGION_SIZE_2MB)
-        .WithDataAccessPermission(MPU_ACCESS_PERMISSION_USER_READ_PRIV_WRITE)
-        .WithInstructionAccessPermission(MPU_ACCESS_PERMISSION_USER_READ_PRIV_WRITE)
-        .WithDataCache()
-        .WithInstructionCache()
-        .ApplyToRegion(MPU_REGION_3);
+    setupRomLinearMemoryProtection();
 
     // mpu region 4: OBJ VRAM (DS)
     MemoryProtectionRegionBuilder(0x06400000, MPU_REGION_SIZE_32KB)
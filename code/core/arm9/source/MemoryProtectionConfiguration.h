@@ -70,3 +70,9 @@ public:
         mpu_setRegionDataBufferability(region, _regionBufferable);
     }
 };
+
+/// @brief Configures the memory protection region of the linear part of the rom for ROM_LINEAR_SIZE.
+void setupRomLinearMemoryProtection();
+
+/// @brief Extends the cached main memory region to the 16MB of main memory of the DSi.
+void setupExtendedMainMemoryProtection();
@@ -1,6 +1,6 @@
 #include "common.h"
 #include "SdCache/SdCache.h"
-#include "MemFastSearch.h"
+#include "Application/BootCacheService.h"
 #include "MemoryEmulator/RomDefs.h"
 #include "BadMixerPatch.h"
 
@@ -8,7 +8,7 @@ static const u32 sBuggedMixerSignature[4] = { 0xE92D1FF0u, 0xE8B0000Fu, 0xE1A032
 
 bool BadMixerPatch::TryApplyPatch()
 {
-    u32* function = (u32*)mem_fastSearch16((const u32*)ROM_LINEAR_DS_ADDRESS, ROM_LINEAR_SIZE, sBuggedMixerSignature);
+    u32* function = (u32*)gBootCacheService.FindSignature16((const u32*)ROM_LINEAR_DS_ADDRESS, ROM_LINEAR_SIZE, sBuggedMixerSignature);
     if (!function)
     {
         return false;
@@ -19,7 +19,7 @@ bool BadMixerPatch::TryApplyPatch()
     *(u32*)sdc_loadRomBlockForPatching(((u32)&function[1]) - ROM_LINEAR_DS_ADDRESS + ROM_LINEAR_GBA_ADDRESS) = 0xE890000F;
 
     // some games contain it twice for some reason
-    function = (u32*)mem_fastSearch16((const u32*)ROM_LINEAR_DS_ADDRESS, ROM_LINEAR_SIZE, sBuggedMixerSignature);
+    function = (u32*)gBootCacheService.FindSignature16((const u32*)ROM_LINEAR_DS_ADDRESS, ROM_LINEAR_SIZE, sBuggedMixerSignature);
     if (function)
     {
         function[1] = 0xE890000F;
@@ -2,7 +2,6 @@
 #include "SdCache/SdCache.h"
 #include "Application/Settings/RunSettings.h"
 #include "PatchSwi.h"
-#include "MemoryEmulator/RomDefs.h"
 #include "SelfModifyingPatches.h"
 
 [[gnu::section(".itcm")]]
@@ -37,10 +36,7 @@ void SelfModifyingPatches::PatchSelfModifyingWrite(u32 gbaAddress)
     u32 patchInstruction = ARM_PATCH_SWI(patch_addSwiPatch(patchCode));
     patchInstruction &= ~(0xF << 28);
     patchInstruction |= condition;
-    if (gbaAddress >= ROM_LINEAR_GBA_ADDRESS && gbaAddress < ROM_LINEAR_END_GBA_ADDRESS)
-    {
-        *(u32*)(gbaAddress - ROM_LINEAR_GBA_ADDRESS + ROM_LINEAR_DS_ADDRESS) = patchInstruction;
-    }
+    // for the linear part of the rom this points into the linear rom region
     *instructionPtr = patchInstruction;
 }
 
@@ -284,7 +284,7 @@ ITCM_CODE static void dmaStop(int channel, GbaDmaChannel* dmaIoBase)
 ITCM_CODE static void dmaStartHBlank(int channel, GbaDmaChannel* dmaIoBase, u32 value)
 {
     u32 src = dmaIoBase->src;
-    if ((src >= ROM_LINEAR_DS_ADDRESS && src < ROM_LINEAR_END_DS_ADDRESS))
+    if ((src >= ROM_LINEAR_DS_ADDRESS && src < ROM_LINEAR_MAX_END_DS_ADDRESS))
         return;
     dmaIoBase->control = value;
     dma_state.dmaFlags |= DMA_FLAG_HBLANK(channel);
@@ -351,7 +351,7 @@ ITCM_CODE static void dmaStartSound(int channel, GbaDmaChannel* dmaIoBase, u32 v
 ITCM_CODE static void dmaStartSpecial(int channel, GbaDmaChannel* dmaIoBase, u32 value)
 {
     u32 src = dmaIoBase->src;
-    if ((src >= ROM_LINEAR_DS_ADDRESS && src < ROM_LINEAR_END_DS_ADDRESS))
+    if ((src >= ROM_LINEAR_DS_ADDRESS && src < ROM_LINEAR_MAX_END_DS_ADDRESS))
         return;
     switch (channel)
     {
@@ -372,7 +372,7 @@ ITCM_CODE static void dmaStartImmediate(int channel, GbaDmaChannel* dmaIoBase, u
     if (count == 0)
         count = 0x10000;
     u32 src = dmaIoBase->src;
-    if (src >= ROM_LINEAR_DS_ADDRESS && src < ROM_LINEAR_END_DS_ADDRESS)
+    if (src >= ROM_LINEAR_DS_ADDRESS && src < ROM_LINEAR_MAX_END_DS_ADDRESS)
     {
         // assume this is a pc-relative rom address
         src = src + ROM_LINEAR_GBA_ADDRESS - ROM_LINEAR_DS_ADDRESS;
@@ -392,15 +392,17 @@ ITCM_CODE static void dmaStartImmediate(int channel, GbaDmaChannel* dmaIoBase, u
     int dstStep = getDstStep(control);
     if (control & GBA_DMA_CONTROL_32BIT)
     {
-        sdc_setIrqForbiddenReplacementRange((u32)src, count << 2);
+        // keep the source blocks resident while nested irqs, like hblank dma, load rom blocks
+        sdc_pinRomRange(src, count << 2);
         dma_immTransfer32(src, dst, count << 2, srcStep, dstStep);
+        sdc_unpinRomRange(src, count << 2);
     }
     else
     {
-        sdc_setIrqForbiddenReplacementRange((u32)src, count << 1);
+        sdc_pinRomRange(src, count << 1);
         dma_immTransfer16(src, dst, count << 1, srcStep, dstStep);
+        sdc_unpinRomRange(src, count << 1);
     }
-    sdc_resetIrqForbiddenReplacementRange();
     if (channel == 3)
     {
         vm_disableNestedIrqs();
@@ -1,20 +1,27 @@
 #include "common.h"
 #include <libtwl/ipc/ipcFifo.h>
 #include <libtwl/ipc/ipcFifoSystem.h>
+#include <algorithm>
 #include <string.h>
 #include "Fat/ff.h"
 #include "Core/Environment.h"
-#include "MemFastSearch.h"
+#include "Application/BootCacheService.h"
 #include "SaveSwi.h"
 #include "SaveTypeInfo.h"
 #include "VirtualMachine/VMNestedIrq.h"
 #include "MemoryEmulator/RomDefs.h"
 #include "IpcChannels.h"
 #include "GbaSaveIpcCommand.h"
+#include "SdCache/SdCacheStats.h"
+#include "SectorMappedFile.h"
+#include "SaveJournal.h"
 #include "Save.h"
 
 #define DEFAULT_SAVE_SIZE   (32 * 1024)
 
+/// @brief The maximum number of sectors of one write-back, which covers a whole sram save.
+#define SAVE_WRITE_BACK_SECTOR_COUNT    SAVE_SRAM_SECTOR_COUNT
+
 [[gnu::section(".ewram.bss")]]
 u8 gSaveData[SAVE_DATA_SIZE] alignas(32);
 
@@ -24,12 +31,41 @@ FIL gSaveFile alignas(32);
 [[gnu::section(".ewram.bss"), gnu::aligned(32)]]
 gba_save_shared_t gGbaSaveShared;
 
-static DWORD sClusterTable[64];
 static u32 sSkipSaveCheckInstruction;
+static u32 sSaveSize;
+
+[[gnu::section(".ewram.bss")]]
+static u32 sSaveSdSectors[SAVE_SECTOR_COUNT];
+
+[[gnu::section(".ewram.bss")]]
+static SectorMappedFile sSaveSectorMap;
+
+[[gnu::section(".ewram.bss")]]
+static SaveJournal sSaveJournal;
+
+/// @brief A bit for each sector of gSaveData that differs from the save file.
+static u32 sDirtySectors[SAVE_SECTOR_COUNT / 32];
+
+u8 gSaveSramDirtySectors[SAVE_SRAM_SECTOR_COUNT];
+
+/// @brief The dirty sectors of the write-back in progress, packed in ascending sector order.
+///        The game keeps writing gSaveData while the write-back is in progress.
+[[gnu::section(".ewram.bss")]]
+static u8 sWriteBackData[SAVE_WRITE_BACK_SECTOR_COUNT * 512] alignas(32);
+
+/// @brief The segment lists of the journal commit and of the in place write of the write-back in progress.
+[[gnu::section(".ewram.bss"), gnu::aligned(32)]]
+static FsSegment sWriteBackSegments[2 * SAVE_WRITE_BACK_SECTOR_COUNT + 1];
+
+/// @brief A bit for each sector of the write-back in progress.
+static u32 sWriteBackSectors[SAVE_SECTOR_COUNT / 32];
+
+/// @brief The wait tokens of the journal data, the journal header and the in place write of the write-back in progress.
+static FsWaitToken sWriteBackWaitTokens[3];
 
 bool sav_tryPatchFunction(const u32* signature, u32 saveSwiNumber, void* patchFunction)
 {
-    u32* function = (u32*)mem_fastSearch16((const u32*)ROM_LINEAR_DS_ADDRESS, ROM_LINEAR_SIZE, signature);
+    u32* function = (u32*)gBootCacheService.FindSignature16((const u32*)ROM_LINEAR_DS_ADDRESS, ROM_LINEAR_SIZE, signature);
     if (!function)
         return false;
 
@@ -38,11 +74,141 @@ bool sav_tryPatchFunction(const u32* signature, u32 saveSwiNumber, void* patchFu
     return true;
 }
 
-static void loadSaveClusterMap(void)
+static void writeDirtySaveSectors(void)
+{
+    u32 sectorCount = sSaveSize / 512;
+    u32 sector = 0;
+    u32 runLength;
+    if (!gSaveFile.obj.fs || !sav_findSectorRun(sDirtySectors, sectorCount, sector, runLength))
+    {
+        return;
+    }
+
+    if (sSaveJournal.IsOpen())
+    {
+        sSaveJournal.Commit(gSaveData, sDirtySectors);
+    }
+
+    while (sav_findSectorRun(sDirtySectors, sectorCount, sector, runLength))
+    {
+        sSaveSectorMap.WriteSectors(gSaveData + sector * 512, sector, runLength);
+        sector += runLength;
+    }
+    memset(sDirtySectors, 0, sizeof(sDirtySectors));
+    sSaveSectorMap.Sync();
+}
+
+static bool hasDirtySaveSectors(void)
 {
-    sClusterTable[0] = sizeof(sClusterTable) / sizeof(DWORD);
-    gSaveFile.cltbl = sClusterTable;
-    f_lseek(&gSaveFile, CREATE_LINKMAP);
+    u32 sector = 0;
+    u32 runLength;
+    return sav_findSectorRun(sDirtySectors, sSaveSize / 512, sector, runLength);
+}
+
+/// @brief Moves the sectors that the memory emulator marked in gSaveSramDirtySectors to sDirtySectors.
+static void collectSramDirtySectors(void)
+{
+    for (u32 sector = 0; sector < SAVE_SRAM_SECTOR_COUNT; sector++)
+    {
+        if (gSaveSramDirtySectors[sector])
+        {
+            gSaveSramDirtySectors[sector] = 0;
+            sDirtySectors[sector >> 5] |= 1 << (sector & 31);
+        }
+    }
+}
+
+/// @brief Starts writing the dirty sectors to the journal and the save file with transactions of FS_PRIORITY_LOW,
+///        which the arm7 executes in between the rom reads of the emulation.
+/// @return True if transactions were submitted, or false if there was nothing to write asynchronously.
+static bool startWriteBack(void)
+{
+    collectSramDirtySectors();
+    if (!gSaveFile.obj.fs)
+    {
+        return false;
+    }
+
+    if (!sSaveSectorMap.IsMapped() || (sSaveJournal.IsOpen() && !sSaveJournal.IsMapped()))
+    {
+        // fragmented files can only be written through FatFs
+#ifdef GBAR3_SDC_STATS
+        gSdcStatsIsSaveWriteActive = true;
+#endif
+        writeDirtySaveSectors();
+#ifdef GBAR3_SDC_STATS
+        gSdcStatsIsSaveWriteActive = false;
+#endif
+        return false;
+    }
+
+    // take a snapshot of the dirty sectors, sectors that do not fit stay dirty for the next write-back
+    u32 sectorCount = sSaveSize / 512;
+    u32 writeBackSectorCount = 0;
+    u32 sector = 0;
+    u32 runLength;
+    memset(sWriteBackSectors, 0, sizeof(sWriteBackSectors));
+    while (writeBackSectorCount < SAVE_WRITE_BACK_SECTOR_COUNT &&
+        sav_findSectorRun(sDirtySectors, sectorCount, sector, runLength))
+    {
+        if (runLength > SAVE_WRITE_BACK_SECTOR_COUNT - writeBackSectorCount)
+        {
+            runLength = SAVE_WRITE_BACK_SECTOR_COUNT - writeBackSectorCount;
+        }
+        memcpy(sWriteBackData + writeBackSectorCount * 512, gSaveData + sector * 512, runLength * 512);
+        writeBackSectorCount += runLength;
+        for (u32 end = sector + runLength; sector < end; sector++)
+        {
+            sDirtySectors[sector >> 5] &= ~(1 << (sector & 31));
+            sWriteBackSectors[sector >> 5] |= 1 << (sector & 31);
+        }
+    }
+    if (writeBackSectorCount == 0)
+    {
+        return false;
+    }
+
+    u32 segmentCount = 0;
+    if (sSaveJournal.IsOpen())
+    {
+        segmentCount = sSaveJournal.CommitAsync(sWriteBackData, sWriteBackSectors, sWriteBackSegments, sWriteBackWaitTokens);
+    }
+    else
+    {
+        sWriteBackWaitTokens[0].transactionComplete = true;
+        sWriteBackWaitTokens[1].transactionComplete = true;
+    }
+
+    FsSegment* segments = &sWriteBackSegments[segmentCount];
+    segmentCount = 0;
+    u8* sectorData = sWriteBackData;
+    sector = 0;
+    while (sav_findSectorRun(sWriteBackSectors, sectorCount, sector, runLength))
+    {
+        segmentCount = sSaveSectorMap.AppendSegments(segments, segmentCount, sectorData, sector, runLength);
+        sectorData += runLength * 512;
+        sector += runLength;
+    }
+    sSaveSectorMap.WriteSegmentsAsync(segments, segmentCount, FS_PRIORITY_LOW, &sWriteBackWaitTokens[2]);
+#ifdef GBAR3_SDC_STATS
+    gSdcStatsIsSaveWriteActive = true;
+#endif
+    return true;
+}
+
+static bool isWriteBackComplete(void)
+{
+    for (u32 i = 0; i < 3; i++)
+    {
+        if (!fs_isTransactionComplete(&sWriteBackWaitTokens[i]))
+        {
+            return false;
+        }
+    }
+#ifdef GBAR3_SDC_STATS
+    gSdcStatsIsSaveWriteActive = false;
+#endif
+    return true;
 }
 
 static void fillSaveFile(u32 start, u32 end)
@@ -75,7 +241,7 @@ void sav_initializeSave(const SaveTypeInfo* saveTypeInfo, const char* savePath)
             if (f_lseek(&gSaveFile, saveSize) == FR_OK)
             {
                 f_rewind(&gSaveFile);
-                loadSaveClusterMap();
+                sSaveSectorMap.Initialize(&gSaveFile, sSaveSdSectors, saveSize / 512);
                 clusterMapLoaded = true;
                 fillSaveFile(initialSize, saveSize);
             }
@@ -83,7 +249,7 @@ void sav_initializeSave(const SaveTypeInfo* saveTypeInfo, const char* savePath)
 
         if (!clusterMapLoaded)
         {
-            loadSaveClusterMap();
+            sSaveSectorMap.Initialize(&gSaveFile, sSaveSdSectors, saveSize / 512);
             clusterMapLoaded = true;
         }
 
@@ -108,91 +274,235 @@ void sav_initializeSave(const SaveTypeInfo* saveTypeInfo, const char* savePath)
             if (f_lseek(&gSaveFile, saveSize) == FR_OK)
             {
                 f_rewind(&gSaveFile);
-                loadSaveClusterMap();
+                sSaveSectorMap.Initialize(&gSaveFile, sSaveSdSectors, saveSize / 512);
                 fillSaveFile(0, saveSize);
             }
         }
     }
 
-    gGbaSaveShared.saveState = GBA_SAVE_STATE_CLEAN;
-    sSkipSaveCheckInstruction = emu_vblankIrqSkipSaveCheckInstruction;
-    if (!saveTypeInfo || (saveTypeInfo->type & SAVE_TYPE_SRAM))
+    sSaveSize = saveSize;
+    memset(sDirtySectors, 0, sizeof(sDirtySectors));
+    memset(gSaveSramDirtySectors, 0, sizeof(gSaveSramDirtySectors));
+    gGbaSaveShared.isWriteBackActive = false;
+    if (gSaveFile.obj.fs && !Environment::IsIsNitroEmulator() &&
+        sSaveJournal.Open(savePath, saveSize) &&
+        sSaveJournal.Recover(gSaveData, sDirtySectors))
     {
-        gGbaSaveShared.saveData = gSaveData;
-        gGbaSaveShared.saveDataSize = saveSize;
-    }
-    else
-    {
-        gGbaSaveShared.saveData = nullptr;
-        gGbaSaveShared.saveDataSize = 0;
+        // complete the write that was interrupted
+        writeDirtySaveSectors();
     }
+    gGbaSaveShared.saveState = GBA_SAVE_STATE_CLEAN;
+    sSkipSaveCheckInstruction = emu_vblankIrqSkipSaveCheckInstruction;
+    gGbaSaveShared.saveData = gSaveData;
+    gGbaSaveShared.saveDataSize = saveSize;
 
     ipc_sendWordDirect(
-        ((((u32)&gGbaSaveShared) >> 5) << (IPC_FIFO_MSG_CHANNEL_BITS + 3)) |
+        ((((u32)(uintptr_t)&gGbaSaveShared) >> 5) << (IPC_FIFO_MSG_CHANNEL_BITS + 3)) |
         (GBA_SAVE_IPC_CMD_SETUP << IPC_FIFO_MSG_CHANNEL_BITS) |
         IPC_CHANNEL_GBA_SAVE);
     while (ipc_isRecvFifoEmpty());
     ipc_recvWordDirect();
 }
 
-extern "C" u8 sav_readSaveByteFromFile(u32 saveAddress)
+static void markSaveSectorDirty(u32 sector)
+{
+    sDirtySectors[sector >> 5] |= 1 << (sector & 31);
+}
+
+/// @brief Lets the arm7 schedule a write-back of the dirty sectors, like the memory emulator does for an sram write.
+static void requestWriteBack(void)
+{
+    gGbaSaveShared.saveState = GBA_SAVE_STATE_DIRTY;
+    emu_vblankIrqSkipSaveCheckInstruction = 0; // nop, do not skip the save check when dirty
+}
+
+static bool isFilledWith(const u8* data, u32 length, u8 value)
+{
+    for (u32 i = 0; i < length; i++)
+    {
+        if (data[i] != value)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+extern "C" void sav_flushSaveFile(void)
 {
     vm_enableNestedIrqs();
-    u8 saveByte;
+    if (!Environment::IsIsNitroEmulator())
+    {
+#ifdef GBAR3_SDC_STATS
+        gSdcStatsIsSaveWriteActive = true;
+#endif
+        writeDirtySaveSectors();
+#ifdef GBAR3_SDC_STATS
+        gSdcStatsIsSaveWriteActive = false;
+#endif
+    }
+    vm_disableNestedIrqs();
+}
+
+extern "C" void sav_read(u32 saveAddress, void* dst, u32 length)
+{
+    u8* destination = (u8*)dst;
     if (Environment::IsIsNitroEmulator())
     {
         // save buffer in extended memory
-        saveByte = ISNITRO_SAVE_BUFFER[saveAddress];
+        for (u32 i = 0; i < length; i++)
+        {
+            destination[i] = ISNITRO_SAVE_BUFFER[saveAddress + i];
+        }
+        return;
     }
-    else
+
+    u32 mirrorLength = saveAddress < sSaveSize ? std::min(length, sSaveSize - saveAddress) : 0;
+    memcpy(destination, &gSaveData[saveAddress], mirrorLength);
+    memset(destination + mirrorLength, SAVE_DATA_FILL, length - mirrorLength);
+}
+
+extern "C" void sav_write(u32 saveAddress, const void* src, u32 length)
+{
+    const u8* source = (const u8*)src;
+    if (Environment::IsIsNitroEmulator())
     {
-        // write to file
-        f_lseek(&gSaveFile, saveAddress);
-        UINT bytesRead = 0;
-        f_read(&gSaveFile, &saveByte, 1, &bytesRead);
+        // save buffer in extended memory
+        for (u32 i = 0; i < length; i++)
+        {
+            ISNITRO_SAVE_BUFFER[saveAddress + i] = source[i];
+        }
+        return;
+    }
+
+    u32 end = saveAddress < sSaveSize ? saveAddress + std::min(length, sSaveSize - saveAddress) : saveAddress;
+    bool isChanged = false;
+    while (saveAddress < end)
+    {
+        // only sectors of which the content changed have to be written to the save file
+        u32 chunkLength = std::min(end, (saveAddress | 511) + 1) - saveAddress;
+        if (memcmp(&gSaveData[saveAddress], source, chunkLength) != 0)
+        {
+            memcpy(&gSaveData[saveAddress], source, chunkLength);
+            markSaveSectorDirty(saveAddress >> 9);
+            isChanged = true;
+        }
+        saveAddress += chunkLength;
+        source += chunkLength;
+    }
+    if (isChanged)
+    {
+        requestWriteBack();
     }
-    vm_disableNestedIrqs();
-    return saveByte;
 }
 
-extern "C" void sav_writeSaveByteToFile(u32 saveAddress, u8 data)
+extern "C" void sav_fill(u32 saveAddress, u8 value, u32 length)
 {
-    vm_enableNestedIrqs();
     if (Environment::IsIsNitroEmulator())
     {
         // save buffer in extended memory
-        ISNITRO_SAVE_BUFFER[saveAddress] = data;
+        for (u32 i = 0; i < length; i++)
+        {
+            ISNITRO_SAVE_BUFFER[saveAddress + i] = value;
+        }
+        return;
     }
-    else
+
+    u32 end = saveAddress < sSaveSize ? saveAddress + std::min(length, sSaveSize - saveAddress) : saveAddress;
+    bool isChanged = false;
+    while (saveAddress < end)
     {
-        // write to file
-        f_lseek(&gSaveFile, saveAddress);
-        UINT bytesWritten = 0;
-        f_write(&gSaveFile, &data, 1, &bytesWritten);
+        u32 chunkLength = std::min(end, (saveAddress | 511) + 1) - saveAddress;
+        if (!isFilledWith(&gSaveData[saveAddress], chunkLength, value))
+        {
+            memset(&gSaveData[saveAddress], value, chunkLength);
+            markSaveSectorDirty(saveAddress >> 9);
+            isChanged = true;
+        }
+        saveAddress += chunkLength;
+    }
+    if (isChanged)
+    {
+        requestWriteBack();
     }
-    vm_disableNestedIrqs();
 }
 
-extern "C" void sav_flushSaveFile(void)
+extern "C" u32 sav_compare(u32 saveAddress, const void* src, u32 length)
 {
-    vm_enableNestedIrqs();
-    if (!Environment::IsIsNitroEmulator())
+    const u8* source = (const u8*)src;
+    if (Environment::IsIsNitroEmulator())
     {
-        f_sync(&gSaveFile);
+        // save buffer in extended memory
+        for (u32 i = 0; i < length; i++)
+        {
+            if (ISNITRO_SAVE_BUFFER[saveAddress + i] != source[i])
+            {
+                return i;
+            }
+        }
+        return length;
     }
-    vm_disableNestedIrqs();
+
+    u32 mirrorLength = saveAddress < sSaveSize ? std::min(length, sSaveSize - saveAddress) : 0;
+    if (memcmp(&gSaveData[saveAddress], source, mirrorLength) != 0)
+    {
+        for (u32 i = 0; i < mirrorLength; i++)
+        {
+            if (gSaveData[saveAddress + i] != source[i])
+            {
+                return i;
+            }
+        }
+    }
+    for (u32 i = mirrorLength; i < length; i++)
+    {
+        if (source[i] != SAVE_DATA_FILL)
+        {
+            return i;
+        }
+    }
+    return length;
 }
 
-extern "C" void sav_writeSaveToFile(void)
+extern "C" void sav_updateWriteBack(void)
 {
-    if (gGbaSaveShared.saveDataSize != 0 && !Environment::IsIsNitroEmulator())
+    if (vm_nestedIrqLevel != 0)
+    {
+        // an arm9 service, which may be using FatFs, was interrupted
+        return;
+    }
+
+    if (gGbaSaveShared.isWriteBackActive)
+    {
+        if (!isWriteBackComplete())
+        {
+            return;
+        }
+        if (gGbaSaveShared.saveState != GBA_SAVE_STATE_WRITE && !hasDirtySaveSectors())
+        {
+            gGbaSaveShared.isWriteBackActive = false;
+            if (gGbaSaveShared.saveState == GBA_SAVE_STATE_CLEAN)
+            {
+                emu_vblankIrqSkipSaveCheckInstruction = sSkipSaveCheckInstruction;
+            }
+            return;
+        }
+    }
+    else if (gGbaSaveShared.saveState != GBA_SAVE_STATE_WRITE)
     {
-        f_lseek(&gSaveFile, 0);
-        UINT bytesWritten = 0;
-        f_write(&gSaveFile, gSaveData, gGbaSaveShared.saveDataSize, &bytesWritten);
-        f_sync(&gSaveFile);
+        return;
     }
 
+    // the arm7 must not see the save as clean before the write-back completed
+    gGbaSaveShared.isWriteBackActive = true;
     gGbaSaveShared.saveState = GBA_SAVE_STATE_CLEAN;
-    emu_vblankIrqSkipSaveCheckInstruction = sSkipSaveCheckInstruction;
+    if (!Environment::IsIsNitroEmulator() && startWriteBack())
+    {
+        return;
+    }
+    gGbaSaveShared.isWriteBackActive = false;
+    if (gGbaSaveShared.saveState == GBA_SAVE_STATE_CLEAN)
+    {
+        emu_vblankIrqSkipSaveCheckInstruction = sSkipSaveCheckInstruction;
+    }
 }
@@ -4,7 +4,9 @@
 #include "GbaSaveShared.h"
 
 #define SAVE_DATA_FILL              0xFF
-#define SAVE_DATA_SIZE              (32 * 1024)
+#define SAVE_DATA_SIZE              (128 * 1024)
+#define SAVE_SECTOR_COUNT           (SAVE_DATA_SIZE / 512)
+#define SAVE_SRAM_SECTOR_COUNT      ((32 * 1024) / 512)
 #define ISNITRO_SAVE_BUFFER         ((vu8*)0x02480000)
 #define ISNITRO_SAVE_BUFFER_SIZE    (128 * 1024)
 
@@ -12,6 +14,9 @@ extern u8 gSaveData[SAVE_DATA_SIZE];
 extern FIL gSaveFile;
 extern gba_save_shared_t gGbaSaveShared;
 
+/// @brief A flag for each sector of an sram save, which the memory emulator sets when it writes the sector.
+extern u8 gSaveSramDirtySectors[SAVE_SRAM_SECTOR_COUNT];
+
 extern u32 emu_vblankIrqSkipSaveCheckInstruction;
 
 bool sav_tryPatchFunction(const u32* signature, u32 saveSwiNumber, void* patchFunction);
@@ -21,10 +26,43 @@ void sav_initializeSave(const SaveTypeInfo* saveTypeInfo, const char* savePath);
 extern "C" {
 #endif
 
-u8 sav_readSaveByteFromFile(u32 offset);
-void sav_writeSaveByteToFile(u32 offset, u8 data);
+/// @brief Writes the dirty sectors of the save to the save file.
 void sav_flushSaveFile(void);
-void sav_writeSaveToFile(void);
+
+/// @brief Reads a span of the ram mirror of the save. Bytes beyond the save read as SAVE_DATA_FILL.
+/// @param saveAddress The save address to start reading at.
+/// @param dst The buffer to read to.
+/// @param length The number of bytes to read.
+void sav_read(u32 saveAddress, void* dst, u32 length);
+
+/// @brief Writes a span to the ram mirror of the save and marks the sectors that changed dirty.
+///        When a sector changed, the arm7 is notified to schedule a write-back with sav_updateWriteBack.
+///        Bytes beyond the save are ignored.
+/// @param saveAddress The save address to start writing at.
+/// @param src The data to write.
+/// @param length The number of bytes to write.
+void sav_write(u32 saveAddress, const void* src, u32 length);
+
+/// @brief Fills a span of the ram mirror of the save with the given value and marks the sectors
+///        that changed dirty. When a sector changed, the arm7 is notified to schedule a write-back
+///        with sav_updateWriteBack. Bytes beyond the save are ignored.
+/// @param saveAddress The save address to start filling at.
+/// @param value The value to fill with.
+/// @param length The number of bytes to fill.
+void sav_fill(u32 saveAddress, u8 value, u32 length);
+
+/// @brief Compares a span of the ram mirror of the save with the given data.
+/// @param saveAddress The save address to start comparing at.
+/// @param src The data to compare with.
+/// @param length The number of bytes to compare.
+/// @return The offset of the first byte that differs, or length when the span equals the data.
+u32 sav_compare(u32 saveAddress, const void* src, u32 length);
+
+/// @brief Advances the write-back of the save, called from the vblank irq while the arm7 requests
+///        a write with GBA_SAVE_STATE_WRITE or while gGbaSaveShared.isWriteBackActive is set.
+///        Starts writing a snapshot of the dirty sectors and returns without waiting for the sd card,
+///        a later call completes the write-back once the arm7 finished the transactions.
+void sav_updateWriteBack(void);
 
 #ifdef __cplusplus
 }
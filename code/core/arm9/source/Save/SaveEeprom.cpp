@@ -20,20 +20,24 @@ static const u32 sProgramEepromDwordV126Sig[] = { 0x4647B5F0u, 0xB0ACB480u, 0x04
 
 static u16 readEepromDword(u16 epAdr, u16* dst)
 {
+    // the dwords are stored in the save in big endian order
+    u8 data[8];
+    sav_readFromUserMode(epAdr << 3, data, 8);
     for (int i = 0; i < 8; ++i)
     {
-        ((u8*)dst)[7 - i] = sav_readSaveByteFromFileFromUserMode((epAdr << 3) + i);
+        ((u8*)dst)[7 - i] = data[i];
     }
     return 0;
 }
 
 static u16 programEepromDword(u16 epAdr, const u16* src)
 {
+    u8 data[8];
     for (int i = 0; i < 8; ++i)
     {
-        sav_writeSaveByteToFileFromUserMode((epAdr << 3) + i, ((u8*)src)[7 - i]);
+        data[i] = ((const u8*)src)[7 - i];
     }
-    sav_flushSaveFileFromUserMode();
+    sav_writeFromUserMode(epAdr << 3, data, 8);
     return 0;
 }
 
@@ -1,12 +1,13 @@
 #include "common.h"
 #include <string.h>
 #include <libtwl/mem/memSwap.h>
-#include "MemFastSearch.h"
+#include "Application/BootCacheService.h"
 #include "Save.h"
 #include "SaveSwi.h"
 #include "SaveFlashDefinitions.h"
 #include "SaveTypeInfo.h"
 #include "MemoryEmulator/RomDefs.h"
+#include "SdCache/CompressedRom.h"
 #include "SaveFlash.h"
 
 #define MAKER_ID_MACRONIX           0xC2
@@ -38,73 +39,43 @@ static const u16 sMaxTime[] = { 0xA, 0xFFBD, 0xC2, 0xA, 0xFFBD, 0xC2, 0x28, 0xFF
 
 static void readFlash(u16 secNo, u32 offset, u8* dst, u32 size)
 {
-    u32 saveAddress = (secNo << 12) + offset;
-    for (u32 i = 0; i < size; ++i)
-    {
-        *dst++ = sav_readSaveByteFromFileFromUserMode(saveAddress++);
-    }
+    sav_readFromUserMode((secNo << 12) + offset, dst, size);
 }
 
-static u32 verifyFlashSector(u16 secNo, const u8* src)
+static u32 verifyFlash(u16 secNo, const u8* src, u32 size)
 {
-    u32 saveAddress = secNo << 12;
-    for (u32 i = 0; i < (1 << 12); ++i)
-    {
-        u8 saveByte = sav_readSaveByteFromFileFromUserMode(saveAddress++);
-        u8 expectedByte = *src++;
-        if (saveByte != expectedByte)
-            return 0x0E000000 + ((secNo & 0xF) << 12) + i;
-    }
+    u32 offset = sav_compareFromUserMode(secNo << 12, src, size);
+    if (offset != size)
+        return 0x0E000000 + ((secNo & 0xF) << 12) + offset;
     return 0;
 }
 
-static u32 verifyFlash(u16 secNo, const u8* src, u32 size)
+static u32 verifyFlashSector(u16 secNo, const u8* src)
 {
-    u32 saveAddress = secNo << 12;
-    for (u32 i = 0; i < size; ++i)
-    {
-        u8 saveByte = sav_readSaveByteFromFileFromUserMode(saveAddress++);
-        u8 expectedByte = *src++;
-        if (saveByte != expectedByte)
-            return 0x0E000000 + ((secNo & 0xF) << 12) + i;
-    }
-    return 0;
+    return verifyFlash(secNo, src, 1 << 12);
 }
 
 static u16 eraseFlashChip()
 {
-    for (u32 i = 0; i < sizeof(gSaveData); ++i)
-    {
-        sav_writeSaveByteToFileFromUserMode(i, 0xFF);
-    }
-    sav_flushSaveFileFromUserMode();
+    sav_fillFromUserMode(0, 0xFF, sFlashType.saveSize);
     return 0;
 }
 
 static u16 eraseFlashSector(u16 secNo)
 {
-    for (u32 i = 0; i < (1 << 12); ++i)
-    {
-        sav_writeSaveByteToFileFromUserMode((secNo << 12) + i, 0xFF);
-    }
-    sav_flushSaveFileFromUserMode();
+    sav_fillFromUserMode(secNo << 12, 0xFF, 1 << 12);
     return 0;
 }
 
 static u16 programFlashSector(u16 secNo, const u8* src)
 {
-    for (u32 i = 0; i < (1 << 12); ++i)
-    {
-        sav_writeSaveByteToFileFromUserMode((secNo << 12) + i, *src++);
-    }
-    sav_flushSaveFileFromUserMode();
+    sav_writeFromUserMode(secNo << 12, src, 1 << 12);
     return 0;
 }
 
 static u16 programFlashByte1M(u16 secNo, u32 offset, u8 data)
 {
-    sav_writeSaveByteToFileFromUserMode((secNo << 12) + offset, data);
-    sav_flushSaveFileFromUserMode();
+    sav_writeFromUserMode((secNo << 12) + offset, &data, 1);
     return 0;
 }
 
@@ -171,12 +142,7 @@ static void initializeFlash1M()
 
 static bool loadDataV120(const SaveTypeInfo* saveTypeInfo, FIL* romFile, u32 tagRomAddress, u8* tempBuffer)
 {
-    if (f_lseek(romFile, tagRomAddress + ((saveTypeInfo->tagLength + 3) & ~3)) != FR_OK)
-    {
-        return false;
-    }
-    UINT read;
-    if (f_read(romFile, tempBuffer, 0x94, &read) != FR_OK || read != 0x94)
+    if (crom_read(romFile, tagRomAddress + ((saveTypeInfo->tagLength + 3) & ~3), tempBuffer, 0x94) != 0x94)
     {
         return false;
     }
@@ -198,7 +164,7 @@ bool flash_patchV120(const SaveTypeInfo* saveTypeInfo, FIL* romFile, u32 tagRomA
         return false;
     }
 
-    u32* pIdentify = (u32*)mem_fastSearch16((const u32*)ROM_LINEAR_DS_ADDRESS, ROM_LINEAR_SIZE, sIdentifyFlashV120Sig);
+    u32* pIdentify = (u32*)gBootCacheService.FindSignature16((const u32*)ROM_LINEAR_DS_ADDRESS, ROM_LINEAR_SIZE, sIdentifyFlashV120Sig);
     if (!pIdentify)
     {
         return false;
@@ -224,7 +190,7 @@ bool flash_patchV123(const SaveTypeInfo* saveTypeInfo, FIL* romFile, u32 tagRomA
         return false;
     }
 
-    u32* pIdentify = (u32*)mem_fastSearch16((const u32*)ROM_LINEAR_DS_ADDRESS, ROM_LINEAR_SIZE, sIdentifyFlashV123Sig);
+    u32* pIdentify = (u32*)gBootCacheService.FindSignature16((const u32*)ROM_LINEAR_DS_ADDRESS, ROM_LINEAR_SIZE, sIdentifyFlashV123Sig);
     if (!pIdentify)
     {
         return false;
@@ -250,7 +216,7 @@ bool flash_patchV126(const SaveTypeInfo* saveTypeInfo, FIL* romFile, u32 tagRomA
         return false;
     }
 
-    u32* pIdentify = (u32*)mem_fastSearch16((const u32*)ROM_LINEAR_DS_ADDRESS, ROM_LINEAR_SIZE, sIdentifyFlashV123Sig);
+    u32* pIdentify = (u32*)gBootCacheService.FindSignature16((const u32*)ROM_LINEAR_DS_ADDRESS, ROM_LINEAR_SIZE, sIdentifyFlashV123Sig);
     if (!pIdentify)
     {
         return false;
@@ -275,12 +241,7 @@ bool flash_patchV126(const SaveTypeInfo* saveTypeInfo, FIL* romFile, u32 tagRomA
 
 bool flash_patch512V130(const SaveTypeInfo* saveTypeInfo, FIL* romFile, u32 tagRomAddress, u8* tempBuffer)
 {
-    if (f_lseek(romFile, tagRomAddress + ((saveTypeInfo->tagLength + 3) & ~3)) != FR_OK)
-    {
-        return false;
-    }
-    UINT read = 0;
-    if (f_read(romFile, tempBuffer, 0x94, &read) != FR_OK || read != 0x94)
+    if (crom_read(romFile, tagRomAddress + ((saveTypeInfo->tagLength + 3) & ~3), tempBuffer, 0x94) != 0x94)
     {
         return false;
     }
@@ -306,12 +267,7 @@ bool flash_patch512V130(const SaveTypeInfo* saveTypeInfo, FIL* romFile, u32 tagR
 
 bool flash_patch1MV102(const SaveTypeInfo* saveTypeInfo, FIL* romFile, u32 tagRomAddress, u8* tempBuffer)
 {
-    if (f_lseek(romFile, tagRomAddress + ((saveTypeInfo->tagLength + 3) & ~3)) != FR_OK)
-    {
-        return false;
-    }
-    UINT read = 0;
-    if (f_read(romFile, tempBuffer, 0x94, &read) != FR_OK || read != 0x94)
+    if (crom_read(romFile, tagRomAddress + ((saveTypeInfo->tagLength + 3) & ~3), tempBuffer, 0x94) != 0x94)
     {
         return false;
     }
@@ -342,12 +298,7 @@ bool flash_patch1MV102(const SaveTypeInfo* saveTypeInfo, FIL* romFile, u32 tagRo
 
 bool flash_patch1MV103(const SaveTypeInfo* saveTypeInfo, FIL* romFile, u32 tagRomAddress, u8* tempBuffer)
 {
-    if (f_lseek(romFile, tagRomAddress + ((saveTypeInfo->tagLength + 3) & ~3)) != FR_OK)
-    {
-        return false;
-    }
-    UINT read = 0;
-    if (f_read(romFile, tempBuffer, 0x94, &read) != FR_OK || read != 0x94)
+    if (crom_read(romFile, tagRomAddress + ((saveTypeInfo->tagLength + 3) & ~3), tempBuffer, 0x94) != 0x94)
     {
         return false;
     }
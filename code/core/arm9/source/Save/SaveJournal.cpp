@@ -0,0 +1,259 @@
+#include "common.h"
+#include <stddef.h>
+#include <string.h>
+#include "SaveJournal.h"
+
+/// @brief The table of the reflected crc32 with polynomial 0xEDB88320.
+class Crc32Table
+{
+    u32 _table[256];
+
+public:
+    constexpr Crc32Table()
+        : _table()
+    {
+        for (u32 i = 0; i < 256; i++)
+        {
+            u32 crc = i;
+            for (u32 bit = 0; bit < 8; bit++)
+            {
+                crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320 : 0);
+            }
+            _table[i] = crc;
+        }
+    }
+
+    u32 Update(u32 crc, const void* data, u32 length) const
+    {
+        const u8* bytes = (const u8*)data;
+        crc = ~crc;
+        for (u32 i = 0; i < length; i++)
+        {
+            crc = _table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+};
+
+static constexpr Crc32Table sCrc32Table { };
+
+static u32 getHeaderCrc(const save_journal_header_t& header, const u32* sectorCrcs)
+{
+    u32 crc = sCrc32Table.Update(0, &header, offsetof(save_journal_header_t, crc));
+    u32 sector = 0;
+    u32 runLength;
+    while (sav_findSectorRun(header.dirtySectors, header.sectorCount, sector, runLength))
+    {
+        crc = sCrc32Table.Update(crc, &sectorCrcs[sector], runLength * sizeof(u32));
+        sector += runLength;
+    }
+    return crc;
+}
+
+bool SaveJournal::Open(const char* savePath, u32 saveSize)
+{
+    Close();
+    char path[256];
+    u32 savePathLength = strlen(savePath);
+    if (savePathLength + sizeof(SAVE_JOURNAL_EXTENSION) > sizeof(path))
+    {
+        return false;
+    }
+    memcpy(path, savePath, savePathLength);
+    memcpy(path + savePathLength, SAVE_JOURNAL_EXTENSION, sizeof(SAVE_JOURNAL_EXTENSION));
+
+    memset(&_file, 0, sizeof(_file));
+    if (f_open(&_file, path, FA_OPEN_ALWAYS | FA_READ | FA_WRITE) != FR_OK)
+    {
+        return false;
+    }
+
+    _sectorCount = saveSize / 512;
+    u32 journalSectorCount = SAVE_JOURNAL_SLOT_COUNT * (1 + _sectorCount);
+    bool isNew = f_size(&_file) < journalSectorCount * 512;
+    if (isNew && (f_lseek(&_file, journalSectorCount * 512) != FR_OK ||
+        f_tell(&_file) != journalSectorCount * 512))
+    {
+        // not enough space
+        f_close(&_file);
+        return false;
+    }
+
+    _sectorMap.Initialize(&_file, _sdSectors, journalSectorCount);
+    _isOpen = true;
+    if (isNew)
+    {
+        // the clusters of the journal may hold anything, invalidate the headers
+        memset(_sectorBuffer, 0, sizeof(_sectorBuffer));
+        for (u32 slot = 0; slot < SAVE_JOURNAL_SLOT_COUNT; slot++)
+        {
+            _sectorMap.WriteSectors(_sectorBuffer, GetSlotSector(slot), 1);
+        }
+        _sectorMap.Sync();
+        f_sync(&_file);
+    }
+    return true;
+}
+
+bool SaveJournal::TryLoadHeader(u32 slot, save_journal_header_t& header)
+{
+    _sectorMap.ReadSectors(_sectorBuffer, GetSlotSector(slot), 1);
+    memcpy(&header, _sectorBuffer, sizeof(header));
+    return header.magic == SAVE_JOURNAL_MAGIC &&
+        header.version == SAVE_JOURNAL_VERSION &&
+        header.sectorCount == _sectorCount &&
+        (header.generation & 1) == slot;
+}
+
+bool SaveJournal::TryRecoverFromSlot(const save_journal_header_t& header, u8* saveData, u32* dirtySectors)
+{
+    u32* sectorCrcs = _slotSectorCrcs;
+    memcpy(sectorCrcs, _sectorCrcs, _sectorCount * sizeof(u32));
+    u32 slotSector = GetSlotSector(header.generation) + 1;
+    u32 sector = 0;
+    u32 runLength;
+    while (sav_findSectorRun(header.dirtySectors, _sectorCount, sector, runLength))
+    {
+        for (u32 i = 0; i < runLength; i++)
+        {
+            _sectorMap.ReadSectors(_sectorBuffer, slotSector + sector + i, 1);
+            sectorCrcs[sector + i] = sCrc32Table.Update(0, _sectorBuffer, 512);
+        }
+        sector += runLength;
+    }
+
+    if (getHeaderCrc(header, sectorCrcs) != header.crc ||
+        sCrc32Table.Update(0, sectorCrcs, _sectorCount * sizeof(u32)) != header.imageCrc)
+    {
+        // either the slot was not committed, or the save file was replaced by a different save
+        return false;
+    }
+
+    sector = 0;
+    while (sav_findSectorRun(header.dirtySectors, _sectorCount, sector, runLength))
+    {
+        _sectorMap.ReadSectors(saveData + sector * 512, slotSector + sector, runLength);
+        for (u32 i = 0; i < runLength; i++, sector++)
+        {
+            dirtySectors[sector >> 5] |= 1 << (sector & 31);
+        }
+    }
+    memcpy(_sectorCrcs, sectorCrcs, _sectorCount * sizeof(u32));
+    return true;
+}
+
+bool SaveJournal::Recover(u8* saveData, u32* dirtySectors)
+{
+    for (u32 sector = 0; sector < _sectorCount; sector++)
+    {
+        _sectorCrcs[sector] = sCrc32Table.Update(0, saveData + sector * 512, 512);
+    }
+
+    save_journal_header_t headers[SAVE_JOURNAL_SLOT_COUNT];
+    bool isValid[SAVE_JOURNAL_SLOT_COUNT];
+    for (u32 slot = 0; slot < SAVE_JOURNAL_SLOT_COUNT; slot++)
+    {
+        isValid[slot] = TryLoadHeader(slot, headers[slot]);
+        if (isValid[slot] && headers[slot].generation > _generation)
+        {
+            _generation = headers[slot].generation;
+        }
+    }
+
+    // only the newest generation can be torn, the one before it was complete when the newest was committed
+    u32 newestSlot = _generation & 1;
+    if (!isValid[newestSlot])
+    {
+        return false;
+    }
+
+    const auto& header = headers[newestSlot];
+    if (sCrc32Table.Update(0, _sectorCrcs, _sectorCount * sizeof(u32)) == header.imageCrc)
+    {
+        // the save file is complete
+        return false;
+    }
+
+    if (TryRecoverFromSlot(header, saveData, dirtySectors))
+    {
+        return true;
+    }
+
+    // the newest generation was not committed, so the save file holds the one before it
+    return false;
+}
+
+void SaveJournal::BuildHeader(u32 generation, const u32* dirtySectors)
+{
+    memset(_sectorBuffer, 0, sizeof(_sectorBuffer));
+    auto& header = *(save_journal_header_t*)_sectorBuffer;
+    header.magic = SAVE_JOURNAL_MAGIC;
+    header.version = SAVE_JOURNAL_VERSION;
+    header.sectorCount = _sectorCount;
+    header.generation = generation;
+    memcpy(header.dirtySectors, dirtySectors, sizeof(header.dirtySectors));
+    header.imageCrc = sCrc32Table.Update(0, _sectorCrcs, _sectorCount * sizeof(u32));
+    header.crc = getHeaderCrc(header, _sectorCrcs);
+}
+
+void SaveJournal::Commit(const u8* saveData, const u32* dirtySectors)
+{
+    u32 generation = _generation + 1;
+    u32 slotSector = GetSlotSector(generation);
+    u32 sector = 0;
+    u32 runLength;
+    while (sav_findSectorRun(dirtySectors, _sectorCount, sector, runLength))
+    {
+        for (u32 i = sector; i < sector + runLength; i++)
+        {
+            _sectorCrcs[i] = sCrc32Table.Update(0, saveData + i * 512, 512);
+        }
+        _sectorMap.WriteSectors(saveData + sector * 512, slotSector + 1 + sector, runLength);
+        sector += runLength;
+    }
+    BuildHeader(generation, dirtySectors);
+
+    // the data must be complete before the header commits it
+    _sectorMap.Sync();
+    _sectorMap.WriteSectors(_sectorBuffer, slotSector, 1);
+    _sectorMap.Sync();
+    _generation = generation;
+}
+
+u32 SaveJournal::CommitAsync(const u8* sectorData, const u32* dirtySectors, FsSegment* segments, FsWaitToken* waitTokens)
+{
+    u32 generation = _generation + 1;
+    u32 slotSector = GetSlotSector(generation);
+    u32 segmentCount = 0;
+    u32 sector = 0;
+    u32 runLength;
+    while (sav_findSectorRun(dirtySectors, _sectorCount, sector, runLength))
+    {
+        for (u32 i = sector; i < sector + runLength; i++)
+        {
+            _sectorCrcs[i] = sCrc32Table.Update(0, sectorData, 512);
+            segmentCount = _sectorMap.AppendSegments(segments, segmentCount, (void*)sectorData, slotSector + 1 + i, 1);
+            sectorData += 512;
+        }
+        sector += runLength;
+    }
+    BuildHeader(generation, dirtySectors);
+
+    // the arm7 executes transactions of the same priority in submission order,
+    // so the data is complete before the header commits it
+    _sectorMap.WriteSegmentsAsync(segments, segmentCount, FS_PRIORITY_LOW, &waitTokens[0]);
+    u32 headerSegmentCount = _sectorMap.AppendSegments(&segments[segmentCount], 0, _sectorBuffer, slotSector, 1);
+    _sectorMap.WriteSegmentsAsync(&segments[segmentCount], headerSegmentCount, FS_PRIORITY_LOW, &waitTokens[1]);
+    _generation = generation;
+    return segmentCount + headerSegmentCount;
+}
+
+void SaveJournal::Close()
+{
+    if (_isOpen)
+    {
+        f_close(&_file);
+        _isOpen = false;
+    }
+    _generation = 0;
+}
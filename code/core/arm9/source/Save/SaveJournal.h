@@ -0,0 +1,122 @@
+#pragma once
+#include "Fat/ff.h"
+#include "Save.h"
+#include "SectorMappedFile.h"
+
+// The save file itself stays a plain save image. Before dirty sectors are written to it in place,
+// they are committed to a journal file next to it, such that a write that is torn by a power loss
+// or a reset can be completed on the next boot.
+//
+// The journal consists of two slots that are used alternately. A slot is a header sector followed by
+// one sector for each save sector, of which only the sectors written in the generation of the slot are
+// valid. A generation is committed by the write of its header sector, after its data sectors reached
+// the sd card. The previous generation is always complete in the save file at that point.
+
+#define SAVE_JOURNAL_MAGIC          0x4C4E524A // JRNL
+#define SAVE_JOURNAL_VERSION        1
+#define SAVE_JOURNAL_SLOT_COUNT     2
+#define SAVE_JOURNAL_EXTENSION      ".jrn"
+
+/// @brief The header sector of a journal slot.
+typedef struct
+{
+    u32 magic;
+    u16 version;
+    /// @brief The number of sectors of the save.
+    u16 sectorCount;
+    u32 generation;
+    /// @brief A bit for each save sector that was written in this generation.
+    u32 dirtySectors[SAVE_SECTOR_COUNT / 32];
+    /// @brief The crc of the crcs of all sectors of the save after this generation.
+    u32 imageCrc;
+    /// @brief The crc of the fields above, continued over the crcs of the dirty sectors.
+    u32 crc;
+} save_journal_header_t;
+
+/// @brief Finds the next run of set bits in a sector bitmap.
+/// @param bitmap The bitmap.
+/// @param sectorCount The number of sectors in the bitmap.
+/// @param sector The sector to start searching at. Set to the first sector of the run.
+/// @param runLength Set to the number of sectors in the run.
+/// @return True if a run was found, or false if there are no set bits from sector on.
+static inline bool sav_findSectorRun(const u32* bitmap, u32 sectorCount, u32& sector, u32& runLength)
+{
+    while (sector < sectorCount && !(bitmap[sector >> 5] & (1 << (sector & 31))))
+    {
+        sector++;
+    }
+    if (sector == sectorCount)
+    {
+        return false;
+    }
+    u32 end = sector + 1;
+    while (end < sectorCount && (bitmap[end >> 5] & (1 << (end & 31))))
+    {
+        end++;
+    }
+    runLength = end - sector;
+    return true;
+}
+
+/// @brief The journal of a save file.
+class SaveJournal
+{
+    FIL _file;
+    SectorMappedFile _sectorMap;
+    u32 _sdSectors[SAVE_JOURNAL_SLOT_COUNT * (1 + SAVE_SECTOR_COUNT)];
+    u32 _sectorCount = 0;
+    u32 _generation = 0;
+    bool _isOpen = false;
+
+    /// @brief The crc of each sector of the save as of the last committed generation.
+    u32 _sectorCrcs[SAVE_SECTOR_COUNT];
+    /// @brief The crc of each sector of the save after completing the write of a slot, used for recovery.
+    u32 _slotSectorCrcs[SAVE_SECTOR_COUNT];
+    u8 _sectorBuffer[512] alignas(32);
+
+    u32 GetSlotSector(u32 generation) const { return (generation & 1) * (1 + _sectorCount); }
+    bool TryLoadHeader(u32 slot, save_journal_header_t& header);
+    bool TryRecoverFromSlot(const save_journal_header_t& header, u8* saveData, u32* dirtySectors);
+
+    /// @brief Builds the header of the given generation in _sectorBuffer from the current sector crcs.
+    void BuildHeader(u32 generation, const u32* dirtySectors);
+
+public:
+    /// @brief Opens the journal of the given save file, or creates it when it does not exist.
+    /// @param savePath The path of the save file.
+    /// @param saveSize The size of the save in bytes, a multiple of 512.
+    /// @return True if the journal can be used.
+    bool Open(const char* savePath, u32 saveSize);
+
+    /// @brief Completes a torn write of the newest committed generation. Must be called after Open,
+    ///        with the save as it was loaded from the save file.
+    /// @param saveData The save. The sectors of a torn write are restored in it.
+    /// @param dirtySectors The bitmap in which the restored sectors are marked,
+    ///                     which still have to be written to the save file.
+    /// @return True if sectors were restored.
+    bool Recover(u8* saveData, u32* dirtySectors);
+
+    /// @brief Commits the dirty sectors of the save as a new generation.
+    ///        Afterwards the dirty sectors can be written to the save file in place.
+    /// @param saveData The save.
+    /// @param dirtySectors The bitmap of the sectors to commit.
+    void Commit(const u8* saveData, const u32* dirtySectors);
+
+    /// @brief Starts committing dirty sectors as a new generation with two transactions of FS_PRIORITY_LOW,
+    ///        one for the data and one for the header. Afterwards the dirty sectors can be written to the
+    ///        save file in place with FS_PRIORITY_LOW as well, which the arm7 executes after the commit.
+    ///        Requires IsMapped.
+    /// @param sectorData The cache aligned data of the dirty sectors, packed in ascending sector order.
+    ///                   Must stay valid until the transactions completed.
+    /// @param dirtySectors The bitmap of the sectors to commit.
+    /// @param segments Room for the segment lists of the transactions, one more than the number of dirty sectors.
+    ///                 Must be in main memory and stay valid until the transactions completed.
+    /// @param waitTokens The wait tokens of the two transactions.
+    /// @return The number of segments that were used.
+    u32 CommitAsync(const u8* sectorData, const u32* dirtySectors, FsSegment* segments, FsWaitToken* waitTokens);
+
+    void Close();
+
+    bool IsOpen() const { return _isOpen; }
+    bool IsMapped() const { return _sectorMap.IsMapped(); }
+};
@@ -28,9 +28,12 @@ extern u32 sav_callSwi15();
 extern u8 sav_readSaveByte(u32 saveAddress);
 extern void sav_writeSaveByte(u32 saveAddress, u8 value);
 
-extern u8 sav_readSaveByteFromFileFromUserMode(u32 saveAddress);
-extern void sav_writeSaveByteToFileFromUserMode(u32 saveAddress, u8 data);
-extern void sav_flushSaveFileFromUserMode(void);
+// The span save api of Save.h for the save functions that are called by the game in user mode.
+// Each of them is a single swi, such that one save function of the game costs one call.
+extern void sav_readFromUserMode(u32 saveAddress, void* dst, u32 length);
+extern void sav_writeFromUserMode(u32 saveAddress, const void* src, u32 length);
+extern void sav_fillFromUserMode(u32 saveAddress, u8 value, u32 length);
+extern u32 sav_compareFromUserMode(u32 saveAddress, const void* src, u32 length);
 
 #ifdef __cplusplus
 }
@@ -9,11 +9,13 @@ arm_func sav_swiHandler
     cmp r13, #0x91
         beq sav_swiWriteSaveByte
     cmp r13, #0x92
-        beq sav_swiReadSaveByteFromFile
+        beq sav_swiRead
     cmp r13, #0x93
-        beq sav_swiWriteSaveByteToFile
+        beq sav_swiWrite
     cmp r13, #0x94
-        beq sav_swiFlushSaveFile
+        beq sav_swiFill
+    cmp r13, #0x95
+        beq sav_swiCompare
     adr r12, (sav_swiTable - (0x80 * 4))
     ldr r12, [r12, r13, lsl #2]
     msr cpsr_c, #0x9F
@@ -42,23 +44,29 @@ arm_func sav_swiWriteSaveByte
     strb r1, [r2, r0]
     movs pc, lr
 
-arm_func sav_swiReadSaveByteFromFile
+arm_func sav_swiRead
     msr cpsr_c, #0x9F
     push {lr}
     adr lr, returnFromSwi
-    b sav_readSaveByteFromFile
+    b sav_read
 
-arm_func sav_swiWriteSaveByteToFile
+arm_func sav_swiWrite
     msr cpsr_c, #0x9F
     push {lr}
     adr lr, returnFromSwi
-    b sav_writeSaveByteToFile
+    b sav_write
 
-arm_func sav_swiFlushSaveFile
+arm_func sav_swiFill
     msr cpsr_c, #0x9F
     push {lr}
     adr lr, returnFromSwi
-    b sav_flushSaveFile
+    b sav_fill
+
+arm_func sav_swiCompare
+    msr cpsr_c, #0x9F
+    push {lr}
+    adr lr, returnFromSwi
+    b sav_compare
 
 returnFromSwi:
     pop {lr}
@@ -106,14 +114,18 @@ thumb_func sav_writeSaveByte
     swi 0x91
     bx lr
 
-thumb_func sav_readSaveByteFromFileFromUserMode
+thumb_func sav_readFromUserMode
     swi 0x92
     bx lr
 
-thumb_func sav_writeSaveByteToFileFromUserMode
+thumb_func sav_writeFromUserMode
     swi 0x93
     bx lr
 
-thumb_func sav_flushSaveFileFromUserMode
+thumb_func sav_fillFromUserMode
     swi 0x94
     bx lr
+
+thumb_func sav_compareFromUserMode
+    swi 0x95
+    bx lr
@@ -1,18 +1,21 @@
 #include "common.h"
 #include <algorithm>
 #include <array>
+#include <string.h>
 #include "SdCache/SdCache.h"
+#include "SdCache/CompressedRom.h"
 #include "SaveEeprom.h"
 #include "SaveFlash.h"
 #include "SaveSram.h"
+#include "MemFastSearch.h"
 #include "SaveTagScanner.h"
 
-#define SAVE_TAG_SCANNER_TEMP_BUFFER_HALF_SIZE  (SAVE_TAG_SCANNER_TEMP_BUFFER_SIZE >> 1)
-
 #define TAG_START_FLAS  0x53414C46
 #define TAG_START_SRAM  0x4D415253
 #define TAG_START_EEPR  0x52504545
 
+static constexpr u32 sTagStarts[3] = { TAG_START_FLAS, TAG_START_SRAM, TAG_START_EEPR };
+
 static constexpr auto sSaveTypeInfos = std::to_array<const SaveTypeInfo>
 ({
     {"EEPROM_V111", 12, SAVE_TYPE_EEPROM_V111, 512, eeprom_patchV111},
@@ -46,47 +49,137 @@ static constexpr auto sSaveTypeInfos = std::to_array<const SaveTypeInfo>
     {"SRAM_V113", 10, SAVE_TYPE_SRAM_V113, 32 * 1024, sram_patchV111},
 });
 
-const SaveTypeInfo* SaveTagScanner::FindSaveTag(FIL* romFile, u8* tempBuffer, u32& tagRomAddress)
+const SaveTypeInfo* SaveTagScanner::FindSaveTag(FIL* romFile, const void* loadedRom, u32 loadedRomSize, u8* tempBuffer, u32& tagRomAddress)
 {
     tagRomAddress = 0;
-    f_rewind(romFile);
-    UINT read;
-    u32 curAddr = 0;
-    if (f_read(romFile, tempBuffer, SAVE_TAG_SCANNER_TEMP_BUFFER_HALF_SIZE, &read) != FR_OK)
+    u32 romSize = crom_getRomSize(romFile);
+    loadedRomSize = loadedRom ? std::min(loadedRomSize, romSize) & ~3 : 0;
+    if (loadedRomSize < SAVE_TAG_SCANNER_TAG_SIZE)
     {
-        return nullptr;
+        loadedRomSize = 0;
     }
-    int searchBufPtr = 0;
-    while (curAddr < f_size(romFile))
+
+    _tailLength = 0;
+    u32 romAddress = 0;
+    while (romAddress < romSize)
     {
-        if (searchBufPtr == 0)
+        // the loaded part of the rom is scanned in place, the rest is read in large aligned blocks
+        const u8* block;
+        u32 blockLength;
+        if (romAddress < loadedRomSize)
         {
-            if (f_read(romFile, tempBuffer + SAVE_TAG_SCANNER_TEMP_BUFFER_HALF_SIZE,
-                SAVE_TAG_SCANNER_TEMP_BUFFER_HALF_SIZE, &read) != FR_OK)
-            {
-                return nullptr;
-            }
+            block = (const u8*)loadedRom;
+            blockLength = loadedRomSize;
         }
-        else if (searchBufPtr == SAVE_TAG_SCANNER_TEMP_BUFFER_HALF_SIZE)
+        else
         {
-            if (f_read(romFile, tempBuffer, SAVE_TAG_SCANNER_TEMP_BUFFER_HALF_SIZE, &read) != FR_OK)
-            {
-                return nullptr;
-            }
+            block = tempBuffer;
+            blockLength = std::min<u32>(SAVE_TAG_SCANNER_TEMP_BUFFER_SIZE, romSize - romAddress);
+            crom_read(romFile, romAddress, tempBuffer, blockLength);
         }
 
-        SaveType saveType = IdentifySaveTypeFromFirst4TagBytes(*(u32*)&tempBuffer[searchBufPtr]);
-        if (saveType != SAVE_TYPE_NONE)
+        auto saveTypeInfo = ScanBlock(block, blockLength, romAddress, romAddress + blockLength == romSize, tagRomAddress);
+        if (saveTypeInfo)
         {
-            auto saveTypeInfo = GetSaveTypeInfoFromTag(saveType, tempBuffer, searchBufPtr);
-            if (saveTypeInfo)
-            {
-                tagRomAddress = curAddr;
-                return saveTypeInfo;
-            }
+            return saveTypeInfo;
+        }
+        romAddress += blockLength;
+    }
+    return nullptr;
+}
+
+bool SaveTagScanner::IsSaveTagAt(FIL* romFile, const void* loadedRom, u32 loadedRomSize,
+    const SaveTypeInfo* saveTypeInfo, u32 tagRomAddress)
+{
+    // compared like the scanner does, including the zero padding up to the next word
+    u32 alignedTagLength = (saveTypeInfo->tagLength + 3) & ~3;
+    if (tagRomAddress & 3)
+    {
+        return false;
+    }
+
+    u32 romSize = crom_getRomSize(romFile);
+    if (tagRomAddress >= romSize)
+    {
+        return false;
+    }
+
+    // the rom is padded with zeros beyond its end, like ScanWindow does
+    u8 tag[SAVE_TAG_SCANNER_TAG_SIZE];
+    memset(tag, 0, sizeof(tag));
+    u32 length = std::min(alignedTagLength, romSize - tagRomAddress);
+    if (loadedRom && tagRomAddress + length <= loadedRomSize)
+    {
+        memcpy(tag, (const u8*)loadedRom + tagRomAddress, length);
+    }
+    else if (crom_read(romFile, tagRomAddress, tag, length) != length)
+    {
+        return false;
+    }
+    return memcmp(tag, saveTypeInfo->tag, alignedTagLength) == 0;
+}
+
+const SaveTypeInfo* SaveTagScanner::ScanBlock(const u8* block, u32 length, u32 romAddress, bool isLastBlock, u32& tagRomAddress)
+{
+    u8* window = (u8*)_window;
+    if (isLastBlock && length <= SAVE_TAG_SCANNER_TAG_SIZE)
+    {
+        memcpy(window + _tailLength, block, length);
+        return ScanWindow(_tailLength + length, romAddress - _tailLength, tagRomAddress);
+    }
+
+    // the tags that start at the end of the previous block continue in this block
+    memcpy(window + _tailLength, block, SAVE_TAG_SCANNER_TAG_SIZE);
+    auto saveTypeInfo = ScanWords(window, _tailLength, romAddress - _tailLength, tagRomAddress);
+    if (saveTypeInfo)
+    {
+        return saveTypeInfo;
+    }
+
+    u32 inPlaceLength = (length - SAVE_TAG_SCANNER_TAG_SIZE) & ~3;
+    saveTypeInfo = ScanWords(block, inPlaceLength, romAddress, tagRomAddress);
+    if (saveTypeInfo)
+    {
+        return saveTypeInfo;
+    }
+
+    _tailLength = length - inPlaceLength;
+    memcpy(window, block + inPlaceLength, _tailLength);
+    if (isLastBlock)
+    {
+        return ScanWindow(_tailLength, romAddress + inPlaceLength, tagRomAddress);
+    }
+    return nullptr;
+}
+
+const SaveTypeInfo* SaveTagScanner::ScanWindow(u32 length, u32 romAddress, u32& tagRomAddress)
+{
+    // the end of the rom, tags that would continue beyond it do not match the padding
+    u8* window = (u8*)_window;
+    memset(window + length, 0, SAVE_TAG_SCANNER_TAG_SIZE);
+    return ScanWords(window, (length + 3) & ~3, romAddress, tagRomAddress);
+}
+
+const SaveTypeInfo* SaveTagScanner::ScanWords(const u8* data, u32 length, u32 romAddress, u32& tagRomAddress)
+{
+    const u32* position = (const u32*)data;
+    const u32* end = (const u32*)(data + length);
+    while (position < end)
+    {
+        // find the candidates with a single pass over all tag starts
+        position = mem_fastSearchAny3(position, (end - position) * 4, sTagStarts);
+        if (!position)
+        {
+            break;
+        }
+        SaveType saveType = IdentifySaveTypeFromFirst4TagBytes(*position);
+        auto saveTypeInfo = GetSaveTypeInfoFromTag(saveType, (const u8*)position);
+        if (saveTypeInfo)
+        {
+            tagRomAddress = romAddress + ((const u8*)position - data);
+            return saveTypeInfo;
         }
-        searchBufPtr = (searchBufPtr + 4) & (SAVE_TAG_SCANNER_TEMP_BUFFER_SIZE - 1);
-        curAddr += 4;
+        position++;
     }
     return nullptr;
 }
@@ -114,7 +207,7 @@ SaveType SaveTagScanner::IdentifySaveTypeFromFirst4TagBytes(u32 first4TagBytes)
     }
 }
 
-const SaveTypeInfo* SaveTagScanner::GetSaveTypeInfoFromTag(SaveType saveType, const u8* tempBuffer, u32 searchBufPtr)
+const SaveTypeInfo* SaveTagScanner::GetSaveTypeInfoFromTag(SaveType saveType, const u8* tag)
 {
     for (const auto& saveTypeInfo : sSaveTypeInfos)
     {
@@ -127,7 +220,7 @@ const SaveTypeInfo* SaveTagScanner::GetSaveTypeInfoFromTag(SaveType saveType, co
         for (u32 j = 4; j < alignedTagLength; j += 4)
         {
             const u32 expected = *(u32*)&saveTypeInfo.tag[j];
-            const u32 actual = *(u32*)&tempBuffer[(searchBufPtr + j) & (SAVE_TAG_SCANNER_TEMP_BUFFER_SIZE - 1)];
+            const u32 actual = *(const u32*)&tag[j];
             if (actual != expected)
             {
                 found = false;
@@ -141,3 +234,13 @@ const SaveTypeInfo* SaveTagScanner::GetSaveTypeInfoFromTag(SaveType saveType, co
     }
     return nullptr;
 }
+
+u32 SaveTagScanner::GetSaveTypeInfoIndex(const SaveTypeInfo* saveTypeInfo)
+{
+    return saveTypeInfo - sSaveTypeInfos.data();
+}
+
+const SaveTypeInfo* SaveTagScanner::GetSaveTypeInfo(u32 index)
+{
+    return index < sSaveTypeInfos.size() ? &sSaveTypeInfos[index] : nullptr;
+}
@@ -4,15 +4,62 @@
 
 #define SAVE_TAG_SCANNER_TEMP_BUFFER_SIZE   (64 * 1024)
 
+/// @brief The number of bytes that are compared for a tag, the size of SaveTypeInfo::tag.
+#define SAVE_TAG_SCANNER_TAG_SIZE           16
+
 class SaveTagScanner
 {
+    /// @brief The end of the previous block, of which the tags were not scanned yet,
+    ///        followed by the start of the current block or by padding.
+    u32 _window[SAVE_TAG_SCANNER_TAG_SIZE];
+    u32 _tailLength;
+
     SaveType IdentifySaveTypeFromFirst4TagBytes(u32 first4TagBytes);
-    const SaveTypeInfo* GetSaveTypeInfoFromTag(SaveType saveType, const u8* tempBuffer, u32 searchBufPtr);
+    const SaveTypeInfo* GetSaveTypeInfoFromTag(SaveType saveType, const u8* tag);
+
+    /// @brief Scans the next block of the rom for save tags. Tags that start in the last
+    ///        SAVE_TAG_SCANNER_TAG_SIZE bytes of the block are scanned with the next block.
+    /// @param block The block.
+    /// @param length The length of the block. Except for the last block, a multiple of 4
+    ///               and at least SAVE_TAG_SCANNER_TAG_SIZE.
+    /// @param romAddress The rom address of the block.
+    /// @param isLastBlock True if the block ends at the end of the rom.
+    /// @param tagRomAddress When successful this will contain the rom address of the found save tag.
+    /// @return Save type information when a tag was found, or nullptr otherwise.
+    const SaveTypeInfo* ScanBlock(const u8* block, u32 length, u32 romAddress, bool isLastBlock, u32& tagRomAddress);
+
+    /// @brief Scans the first length bytes of _window at the end of the rom.
+    const SaveTypeInfo* ScanWindow(u32 length, u32 romAddress, u32& tagRomAddress);
+
+    /// @brief Scans the word aligned positions of the given data for save tags.
+    ///        The data must be followed by at least SAVE_TAG_SCANNER_TAG_SIZE readable bytes.
+    const SaveTypeInfo* ScanWords(const u8* data, u32 length, u32 romAddress, u32& tagRomAddress);
+
 public:
     /// @brief Scans the given romFile for known save tags.
     /// @param romFile The rom file to scan.
+    /// @param loadedRom The start of the rom when it is already loaded into memory, or nullptr.
+    ///                  This part is scanned in place instead of being read from the rom file again.
+    /// @param loadedRomSize The number of bytes of the rom at loadedRom.
     /// @param tempBuffer A temporarily buffer of SAVE_TAG_SCANNER_TEMP_BUFFER_SIZE used for scanning.
     /// @param tagRomAddress When successful this will contain the rom address of the found save tag.
     /// @return Save type information when a tag was found, or nullptr otherwise.
-    const SaveTypeInfo* FindSaveTag(FIL* romFile, u8* tempBuffer, u32& tagRomAddress);
+    const SaveTypeInfo* FindSaveTag(FIL* romFile, const void* loadedRom, u32 loadedRomSize, u8* tempBuffer, u32& tagRomAddress);
+
+    /// @brief Checks whether the tag of the given save type is at the given rom address, such that
+    ///        a previously detected save type can be used without scanning the rom again.
+    /// @param romFile The rom file.
+    /// @param loadedRom The start of the rom when it is already loaded into memory, or nullptr.
+    /// @param loadedRomSize The number of bytes of the rom at loadedRom.
+    /// @param saveTypeInfo The save type information of the tag.
+    /// @param tagRomAddress The rom address of the tag.
+    /// @return True if the tag was found at tagRomAddress.
+    static bool IsSaveTagAt(FIL* romFile, const void* loadedRom, u32 loadedRomSize,
+        const SaveTypeInfo* saveTypeInfo, u32 tagRomAddress);
+
+    /// @brief Gets the index of the given save type information, such that it can be stored.
+    static u32 GetSaveTypeInfoIndex(const SaveTypeInfo* saveTypeInfo);
+
+    /// @brief Gets the save type information with the given index, or nullptr when the index is invalid.
+    static const SaveTypeInfo* GetSaveTypeInfo(u32 index);
 };
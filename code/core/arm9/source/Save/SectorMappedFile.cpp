@@ -0,0 +1,129 @@
+#include "common.h"
+#include "Fat/ff.h"
+#include "Fat/diskio.h"
+#include "SectorMappedFile.h"
+
+void SectorMappedFile::Initialize(FIL* file, u32* sdSectors, u32 sectorCount)
+{
+    _file = file;
+    _sdSectors = sdSectors;
+    _isMapped = false;
+
+    _clusterTable[0] = sizeof(_clusterTable) / sizeof(DWORD);
+    _file->cltbl = _clusterTable;
+    if (f_lseek(_file, CREATE_LINKMAP) != FR_OK)
+    {
+        // too fragmented, fall back to following the cluster chain
+        _file->cltbl = nullptr;
+        return;
+    }
+
+    const FATFS* fs = _file->obj.fs;
+    const DWORD* linkMap = _clusterTable + 1;
+    u32 sector = 0;
+    while (sector < sectorCount)
+    {
+        u32 clusterCount = *linkMap++;
+        if (clusterCount == 0)
+        {
+            return;
+        }
+        u32 sdSector = fs->database + (*linkMap++ - 2) * fs->csize;
+        u32 fragmentEnd = sector + clusterCount * fs->csize;
+        while (sector < sectorCount && sector < fragmentEnd)
+        {
+            _sdSectors[sector++] = sdSector++;
+        }
+    }
+    _isMapped = true;
+}
+
+void SectorMappedFile::ReadSectors(void* buffer, u32 fileSector, u32 count)
+{
+    if (!_isMapped)
+    {
+        f_lseek(_file, fileSector * 512);
+        UINT bytesRead = 0;
+        f_read(_file, buffer, count * 512, &bytesRead);
+        return;
+    }
+
+    BYTE pdrv = _file->obj.fs->pdrv;
+    u32 end = fileSector + count;
+    while (fileSector < end)
+    {
+        u32 runLength = 1;
+        while (fileSector + runLength < end && _sdSectors[fileSector + runLength] == _sdSectors[fileSector] + runLength)
+        {
+            runLength++;
+        }
+        disk_read(pdrv, (BYTE*)buffer, _sdSectors[fileSector], runLength);
+        buffer = (u8*)buffer + runLength * 512;
+        fileSector += runLength;
+    }
+}
+
+void SectorMappedFile::WriteSectors(const void* buffer, u32 fileSector, u32 count)
+{
+    if (!_isMapped)
+    {
+        f_lseek(_file, fileSector * 512);
+        UINT bytesWritten = 0;
+        f_write(_file, buffer, count * 512, &bytesWritten);
+        return;
+    }
+
+    BYTE pdrv = _file->obj.fs->pdrv;
+    u32 end = fileSector + count;
+    while (fileSector < end)
+    {
+        u32 runLength = 1;
+        while (fileSector + runLength < end && _sdSectors[fileSector + runLength] == _sdSectors[fileSector] + runLength)
+        {
+            runLength++;
+        }
+        disk_write(pdrv, (const BYTE*)buffer, _sdSectors[fileSector], runLength);
+        buffer = (const u8*)buffer + runLength * 512;
+        fileSector += runLength;
+    }
+}
+
+void SectorMappedFile::Sync()
+{
+    if (_isMapped)
+    {
+        disk_ioctl(_file->obj.fs->pdrv, CTRL_SYNC, nullptr);
+    }
+    else
+    {
+        f_sync(_file);
+    }
+}
+
+u32 SectorMappedFile::AppendSegments(FsSegment* segments, u32 segmentCount, void* buffer, u32 fileSector, u32 count) const
+{
+    for (u32 i = 0; i < count; i++)
+    {
+        u32 sdSector = _sdSectors[fileSector + i];
+        u8* sectorBuffer = (u8*)buffer + i * 512;
+        if (segmentCount != 0)
+        {
+            auto& last = segments[segmentCount - 1];
+            if (last.sector + last.count == sdSector && (u8*)last.buffer + last.count * 512 == sectorBuffer)
+            {
+                last.count++;
+                continue;
+            }
+        }
+        segments[segmentCount].sector = sdSector;
+        segments[segmentCount].count = 1;
+        segments[segmentCount].buffer = sectorBuffer;
+        segmentCount++;
+    }
+    return segmentCount;
+}
+
+void SectorMappedFile::WriteSegmentsAsync(const FsSegment* segments, u32 segmentCount, FsPriority priority, FsWaitToken* waitToken)
+{
+    disk_writeSegmentsAsync(_file->obj.fs->pdrv, segments, segmentCount, priority, waitToken);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "Fat/ff.h"
+#include "Fat/FsIpc.h"
+
+/// @brief Maps the sectors of an open file to sd sectors once through its cluster link map, such that
+///        the sectors can be accessed with disk_read and disk_write without going through FatFs.
+///        Falls back to FatFs when the file is too fragmented for the link map.
+class SectorMappedFile
+{
+    FIL* _file = nullptr;
+    u32* _sdSectors = nullptr;
+    bool _isMapped = false;
+    DWORD _clusterTable[64];
+
+public:
+    /// @brief Loads the cluster link map of the given file and maps its first sectorCount sectors.
+    /// @param file The open file. Must be at least sectorCount sectors large.
+    /// @param sdSectors The table to fill with the sd sector of each file sector.
+    ///                  Must have room for sectorCount entries and stay valid while the file is used.
+    /// @param sectorCount The number of sectors to map.
+    void Initialize(FIL* file, u32* sdSectors, u32 sectorCount);
+
+    void ReadSectors(void* buffer, u32 fileSector, u32 count);
+
+    /// @brief Writes the given sectors, merging sectors that are contiguous on the sd card into one write.
+    void WriteSectors(const void* buffer, u32 fileSector, u32 count);
+
+    /// @brief Makes sure that all written sectors reached the sd card.
+    void Sync();
+
+    /// @brief Appends the sd sector runs of the given file sectors to a segment list for
+    ///        WriteSegmentsAsync, extending the last segment when the sectors continue it.
+    ///        Requires the file to be mapped.
+    /// @param segments The segment list.
+    /// @param segmentCount The number of segments in the list.
+    /// @param buffer The cache aligned data of the sectors.
+    /// @param fileSector The first file sector.
+    /// @param count The number of sectors.
+    /// @return The new number of segments in the list.
+    u32 AppendSegments(FsSegment* segments, u32 segmentCount, void* buffer, u32 fileSector, u32 count) const;
+
+    /// @brief Starts writing a segment list that was built with AppendSegments, past FatFs.
+    void WriteSegmentsAsync(const FsSegment* segments, u32 segmentCount, FsPriority priority, FsWaitToken* waitToken);
+
+    bool IsMapped() const { return _isMapped; }
+};
@@ -0,0 +1,186 @@
+#include "common.h"
+#include <stdlib.h>
+#include <string.h>
+#include "Fat/ff.h"
+#include "Lz4.h"
+#include "CompressedRom.h"
+
+static bool sIsCompressed;
+static u32 sRomSize;
+static u32 sBlockCount;
+
+/// @brief The file offsets of the block payloads, with an extra entry for the end of the last payload.
+static u32* sBlockOffsets;
+
+static bool isValidBlockIndex(const u32* blockOffsets, u32 blockCount, u32 fileSize)
+{
+    for (u32 i = 0; i < blockCount; i++)
+    {
+        if (blockOffsets[i + 1] < blockOffsets[i] ||
+            blockOffsets[i + 1] - blockOffsets[i] == 0 ||
+            blockOffsets[i + 1] - blockOffsets[i] > SDC_BLOCK_SIZE)
+        {
+            return false;
+        }
+    }
+    return blockOffsets[blockCount] <= fileSize;
+}
+
+bool crom_open(FIL* file)
+{
+    sIsCompressed = false;
+    sRomSize = 0;
+    sBlockCount = 0;
+    if (sBlockOffsets)
+    {
+        free(sBlockOffsets);
+        sBlockOffsets = nullptr;
+    }
+
+    CompressedRomHeader header;
+    UINT bytesRead = 0;
+    f_rewind(file);
+    if (f_read(file, &header, sizeof(header), &bytesRead) != FR_OK || bytesRead != sizeof(header) ||
+        header.magic != CROM_MAGIC)
+    {
+        // plain rom
+        return false;
+    }
+
+    if (header.version != CROM_VERSION || header.blockShift != SDC_BLOCK_SHIFT ||
+        header.romSize == 0 || header.romSize > SDC_ROM_BLOCK_COUNT * SDC_BLOCK_SIZE ||
+        header.blockCount != (header.romSize + SDC_BLOCK_SIZE - 1) >> SDC_BLOCK_SHIFT)
+    {
+        gLogger->Log(LogLevel::Error, "Unsupported compressed rom container\n");
+        return false;
+    }
+
+    u32 indexSize = (header.blockCount + 1) * sizeof(u32);
+    u32* blockOffsets = (u32*)malloc(indexSize);
+    if (!blockOffsets)
+    {
+        gLogger->Log(LogLevel::Error, "Not enough memory for the compressed rom index\n");
+        return false;
+    }
+
+    if (f_read(file, blockOffsets, indexSize, &bytesRead) != FR_OK || bytesRead != indexSize ||
+        !isValidBlockIndex(blockOffsets, header.blockCount, f_size(file)))
+    {
+        gLogger->Log(LogLevel::Error, "Corrupt compressed rom index\n");
+        free(blockOffsets);
+        return false;
+    }
+
+    sIsCompressed = true;
+    sRomSize = header.romSize;
+    sBlockCount = header.blockCount;
+    sBlockOffsets = blockOffsets;
+    return true;
+}
+
+bool crom_isCompressed(void)
+{
+    return sIsCompressed;
+}
+
+u32 crom_getRomSize(FIL* file)
+{
+    return sIsCompressed ? sRomSize : f_size(file);
+}
+
+u32 crom_getBlockPayload(u32 romBlock, u32* fileOffset)
+{
+    if (romBlock >= sBlockCount)
+    {
+        return 0;
+    }
+
+    *fileOffset = sBlockOffsets[romBlock];
+    return sBlockOffsets[romBlock + 1] - sBlockOffsets[romBlock];
+}
+
+bool crom_decodeBlock(const u8* payload, u32 length, u8* dst)
+{
+    if (length == SDC_BLOCK_SIZE)
+    {
+        // stored uncompressed
+        memcpy(dst, payload, SDC_BLOCK_SIZE);
+        return true;
+    }
+
+    return lz4_decompressBlock(payload, length, dst, SDC_BLOCK_SIZE);
+}
+
+/// @brief Reads and decodes a rom block of a compressed rom through FatFs.
+static bool readCompressedBlock(FIL* file, u32 romBlock, u8* payloadBuffer, u8* dst)
+{
+    u32 fileOffset;
+    u32 length = crom_getBlockPayload(romBlock, &fileOffset);
+    UINT bytesRead = 0;
+    return length != 0 &&
+        f_lseek(file, fileOffset) == FR_OK &&
+        f_read(file, payloadBuffer, length, &bytesRead) == FR_OK && bytesRead == length &&
+        crom_decodeBlock(payloadBuffer, length, dst);
+}
+
+u32 crom_read(FIL* file, u32 romOffset, void* dst, u32 length)
+{
+    if (!sIsCompressed)
+    {
+        UINT bytesRead = 0;
+        if (f_lseek(file, romOffset) != FR_OK || f_read(file, dst, length, &bytesRead) != FR_OK)
+        {
+            return 0;
+        }
+        return bytesRead;
+    }
+
+    if (romOffset >= sRomSize)
+    {
+        return 0;
+    }
+    if (length > sRomSize - romOffset)
+    {
+        length = sRomSize - romOffset;
+    }
+
+    u8* payloadBuffer = (u8*)malloc(2 * SDC_BLOCK_SIZE);
+    if (!payloadBuffer)
+    {
+        return 0;
+    }
+    u8* blockBuffer = payloadBuffer + SDC_BLOCK_SIZE;
+
+    u32 done = 0;
+    while (done < length)
+    {
+        u32 romBlock = (romOffset + done) >> SDC_BLOCK_SHIFT;
+        u32 blockOffset = (romOffset + done) & SDC_BLOCK_MASK;
+        u32 chunkLength = SDC_BLOCK_SIZE - blockOffset;
+        if (chunkLength > length - done)
+        {
+            chunkLength = length - done;
+        }
+
+        if (chunkLength == SDC_BLOCK_SIZE)
+        {
+            // decode full blocks in place
+            if (!readCompressedBlock(file, romBlock, payloadBuffer, (u8*)dst + done))
+            {
+                break;
+            }
+        }
+        else
+        {
+            if (!readCompressedBlock(file, romBlock, payloadBuffer, blockBuffer))
+            {
+                break;
+            }
+            memcpy((u8*)dst + done, blockBuffer + blockOffset, chunkLength);
+        }
+        done += chunkLength;
+    }
+
+    free(payloadBuffer);
+    return done;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "SdCacheDefs.h"
+
+// A compressed rom container stores every 4 kB rom block as an independently compressed
+// LZ4 block, such that less data has to be read from the sd card on a cache miss.
+//
+// Layout:
+//   CompressedRomHeader
+//   u32 blockOffsets[blockCount + 1]   file offsets of the block payloads, the last entry is the file size
+//   block payloads                     a payload of SDC_BLOCK_SIZE bytes is stored uncompressed
+//
+// The last block is padded with 0xFF to a full block before compression.
+// Containers are created with the RomPacker host tool.
+
+#define CROM_MAGIC      0x345A4247 // GBZ4
+#define CROM_VERSION    1
+
+typedef struct
+{
+    u32 magic;
+    u16 version;
+    u16 blockShift;
+    u32 romSize;
+    u32 blockCount;
+} CompressedRomHeader;
+
+// host tools only use the format definitions
+#ifndef CROM_HOST_TOOL
+
+#include "Fat/ff.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Checks whether the given rom file is a compressed rom container and loads its block index.
+/// @param file The opened rom file.
+/// @return True if the file is a valid compressed rom container, or false if it is treated as a plain rom.
+bool crom_open(FIL* file);
+
+/// @brief Returns whether the rom file passed to crom_open is a compressed rom container.
+bool crom_isCompressed(void);
+
+/// @brief Returns the size of the (uncompressed) rom.
+/// @param file The rom file passed to crom_open.
+/// @return The rom size in bytes.
+u32 crom_getRomSize(FIL* file);
+
+/// @brief Returns the location of the payload of a rom block in a compressed rom container.
+/// @param romBlock The rom block.
+/// @param fileOffset Returns the file offset of the payload.
+/// @return The length of the payload in bytes, or 0 if the rom block lies beyond the end of the rom.
+u32 crom_getBlockPayload(u32 romBlock, u32* fileOffset);
+
+/// @brief Decodes a rom block payload.
+/// @param payload The payload.
+/// @param length The length of the payload in bytes.
+/// @param dst The destination buffer of SDC_BLOCK_SIZE bytes.
+/// @return True if the payload was decoded, or false if it is corrupt.
+bool crom_decodeBlock(const u8* payload, u32 length, u8* dst);
+
+/// @brief Reads uncompressed rom data through FatFs, independent of whether the rom is compressed.
+///        Intended for boot time code, like header parsing and save type detection.
+/// @param file The rom file passed to crom_open.
+/// @param romOffset The offset in the rom to start reading.
+/// @param dst The destination buffer.
+/// @param length The number of bytes to read.
+/// @return The number of bytes read, which is less than length when reading past the end of the rom.
+u32 crom_read(FIL* file, u32 romOffset, void* dst, u32 length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
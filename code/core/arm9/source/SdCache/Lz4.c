@@ -0,0 +1,116 @@
+#include "common.h"
+#include <string.h>
+#include "Lz4.h"
+
+/// @brief Runs of at least this many bytes are copied with memcpy, which uses word copies when possible.
+#define LZ4_MEMCPY_THRESHOLD    16
+
+/// @brief Copies bytes in order, such that overlapping matches replicate earlier output as LZ4 requires.
+ITCM_CODE static inline void copyBytes(u8* dst, const u8* src, u32 length)
+{
+    while (length >= 4)
+    {
+        dst[0] = src[0];
+        dst[1] = src[1];
+        dst[2] = src[2];
+        dst[3] = src[3];
+        dst += 4;
+        src += 4;
+        length -= 4;
+    }
+    while (length != 0)
+    {
+        *dst++ = *src++;
+        length--;
+    }
+}
+
+/// @brief Reads the extension bytes of a literal or match length.
+/// @return False if the extension runs past the end of the input.
+ITCM_CODE static inline bool readLengthExtension(const u8** src, const u8* srcEnd, u32* length)
+{
+    u32 value;
+    do
+    {
+        if (*src == srcEnd)
+        {
+            return false;
+        }
+        value = *(*src)++;
+        *length += value;
+    } while (value == 255);
+    return true;
+}
+
+ITCM_CODE bool lz4_decompressBlock(const u8* src, u32 srcLength, u8* dst, u32 dstLength)
+{
+    const u8* srcEnd = src + srcLength;
+    u8* const dstStart = dst;
+    u8* const dstEnd = dst + dstLength;
+    while (src != srcEnd)
+    {
+        u32 token = *src++;
+        u32 literalLength = token >> 4;
+        if (literalLength == 15 && !readLengthExtension(&src, srcEnd, &literalLength))
+        {
+            return false;
+        }
+
+        if (literalLength > (u32)(srcEnd - src) || literalLength > (u32)(dstEnd - dst))
+        {
+            return false;
+        }
+
+        if (literalLength >= LZ4_MEMCPY_THRESHOLD)
+        {
+            memcpy(dst, src, literalLength);
+        }
+        else
+        {
+            copyBytes(dst, src, literalLength);
+        }
+        src += literalLength;
+        dst += literalLength;
+
+        if (src == srcEnd)
+        {
+            // the last sequence only has literals
+            break;
+        }
+
+        if (srcEnd - src < 2)
+        {
+            return false;
+        }
+
+        u32 offset = src[0] | (src[1] << 8);
+        src += 2;
+        if (offset == 0 || offset > (u32)(dst - dstStart))
+        {
+            return false;
+        }
+
+        u32 matchLength = token & 0xF;
+        if (matchLength == 15 && !readLengthExtension(&src, srcEnd, &matchLength))
+        {
+            return false;
+        }
+        matchLength += 4;
+
+        if (matchLength > (u32)(dstEnd - dst))
+        {
+            return false;
+        }
+
+        if (offset >= matchLength && matchLength >= LZ4_MEMCPY_THRESHOLD)
+        {
+            memcpy(dst, dst - offset, matchLength);
+        }
+        else
+        {
+            copyBytes(dst, dst - offset, matchLength);
+        }
+        dst += matchLength;
+    }
+    return dst == dstEnd;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Decompresses a raw LZ4 block (without frame header). The input is fully validated,
+///        such that corrupt data can never cause reads or writes outside of the given buffers.
+/// @param src The compressed data.
+/// @param srcLength The length of the compressed data in bytes.
+/// @param dst The destination buffer.
+/// @param dstLength The exact decompressed length in bytes.
+/// @return True if the block was decompressed to exactly dstLength bytes, or false if the data is corrupt.
+bool lz4_decompressBlock(const u8* src, u32 srcLength, u8* dst, u32 dstLength);
+
+#ifdef __cplusplus
+}
+#endif
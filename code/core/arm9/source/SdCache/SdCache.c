@@ -1,4 +1,6 @@
 #include "common.h"
+#include <stdlib.h>
+#include <malloc.h>
 #include <string.h>
 #include "Fat/ff.h"
 #include "Fat/diskio.h"
@@ -6,49 +8,284 @@
 #include "VirtualMachine/VMNestedIrq.h"
 #include "cp15.h"
 #include "Cpsr.h"
+#include "MemCopy.h"
 #include "SdCache.h"
+#include "SdCachePolicy.h"
+#include "SdCacheProfile.h"
+#include "SdCacheStats.h"
+#include "SdCacheTrace.h"
+#include "SdSectorTable.h"
+#include "CompressedRom.h"
+
+/// @brief The maximum number of adjacent rom blocks that are read with a single sd transaction.
+#define SDC_MAX_COALESCED_BLOCKS    8
+
+/// @brief The initial number of blocks in the patch pool.
+#define SDC_PATCH_POOL_INITIAL_CAPACITY     4
 
 typedef struct
 {
     vu16 cacheBlock;
+    vu16 isReadAhead;
     vu32 romBlock;
+    vu32 blockCount;
+    FsWaitToken* volatile waitToken;
 } SdcFetch;
 
 static SdcFetch sCurrentFetch;
 
+/// @brief Wait token of a read-ahead fetch. Read-ahead fetches are not waited for
+///        by the function that started them, so the token cannot live on the stack.
+static FsWaitToken sReadAheadWaitToken;
+
+/// @brief The maximum number of blocks to read ahead of a sequential stream
+///        of rom block misses, or 0 when read-ahead is disabled.
+static u32 sReadAheadDepth;
+
+/// @brief The rom block of the most recent miss, used to detect sequential streams.
+static u32 sLastMissRomBlock;
+
+/// @brief Marks cache blocks that were filled by read-ahead and have not been accessed yet.
+static u8 sReadAheadPending[SDC_MAX_BLOCK_COUNT];
+
+SdcReadAheadStats gSdcReadAheadStats;
+
 [[gnu::section(".vramhi.bss")]]
 void* sdc_romBlockToCacheBlock[SDC_ROM_BLOCK_COUNT];
 
-/// @brief Random generator state for random cache replacement.
-static u32 sRandomState;
-
 /// @brief Maps sd cache blocks to rom blocks.
-static u16 sCacheBlockToRomBlock[SDC_BLOCK_COUNT];
+static u16 sCacheBlockToRomBlock[SDC_MAX_BLOCK_COUNT];
+
+/// @brief Maps rom blocks to the cache block that holds them, also when that cache block has been
+///        unmapped by the replacement policy, or SDC_BLOCK_INVALID. Inverse of sCacheBlockToRomBlock.
+[[gnu::section(".ewram.bss")]]
+static u16 sRomBlockToResidentCacheBlock[SDC_ROM_BLOCK_COUNT];
+
+/// @brief The total number of cache blocks, including the blocks of the cache extension.
+static u32 sCacheBlockCount;
 
 /// @brief The number of usable blocks in the cache. This can be less than the
 ///        total number of cache blocks when some blocks are permanently loaded.
 static u32 sBlockCount;
 
+/// @brief Cache blocks that follow the SDC_BLOCK_COUNT blocks of sdc_cache, or null when
+///        the cache is not extended. These are not adjacent in memory to sdc_cache.
+static u8 (*sCacheExtension)[SDC_BLOCK_SIZE];
+
 static u32 sTabuBlock;
-vu32 gSdCacheIrqForbiddenRomBlockReplacementRange;
+
+/// @brief The memory of the victim slots, which hold blocks that were evicted from the cache.
+///        The slots can be spread over several victim pools at different addresses.
+static u8* sVictimSlotData[SDC_VICTIM_MAX_BLOCK_COUNT];
+
+/// @brief Maps victim slots to rom blocks. A rom block is never in a victim slot
+///        and a cache block at the same time.
+static u16 sVictimSlotToRomBlock[SDC_VICTIM_MAX_BLOCK_COUNT];
+
+#define SDC_VICTIM_SLOT_INVALID 0xFF
+
+/// @brief Maps rom blocks to the victim slot that holds them, or SDC_VICTIM_SLOT_INVALID.
+///        Inverse of sVictimSlotToRomBlock.
+[[gnu::section(".ewram.bss")]]
+static u8 sRomBlockToVictimSlot[SDC_ROM_BLOCK_COUNT];
+
+_Static_assert(SDC_VICTIM_MAX_BLOCK_COUNT <= SDC_VICTIM_SLOT_INVALID, "Victim slots do not fit in sRomBlockToVictimSlot");
+
+/// @brief The total number of victim slots of all victim pools, or 0 when there are no victim pools.
+static u32 sVictimSlotCount;
+
+/// @brief The next victim slot to replace. Victim slots are replaced in fifo order.
+static u32 sVictimNextSlot;
+
+/// @brief Marks cache blocks of which the rom block was accessed again after it was loaded,
+///        which are the only blocks that are demoted to a victim pool when they are evicted.
+static u8 sCacheBlockReused[SDC_MAX_BLOCK_COUNT];
+
+[[gnu::section(".ewram.bss")]]
+vu8 sdc_romBlockPinCount[SDC_ROM_BLOCK_COUNT];
+
+/// @brief Permanently loaded rom blocks that are patched. These are kept outside
+///        of the sd cache, such that patching does not reduce the cache size.
+static u8 (*sPatchPool)[SDC_BLOCK_SIZE];
+
+/// @brief Maps patch pool blocks to rom blocks.
+static u16* sPatchPoolRomBlocks;
+
+static u32 sPatchPoolCount;
+static u32 sPatchPoolCapacity;
+
+/// @brief The active cache block replacement policy.
+static const SdcPolicy* sPolicy;
 
 static DWORD sClusterTable[512];
 
+#ifdef GBAR3_SDC_TRACE
+/// @brief The number of hard misses, used to flag the trace records of hard misses.
+static u32 sTraceHardMissCount;
+#endif
+
+#ifdef GBAR3_SDC_STATS
+/// @brief The hard miss count at the time each cache block was loaded, used to detect thrashing.
+static u32 sCacheBlockLoadMissCount[SDC_MAX_BLOCK_COUNT];
+#endif
+
+/// @brief Maps rom blocks to their first sd sector, or null when the table could not be allocated.
+static u32* sRomBlockToSdSector;
+
+/// @brief The number of 4 kB blocks of the rom file. For plain roms these are the rom blocks.
+static u32 sRomFileBlockCount;
+
+/// @brief Whether the rom file is a compressed rom container.
+static bool sIsCompressedRom;
+
+/// @brief Receives the payload of a compressed rom block, which is then decoded into its destination.
+///        Large enough for a stored block that does not start at a sector boundary.
+[[gnu::section(".ewram.bss"), gnu::aligned(32)]]
+static u8 sPayloadBuffer[SDC_BLOCK_SIZE + 512];
+
+/// @brief The offset and length of the payload in sPayloadBuffer.
+static u32 sPayloadOffset;
+static u32 sPayloadLength;
+
+/// @brief The segments of a read that spans several fragments of the rom file. The sd cache
+///        has at most one read in flight, so the segments of that read can be static.
+[[gnu::section(".ewram.bss")]]
+static FsSegment sReadSegments[SDC_MAX_COALESCED_BLOCKS];
+
 // temporarily
 extern FIL gFile;
 
+/// @brief Returns the memory of the given cache block.
+static inline u8* getCacheBlock(u32 cacheBlock)
+{
+    if (cacheBlock < SDC_BLOCK_COUNT)
+    {
+        return sdc_cache[cacheBlock];
+    }
+    return sCacheExtension[cacheBlock - SDC_BLOCK_COUNT];
+}
+
+/// @brief Returns the index of the cache block at the given address.
+/// @return The index of the cache block, or SDC_BLOCK_INVALID if the address is not in the cache.
+static u32 getCacheBlockIndex(const void* data)
+{
+    u32 offset = (u32)data - (u32)sdc_cache;
+    if (offset < SDC_SIZE)
+    {
+        return offset >> SDC_BLOCK_SHIFT;
+    }
+    offset = (u32)data - (u32)sCacheExtension;
+    if (sCacheExtension && offset < (sCacheBlockCount - SDC_BLOCK_COUNT) * SDC_BLOCK_SIZE)
+    {
+        return SDC_BLOCK_COUNT + (offset >> SDC_BLOCK_SHIFT);
+    }
+    return SDC_BLOCK_INVALID;
+}
+
+/// @brief Returns whether the given cache blocks are adjacent in memory, such that
+///        a run of rom blocks can be read into them at once.
+static inline bool areCacheBlocksAdjacent(u32 cacheBlock, u32 nextCacheBlock)
+{
+    return nextCacheBlock == cacheBlock + 1 && nextCacheBlock != SDC_BLOCK_COUNT;
+}
+
 /// @brief Returns a cache block to replace.
+/// @param excludedCacheBlock A cache block that should not be returned, or SDC_BLOCK_INVALID.
+/// @return The index of the cache block to replace.
+static u32 getBlockToReplace(u32 excludedCacheBlock)
+{
+    u32 block;
+    do
+    {
+        block = sPolicy->getBlockToReplace(sBlockCount);
+    } while (block == sTabuBlock || block == excludedCacheBlock);
+    return block;
+}
+
+static bool isCacheBlockPinned(u32 cacheBlock)
+{
+    u32 romBlock = sCacheBlockToRomBlock[cacheBlock];
+    return romBlock != SDC_ROM_BLOCK_INVALID && sdc_romBlockPinCount[romBlock] != 0;
+}
+
+/// @brief Returns a cache block to replace that does not hold a pinned rom block.
+/// @param excludedCacheBlock A cache block that should not be returned, or SDC_BLOCK_INVALID.
+/// @return The index of the cache block to replace, or SDC_BLOCK_INVALID if the policy
+///         only offered cache blocks that hold a pinned rom block.
+static u32 selectUnpinnedBlockToReplace(u32 excludedCacheBlock)
+{
+    for (u32 i = 0; i <= 2 * sBlockCount; i++)
+    {
+        u32 cacheBlock = getBlockToReplace(excludedCacheBlock);
+        if (!isCacheBlockPinned(cacheBlock))
+        {
+            return cacheBlock;
+        }
+    }
+    return SDC_BLOCK_INVALID;
+}
+
+/// @brief Returns a cache block to replace, skipping cache blocks that hold a pinned rom block.
+/// @param excludedCacheBlock A cache block that should not be returned, or SDC_BLOCK_INVALID.
 /// @return The index of the cache block to replace.
-static u32 getBlockToReplace(void)
+static u32 selectBlockToReplace(u32 excludedCacheBlock)
 {
-    sRandomState = sRandomState * 1566083941u + 2531011u;
-    u32 maxPlusOne = sBlockCount;
-    if (sTabuBlock != SDC_BLOCK_INVALID)
+    u32 cacheBlock = selectUnpinnedBlockToReplace(excludedCacheBlock);
+    if (cacheBlock == SDC_BLOCK_INVALID)
+    {
+        // when (nearly) everything is pinned, replacing a pinned block is better than hanging
+        cacheBlock = getBlockToReplace(excludedCacheBlock);
+    }
+    return cacheBlock;
+}
+
+/// @brief Returns the cache block that holds the given rom block, also when
+///        that cache block has been unmapped by the replacement policy.
+/// @param romBlock The rom block to find.
+/// @return The index of the cache block, or SDC_BLOCK_INVALID if the rom block is not resident.
+static u32 findResidentCacheBlock(u32 romBlock)
+{
+    u32 cacheBlock = sRomBlockToResidentCacheBlock[romBlock];
+    // permanently loaded blocks are not managed by the replacement policy
+    return cacheBlock < sBlockCount ? cacheBlock : SDC_BLOCK_INVALID;
+}
+
+/// @brief Sets the rom block held by the given cache block and keeps the inverse mapping in sync.
+/// @param cacheBlock The index of the cache block.
+/// @param romBlock The rom block, or SDC_ROM_BLOCK_INVALID to mark the cache block empty.
+static void setCacheBlockRomBlock(u32 cacheBlock, u32 romBlock)
+{
+    u32 oldRomBlock = sCacheBlockToRomBlock[cacheBlock];
+    if (oldRomBlock != SDC_ROM_BLOCK_INVALID && sRomBlockToResidentCacheBlock[oldRomBlock] == cacheBlock)
+    {
+        sRomBlockToResidentCacheBlock[oldRomBlock] = SDC_BLOCK_INVALID;
+    }
+    sCacheBlockToRomBlock[cacheBlock] = romBlock;
+    if (romBlock != SDC_ROM_BLOCK_INVALID)
     {
-        maxPlusOne--;
+        sRomBlockToResidentCacheBlock[romBlock] = cacheBlock;
+    }
+}
+
+bool sdc_isCacheBlockMapped(u32 cacheBlock)
+{
+    u32 romBlock = sCacheBlockToRomBlock[cacheBlock];
+    return romBlock != SDC_ROM_BLOCK_INVALID && sdc_romBlockToCacheBlock[romBlock] != NULL;
+}
+
+void sdc_unmapCacheBlock(u32 cacheBlock)
+{
+    // permanently loaded blocks must stay mapped
+    if (cacheBlock >= sBlockCount)
+    {
+        return;
+    }
+
+    u32 romBlock = sCacheBlockToRomBlock[cacheBlock];
+    if (romBlock != SDC_ROM_BLOCK_INVALID)
+    {
+        sdc_romBlockToCacheBlock[romBlock] = NULL;
     }
-    u32 block = ((sRandomState >> 16) * maxPlusOne) >> 16;
-    return block == sTabuBlock ? (sBlockCount - 1) : block;
 }
 
 static bool isCurrentlyFetching(void)
@@ -56,51 +293,305 @@ static bool isCurrentlyFetching(void)
     return sCurrentFetch.cacheBlock != SDC_BLOCK_INVALID;
 }
 
-static void finishFetch()
+static void finishFetch();
+
+/// @brief Waits for the current fetch and finishes it. Other sd transactions, such as save
+///        writes with a lower priority, are not waited for.
+/// @return The irq state to restore. Irqs are disabled when this function returns.
+static u32 waitForCurrentFetch(void)
 {
-    sCacheBlockToRomBlock[sCurrentFetch.cacheBlock] = sCurrentFetch.romBlock;
-    sdc_romBlockToCacheBlock[sCurrentFetch.romBlock] = &sdc_cache[sCurrentFetch.cacheBlock][0];
-    sCurrentFetch.romBlock = SDC_ROM_BLOCK_INVALID;
-    sCurrentFetch.cacheBlock = SDC_BLOCK_INVALID;
-    dc_drainWriteBuffer();
+    u32 irqs = arm_disableIrqs();
+    while (isCurrentlyFetching())
+    {
+        FsWaitToken* waitToken = sCurrentFetch.waitToken;
+        arm_restoreIrqs(irqs);
+        irqs = fs_waitForCompletion(waitToken, true);
+        // a nested irq may have finished the fetch and started another one while waiting
+        if (isCurrentlyFetching() && sCurrentFetch.waitToken == waitToken && waitToken->transactionComplete)
+        {
+            finishFetch();
+        }
+    }
+    return irqs;
+}
+
+static FsDevice getFsDevice(void)
+{
+    return gFile.obj.fs->pdrv == DEV_FAT ? FS_DEVICE_DLDI : FS_DEVICE_DSI_SD;
+}
+
+/// @brief Returns the victim slot that holds the given rom block.
+/// @param romBlock The rom block to find.
+/// @return The index of the victim slot, or SDC_BLOCK_INVALID if the rom block is not in a victim pool.
+static u32 findVictimSlot(u32 romBlock)
+{
+    u32 victimSlot = sRomBlockToVictimSlot[romBlock];
+    return victimSlot == SDC_VICTIM_SLOT_INVALID ? SDC_BLOCK_INVALID : victimSlot;
+}
+
+/// @brief Sets the rom block held by the given victim slot and keeps the inverse mapping in sync.
+/// @param victimSlot The index of the victim slot.
+/// @param romBlock The rom block, or SDC_ROM_BLOCK_INVALID to mark the victim slot empty.
+static void setVictimSlotRomBlock(u32 victimSlot, u32 romBlock)
+{
+    u32 oldRomBlock = sVictimSlotToRomBlock[victimSlot];
+    if (oldRomBlock != SDC_ROM_BLOCK_INVALID && sRomBlockToVictimSlot[oldRomBlock] == victimSlot)
+    {
+        sRomBlockToVictimSlot[oldRomBlock] = SDC_VICTIM_SLOT_INVALID;
+    }
+    sVictimSlotToRomBlock[victimSlot] = romBlock;
+    if (romBlock != SDC_ROM_BLOCK_INVALID)
+    {
+        sRomBlockToVictimSlot[romBlock] = victimSlot;
+    }
+}
+
+/// @brief Returns whether the rom block in the given cache block should be copied
+///        to a victim pool when the cache block is evicted.
+static bool shouldDemoteCacheBlock(u32 cacheBlock)
+{
+    // the copy delays the miss that evicts the block, blocks that were used only once,
+    // such as streamed data and read-ahead blocks, are not worth it
+    return sVictimSlotCount != 0 && sCacheBlockReused[cacheBlock] &&
+        findVictimSlot(sCacheBlockToRomBlock[cacheBlock]) == SDC_BLOCK_INVALID;
+}
+
+/// @brief Copies the rom block in the given cache block to the oldest victim slot,
+///        such that a later miss on it does not have to read the sd card. Must be
+///        called before the cache block is evicted.
+/// @param cacheBlock The index of the cache block.
+static void demoteCacheBlock(u32 cacheBlock)
+{
+    if (!shouldDemoteCacheBlock(cacheBlock))
+    {
+        return;
+    }
+
+    u32 victimSlot = sVictimNextSlot;
+    if (++sVictimNextSlot == sVictimSlotCount)
+    {
+        sVictimNextSlot = 0;
+    }
+    mem_copy32(getCacheBlock(cacheBlock), sVictimSlotData[victimSlot], SDC_BLOCK_SIZE);
+    setVictimSlotRomBlock(victimSlot, sCacheBlockToRomBlock[cacheBlock]);
+    SDC_STATS_INCREMENT(demotionCount);
+}
+
+/// @brief Exchanges the contents of two blocks.
+static void swapBlocks(u32* a, u32* b)
+{
+    for (u32 i = 0; i < SDC_BLOCK_SIZE / 4; i++)
+    {
+        u32 value = a[i];
+        a[i] = b[i];
+        b[i] = value;
+    }
+}
+
+/// @brief Removes the rom block that is currently in the given cache block from the cache.
+/// @param cacheBlock The index of the cache block.
+static void evictCacheBlock(u32 cacheBlock)
+{
+    u32 oldRomBlock = sCacheBlockToRomBlock[cacheBlock];
+    if (oldRomBlock != SDC_ROM_BLOCK_INVALID)
+    {
+        sdc_romBlockToCacheBlock[oldRomBlock] = NULL;
+        setCacheBlockRomBlock(cacheBlock, SDC_ROM_BLOCK_INVALID);
+#ifdef GBAR3_SDC_STATS
+        if (gSdcStats.hardMissCount - sCacheBlockLoadMissCount[cacheBlock] < sCacheBlockCount / 4)
+        {
+            gSdcStats.thrashCount++;
+        }
+#endif
+    }
+
+    sCacheBlockReused[cacheBlock] = false;
+    if (sReadAheadPending[cacheBlock])
+    {
+        sReadAheadPending[cacheBlock] = false;
+        gSdcReadAheadStats.wastedCount++;
+    }
+}
+
+/// @brief Returns the first sd sector of the given block of the rom file when no sector table is available.
+///        Uses the cluster link map if possible and otherwise follows the cluster chain through FatFs.
+static u32 getSdSectorOfFileBlockSlow(u32 fileBlock)
+{
+    FATFS* fs = gFile.obj.fs;
+    if (gFile.cltbl)
+    {
+        return sdc_getSdSectorFromLinkMap(gFile.cltbl + 1, fs->csize, fs->database, fileBlock);
+    }
+
+    // seek one byte into the block, such that gFile.clust is the cluster containing the block
+    u32 irqs = arm_disableIrqs();
+    u32 fileOffset = fileBlock * SDC_BLOCK_SIZE;
+    u32 sector = 0;
+    if (f_lseek(&gFile, fileOffset + 1) == FR_OK)
+    {
+        sector = fs->database + fs->csize * (gFile.clust - 2);
+        sector += fileOffset / 512 & (fs->csize - 1);
+    }
+    arm_restoreIrqs(irqs);
+    return sector;
+}
+
+static u32 getSdSectorOfFileBlock(u32 fileBlock)
+{
+    if (fileBlock >= sRomFileBlockCount)
+    {
+        return 0;
+    }
+
+    if (sRomBlockToSdSector)
+    {
+        return sRomBlockToSdSector[fileBlock];
+    }
+
+    return getSdSectorOfFileBlockSlow(fileBlock);
+}
+
+static u32 getSdSectorOfFileOffset(u32 fileOffset)
+{
+    u32 sector = getSdSectorOfFileBlock(fileOffset >> SDC_BLOCK_SHIFT);
+    return sector == 0 ? 0 : sector + ((fileOffset & SDC_BLOCK_MASK) >> 9);
 }
 
+/// @brief Returns the first sd sector of the given rom block. For compressed roms
+///        this is the sector containing the start of the payload of the block.
+/// @return The sd sector, or 0 if the rom block lies beyond the end of the rom.
 static u32 getSdSectorOfRomBlock(u32 romBlock)
 {
-    u32 romOffset = romBlock * SDC_BLOCK_SIZE;
-    if (romOffset >= f_size(&gFile))
+    if (!sIsCompressedRom)
+    {
+        return getSdSectorOfFileBlock(romBlock);
+    }
+
+    u32 fileOffset;
+    if (crom_getBlockPayload(romBlock, &fileOffset) == 0)
     {
         return 0;
     }
+    return getSdSectorOfFileOffset(fileOffset);
+}
 
-    FATFS* fs = gFile.obj.fs;
-    u32* tbl = gFile.cltbl + 1;
-    u32 csect = (UINT)(romOffset / 512 & (fs->csize - 1));
-    u32 cshift = __builtin_ctz(fs->csize) + 9;
-    u32 cl = (DWORD)(romOffset >> cshift);
-    while (true)
+/// @brief Starts an asynchronous read of a run of rom blocks that are backed by the rom file.
+///        A run that spans several fragments of the rom file is read with a single scatter-gather
+///        transaction. Blocks of a compressed rom are read to sPayloadBuffer and must be decoded
+///        with decodePayload once the read completed, so their runs are limited to a single block.
+/// @param romBlock The first rom block of the run.
+/// @param sector The sd sector of the first rom block.
+/// @param dst The destination of plain rom blocks.
+/// @param blockCount The number of rom blocks in the run, at most SDC_MAX_COALESCED_BLOCKS.
+/// @param priority The priority of the read.
+/// @param waitToken The wait token of the read.
+static void startRead(u32 romBlock, u32 sector, u8* dst, u32 blockCount, FsPriority priority, FsWaitToken* waitToken)
+{
+    FsDevice device = getFsDevice();
+    if (!sIsCompressedRom)
     {
-        u32 ncl = *tbl++;
-        if (cl < ncl)
+        u32 segmentCount = 1;
+        sReadSegments[0].sector = sector;
+        sReadSegments[0].count = SDC_BLOCK_SIZE / 512;
+        sReadSegments[0].buffer = dst;
+        for (u32 i = 1; i < blockCount; i++)
         {
-            break;
+            FsSegment* segment = &sReadSegments[segmentCount - 1];
+            u32 blockSector = getSdSectorOfRomBlock(romBlock + i);
+            if (blockSector == segment->sector + segment->count)
+            {
+                segment->count += SDC_BLOCK_SIZE / 512;
+            }
+            else
+            {
+                // the next block is in a different fragment of the rom file
+                segment++;
+                segment->sector = blockSector;
+                segment->count = SDC_BLOCK_SIZE / 512;
+                segment->buffer = dst + i * SDC_BLOCK_SIZE;
+                segmentCount++;
+            }
         }
-        cl -= ncl;
-        tbl++;
+
+        if (segmentCount == 1)
+        {
+            fs_readCacheAlignedSectorsAsync(device, dst, sector, blockCount * (SDC_BLOCK_SIZE / 512), priority, waitToken);
+        }
+        else
+        {
+            fs_readCacheAlignedSectorsVAsync(device, sReadSegments, segmentCount, priority, waitToken);
+        }
+        return;
     }
-    u32 cluster = cl + *tbl - 2;
-    u32 sector = fs->database + fs->csize * cluster;
-    sector += csect;
-    return sector;
+
+    u32 fileOffset;
+    sPayloadLength = crom_getBlockPayload(romBlock, &fileOffset);
+    sPayloadOffset = fileOffset & 511;
+    u32 sectorCount = (sPayloadOffset + sPayloadLength + 511) >> 9;
+    // sectors are only known to be contiguous within a 4 kB block of the rom file
+    u32 firstPartSectorCount = (SDC_BLOCK_SIZE / 512) - ((fileOffset & SDC_BLOCK_MASK) >> 9);
+    if (sectorCount > firstPartSectorCount)
+    {
+        u32 secondPartSector = getSdSectorOfFileOffset((fileOffset & ~SDC_BLOCK_MASK) + SDC_BLOCK_SIZE);
+        if (secondPartSector != sector + firstPartSectorCount)
+        {
+            // the payload crosses a fragment boundary of the rom file
+            sReadSegments[0].sector = sector;
+            sReadSegments[0].count = firstPartSectorCount;
+            sReadSegments[0].buffer = sPayloadBuffer;
+            sReadSegments[1].sector = secondPartSector;
+            sReadSegments[1].count = sectorCount - firstPartSectorCount;
+            sReadSegments[1].buffer = sPayloadBuffer + firstPartSectorCount * 512;
+            fs_readCacheAlignedSectorsVAsync(device, sReadSegments, 2, priority, waitToken);
+            return;
+        }
+    }
+    fs_readCacheAlignedSectorsAsync(device, sPayloadBuffer, sector, sectorCount, priority, waitToken);
 }
 
-static void fillOutOfBoundsCacheBlock(u32 romBlock, u32 cacheBlock)
+/// @brief Decodes the payload of a compressed rom block read by startRead.
+static void decodePayload(u8* dst)
+{
+    if (!crom_decodeBlock(sPayloadBuffer + sPayloadOffset, sPayloadLength, dst))
+    {
+        // corrupt container, behave like open bus
+        memset(dst, 0xFF, SDC_BLOCK_SIZE);
+    }
+}
+
+static void finishFetch()
 {
-    u32 romSize = f_size(&gFile);
+    if (sIsCompressedRom)
+    {
+        decodePayload(getCacheBlock(sCurrentFetch.cacheBlock));
+    }
+    for (u32 i = 0; i < sCurrentFetch.blockCount; i++)
+    {
+        u32 cacheBlock = sCurrentFetch.cacheBlock + i;
+        u32 romBlock = sCurrentFetch.romBlock + i;
+        setCacheBlockRomBlock(cacheBlock, romBlock);
+        if (!sCurrentFetch.isReadAhead)
+        {
+            // read-ahead blocks stay unmapped until their first access, such that it can be observed
+            sdc_romBlockToCacheBlock[romBlock] = getCacheBlock(cacheBlock);
+        }
+    }
+    sCurrentFetch.romBlock = SDC_ROM_BLOCK_INVALID;
+    sCurrentFetch.cacheBlock = SDC_BLOCK_INVALID;
+    sCurrentFetch.isReadAhead = false;
+    sCurrentFetch.blockCount = 0;
+    sCurrentFetch.waitToken = NULL;
+    dc_drainWriteBuffer();
+}
+
+/// @brief Fills the given buffer with the open bus values of a rom block beyond the end of the rom file.
+static void fillOutOfBoundsBlock(u32 romBlock, u8* dst)
+{
+    u32 romSize = crom_getRomSize(&gFile);
     u32 powerOf2RomSize = romSize < 0x100000 ? 0x100000 : (1 << (32 - __builtin_clz(romSize - 1)));
     if (romBlock * SDC_BLOCK_SIZE < powerOf2RomSize)
     {
-        memset(&sdc_cache[cacheBlock][0], 0xFF, SDC_BLOCK_SIZE);
+        memset(dst, 0xFF, SDC_BLOCK_SIZE);
     }
     else
     {
@@ -108,12 +599,163 @@ static void fillOutOfBoundsCacheBlock(u32 romBlock, u32 cacheBlock)
         {
             u32 address = romBlock * SDC_BLOCK_SIZE + i;
             u32 oobValue = (address >> 1) & 0xFFFF;
-            *(u32 *)&sdc_cache[cacheBlock][i] = oobValue | ((oobValue + 1) << 16);
+            *(u32 *)&dst[i] = oobValue | ((oobValue + 1) << 16);
         }
     }
+}
 
-    sCacheBlockToRomBlock[cacheBlock] = romBlock;
-    sdc_romBlockToCacheBlock[romBlock] = &sdc_cache[cacheBlock][0];
+static void fillOutOfBoundsCacheBlock(u32 romBlock, u32 cacheBlock)
+{
+    fillOutOfBoundsBlock(romBlock, getCacheBlock(cacheBlock));
+    setCacheBlockRomBlock(cacheBlock, romBlock);
+    sdc_romBlockToCacheBlock[romBlock] = getCacheBlock(cacheBlock);
+    dc_drainWriteBuffer();
+}
+
+/// @brief Returns the number of adjacent rom blocks, starting at the given rom block, that
+///        can be read with a single sd transaction. Only blocks that are about to be accessed
+///        according to the pins set by dma, that are not resident yet and that lie within
+///        the rom file are included. The run can span several fragments of the rom file.
+/// @param romBlock The first rom block, which is not resident.
+/// @return The number of rom blocks in the run.
+static u32 getCoalescableRunLength(u32 romBlock)
+{
+    if (sIsCompressedRom || sdc_romBlockPinCount[romBlock] == 0)
+    {
+        return 1;
+    }
+
+    u32 length = 1;
+    while (length < SDC_MAX_COALESCED_BLOCKS)
+    {
+        u32 nextRomBlock = romBlock + length;
+        if (nextRomBlock >= SDC_ROM_BLOCK_COUNT || sdc_romBlockPinCount[nextRomBlock] == 0 ||
+            sdc_romBlockToCacheBlock[nextRomBlock] || findResidentCacheBlock(nextRomBlock) != SDC_BLOCK_INVALID ||
+            findVictimSlot(nextRomBlock) != SDC_BLOCK_INVALID)
+        {
+            break;
+        }
+
+        if (getSdSectorOfRomBlock(nextRomBlock) == 0)
+        {
+            // end of the rom
+            break;
+        }
+
+        length++;
+    }
+    return length;
+}
+
+/// @brief Returns whether the given cache block can be replaced as part of a run of
+///        adjacent cache blocks. Only cache blocks that are empty or that are not
+///        referenced according to the replacement policy are taken.
+static bool canJoinCacheBlockRun(u32 cacheBlock)
+{
+    return cacheBlock < sBlockCount && cacheBlock != sTabuBlock &&
+        !sdc_isCacheBlockMapped(cacheBlock) && !isCacheBlockPinned(cacheBlock);
+}
+
+/// @brief Grows the given cache block to a run of adjacent cache blocks.
+/// @param cacheBlock The cache block selected for replacement.
+/// @param length The desired run length. Returns the actual run length.
+/// @return The first cache block of the run.
+static u32 allocateCacheBlockRun(u32 cacheBlock, u32* length)
+{
+    u32 first = cacheBlock;
+    u32 last = cacheBlock;
+    while (last - first + 1 < *length && areCacheBlocksAdjacent(last, last + 1) && canJoinCacheBlockRun(last + 1))
+    {
+        last++;
+    }
+    while (last - first + 1 < *length && first > 0 &&
+        areCacheBlocksAdjacent(first - 1, first) && canJoinCacheBlockRun(first - 1))
+    {
+        first--;
+    }
+    *length = last - first + 1;
+    return first;
+}
+
+/// @brief Starts an asynchronous fetch of the first rom block after the given rom block
+///        that is not resident yet, when it lies within the read-ahead depth. Irqs must be disabled.
+/// @param romBlock The most recently accessed rom block of a sequential stream.
+/// @param excludedCacheBlock A cache block that should not be replaced.
+static void readAhead(u32 romBlock, u32 excludedCacheBlock)
+{
+    if (sReadAheadDepth == 0 || isCurrentlyFetching())
+    {
+        return;
+    }
+
+    for (u32 i = 1; i <= sReadAheadDepth; i++)
+    {
+        u32 nextRomBlock = romBlock + i;
+        if (nextRomBlock >= SDC_ROM_BLOCK_COUNT)
+        {
+            return;
+        }
+
+        if (sdc_romBlockToCacheBlock[nextRomBlock] || findResidentCacheBlock(nextRomBlock) != SDC_BLOCK_INVALID ||
+            findVictimSlot(nextRomBlock) != SDC_BLOCK_INVALID)
+        {
+            continue;
+        }
+
+        u32 sector = getSdSectorOfRomBlock(nextRomBlock);
+        if (sector == 0)
+        {
+            // end of the rom
+            return;
+        }
+
+        // a speculative read must never replace a pinned block
+        u32 cacheBlock = selectUnpinnedBlockToReplace(excludedCacheBlock);
+        if (cacheBlock == SDC_BLOCK_INVALID)
+        {
+            return;
+        }
+
+        demoteCacheBlock(cacheBlock);
+        evictCacheBlock(cacheBlock);
+        sReadAheadPending[cacheBlock] = true;
+        sCurrentFetch.romBlock = nextRomBlock;
+        sCurrentFetch.cacheBlock = cacheBlock;
+        sCurrentFetch.isReadAhead = true;
+        sCurrentFetch.blockCount = 1;
+        sCurrentFetch.waitToken = &sReadAheadWaitToken;
+        startRead(nextRomBlock, sector, getCacheBlock(cacheBlock), 1, FS_PRIORITY_PREFETCH, &sReadAheadWaitToken);
+        gSdcReadAheadStats.issuedCount++;
+        return;
+    }
+}
+
+/// @brief Moves the rom block in the given victim slot to the given cache block. The rom block
+///        that is currently in the cache block is demoted to the victim slot in exchange.
+/// @param victimSlot The victim slot that holds the rom block.
+/// @param cacheBlock The cache block selected for replacement.
+static void promoteVictimSlot(u32 victimSlot, u32 cacheBlock)
+{
+    u32 romBlock = sVictimSlotToRomBlock[victimSlot];
+    u32 oldRomBlock = sCacheBlockToRomBlock[cacheBlock];
+    bool isDemoted = shouldDemoteCacheBlock(cacheBlock);
+    evictCacheBlock(cacheBlock);
+    u8* data = getCacheBlock(cacheBlock);
+    if (isDemoted)
+    {
+        swapBlocks((u32*)data, (u32*)sVictimSlotData[victimSlot]);
+        setVictimSlotRomBlock(victimSlot, oldRomBlock);
+        SDC_STATS_INCREMENT(demotionCount);
+    }
+    else
+    {
+        mem_copy32(sVictimSlotData[victimSlot], data, SDC_BLOCK_SIZE);
+        setVictimSlotRomBlock(victimSlot, SDC_ROM_BLOCK_INVALID);
+    }
+    setCacheBlockRomBlock(cacheBlock, romBlock);
+    // the block was accessed again after it was demoted
+    sCacheBlockReused[cacheBlock] = true;
+    sdc_romBlockToCacheBlock[romBlock] = data;
     dc_drainWriteBuffer();
 }
 
@@ -124,11 +766,7 @@ static void* loadRomBlock(u32 romBlock, u32 cacheBlock)
 {
     u32 sector = getSdSectorOfRomBlock(romBlock);
 
-    u32 irqs = fs_waitForCompletionOfCurrentTransaction(true);
-    if (isCurrentlyFetching())
-    {
-        finishFetch();
-    }
+    u32 irqs = waitForCurrentFetch();
 
     void* currentCacheBlock = sdc_romBlockToCacheBlock[romBlock];
     if (currentCacheBlock)
@@ -137,45 +775,113 @@ static void* loadRomBlock(u32 romBlock, u32 cacheBlock)
         return currentCacheBlock;
     }
 
-    if (cacheBlock == SDC_BLOCK_INVALID)
+    bool isPolicyManaged = cacheBlock == SDC_BLOCK_INVALID;
+    if (isPolicyManaged)
     {
-        cacheBlock = getBlockToReplace();
-        if ((arm_getCpsr() & 0x1F) == 0x12)
+        u32 residentCacheBlock = findResidentCacheBlock(romBlock);
+        if (residentCacheBlock != SDC_BLOCK_INVALID)
         {
-            u32 forbiddenReplacementRange = gSdCacheIrqForbiddenRomBlockReplacementRange;
-            if (forbiddenReplacementRange != 0)
+            // soft miss, the block was unmapped by the replacement policy or fetched by read-ahead
+            sdc_romBlockToCacheBlock[romBlock] = getCacheBlock(residentCacheBlock);
+            sdc_profileRecordAccess(romBlock);
+            SDC_STATS_INCREMENT(softMissCount);
+            if (sReadAheadPending[residentCacheBlock])
+            {
+                sReadAheadPending[residentCacheBlock] = false;
+                gSdcReadAheadStats.usefulCount++;
+                sPolicy->blockLoaded(residentCacheBlock);
+                sLastMissRomBlock = romBlock;
+                readAhead(romBlock, residentCacheBlock);
+            }
+            else
             {
-                u32 forbiddenReplacementRangeStart = forbiddenReplacementRange & 0xFFFF;
-                u32 forbiddenReplacementRangeEnd = forbiddenReplacementRange >> 16;
-                while (true)
-                {
-                    u32 oldRomBlock = sCacheBlockToRomBlock[cacheBlock];
-                    if (oldRomBlock == SDC_ROM_BLOCK_INVALID ||
-                        !(forbiddenReplacementRangeStart <= oldRomBlock && oldRomBlock < forbiddenReplacementRangeEnd))
-                    {
-                        break;
-                    }
-                    cacheBlock = getBlockToReplace();
-                }
+                sCacheBlockReused[residentCacheBlock] = true;
+                sPolicy->blockReferenced(residentCacheBlock);
             }
+            if ((arm_getCpsr() & 0x1F) != 0x12)
+            {
+                sTabuBlock = residentCacheBlock;
+            }
+            arm_restoreIrqs(irqs);
+            return getCacheBlock(residentCacheBlock);
+        }
+
+        sdc_profileRecordAccess(romBlock);
+        cacheBlock = selectBlockToReplace(SDC_BLOCK_INVALID);
+        u32 victimSlot = findVictimSlot(romBlock);
+        if (victimSlot != SDC_BLOCK_INVALID)
+        {
+            // the block was demoted earlier, copying it back is much faster than reading the sd card
+            promoteVictimSlot(victimSlot, cacheBlock);
+            SDC_STATS_INCREMENT(victimHitCount);
+            sPolicy->blockLoaded(cacheBlock);
+            if ((arm_getCpsr() & 0x1F) != 0x12)
+            {
+                sTabuBlock = cacheBlock;
+            }
+            arm_restoreIrqs(irqs);
+            return getCacheBlock(cacheBlock);
+        }
+
+#ifdef GBAR3_SDC_TRACE
+        sTraceHardMissCount++;
+#endif
+#ifdef GBAR3_SDC_STATS
+        gSdcStats.hardMissCount++;
+        if (gSdcStatsRomBlockMissCounts[romBlock] != 0xFFFF)
+        {
+            gSdcStatsRomBlockMissCounts[romBlock]++;
         }
+#endif
     }
-    u32 oldRomBlock = sCacheBlockToRomBlock[cacheBlock];
-    if (oldRomBlock != SDC_ROM_BLOCK_INVALID)
+
+    u32 runLength = 1;
+    if (isPolicyManaged && sector != 0)
     {
-        sdc_romBlockToCacheBlock[oldRomBlock] = NULL;
-        sCacheBlockToRomBlock[cacheBlock] = SDC_ROM_BLOCK_INVALID;
+        runLength = getCoalescableRunLength(romBlock);
+    }
+
+    u32 firstCacheBlock = cacheBlock;
+    if (runLength > 1)
+    {
+        firstCacheBlock = allocateCacheBlockRun(cacheBlock, &runLength);
+    }
+
+    for (u32 i = 0; i < runLength; i++)
+    {
+        demoteCacheBlock(firstCacheBlock + i);
+        evictCacheBlock(firstCacheBlock + i);
+#ifdef GBAR3_SDC_STATS
+        sCacheBlockLoadMissCount[firstCacheBlock + i] = gSdcStats.hardMissCount;
+#endif
+    }
+
+    bool isSequential = isPolicyManaged && romBlock == sLastMissRomBlock + 1;
+    if (isPolicyManaged)
+    {
+        sLastMissRomBlock = romBlock + runLength - 1;
     }
 
     FsWaitToken waitToken;
     if (sector != 0)
     {
-        fs_readCacheAlignedSectorsAsync(
-            gFile.obj.fs->pdrv == DEV_FAT ? FS_DEVICE_DLDI : FS_DEVICE_DSI_SD,
-            &sdc_cache[cacheBlock][0], sector,
-            SDC_BLOCK_SIZE / 512, &waitToken);
+        startRead(romBlock, sector, getCacheBlock(firstCacheBlock), runLength, FS_PRIORITY_ROM_MISS, &waitToken);
         sCurrentFetch.romBlock = romBlock;
-        sCurrentFetch.cacheBlock = cacheBlock;
+        sCurrentFetch.cacheBlock = firstCacheBlock;
+        sCurrentFetch.isReadAhead = false;
+        sCurrentFetch.blockCount = runLength;
+        sCurrentFetch.waitToken = &waitToken;
+    }
+
+    // the requested rom block is the first block of the run
+    cacheBlock = firstCacheBlock;
+
+    if (isPolicyManaged)
+    {
+        for (u32 i = 0; i < runLength; i++)
+        {
+            sPolicy->blockLoaded(firstCacheBlock + i);
+        }
     }
 
     if ((arm_getCpsr() & 0x1F) != 0x12)
@@ -191,6 +897,10 @@ static void* loadRomBlock(u32 romBlock, u32 cacheBlock)
         {
             finishFetch();
         }
+        if (isSequential)
+        {
+            readAhead(romBlock + runLength - 1, cacheBlock);
+        }
         arm_restoreIrqs(irqs);
     }
     else
@@ -198,7 +908,7 @@ static void* loadRomBlock(u32 romBlock, u32 cacheBlock)
         fillOutOfBoundsCacheBlock(romBlock, cacheBlock);
     }
 
-    return &sdc_cache[cacheBlock][0];
+    return getCacheBlock(cacheBlock);
 }
 
 extern void logAddress(u32 address);
@@ -206,55 +916,472 @@ extern void logAddress(u32 address);
 const void* sdc_loadRomBlockDirect(u32 romAddress)
 {
     vm_enableNestedIrqs();
-    // logAddress(romAddress);
     u32 romBlock = ((romAddress << 7) >> 7) / SDC_BLOCK_SIZE;
+#ifdef GBAR3_SDC_TRACE
+    u32 traceHardMissCount = sTraceHardMissCount;
+    SdcTraceRecord* traceRecord = sdc_traceBegin(romAddress);
+#endif
+#ifdef GBAR3_SDC_STATS
+    u32 hardMissCount = gSdcStats.hardMissCount;
+    u32 startTime = sdc_statsGetTime();
+#endif
     void* cacheBlock = loadRomBlock(romBlock, SDC_BLOCK_INVALID);
+#ifdef GBAR3_SDC_STATS
+    if (gSdcStats.hardMissCount != hardMissCount)
+    {
+        u32 time = sdc_statsGetTime() - startTime;
+        gSdcStats.hardMissTime += time;
+        if (time > gSdcStats.hardMissMaxTime)
+        {
+            gSdcStats.hardMissMaxTime = time;
+        }
+        if (gSdcStatsIsSaveWriteActive)
+        {
+            // the miss happened in a gba irq during the save write from the vblank irq
+            gSdcStats.saveWriteMissCount++;
+            if (time > gSdcStats.saveWriteMissMaxTime)
+            {
+                gSdcStats.saveWriteMissMaxTime = time;
+            }
+        }
+    }
+#endif
+#ifdef GBAR3_SDC_TRACE
+    sdc_traceEnd(traceRecord, sTraceHardMissCount != traceHardMissCount);
+#endif
     vm_disableNestedIrqs();
     return cacheBlock;
 }
 
+static bool isInPatchPool(const void* data)
+{
+    return sPatchPool && (u32)data - (u32)sPatchPool < sPatchPoolCount * SDC_BLOCK_SIZE;
+}
+
+/// @brief Moves the patch pool to a new allocation of the given capacity and remaps its blocks.
+/// @param capacity The new capacity in blocks, which must be at least sPatchPoolCount.
+/// @return True if the pool was moved, or false if the allocation failed.
+static bool resizePatchPool(u32 capacity)
+{
+    u8 (*pool)[SDC_BLOCK_SIZE] = (u8 (*)[SDC_BLOCK_SIZE])memalign(32, capacity * SDC_BLOCK_SIZE);
+    u16* romBlocks = (u16*)malloc(capacity * sizeof(u16));
+    if (!pool || !romBlocks)
+    {
+        free(pool);
+        free(romBlocks);
+        return false;
+    }
+
+    u32 irqs = arm_disableIrqs();
+    for (u32 i = 0; i < sPatchPoolCount; i++)
+    {
+        memcpy(&pool[i][0], &sPatchPool[i][0], SDC_BLOCK_SIZE);
+        romBlocks[i] = sPatchPoolRomBlocks[i];
+        sdc_romBlockToCacheBlock[romBlocks[i]] = &pool[i][0];
+    }
+    free(sPatchPool);
+    free(sPatchPoolRomBlocks);
+    sPatchPool = pool;
+    sPatchPoolRomBlocks = romBlocks;
+    sPatchPoolCapacity = capacity;
+    dc_drainWriteBuffer();
+    arm_restoreIrqs(irqs);
+    return true;
+}
+
+/// @brief Loads the given rom block into a new patch pool block.
+/// @param romBlock The rom block to load, which must not be in the patch pool yet.
+/// @return A pointer to the patch pool block, or null if the pool cannot grow.
+static void* loadRomBlockToPatchPool(u32 romBlock)
+{
+    if (sPatchPoolCount == sPatchPoolCapacity)
+    {
+        u32 capacity = sPatchPoolCapacity == 0 ? SDC_PATCH_POOL_INITIAL_CAPACITY : 2 * sPatchPoolCapacity;
+        if (!resizePatchPool(capacity) && !resizePatchPool(sPatchPoolCount + 1))
+        {
+            return NULL;
+        }
+    }
+
+    u32 irqs = waitForCurrentFetch();
+
+    u8* data = &sPatchPool[sPatchPoolCount][0];
+    u32 residentCacheBlock = findResidentCacheBlock(romBlock);
+    u32 victimSlot = findVictimSlot(romBlock);
+    if (residentCacheBlock != SDC_BLOCK_INVALID)
+    {
+        // take over the resident copy and free its cache block
+        memcpy(data, getCacheBlock(residentCacheBlock), SDC_BLOCK_SIZE);
+        evictCacheBlock(residentCacheBlock);
+    }
+    else if (victimSlot != SDC_BLOCK_INVALID)
+    {
+        mem_copy32(sVictimSlotData[victimSlot], data, SDC_BLOCK_SIZE);
+        setVictimSlotRomBlock(victimSlot, SDC_ROM_BLOCK_INVALID);
+    }
+    else
+    {
+        u32 sector = getSdSectorOfRomBlock(romBlock);
+        if (sector != 0)
+        {
+            FsWaitToken waitToken;
+            startRead(romBlock, sector, data, 1, FS_PRIORITY_ROM_MISS, &waitToken);
+            fs_waitForCompletion(&waitToken, true);
+            if (sIsCompressedRom)
+            {
+                decodePayload(data);
+            }
+        }
+        else
+        {
+            fillOutOfBoundsBlock(romBlock, data);
+        }
+    }
+
+    sPatchPoolRomBlocks[sPatchPoolCount++] = romBlock;
+    sdc_romBlockToCacheBlock[romBlock] = data;
+    dc_drainWriteBuffer();
+    arm_restoreIrqs(irqs);
+    return data;
+}
+
 void* sdc_loadRomBlockForPatching(u32 romAddress)
 {
     u32 romBlock = ((romAddress << 7) >> 7) / SDC_BLOCK_SIZE;
     void* data = sdc_romBlockToCacheBlock[romBlock];
     // if not loaded at all yet, or not permanent
-    if (!data || (u32)data < (u32)&sdc_cache[sBlockCount][0])
+    if (!data || (!isInPatchPool(data) && getCacheBlockIndex(data) < sBlockCount))
     {
-        if (data)
+        data = loadRomBlockToPatchPool(romBlock);
+        if (!data)
         {
-            // if already loaded, but not permanent, invalidate block
-            sdc_romBlockToCacheBlock[romBlock] = NULL;
-            sCacheBlockToRomBlock[((u32)data - (u32)&sdc_cache[0][0]) / SDC_BLOCK_SIZE] = SDC_ROM_BLOCK_INVALID;
-        }
+            // no heap memory left, take a block from the end of the cache instead
+            u32 residentCacheBlock = findResidentCacheBlock(romBlock);
+            if (residentCacheBlock != SDC_BLOCK_INVALID)
+            {
+                // if already loaded, but not permanent, invalidate block
+                evictCacheBlock(residentCacheBlock);
+            }
 
-        data = loadRomBlock(romBlock, --sBlockCount);
+            data = loadRomBlock(romBlock, --sBlockCount);
+        }
     }
     return (void*)((u32)data + (romAddress & SDC_BLOCK_MASK));
 }
 
-void sdc_init(void)
+void sdc_compactPatchPool(void)
 {
-    sRandomState = 0xA512ED48; // initial random seed
-    sBlockCount = SDC_BLOCK_COUNT;
-    for (u32 i = 0; i < SDC_ROM_BLOCK_COUNT; i++)
+    if (sPatchPoolCount == 0)
     {
-        sdc_romBlockToCacheBlock[i] = NULL;
+        free(sPatchPool);
+        free(sPatchPoolRomBlocks);
+        sPatchPool = NULL;
+        sPatchPoolRomBlocks = NULL;
+        sPatchPoolCapacity = 0;
     }
-    for (u32 i = 0; i < SDC_BLOCK_COUNT; i++)
+    else if (sPatchPoolCount < sPatchPoolCapacity)
     {
-        sCacheBlockToRomBlock[i] = SDC_ROM_BLOCK_INVALID;
+        // allocate the exact size and free the larger block, such that the heap can coalesce it
+        resizePatchPool(sPatchPoolCount);
     }
+}
 
-    sCurrentFetch.cacheBlock = SDC_BLOCK_INVALID;
-    sCurrentFetch.romBlock = SDC_ROM_BLOCK_INVALID;
-    gSdCacheIrqForbiddenRomBlockReplacementRange = 0;
+u32 sdc_getFreeCacheBlockCount(void)
+{
+    u32 count = 0;
+    for (u32 i = 0; i < sBlockCount; i++)
+    {
+        if (sCacheBlockToRomBlock[i] == SDC_ROM_BLOCK_INVALID)
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+void sdc_prefetchRomBlocks(const u16* romBlocks, u32 count)
+{
+    u32 irqs = waitForCurrentFetch();
+    arm_restoreIrqs(irqs);
+
+    u32 cacheBlock = 0;
+    u32 i = 0;
+    while (i < count)
+    {
+        u32 romBlock = romBlocks[i++];
+        u32 sector = getSdSectorOfRomBlock(romBlock);
+        if (sector == 0 || sdc_romBlockToCacheBlock[romBlock] || findResidentCacheBlock(romBlock) != SDC_BLOCK_INVALID)
+        {
+            continue;
+        }
 
+        while (cacheBlock < sBlockCount && sCacheBlockToRomBlock[cacheBlock] != SDC_ROM_BLOCK_INVALID)
+        {
+            cacheBlock++;
+        }
+        if (cacheBlock == sBlockCount)
+        {
+            // no free cache blocks left
+            break;
+        }
+
+        // read runs of adjacent rom blocks into adjacent free cache blocks at once
+        u32 runLength = 1;
+        while (!sIsCompressedRom && i < count && runLength < SDC_MAX_COALESCED_BLOCKS &&
+            romBlocks[i] == romBlock + runLength &&
+            cacheBlock + runLength < sBlockCount &&
+            areCacheBlocksAdjacent(cacheBlock + runLength - 1, cacheBlock + runLength) &&
+            sCacheBlockToRomBlock[cacheBlock + runLength] == SDC_ROM_BLOCK_INVALID &&
+            !sdc_romBlockToCacheBlock[romBlock + runLength] &&
+            getSdSectorOfRomBlock(romBlock + runLength) != 0)
+        {
+            runLength++;
+            i++;
+        }
+
+        FsWaitToken waitToken;
+        startRead(romBlock, sector, getCacheBlock(cacheBlock), runLength, FS_PRIORITY_PREFETCH, &waitToken);
+        fs_waitForCompletion(&waitToken, false);
+        if (sIsCompressedRom)
+        {
+            decodePayload(getCacheBlock(cacheBlock));
+        }
+
+        for (u32 j = 0; j < runLength; j++)
+        {
+            setCacheBlockRomBlock(cacheBlock + j, romBlock + j);
+            sdc_romBlockToCacheBlock[romBlock + j] = getCacheBlock(cacheBlock + j);
+            sPolicy->blockLoaded(cacheBlock + j);
+        }
+        cacheBlock += runLength;
+    }
+    dc_drainWriteBuffer();
+}
+
+void sdc_setReplacementPolicy(SdcPolicyType policy)
+{
+    u32 irqs = arm_disableIrqs();
+    switch (policy)
+    {
+        case SDC_POLICY_RANDOM:
+        {
+            sPolicy = &sdc_randomPolicy;
+            break;
+        }
+        case SDC_POLICY_SEGMENTED_LRU:
+        {
+            sPolicy = &sdc_segmentedLruPolicy;
+            break;
+        }
+        case SDC_POLICY_CLOCK:
+        default:
+        {
+            sPolicy = &sdc_clockPolicy;
+            break;
+        }
+    }
+    sPolicy->initialize(sBlockCount);
+    arm_restoreIrqs(irqs);
+}
+
+void sdc_setReadAheadDepth(u32 depth)
+{
+    sReadAheadDepth = depth;
+}
+
+static void createClusterLinkMap(void)
+{
     sClusterTable[0] = sizeof(sClusterTable) / sizeof(DWORD);
     gFile.cltbl = sClusterTable;
     u32 result = f_lseek(&gFile, CREATE_LINKMAP);
+    if (result == FR_NOT_ENOUGH_CORE)
+    {
+        // the rom is too fragmented for the static table, FatFs reports the required size in the first entry
+        u32 requiredSize = sClusterTable[0];
+        DWORD* clusterTable = (DWORD*)malloc(requiredSize * sizeof(DWORD));
+        if (clusterTable)
+        {
+            clusterTable[0] = requiredSize;
+            gFile.cltbl = clusterTable;
+            result = f_lseek(&gFile, CREATE_LINKMAP);
+        }
+    }
+
     if (result != FR_OK)
     {
         logAddress(0xDEADBEEF);
         logAddress(result);
+        // fall back to following the cluster chain
+        if (gFile.cltbl != sClusterTable)
+        {
+            free(gFile.cltbl);
+        }
+        gFile.cltbl = NULL;
+    }
+}
+
+static void createRomBlockToSdSectorTable(void)
+{
+    if (sRomBlockToSdSector)
+    {
+        free(sRomBlockToSdSector);
+        sRomBlockToSdSector = NULL;
+    }
+    if (gFile.cltbl && gFile.cltbl != sClusterTable)
+    {
+        free(gFile.cltbl);
+        gFile.cltbl = NULL;
+    }
+
+    sRomFileBlockCount = (f_size(&gFile) + SDC_BLOCK_SIZE - 1) >> SDC_BLOCK_SHIFT;
+    sIsCompressedRom = crom_isCompressed();
+    createClusterLinkMap();
+    if (!gFile.cltbl || sRomFileBlockCount == 0)
+    {
+        return;
+    }
+
+    u32* table = (u32*)malloc(sRomFileBlockCount * sizeof(u32));
+    if (!table)
+    {
+        return;
+    }
+
+    FATFS* fs = gFile.obj.fs;
+    if (!sdc_buildSdSectorTable(gFile.cltbl + 1, fs->csize, fs->database, table, sRomFileBlockCount))
+    {
+        free(table);
+        return;
+    }
+
+    sRomBlockToSdSector = table;
+}
+
+void sdc_init(void* extension, u32 extensionSize)
+{
+    if (extensionSize > SDC_EXTENSION_MAX_SIZE)
+    {
+        extensionSize = SDC_EXTENSION_MAX_SIZE;
+    }
+    sCacheExtension = extensionSize >= SDC_BLOCK_SIZE ? (u8 (*)[SDC_BLOCK_SIZE])extension : NULL;
+    sCacheBlockCount = SDC_BLOCK_COUNT + (sCacheExtension ? extensionSize >> SDC_BLOCK_SHIFT : 0);
+    sBlockCount = sCacheBlockCount;
+    sTabuBlock = SDC_BLOCK_INVALID;
+    for (u32 i = 0; i < SDC_ROM_BLOCK_COUNT; i++)
+    {
+        sdc_romBlockToCacheBlock[i] = NULL;
+    }
+    for (u32 i = 0; i < SDC_MAX_BLOCK_COUNT; i++)
+    {
+        sCacheBlockToRomBlock[i] = SDC_ROM_BLOCK_INVALID;
+    }
+    memset(sRomBlockToResidentCacheBlock, 0xFF, sizeof(sRomBlockToResidentCacheBlock));
+    memset(sRomBlockToVictimSlot, SDC_VICTIM_SLOT_INVALID, sizeof(sRomBlockToVictimSlot));
+
+    sCurrentFetch.cacheBlock = SDC_BLOCK_INVALID;
+    sCurrentFetch.romBlock = SDC_ROM_BLOCK_INVALID;
+    sCurrentFetch.isReadAhead = false;
+    sCurrentFetch.blockCount = 0;
+    sCurrentFetch.waitToken = NULL;
+    for (u32 i = 0; i < SDC_ROM_BLOCK_COUNT; i++)
+    {
+        sdc_romBlockPinCount[i] = 0;
+    }
+    // keep the patch pool allocation for reuse, the rom block mapping was reset above
+    sPatchPoolCount = 0;
+    sVictimSlotCount = 0;
+    sVictimNextSlot = 0;
+    sReadAheadDepth = 0;
+    sLastMissRomBlock = SDC_ROM_BLOCK_INVALID;
+    memset(sReadAheadPending, 0, sizeof(sReadAheadPending));
+    memset(sCacheBlockReused, 0, sizeof(sCacheBlockReused));
+    memset(&gSdcReadAheadStats, 0, sizeof(gSdcReadAheadStats));
+    sdc_setReplacementPolicy(SDC_POLICY_CLOCK);
+
+    createRomBlockToSdSectorTable();
+}
+
+u32 sdc_getCacheBlockCount(void)
+{
+    return sCacheBlockCount;
+}
+
+void sdc_mapPermanentRomBlocks(u32 romAddress, u32 length, void* data)
+{
+    u32 romBlock = ((romAddress << 7) >> 7) >> SDC_BLOCK_SHIFT;
+    u32 blockCount = length >> SDC_BLOCK_SHIFT;
+    for (u32 i = 0; i < blockCount && romBlock + i < SDC_ROM_BLOCK_COUNT; i++)
+    {
+        sdc_romBlockToCacheBlock[romBlock + i] = (u8*)data + (i << SDC_BLOCK_SHIFT);
+    }
+}
+
+u32 sdc_addVictimPool(void* pool, u32 size)
+{
+    u32 irqs = arm_disableIrqs();
+    u32 blockCount = 0;
+    while (blockCount < (size >> SDC_BLOCK_SHIFT) && sVictimSlotCount < SDC_VICTIM_MAX_BLOCK_COUNT)
+    {
+        sVictimSlotData[sVictimSlotCount] = (u8*)pool + (blockCount << SDC_BLOCK_SHIFT);
+        sVictimSlotToRomBlock[sVictimSlotCount] = SDC_ROM_BLOCK_INVALID;
+        sVictimSlotCount++;
+        blockCount++;
+    }
+    arm_restoreIrqs(irqs);
+    return blockCount << SDC_BLOCK_SHIFT;
+}
+
+bool sdc_loadWholeRom(u32 romSize)
+{
+    u32 romBlockCount = (romSize + SDC_BLOCK_SIZE - 1) >> SDC_BLOCK_SHIFT;
+    if (romBlockCount > SDC_ROM_BLOCK_COUNT)
+    {
+        return false;
+    }
+
+    u32 missingCount = 0;
+    for (u32 romBlock = 0; romBlock < romBlockCount; romBlock++)
+    {
+        if (!sdc_romBlockToCacheBlock[romBlock])
+        {
+            missingCount++;
+        }
+    }
+    if (missingCount == 0)
+    {
+        return true;
+    }
+    if (missingCount > sdc_getFreeCacheBlockCount())
+    {
+        return false;
+    }
+
+    u16* romBlocks = (u16*)malloc(missingCount * sizeof(u16));
+    if (!romBlocks)
+    {
+        return false;
+    }
+
+    u32 count = 0;
+    for (u32 romBlock = 0; romBlock < romBlockCount; romBlock++)
+    {
+        if (!sdc_romBlockToCacheBlock[romBlock])
+        {
+            romBlocks[count++] = romBlock;
+        }
+    }
+    sdc_prefetchRomBlocks(romBlocks, count);
+
+    bool isComplete = true;
+    for (u32 i = 0; i < count; i++)
+    {
+        if (!sdc_romBlockToCacheBlock[romBlocks[i]])
+        {
+            // the sd sector of the block is unknown
+            isComplete = false;
+            break;
+        }
     }
+    free(romBlocks);
+    return isComplete;
 }
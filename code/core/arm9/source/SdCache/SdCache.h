@@ -1,5 +1,7 @@
 #pragma once
 #include "SdCacheDefs.h"
+#include "SdCachePolicy.h"
+#include "SdCacheStats.h"
 #include "MemoryEmulator/HiCodeCacheMapping.h"
 #include "cp15.h"
 
@@ -11,7 +13,24 @@ extern u8 sdc_cache[SDC_BLOCK_COUNT][SDC_BLOCK_SIZE];
 ///        This table includes pointers to the linearly loaded part of the rom.
 extern void* sdc_romBlockToCacheBlock[SDC_ROM_BLOCK_COUNT];
 
-extern vu32 gSdCacheIrqForbiddenRomBlockReplacementRange;
+/// @brief Pin counts of the rom blocks. Cache blocks that hold a pinned rom block
+///        are not selected for replacement, unless all candidates are pinned.
+extern vu8 sdc_romBlockPinCount[SDC_ROM_BLOCK_COUNT];
+
+/// @brief Read-ahead statistics of the sd cache.
+typedef struct
+{
+    /// @brief The number of read-ahead fetches that were started.
+    u32 issuedCount;
+
+    /// @brief The number of read-ahead blocks that were accessed before being replaced.
+    u32 usefulCount;
+
+    /// @brief The number of read-ahead blocks that were replaced without being accessed.
+    u32 wastedCount;
+} SdcReadAheadStats;
+
+extern SdcReadAheadStats gSdcReadAheadStats;
 
 #ifdef __cplusplus
 extern "C" {
@@ -24,17 +43,29 @@ extern "C" {
 const void* sdc_loadRomBlockDirect(u32 romAddress);
 
 /// @brief Permanently loads the rom block that contains the given romAddress
-///        into the sd cache for the purpose of applying patches.
+///        into the patch pool for the purpose of applying patches. When the pool
+///        cannot grow, a block is permanently taken from the sd cache instead.
+///        The returned pointer is only valid until the next call of this function
+///        or of sdc_compactPatchPool, because the pool can be moved.
 /// @param romAddress An address in the block to load permanently into the cache.
-/// @return A pointer to romAddress in the cache block.
+/// @return A pointer to romAddress in the permanently loaded block.
 void* sdc_loadRomBlockForPatching(u32 romAddress);
 
+/// @brief Shrinks the patch pool to the number of patched blocks, such that the heap
+///        memory reserved for growing the pool becomes available again. Should be
+///        called once all patches have been applied.
+void sdc_compactPatchPool(void);
+
 static inline const void* sdc_getRomBlock(u32 romAddress)
 {
     u32 romBlock = ((romAddress << 7) >> 7) >> SDC_BLOCK_SHIFT;
     void* data = sdc_romBlockToCacheBlock[romBlock];
     if (data)
+    {
+        SDC_STATS_INCREMENT(getRomBlockHitCount);
         return data;
+    }
+    SDC_STATS_INCREMENT(getRomBlockMissCount);
 // #ifdef GBAR3_HICODE_CACHE_MAPPING
 //     hic_unmapRomBlock();
 // #endif
@@ -42,26 +73,106 @@ static inline const void* sdc_getRomBlock(u32 romAddress)
     return sdc_loadRomBlockDirect(romAddress);
 }
 
-static inline void sdc_resetIrqForbiddenReplacementRange(void)
+/// @brief Returns the range of rom blocks overlapping the given rom address range.
+/// @return True if the range lies in the rom, or false otherwise.
+static inline bool sdc_getRomBlockRange(u32 romAddress, u32 length, u32* startRomBlock, u32* endRomBlock)
 {
-    gSdCacheIrqForbiddenRomBlockReplacementRange = 0;
+    if (romAddress < 0x08000000 || romAddress >= 0x0E000000 || length == 0)
+    {
+        return false;
+    }
+    romAddress = (romAddress << 7) >> 7;
+    *startRomBlock = romAddress >> SDC_BLOCK_SHIFT;
+    *endRomBlock = (romAddress + length + (SDC_BLOCK_SIZE - 1)) >> SDC_BLOCK_SHIFT;
+    if (*endRomBlock > SDC_ROM_BLOCK_COUNT)
+    {
+        *endRomBlock = SDC_ROM_BLOCK_COUNT;
+    }
+    return true;
 }
 
-static inline void sdc_setIrqForbiddenReplacementRange(u32 romAddress, u32 length)
+/// @brief Pins the rom blocks overlapping the given range, such that they are not replaced
+///        while pinned. Pins are reference counted, every pin must be balanced by an unpin
+///        of the same range. Nested code, such as irqs, must unpin before returning.
+///        Addresses outside of the rom are ignored.
+/// @param romAddress The start address of the range.
+/// @param length The length of the range in bytes.
+static inline void sdc_pinRomRange(u32 romAddress, u32 length)
 {
-    if (romAddress < 0x08000000 || romAddress >= 0x0E000000)
+    u32 startRomBlock, endRomBlock;
+    if (sdc_getRomBlockRange(romAddress, length, &startRomBlock, &endRomBlock))
     {
-        sdc_resetIrqForbiddenReplacementRange();
-        return;
+        for (u32 romBlock = startRomBlock; romBlock < endRomBlock; romBlock++)
+        {
+            sdc_romBlockPinCount[romBlock]++;
+        }
+    }
+}
+
+/// @brief Releases a pin of the rom blocks overlapping the given range.
+/// @param romAddress The start address of the range, as passed to sdc_pinRomRange.
+/// @param length The length of the range in bytes, as passed to sdc_pinRomRange.
+static inline void sdc_unpinRomRange(u32 romAddress, u32 length)
+{
+    u32 startRomBlock, endRomBlock;
+    if (sdc_getRomBlockRange(romAddress, length, &startRomBlock, &endRomBlock))
+    {
+        for (u32 romBlock = startRomBlock; romBlock < endRomBlock; romBlock++)
+        {
+            sdc_romBlockPinCount[romBlock]--;
+        }
     }
-    romAddress = (romAddress << 7) >> 7;
-    u32 startRomBlock = romAddress >> SDC_BLOCK_SHIFT;
-    u32 endRomBlock = (romAddress + length + (SDC_BLOCK_SIZE - 1)) >> SDC_BLOCK_SHIFT;
-    gSdCacheIrqForbiddenRomBlockReplacementRange = startRomBlock | (endRomBlock << 16);
 }
 
 /// @brief Initializes the sd cache.
-void sdc_init(void);
+/// @param extension Memory that extends the cache beyond sdc_cache, or null.
+/// @param extensionSize The size of the extension in bytes, at most SDC_EXTENSION_MAX_SIZE.
+void sdc_init(void* extension, u32 extensionSize);
+
+/// @brief Returns the total number of cache blocks, including the blocks of the extension.
+u32 sdc_getCacheBlockCount(void);
+
+/// @brief Maps rom blocks to memory that permanently holds them, such as the linear part of the rom.
+///        These rom blocks never miss and are treated as permanently loaded for patching.
+/// @param romAddress The rom address of the first block.
+/// @param length The length in bytes, a multiple of SDC_BLOCK_SIZE.
+/// @param data The memory that holds the rom blocks.
+void sdc_mapPermanentRomBlocks(u32 romAddress, u32 length, void* data);
+
+/// @brief Adds a victim pool, which receives the rom blocks that are evicted from the cache.
+///        A later miss on such a block copies it back instead of reading the sd card.
+///        Victim pools can be placed in any memory that is otherwise unused, such as idle vram banks,
+///        as long as it supports 32-bit accesses. Victim pools are removed by sdc_init.
+/// @param pool The memory of the victim pool, which must be 32-bit aligned.
+/// @param size The size of the victim pool in bytes.
+/// @return The number of bytes of the pool that are used, which is less than
+///         size when the total size of all pools exceeds SDC_VICTIM_MAX_SIZE.
+u32 sdc_addVictimPool(void* pool, u32 size);
+
+/// @brief Sets the cache block replacement policy. The default policy is SDC_POLICY_CLOCK.
+/// @param policy The replacement policy to use.
+void sdc_setReplacementPolicy(SdcPolicyType policy);
+
+/// @brief Sets the maximum number of rom blocks that are fetched asynchronously ahead
+///        of a sequential stream of rom block misses. Read-ahead is disabled by default.
+/// @param depth The read-ahead depth in blocks, or 0 to disable read-ahead.
+void sdc_setReadAheadDepth(u32 depth);
+
+/// @brief Returns the number of replaceable cache blocks that do not hold a rom block.
+/// @return The number of free cache blocks.
+u32 sdc_getFreeCacheBlockCount(void);
+
+/// @brief Loads the given rom blocks into free cache blocks, for example to warm up the cache at boot.
+///        Rom blocks that are already loaded are skipped, and loading stops when no free cache blocks are left.
+/// @param romBlocks The rom blocks to load, preferably sorted in ascending order.
+/// @param count The number of rom blocks.
+void sdc_prefetchRomBlocks(const u16* romBlocks, u32 count);
+
+/// @brief Loads all rom blocks that are not loaded yet into the cache, when they fit
+///        in the free cache blocks. Afterwards the rom never misses.
+/// @param romSize The size of the rom in bytes.
+/// @return True if the whole rom is loaded, or false otherwise.
+bool sdc_loadWholeRom(u32 romSize);
 
 #ifdef __cplusplus
 }
@@ -1,10 +1,21 @@
 #pragma once
 
+// SDC_SIZE and SDC_BLOCK_SHIFT can be overridden by the build, for example by the sd cache simulator
+#ifndef SDC_SIZE
 #define SDC_SIZE                (1 * 1024 * 1024)
+#endif
+#ifndef SDC_BLOCK_SHIFT
 #define SDC_BLOCK_SHIFT         12
+#endif
 #define SDC_BLOCK_SIZE          (1 << SDC_BLOCK_SHIFT)
 #define SDC_BLOCK_MASK          (SDC_BLOCK_SIZE - 1)
 #define SDC_BLOCK_COUNT         (SDC_SIZE / SDC_BLOCK_SIZE)
+// the cache can be extended at boot with memory that is not used by the linear part of the rom
+#define SDC_EXTENSION_MAX_SIZE  (1 * 1024 * 1024)
+#define SDC_MAX_BLOCK_COUNT     ((SDC_SIZE + SDC_EXTENSION_MAX_SIZE) / SDC_BLOCK_SIZE)
+// blocks evicted from the cache are demoted to victim pools in otherwise unused memory, such as idle vram banks
+#define SDC_VICTIM_MAX_SIZE         (512 * 1024)
+#define SDC_VICTIM_MAX_BLOCK_COUNT  (SDC_VICTIM_MAX_SIZE / SDC_BLOCK_SIZE)
 #define SDC_BLOCK_INVALID       0xFFFF
 #define SDC_ROM_BLOCK_INVALID   0xFFFF
 
@@ -0,0 +1,66 @@
+#pragma once
+
+/// @brief Available sd cache block replacement policies.
+typedef enum
+{
+    /// @brief Pseudo-random replacement.
+    SDC_POLICY_RANDOM,
+
+    /// @brief CLOCK (second-chance) replacement.
+    SDC_POLICY_CLOCK,
+
+    /// @brief Segmented LRU with a probationary and a protected segment.
+    SDC_POLICY_SEGMENTED_LRU
+} SdcPolicyType;
+
+/// @brief Interface of an sd cache block replacement policy.
+///
+///        Hits in the emulated memory handlers never leave the assembly fast path, so policies
+///        cannot observe them directly. Instead a policy can unmap a cache block from
+///        sdc_romBlockToCacheBlock using sdc_unmapCacheBlock while keeping the data resident.
+///        The next access to that block then results in a cheap soft miss, which reports the
+///        block through blockReferenced. Whether a block is mapped thus acts as its reference bit.
+typedef struct
+{
+    /// @brief Resets the policy state.
+    /// @param blockCount The number of replaceable cache blocks.
+    void (*initialize)(u32 blockCount);
+
+    /// @brief Returns a cache block to replace. Consecutive calls should
+    ///        return different blocks, such that the caller can skip blocks
+    ///        that are not allowed to be replaced at the moment.
+    /// @param blockCount The number of replaceable cache blocks. This can
+    ///                   shrink over time when blocks are permanently loaded.
+    /// @return The index of the cache block to replace.
+    u32 (*getBlockToReplace)(u32 blockCount);
+
+    /// @brief Called after a rom block has been loaded into the given cache block.
+    /// @param cacheBlock The index of the cache block.
+    void (*blockLoaded)(u32 cacheBlock);
+
+    /// @brief Called when an unmapped, but still resident cache block was accessed again.
+    /// @param cacheBlock The index of the cache block.
+    void (*blockReferenced)(u32 cacheBlock);
+} SdcPolicy;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern const SdcPolicy sdc_randomPolicy;
+extern const SdcPolicy sdc_clockPolicy;
+extern const SdcPolicy sdc_segmentedLruPolicy;
+
+/// @brief Returns whether the given cache block is currently mapped in sdc_romBlockToCacheBlock.
+/// @param cacheBlock The index of the cache block.
+/// @return True if the cache block is mapped, or false otherwise.
+bool sdc_isCacheBlockMapped(u32 cacheBlock);
+
+/// @brief Unmaps the given cache block from sdc_romBlockToCacheBlock,
+///        while keeping its contents resident in the cache.
+/// @param cacheBlock The index of the cache block.
+void sdc_unmapCacheBlock(u32 cacheBlock);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,49 @@
+#include "common.h"
+#include "SdCachePolicy.h"
+
+/// @brief The cache block the clock hand currently points at.
+static u32 sHand;
+
+static void initialize(u32 blockCount)
+{
+    sHand = 0;
+}
+
+static u32 getBlockToReplace(u32 blockCount)
+{
+    while (true)
+    {
+        if (sHand >= blockCount)
+        {
+            sHand = 0;
+        }
+
+        u32 block = sHand++;
+        if (!sdc_isCacheBlockMapped(block))
+        {
+            // not referenced since the last time the hand passed
+            return block;
+        }
+
+        // clear the reference bit to give the block a second chance
+        sdc_unmapCacheBlock(block);
+    }
+}
+
+static void blockLoaded(u32 cacheBlock)
+{
+    // newly loaded blocks are mapped, which marks them as referenced
+}
+
+static void blockReferenced(u32 cacheBlock)
+{
+    // the block was mapped again, which marks it as referenced
+}
+
+const SdcPolicy sdc_clockPolicy =
+{
+    initialize,
+    getBlockToReplace,
+    blockLoaded,
+    blockReferenced
+};
@@ -0,0 +1,32 @@
+#include "common.h"
+#include "SdCachePolicy.h"
+
+/// @brief Random generator state for random cache replacement.
+static u32 sRandomState;
+
+static void initialize(u32 blockCount)
+{
+    sRandomState = 0xA512ED48; // initial random seed
+}
+
+static u32 getBlockToReplace(u32 blockCount)
+{
+    sRandomState = sRandomState * 1566083941u + 2531011u;
+    return ((sRandomState >> 16) * blockCount) >> 16;
+}
+
+static void blockLoaded(u32 cacheBlock)
+{
+}
+
+static void blockReferenced(u32 cacheBlock)
+{
+}
+
+const SdcPolicy sdc_randomPolicy =
+{
+    initialize,
+    getBlockToReplace,
+    blockLoaded,
+    blockReferenced
+};
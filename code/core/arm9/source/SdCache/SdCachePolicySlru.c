@@ -0,0 +1,142 @@
+#include "common.h"
+#include "SdCacheDefs.h"
+#include "SdCachePolicy.h"
+
+#define LIST_PROBATION      SDC_MAX_BLOCK_COUNT
+#define LIST_PROTECTED      (SDC_MAX_BLOCK_COUNT + 1)
+
+/// @brief Doubly linked lists of cache blocks. The last two entries are the list heads
+///        of the probationary and the protected segment. Next points towards the LRU end.
+static u16 sNext[SDC_MAX_BLOCK_COUNT + 2];
+static u16 sPrev[SDC_MAX_BLOCK_COUNT + 2];
+
+/// @brief The list each cache block is in, or SDC_BLOCK_INVALID if the block is in no list.
+static u16 sSegment[SDC_MAX_BLOCK_COUNT];
+
+static u32 sBlockCount;
+static u32 sProtectedCount;
+static u32 sProtectedCapacity;
+
+/// @brief The most recently loaded cache block, or SDC_BLOCK_INVALID.
+static u32 sLastLoadedBlock;
+
+static void unlink(u32 block)
+{
+    sNext[sPrev[block]] = sNext[block];
+    sPrev[sNext[block]] = sPrev[block];
+    if (sSegment[block] == LIST_PROTECTED)
+    {
+        sProtectedCount--;
+    }
+    sSegment[block] = SDC_BLOCK_INVALID;
+}
+
+static void insertMostRecentlyUsed(u32 list, u32 block)
+{
+    sNext[block] = sNext[list];
+    sPrev[block] = list;
+    sPrev[sNext[list]] = block;
+    sNext[list] = block;
+    sSegment[block] = list;
+    if (list == LIST_PROTECTED)
+    {
+        sProtectedCount++;
+    }
+}
+
+static void moveToMostRecentlyUsed(u32 list, u32 block)
+{
+    if (sSegment[block] != SDC_BLOCK_INVALID)
+    {
+        unlink(block);
+    }
+    insertMostRecentlyUsed(list, block);
+}
+
+static void demoteProtectedOverflow(void)
+{
+    while (sProtectedCount > sProtectedCapacity)
+    {
+        u32 block = sPrev[LIST_PROTECTED];
+        moveToMostRecentlyUsed(LIST_PROBATION, block);
+        // unmap so that a new access to this block is observed
+        sdc_unmapCacheBlock(block);
+    }
+}
+
+static void initialize(u32 blockCount)
+{
+    sNext[LIST_PROBATION] = LIST_PROBATION;
+    sPrev[LIST_PROBATION] = LIST_PROBATION;
+    sNext[LIST_PROTECTED] = LIST_PROTECTED;
+    sPrev[LIST_PROTECTED] = LIST_PROTECTED;
+    sBlockCount = blockCount;
+    sProtectedCount = 0;
+    sProtectedCapacity = blockCount - (blockCount >> 2);
+    sLastLoadedBlock = SDC_BLOCK_INVALID;
+    for (u32 i = 0; i < SDC_MAX_BLOCK_COUNT; i++)
+    {
+        sSegment[i] = SDC_BLOCK_INVALID;
+    }
+    for (u32 i = 0; i < blockCount; i++)
+    {
+        insertMostRecentlyUsed(LIST_PROBATION, i);
+    }
+}
+
+static u32 getBlockToReplace(u32 blockCount)
+{
+    if (blockCount < sBlockCount)
+    {
+        // permanently loaded blocks are no longer managed
+        for (u32 i = blockCount; i < sBlockCount; i++)
+        {
+            if (sSegment[i] != SDC_BLOCK_INVALID)
+            {
+                unlink(i);
+            }
+        }
+        sBlockCount = blockCount;
+        sProtectedCapacity = blockCount - (blockCount >> 2);
+        demoteProtectedOverflow();
+    }
+
+    u32 block = sPrev[LIST_PROBATION];
+    if (block == LIST_PROBATION)
+    {
+        // probationary segment is empty
+        block = sPrev[LIST_PROTECTED];
+    }
+
+    // move the candidate out of the way, such that a next call returns a different block
+    moveToMostRecentlyUsed(LIST_PROBATION, block);
+    return block;
+}
+
+static void blockLoaded(u32 cacheBlock)
+{
+    // getBlockToReplace already moved the new block to the front of the probationary segment,
+    // so the previously loaded block has to be remembered separately
+    if (sLastLoadedBlock < sBlockCount && sLastLoadedBlock != cacheBlock)
+    {
+        // unmap the previously loaded block, such that a
+        // second access to it can promote it to the protected segment
+        sdc_unmapCacheBlock(sLastLoadedBlock);
+    }
+    sLastLoadedBlock = cacheBlock;
+    moveToMostRecentlyUsed(LIST_PROBATION, cacheBlock);
+}
+
+static void blockReferenced(u32 cacheBlock)
+{
+    moveToMostRecentlyUsed(LIST_PROTECTED, cacheBlock);
+    demoteProtectedOverflow();
+}
+
+const SdcPolicy sdc_segmentedLruPolicy =
+{
+    initialize,
+    getBlockToReplace,
+    blockLoaded,
+    blockReferenced
+};
@@ -0,0 +1,220 @@
+#include "common.h"
+#include <stdlib.h>
+#include <string.h>
+#include "Fat/ff.h"
+#include "VirtualMachine/VMNestedIrq.h"
+#include "SdCache.h"
+#include "SdCacheProfile.h"
+#include "SdCacheStats.h"
+#include "Fat/FsStats.h"
+
+/// @brief The number of new accesses after which the profile is written again.
+#define SDC_PROFILE_WRITE_INTERVAL      1024
+
+/// @brief The minimum access count for a rom block to be prefetched at boot.
+#define SDC_PROFILE_MIN_WARMUP_COUNT    2
+
+[[gnu::section(".ewram.bss")]]
+u16 sdc_profileAccessCounts[SDC_ROM_BLOCK_COUNT];
+
+[[gnu::section(".ewram.bss"), gnu::aligned(32)]]
+static FIL sProfileFile;
+
+vu8 gSdcProfileWritePending;
+
+static bool sProfileOpen;
+static u32 sGameCode;
+static u32 sRomBlockCount;
+static u32 sNewAccessCount;
+
+void sdc_loadProfile(const char* path, u32 gameCode, u32 romSize)
+{
+    memset(sdc_profileAccessCounts, 0, sizeof(sdc_profileAccessCounts));
+    gSdcProfileWritePending = false;
+    sNewAccessCount = 0;
+    sGameCode = gameCode;
+    sRomBlockCount = (romSize + SDC_BLOCK_SIZE - 1) >> SDC_BLOCK_SHIFT;
+    if (sRomBlockCount > SDC_ROM_BLOCK_COUNT)
+    {
+        sRomBlockCount = SDC_ROM_BLOCK_COUNT;
+    }
+
+    memset(&sProfileFile, 0, sizeof(sProfileFile));
+    sProfileOpen = f_open(&sProfileFile, path, FA_OPEN_ALWAYS | FA_READ | FA_WRITE) == FR_OK;
+    if (!sProfileOpen)
+    {
+        return;
+    }
+
+    SdcProfileHeader header;
+    UINT bytesRead = 0;
+    if (f_read(&sProfileFile, &header, sizeof(header), &bytesRead) != FR_OK || bytesRead != sizeof(header) ||
+        header.magic != SDC_PROFILE_MAGIC || header.version != SDC_PROFILE_VERSION ||
+        header.blockShift != SDC_BLOCK_SHIFT || header.gameCode != gameCode ||
+        header.romBlockCount != sRomBlockCount)
+    {
+        // no profile yet, or a profile of a different rom
+        return;
+    }
+
+    f_read(&sProfileFile, sdc_profileAccessCounts, sRomBlockCount * sizeof(u16), &bytesRead);
+    for (u32 i = 0; i < sRomBlockCount; i++)
+    {
+        // age the counts of earlier sessions, such that recent behavior weighs more
+        sdc_profileAccessCounts[i] = (sdc_profileAccessCounts[i] + 1) >> 1;
+    }
+}
+
+void sdc_profileRecordAccess(u32 romBlock)
+{
+#ifdef GBAR3_SDC_STATS
+    // also dump the statistics periodically when no profile is recorded
+    if (!sProfileOpen && ++sNewAccessCount >= SDC_PROFILE_WRITE_INTERVAL)
+    {
+        gSdcProfileWritePending = true;
+    }
+#endif
+    if (!sProfileOpen || romBlock >= sRomBlockCount)
+    {
+        return;
+    }
+
+    if (sdc_profileAccessCounts[romBlock] == 0xFFFF)
+    {
+        // rescale instead of saturating to keep the ratios between blocks
+        for (u32 i = 0; i < sRomBlockCount; i++)
+        {
+            sdc_profileAccessCounts[i] >>= 1;
+        }
+    }
+    sdc_profileAccessCounts[romBlock]++;
+
+    if (++sNewAccessCount >= SDC_PROFILE_WRITE_INTERVAL)
+    {
+        gSdcProfileWritePending = true;
+    }
+}
+
+static void siftDown(u16* heap, u32 count, u32 index)
+{
+    while (true)
+    {
+        u32 smallest = index;
+        u32 left = 2 * index + 1;
+        u32 right = left + 1;
+        if (left < count && sdc_profileAccessCounts[heap[left]] < sdc_profileAccessCounts[heap[smallest]])
+        {
+            smallest = left;
+        }
+        if (right < count && sdc_profileAccessCounts[heap[right]] < sdc_profileAccessCounts[heap[smallest]])
+        {
+            smallest = right;
+        }
+        if (smallest == index)
+        {
+            return;
+        }
+        u16 temp = heap[index];
+        heap[index] = heap[smallest];
+        heap[smallest] = temp;
+        index = smallest;
+    }
+}
+
+static int compareRomBlocks(const void* a, const void* b)
+{
+    return (int)*(const u16*)a - (int)*(const u16*)b;
+}
+
+void sdc_warmupFromProfile(void)
+{
+    if (!sProfileOpen)
+    {
+        return;
+    }
+
+    u32 capacity = sdc_getFreeCacheBlockCount();
+    if (capacity == 0)
+    {
+        return;
+    }
+
+    u16* hottest = (u16*)malloc(capacity * sizeof(u16));
+    if (!hottest)
+    {
+        return;
+    }
+
+    // select the hottest rom blocks that are not loaded yet using a min-heap on the access count
+    u32 count = 0;
+    for (u32 romBlock = 0; romBlock < sRomBlockCount; romBlock++)
+    {
+        u32 accessCount = sdc_profileAccessCounts[romBlock];
+        if (accessCount < SDC_PROFILE_MIN_WARMUP_COUNT || sdc_romBlockToCacheBlock[romBlock])
+        {
+            continue;
+        }
+
+        if (count < capacity)
+        {
+            hottest[count++] = romBlock;
+            if (count == capacity)
+            {
+                for (int i = capacity / 2 - 1; i >= 0; i--)
+                {
+                    siftDown(hottest, count, i);
+                }
+            }
+        }
+        else if (accessCount > sdc_profileAccessCounts[hottest[0]])
+        {
+            hottest[0] = romBlock;
+            siftDown(hottest, count, 0);
+        }
+    }
+
+    // prefetch in rom order, such that adjacent blocks can be read together
+    qsort(hottest, count, sizeof(u16), compareRomBlocks);
+    sdc_prefetchRomBlocks(hottest, count);
+    free(hottest);
+}
+
+void sdc_writeProfile(void)
+{
+    gSdcProfileWritePending = false;
+    sNewAccessCount = 0;
+    if (!sProfileOpen)
+    {
+        return;
+    }
+
+    SdcProfileHeader header;
+    header.magic = SDC_PROFILE_MAGIC;
+    header.version = SDC_PROFILE_VERSION;
+    header.blockShift = SDC_BLOCK_SHIFT;
+    header.gameCode = sGameCode;
+    header.romBlockCount = sRomBlockCount;
+
+    UINT bytesWritten = 0;
+    f_lseek(&sProfileFile, 0);
+    f_write(&sProfileFile, &header, sizeof(header), &bytesWritten);
+    f_write(&sProfileFile, sdc_profileAccessCounts, sRomBlockCount * sizeof(u16), &bytesWritten);
+    f_sync(&sProfileFile);
+}
+
+void sdc_writeProfileFromVBlank(void)
+{
+    if (vm_nestedIrqLevel != 0)
+    {
+        // an arm9 service, which may be using FatFs, was interrupted
+        return;
+    }
+
+    sdc_writeProfile();
+#ifdef GBAR3_SDC_STATS
+    sdc_dumpStats();
+#endif
+#ifdef GBAR3_FS_STATS
+    fs_dumpStats();
+#endif
+}
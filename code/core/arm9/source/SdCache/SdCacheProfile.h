@@ -0,0 +1,51 @@
+#pragma once
+#include "SdCacheDefs.h"
+
+#define SDC_PROFILE_MAGIC       0x50434453 // SDCP
+#define SDC_PROFILE_VERSION     1
+
+/// @brief Header of a hot block profile file. The header is followed by
+///        a u16 access count for each of the romBlockCount rom blocks.
+typedef struct
+{
+    u32 magic;
+    u16 version;
+    u16 blockShift;
+    u32 gameCode;
+    u32 romBlockCount;
+} SdcProfileHeader;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Access counts of the rom blocks, including those of earlier sessions.
+extern u16 sdc_profileAccessCounts[SDC_ROM_BLOCK_COUNT];
+
+/// @brief Set when enough new accesses have been recorded to write the profile again.
+extern vu8 gSdcProfileWritePending;
+
+/// @brief Opens the profile at the given path and loads the counts of earlier sessions.
+///        A new profile is started when the file does not exist or belongs to a different rom.
+/// @param path The path of the profile file.
+/// @param gameCode The game code of the rom.
+/// @param romSize The size of the rom in bytes.
+void sdc_loadProfile(const char* path, u32 gameCode, u32 romSize);
+
+/// @brief Records an access to the given rom block. Called by the sd cache on misses.
+/// @param romBlock The rom block that was accessed.
+void sdc_profileRecordAccess(u32 romBlock);
+
+/// @brief Prefetches the hottest rom blocks of the profile into free cache blocks.
+void sdc_warmupFromProfile(void);
+
+/// @brief Writes the profile to its file.
+void sdc_writeProfile(void);
+
+/// @brief Writes the profile from the vblank irq when no arm9 service was interrupted,
+///        such that FatFs is known to be idle. Otherwise the write stays pending.
+void sdc_writeProfileFromVBlank(void);
+
+#ifdef __cplusplus
+}
+#endif
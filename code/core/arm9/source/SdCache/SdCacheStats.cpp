@@ -0,0 +1,118 @@
+#include "common.h"
+
+#if defined(GBAR3_SDC_STATS) || defined(GBAR3_SDC_TRACE)
+
+#include <memory>
+#include <mini-printf.h>
+#include "Fat/ff.h"
+#include "Cpsr.h"
+#include "SdCacheStats.h"
+
+#define SDC_STATS_FILE_PATH     "/_gba/cache/sdstats.txt"
+#define SDC_STATS_HOT_BLOCKS    16
+
+#define REG_VCOUNT              (*(vu16*)0x04000006)
+#define SCANLINES_PER_FRAME     263
+
+static u32 sLastScanline;
+static u32 sTime;
+
+extern "C" u32 sdc_statsGetTime(void)
+{
+    u32 irqs = arm_disableIrqs();
+    u32 scanline = REG_VCOUNT;
+    if (scanline >= sLastScanline)
+    {
+        sTime += scanline - sLastScanline;
+    }
+    else
+    {
+        sTime += scanline + SCANLINES_PER_FRAME - sLastScanline;
+    }
+    sLastScanline = scanline;
+    u32 time = sTime;
+    arm_restoreIrqs(irqs);
+    return time;
+}
+
+#ifdef GBAR3_SDC_STATS
+
+[[gnu::section(".ewram.bss")]]
+SdcStats gSdcStats;
+
+vu8 gSdcStatsIsSaveWriteActive;
+
+[[gnu::section(".ewram.bss")]]
+u16 gSdcStatsRomBlockMissCounts[SDC_ROM_BLOCK_COUNT];
+
+[[gnu::section(".ewram.bss"), gnu::aligned(32)]]
+static FIL sStatsFile;
+
+static u32 formatStats(char* buffer, u32 bufferSize)
+{
+    u32 length = mini_snprintf(buffer, bufferSize,
+        "load32 misses: %u\nload16 misses: %u\nload8 misses: %u\n"
+        "getRomBlock hits: %u\ngetRomBlock misses: %u\n"
+        "soft misses: %u\nhard misses: %u\nthrash evictions: %u\n"
+        "victim hits: %u\ndemotions: %u\n"
+        "hard miss time: %u lines, max %u lines\n"
+        "fs waits: %u, %u lines\n"
+        "hard misses during save writes: %u, max %u lines\n"
+        "hottest rom blocks:\n",
+        gSdcStats.load32MissCount, gSdcStats.load16MissCount, gSdcStats.load8MissCount,
+        gSdcStats.getRomBlockHitCount, gSdcStats.getRomBlockMissCount,
+        gSdcStats.softMissCount, gSdcStats.hardMissCount, gSdcStats.thrashCount,
+        gSdcStats.victimHitCount, gSdcStats.demotionCount,
+        gSdcStats.hardMissTime, gSdcStats.hardMissMaxTime,
+        gSdcStats.fsWaitCount, gSdcStats.fsWaitTime,
+        gSdcStats.saveWriteMissCount, gSdcStats.saveWriteMissMaxTime);
+
+    // list the rom blocks with the most misses, in descending order
+    u32 previousBlock = 0;
+    u32 previousCount = 0xFFFFFFFF;
+    for (u32 i = 0; i < SDC_STATS_HOT_BLOCKS && length < bufferSize; i++)
+    {
+        u32 hottestBlock = 0;
+        u32 hottestCount = 0;
+        for (u32 romBlock = 0; romBlock < SDC_ROM_BLOCK_COUNT; romBlock++)
+        {
+            u32 count = gSdcStatsRomBlockMissCounts[romBlock];
+            bool isAfterPrevious = count < previousCount || (count == previousCount && romBlock > previousBlock);
+            if (count > hottestCount && isAfterPrevious)
+            {
+                hottestBlock = romBlock;
+                hottestCount = count;
+            }
+        }
+
+        if (hottestCount == 0)
+        {
+            break;
+        }
+
+        length += mini_snprintf(buffer + length, bufferSize - length,
+            "  0x%08X: %u\n", 0x08000000 + (hottestBlock << SDC_BLOCK_SHIFT), hottestCount);
+        previousBlock = hottestBlock;
+        previousCount = hottestCount;
+    }
+
+    return length < bufferSize ? length : bufferSize - 1;
+}
+
+extern "C" void sdc_dumpStats(void)
+{
+    auto buffer = std::make_unique<char[]>(1024);
+    u32 length = formatStats(buffer.get(), 1024);
+    gLogger->Log(LogLevel::Info, "%s", buffer.get());
+
+    if (f_open(&sStatsFile, SDC_STATS_FILE_PATH, FA_CREATE_ALWAYS | FA_WRITE) == FR_OK)
+    {
+        UINT bytesWritten = 0;
+        f_write(&sStatsFile, buffer.get(), length, &bytesWritten);
+        f_close(&sStatsFile);
+    }
+}
+
+#endif
+
+#endif
@@ -0,0 +1,112 @@
+#pragma once
+#include "SdCacheDefs.h"
+
+// Statistics are only compiled in when building with GBAR3_SDC_STATS (make SDC_STATS=1)
+
+#define SDC_STATS_LOAD32_MISS_COUNT_OFFSET  0
+#define SDC_STATS_LOAD16_MISS_COUNT_OFFSET  4
+#define SDC_STATS_LOAD8_MISS_COUNT_OFFSET   8
+
+#ifndef __ASSEMBLER__
+
+/// @brief Sd cache and rom memory emulation statistics.
+///        Times are measured in scanlines of about 63.5 us.
+typedef struct
+{
+    /// @brief The number of rom cache misses of emulated 32 bit loads.
+    u32 load32MissCount;
+
+    /// @brief The number of rom cache misses of emulated 16 bit loads.
+    u32 load16MissCount;
+
+    /// @brief The number of rom cache misses of emulated 8 bit loads.
+    u32 load8MissCount;
+
+    /// @brief The number of sdc_getRomBlock calls that found the rom block mapped.
+    u32 getRomBlockHitCount;
+
+    /// @brief The number of sdc_getRomBlock calls that had to load the rom block.
+    u32 getRomBlockMissCount;
+
+    /// @brief The number of misses on rom blocks that were still resident, but unmapped.
+    u32 softMissCount;
+
+    /// @brief The number of misses that required reading from the sd card.
+    u32 hardMissCount;
+
+    /// @brief The number of misses that were served from a victim pool instead of the sd card.
+    u32 victimHitCount;
+
+    /// @brief The number of evicted blocks that were copied to a victim pool.
+    u32 demotionCount;
+
+    /// @brief The number of evictions of blocks that were loaded less than
+    ///        a quarter of the cache size hard misses ago.
+    u32 thrashCount;
+
+    /// @brief The total time spent servicing hard misses.
+    u32 hardMissTime;
+
+    /// @brief The longest time spent servicing a single hard miss.
+    u32 hardMissMaxTime;
+
+    /// @brief The number of times fs_waitForCompletion had to wait for the arm7.
+    u32 fsWaitCount;
+
+    /// @brief The total time spent waiting in fs_waitForCompletion.
+    u32 fsWaitTime;
+
+    /// @brief The number of hard misses while the save was written to the sd card.
+    u32 saveWriteMissCount;
+
+    /// @brief The longest time spent servicing a single hard miss while the save was written.
+    u32 saveWriteMissMaxTime;
+} SdcStats;
+
+#ifdef GBAR3_SDC_STATS
+
+#define SDC_STATS_INCREMENT(counter)    (gSdcStats.counter++)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern SdcStats gSdcStats;
+
+/// @brief True while the save is written to the sd card.
+extern vu8 gSdcStatsIsSaveWriteActive;
+
+/// @brief The number of hard misses per rom block.
+extern u16 gSdcStatsRomBlockMissCounts[SDC_ROM_BLOCK_COUNT];
+
+/// @brief Writes the statistics to the log and to a file on the sd card.
+void sdc_dumpStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#else
+
+#define SDC_STATS_INCREMENT(counter)
+
+#endif
+
+#if defined(GBAR3_SDC_STATS) || defined(GBAR3_SDC_TRACE)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Returns a monotonic time in scanlines. The time only advances correctly when
+///        this function is called at least once per frame during the measured interval.
+/// @return The current time in scanlines.
+u32 sdc_statsGetTime(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+#endif
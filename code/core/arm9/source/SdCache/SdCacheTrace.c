@@ -0,0 +1,138 @@
+#include "common.h"
+
+#ifdef GBAR3_SDC_TRACE
+
+#include <string.h>
+#include "Fat/ff.h"
+#include "Cpsr.h"
+#include "VirtualMachine/VMNestedIrq.h"
+#include "SdCache.h"
+#include "SdCacheStats.h"
+#include "SdCacheTrace.h"
+
+/// @brief The number of records in each of the two trace buffers. While one buffer
+///        is filled, the other one waits to be written from the vblank irq.
+#define SDC_TRACE_BUFFER_RECORD_COUNT   2048
+
+[[gnu::section(".ewram.bss"), gnu::aligned(32)]]
+static SdcTraceRecord sTraceBuffers[2][SDC_TRACE_BUFFER_RECORD_COUNT];
+
+[[gnu::section(".ewram.bss"), gnu::aligned(32)]]
+static FIL sTraceFile;
+
+[[gnu::section(".ewram.bss")]]
+static SdcTraceHeader sTraceHeader;
+
+static bool sTraceOpen;
+static u32 sActiveBuffer;
+static u32 sActiveBufferCount;
+static vu8 sBufferFull[2];
+static u32 sLastEndTime;
+
+static void writeHeader(void)
+{
+    UINT bytesWritten = 0;
+    f_lseek(&sTraceFile, 0);
+    f_write(&sTraceFile, &sTraceHeader, sizeof(sTraceHeader), &bytesWritten);
+}
+
+void sdc_startTrace(const char* path, u32 gameCode, u32 romSize, SdcPolicyType policy, u32 readAheadDepth)
+{
+    sActiveBuffer = 0;
+    sActiveBufferCount = 0;
+    sBufferFull[0] = false;
+    sBufferFull[1] = false;
+
+    sTraceHeader.magic = SDC_TRACE_MAGIC;
+    sTraceHeader.version = SDC_TRACE_VERSION;
+    sTraceHeader.blockShift = SDC_BLOCK_SHIFT;
+    sTraceHeader.cacheBlockCount = sdc_getCacheBlockCount();
+    sTraceHeader.gameCode = gameCode;
+    sTraceHeader.romSize = romSize;
+    sTraceHeader.policy = policy;
+    sTraceHeader.readAheadDepth = readAheadDepth;
+    sTraceHeader.recordCount = 0;
+    sTraceHeader.droppedCount = 0;
+
+    memset(&sTraceFile, 0, sizeof(sTraceFile));
+    sTraceOpen = f_open(&sTraceFile, path, FA_CREATE_ALWAYS | FA_WRITE) == FR_OK;
+    if (sTraceOpen)
+    {
+        writeHeader();
+        f_sync(&sTraceFile);
+    }
+    sLastEndTime = sdc_statsGetTime();
+}
+
+SdcTraceRecord* sdc_traceBegin(u32 romAddress)
+{
+    if (!sTraceOpen)
+    {
+        return NULL;
+    }
+
+    u32 irqs = arm_disableIrqs();
+    if (sActiveBufferCount == SDC_TRACE_BUFFER_RECORD_COUNT)
+    {
+        if (sBufferFull[1 - sActiveBuffer])
+        {
+            // the previous buffer was not written yet
+            sTraceHeader.droppedCount++;
+            arm_restoreIrqs(irqs);
+            return NULL;
+        }
+        sBufferFull[sActiveBuffer] = true;
+        sActiveBuffer = 1 - sActiveBuffer;
+        sActiveBufferCount = 0;
+    }
+
+    SdcTraceRecord* record = &sTraceBuffers[sActiveBuffer][sActiveBufferCount++];
+    u32 gap = sdc_statsGetTime() - sLastEndTime;
+    record->romAddress = romAddress;
+    record->gap = gap > 0xFFFF ? 0xFFFF : gap;
+    record->flags = (arm_getCpsr() & 0x1F) == 0x12 ? SDC_TRACE_FLAG_IRQ : 0;
+    arm_restoreIrqs(irqs);
+    return record;
+}
+
+void sdc_traceEnd(SdcTraceRecord* record, bool isHardMiss)
+{
+    if (!record)
+    {
+        return;
+    }
+
+    if (isHardMiss)
+    {
+        record->flags |= SDC_TRACE_FLAG_HARD_MISS;
+    }
+    sLastEndTime = sdc_statsGetTime();
+}
+
+void sdc_traceVBlank(void)
+{
+    // the scanline clock only advances correctly when it is sampled every frame
+    sdc_statsGetTime();
+    if (!sTraceOpen || vm_nestedIrqLevel != 0)
+    {
+        // an arm9 service, which may be using FatFs, was interrupted
+        return;
+    }
+
+    // only the inactive buffer is written, records of the active buffer are lost when the console is turned off
+    u32 buffer = 1 - sActiveBuffer;
+    if (!sBufferFull[buffer])
+    {
+        return;
+    }
+
+    UINT bytesWritten = 0;
+    f_lseek(&sTraceFile, sizeof(SdcTraceHeader) + sTraceHeader.recordCount * sizeof(SdcTraceRecord));
+    f_write(&sTraceFile, sTraceBuffers[buffer], sizeof(sTraceBuffers[buffer]), &bytesWritten);
+    sTraceHeader.recordCount += SDC_TRACE_BUFFER_RECORD_COUNT;
+    sBufferFull[buffer] = false;
+    writeHeader();
+    f_sync(&sTraceFile);
+}
+
+#endif
@@ -0,0 +1,74 @@
+#pragma once
+#include "SdCacheDefs.h"
+#include "SdCachePolicy.h"
+
+// Tracing is only compiled in when building with GBAR3_SDC_TRACE (make SDC_TRACE=1).
+// The trace can be replayed against different cache configurations with tools/SdCacheSimulator.
+
+#define SDC_TRACE_MAGIC         0x43525453 // STRC
+#define SDC_TRACE_VERSION       1
+
+/// @brief The record was made while an irq was being handled.
+#define SDC_TRACE_FLAG_IRQ          1
+/// @brief The rom block had to be read from the sd card.
+#define SDC_TRACE_FLAG_HARD_MISS    2
+
+/// @brief Header of a trace file. The header is followed by recordCount records.
+typedef struct
+{
+    u32 magic;
+    u16 version;
+    u16 blockShift;
+    u32 cacheBlockCount;
+    u32 gameCode;
+    u32 romSize;
+    u16 policy;
+    u16 readAheadDepth;
+    u32 recordCount;
+    /// @brief The number of records that were lost because the trace could not be written in time.
+    u32 droppedCount;
+} SdcTraceHeader;
+
+/// @brief A call of sdc_loadRomBlockDirect, which happens on every access
+///        to a rom block that is not mapped in sdc_romBlockToCacheBlock.
+typedef struct
+{
+    u32 romAddress;
+    /// @brief The number of scanlines between the end of the previous call and this call, saturated to 0xFFFF.
+    u16 gap;
+    u16 flags;
+} SdcTraceRecord;
+
+#ifdef GBAR3_SDC_TRACE
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Creates the trace file at the given path and starts recording.
+/// @param path The path of the trace file.
+/// @param gameCode The game code of the rom.
+/// @param romSize The size of the rom in bytes.
+/// @param policy The active replacement policy.
+/// @param readAheadDepth The active read-ahead depth.
+void sdc_startTrace(const char* path, u32 gameCode, u32 romSize, SdcPolicyType policy, u32 readAheadDepth);
+
+/// @brief Starts a record of a call of sdc_loadRomBlockDirect.
+/// @param romAddress The requested rom address.
+/// @return The record, or null when the trace is not running or its buffers are full.
+SdcTraceRecord* sdc_traceBegin(u32 romAddress);
+
+/// @brief Completes a record started with sdc_traceBegin.
+/// @param record The record returned by sdc_traceBegin, or null.
+/// @param isHardMiss Whether the rom block had to be read from the sd card.
+void sdc_traceEnd(SdcTraceRecord* record, bool isHardMiss);
+
+/// @brief Advances the trace clock and writes full trace buffers when no arm9 service was interrupted,
+///        such that FatFs is known to be idle. Must be called from the vblank irq.
+void sdc_traceVBlank(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
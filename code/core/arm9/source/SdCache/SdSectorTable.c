@@ -0,0 +1,61 @@
+#include "common.h"
+#include "SdCacheDefs.h"
+#include "SdSectorTable.h"
+
+#define SECTORS_PER_ROM_BLOCK   (SDC_BLOCK_SIZE / 512)
+
+u32 sdc_getSdSectorFromLinkMap(const u32* linkMap, u32 sectorsPerCluster, u32 dataStartSector, u32 romBlock)
+{
+    u32 fileSector = romBlock * SECTORS_PER_ROM_BLOCK;
+    u32 clusterShift = __builtin_ctz(sectorsPerCluster);
+    u32 cluster = fileSector >> clusterShift;
+    while (true)
+    {
+        u32 clusterCount = *linkMap++;
+        if (cluster < clusterCount)
+        {
+            break;
+        }
+        cluster -= clusterCount;
+        linkMap++;
+    }
+    return dataStartSector
+        + ((cluster + *linkMap - 2) << clusterShift)
+        + (fileSector & (sectorsPerCluster - 1));
+}
+
+bool sdc_buildSdSectorTable(const u32* linkMap, u32 sectorsPerCluster, u32 dataStartSector,
+    u32* table, u32 romBlockCount)
+{
+    u32 clusterShift = __builtin_ctz(sectorsPerCluster);
+    u32 romBlock = 0;
+    u32 fragmentFileSector = 0;
+    while (romBlock < romBlockCount)
+    {
+        u32 clusterCount = *linkMap++;
+        if (clusterCount == 0)
+        {
+            // end of the link map
+            return false;
+        }
+
+        u32 firstCluster = *linkMap++;
+        u32 fragmentSector = dataStartSector + ((firstCluster - 2) << clusterShift);
+        u32 fragmentEndFileSector = fragmentFileSector + (clusterCount << clusterShift);
+
+        // all rom blocks starting within this fragment
+        u32 fileSector = romBlock * SECTORS_PER_ROM_BLOCK;
+        while (fileSector < fragmentEndFileSector)
+        {
+            table[romBlock++] = fragmentSector + fileSector - fragmentFileSector;
+            if (romBlock == romBlockCount)
+            {
+                break;
+            }
+            fileSector += SECTORS_PER_ROM_BLOCK;
+        }
+
+        fragmentFileSector = fragmentEndFileSector;
+    }
+    return true;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Returns the first sd sector of the given rom block by walking a FatFs cluster link map.
+/// @param linkMap The FatFs link map, excluding the leading size entry.
+///                Consists of (cluster count, first cluster) pairs terminated by a zero cluster count.
+/// @param sectorsPerCluster The number of sectors per cluster. Must be a power of 2.
+/// @param dataStartSector The first sector of the data region of the file system.
+/// @param romBlock The rom block to look up. Must be within the file described by the link map.
+/// @return The sd sector containing the start of the rom block.
+u32 sdc_getSdSectorFromLinkMap(const u32* linkMap, u32 sectorsPerCluster, u32 dataStartSector, u32 romBlock);
+
+/// @brief Builds a table with the first sd sector of each rom block from a FatFs cluster link map.
+///        The link map is walked once, so the cost is linear in the number of rom blocks and fragments.
+/// @param linkMap The FatFs link map, excluding the leading size entry.
+///                Consists of (cluster count, first cluster) pairs terminated by a zero cluster count.
+/// @param sectorsPerCluster The number of sectors per cluster. Must be a power of 2.
+/// @param dataStartSector The first sector of the data region of the file system.
+/// @param table The table to fill. Must have room for romBlockCount entries.
+/// @param romBlockCount The number of rom blocks.
+/// @return True if the table was built, or false if the link map does not cover all rom blocks.
+bool sdc_buildSdSectorTable(const u32* linkMap, u32 sectorsPerCluster, u32 dataStartSector,
+    u32* table, u32 romBlockCount);
+
+#ifdef __cplusplus
+}
+#endif
@@ -4,6 +4,10 @@
 extern "C" {
 #endif
 
+/// @brief The number of nested vm_enableNestedIrqs calls. Non-zero while an arm9
+///        service that allows nested irqs, like an sd cache miss, is running.
+extern vu32 vm_nestedIrqLevel;
+
 extern void vm_enableNestedIrqs(void);
 extern void vm_disableNestedIrqs(void);
 extern bool vm_yieldGbaIrqs(void);
@@ -10,10 +10,12 @@
 #include <libtwl/gfx/gfxOam.h>
 #include <libtwl/gfx/gfxStatus.h>
 #include <libtwl/rtos/rtosIrq.h>
+#include <algorithm>
 #include <array>
 #include <string.h>
 #include "cp15.h"
 #include "Fat/ff.h"
+#include "Fat/diskio.h"
 #include "VirtualMachine/VirtualMachine.h"
 #include "Emulator/IoRegisters.h"
 #include "Core/Environment.h"
@@ -24,18 +26,23 @@
 #include "Save/SaveTagScanner.h"
 #include "Save/Save.h"
 #include "SdCache/SdCache.h"
+#include "SdCache/SdCacheProfile.h"
+#include "SdCache/SdCacheTrace.h"
+#include "SdCache/CompressedRom.h"
 #include "JitPatcher/JitCommon.h"
 #include "JitPatcher/JitArm.h"
 #include "Peripherals/Sound/GbaSound9.h"
 #include "Patches/HarvestMoonPatches.h"
 #include "Patches/BadMixerPatch.h"
 #include "Application/Settings/AppSettingsService.h"
+#include "Application/BootCacheService.h"
 #include "GbaHeader.h"
 #include "MemoryEmulator/MemoryLoadStore.h"
 #include "ColorLut.h"
 #include "MemoryProtectionConfiguration.h"
 #include "MemoryProtectionUnit.h"
 #include "MemoryEmulator/RomDefs.h"
+#include "MemoryEmulator/RomLayout.h"
 #include "Application/GbaDisplayConfigurationService.h"
 #include "Application/GbaBorderService.h"
 #include "Application/SplashScreen.h"
@@ -49,6 +56,17 @@
 #define BIOS_FILE_PATH                  "/_gba/bios.bin"
 #define SETTINGS_FILE_PATH              "/_gba/gbarunner3.json"
 #define GAME_SETTINGS_FILE_PATH_FORMAT  "/_gba/configs/%c%c%c%c%02X.json"
+#define CACHE_DIRECTORY_PATH            "/_gba/cache"
+#define SD_CACHE_PROFILE_PATH_FORMAT    CACHE_DIRECTORY_PATH "/%c%c%c%c.bin"
+#define SD_CACHE_TRACE_PATH_FORMAT      CACHE_DIRECTORY_PATH "/%c%c%c%c.trc"
+#define BOOT_CACHE_PATH_FORMAT          CACHE_DIRECTORY_PATH "/%c%c%c%c%02X.boot"
+
+// vram C and D in lcdc mode, as mapped by gbaRunnerMain
+#define VRAM_CD_LCDC_ADDRESS            0x06840000
+#define VRAM_CD_SIZE                    (256 * 1024)
+
+// SdCacheSize::Auto selects the 2MB sd cache for roms larger than this, see SdCacheSize.h
+#define AUTO_SD_CACHE_LARGE_ROM_SIZE    (8 * 1024 * 1024)
 
 [[gnu::section(".ewram.bss")]]
 FATFS gFatFs;
@@ -93,6 +111,7 @@ static bool mountDldi()
         return false;
     }
     f_chdrive("fat:");
+    disk_setFatRegion(gFatFs.pdrv, gFatFs.fatbase, gFatFs.fsize * gFatFs.n_fats);
     return true;
 }
 
@@ -105,6 +124,7 @@ static bool mountDsiSd()
         return false;
     }
     f_chdrive("sd:");
+    disk_setFatRegion(gFatFs.pdrv, gFatFs.fatbase, gFatFs.fsize * gFatFs.n_fats);
     return true;
 }
 
@@ -186,15 +206,71 @@ static void applyBiosJitPatches()
     gGbaBios[0x0134 >> 2] = 0xEE800090; // ldr pc, [r0, #-4] (jump to irq handler)
 }
 
-static void loadGbaRom(const char* romPath)
+static void openGbaRom(const char* romPath)
 {
-    UINT br;
     memset(&gFile, 0, sizeof(gFile));
     f_open(&gFile, romPath, FA_OPEN_EXISTING | FA_READ);
-    sdc_init();
-    f_read(&gFile, &gRomHeader, sizeof(GbaHeader), &br);
-    f_lseek(&gFile, ROM_LINEAR_GBA_ADDRESS - 0x08000000);
-    f_read(&gFile, (void*)ROM_LINEAR_DS_ADDRESS, ROM_LINEAR_SIZE, &br);
+    if (crom_open(&gFile))
+    {
+        gLogger->Log(LogLevel::Debug, "Compressed rom\n");
+    }
+    crom_read(&gFile, 0, &gRomHeader, sizeof(GbaHeader));
+}
+
+static void setupRomLayout()
+{
+    const auto& runSettings = gAppSettingsService.GetAppSettings().runSettings;
+    u32 linearSize = ROM_LINEAR_MAX_SIZE;
+    switch (runSettings.sdCacheSize)
+    {
+        case SdCacheSize::Auto:
+            linearSize = crom_getRomSize(&gFile) > AUTO_SD_CACHE_LARGE_ROM_SIZE
+                ? ROM_LINEAR_MIN_SIZE
+                : ROM_LINEAR_MAX_SIZE;
+            break;
+        case SdCacheSize::OneMegabyte:
+            linearSize = ROM_LINEAR_MAX_SIZE;
+            break;
+        case SdCacheSize::TwoMegabytes:
+            linearSize = ROM_LINEAR_MIN_SIZE;
+            break;
+    }
+
+    if (Environment::IsDsiMode() && Environment::HasExtendedMainMemory())
+    {
+        // the rom continues in extended main memory directly after the linear part
+        linearSize = ROM_LINEAR_MAX_SIZE;
+        setupExtendedMainMemoryProtection();
+    }
+
+    if (!memu_setRomLinearSize(linearSize))
+    {
+        gLogger->Log(LogLevel::Error, "Failed to set the linear rom size\n");
+    }
+
+    // the part of the linear rom region that is not used by the rom extends the sd cache
+    sdc_init((void*)ROM_LINEAR_END_DS_ADDRESS, ROM_LINEAR_MAX_END_DS_ADDRESS - ROM_LINEAR_END_DS_ADDRESS);
+    gLogger->Log(LogLevel::Debug, "Linear rom: %d kB, sd cache: %d kB\n",
+        ROM_LINEAR_SIZE >> 10, (sdc_getCacheBlockCount() * SDC_BLOCK_SIZE) >> 10);
+}
+
+static void loadGbaRom()
+{
+    setupRomLayout();
+    crom_read(&gFile, ROM_LINEAR_GBA_ADDRESS - 0x08000000, (void*)ROM_LINEAR_DS_ADDRESS, ROM_LINEAR_SIZE);
+
+    // absolute rom accesses to the linear part should not go through the sd cache
+    u32 romSize = (crom_getRomSize(&gFile) + SDC_BLOCK_MASK) & ~SDC_BLOCK_MASK;
+    sdc_mapPermanentRomBlocks(ROM_LINEAR_GBA_ADDRESS, std::min(romSize, ROM_LINEAR_SIZE), (void*)ROM_LINEAR_DS_ADDRESS);
+
+    if (Environment::IsDsiMode() && Environment::HasExtendedMainMemory() && romSize > ROM_LINEAR_SIZE)
+    {
+        // load as much of the remaining rom as fits, the sd cache only serves the part beyond it
+        u32 extendedSize = std::min(romSize - ROM_LINEAR_SIZE, (u32)ROM_EXTENDED_MAX_SIZE);
+        crom_read(&gFile, ROM_LINEAR_SIZE, (void*)ROM_EXTENDED_DS_ADDRESS, extendedSize);
+        sdc_mapPermanentRomBlocks(ROM_LINEAR_END_GBA_ADDRESS, extendedSize, (void*)ROM_EXTENDED_DS_ADDRESS);
+        gLogger->Log(LogLevel::Debug, "Extended memory rom: %d kB\n", extendedSize >> 10);
+    }
 
     HarvestMoonPatches().TryApplyPatches(gRomHeader.gameCode);
     if (BadMixerPatch().TryApplyPatch())
@@ -235,8 +311,17 @@ static void handleSave(const char* savePath)
     }
 
     u32 tagRomAddress;
-    const SaveTypeInfo* saveTypeInfo = SaveTagScanner().FindSaveTag(&gFile, &sdc_cache[0][0], tagRomAddress);
-    
+    const SaveTypeInfo* saveTypeInfo;
+    // the rom file may have been replaced by a rom with the same header and size, or been patched
+    if (!gBootCacheService.TryGetSaveType(saveTypeInfo, tagRomAddress) ||
+        (saveTypeInfo && !SaveTagScanner::IsSaveTagAt(
+            &gFile, (const void*)ROM_LINEAR_DS_ADDRESS, ROM_LINEAR_SIZE, saveTypeInfo, tagRomAddress)))
+    {
+        saveTypeInfo = SaveTagScanner().FindSaveTag(
+            &gFile, (const void*)ROM_LINEAR_DS_ADDRESS, ROM_LINEAR_SIZE, &sdc_cache[0][0], tagRomAddress);
+        gBootCacheService.StoreSaveType(saveTypeInfo, tagRomAddress);
+    }
+
     if (saveTypeInfo)
     {
         gLogger->Log(LogLevel::Debug, "%s\n", saveTypeInfo->tag);
@@ -292,11 +377,7 @@ static void applyGameJitPatches()
         if (jitPatchAddress >= 0x08000000u && jitPatchAddress < 0x0A000000u)
         {
             gLogger->Log(LogLevel::Debug, "0x%08X\n", jitPatchAddress);
-            if (jitPatchAddress >= ROM_LINEAR_GBA_ADDRESS && jitPatchAddress < ROM_LINEAR_END_GBA_ADDRESS)
-            {
-                jit_processArmInstruction(reinterpret_cast<u32*>(jitPatchAddress - ROM_LINEAR_GBA_ADDRESS + ROM_LINEAR_DS_ADDRESS));
-            }
-
+            // for the linear part of the rom this points into the linear rom region
             jit_processArmInstruction(static_cast<u32*>(sdc_loadRomBlockForPatching(jitPatchAddress)));
         }
     }
@@ -334,17 +415,85 @@ static void setupEWramDataCache()
     mpu_setRegionDataBufferability(MPU_REGION_GBA_EWRAM, false);
 }
 
-static void loadGameSpecificSettings()
+static void loadSettings()
 {
-    auto path = std::make_unique<char[]>(128);
-    mini_snprintf(path.get(), 128, GAME_SETTINGS_FILE_PATH_FORMAT,
+    auto gameSettingsPath = std::make_unique<char[]>(128);
+    mini_snprintf(gameSettingsPath.get(), 128, GAME_SETTINGS_FILE_PATH_FORMAT,
+        gRomHeader.gameCode & 0xFF, (gRomHeader.gameCode >> 8) & 0xFF,
+        (gRomHeader.gameCode >> 16) & 0xFF, gRomHeader.gameCode >> 24,
+        gRomHeader.softwareVersion);
+
+    auto bootCachePath = std::make_unique<char[]>(32);
+    mini_snprintf(bootCachePath.get(), 32, BOOT_CACHE_PATH_FORMAT,
         gRomHeader.gameCode & 0xFF, (gRomHeader.gameCode >> 8) & 0xFF,
         (gRomHeader.gameCode >> 16) & 0xFF, gRomHeader.gameCode >> 24,
         gRomHeader.softwareVersion);
 
-    if (gAppSettingsService.TryLoadAppSettings(path.get()))
+    const char* settingsPaths[BOOT_CACHE_SETTINGS_FILE_COUNT] = { SETTINGS_FILE_PATH, gameSettingsPath.get() };
+    gBootCacheService.Open(bootCachePath.get(), gRomHeader, crom_getRomSize(&gFile), settingsPaths);
+    if (gBootCacheService.TryRestoreAppSettings(gAppSettingsService.GetAppSettings()))
+    {
+        gLogger->Log(LogLevel::Debug, "Loaded settings from the boot cache\n");
+        return;
+    }
+
+    gAppSettingsService.TryLoadAppSettings(SETTINGS_FILE_PATH);
+    if (gAppSettingsService.TryLoadAppSettings(gameSettingsPath.get()))
+    {
+        gLogger->Log(LogLevel::Debug, "Loaded game specific settings from %s\n", gameSettingsPath.get());
+    }
+    gBootCacheService.StoreAppSettings(gAppSettingsService.GetAppSettings());
+}
+
+static void setupSdCache()
+{
+    const auto& runSettings = gAppSettingsService.GetAppSettings().runSettings;
+    SdcPolicyType policy = SDC_POLICY_CLOCK;
+    switch (runSettings.sdCacheReplacementPolicy)
+    {
+        case SdCacheReplacementPolicy::Random:
+            policy = SDC_POLICY_RANDOM;
+            break;
+        case SdCacheReplacementPolicy::Clock:
+            policy = SDC_POLICY_CLOCK;
+            break;
+        case SdCacheReplacementPolicy::SegmentedLru:
+            policy = SDC_POLICY_SEGMENTED_LRU;
+            break;
+    }
+    sdc_setReplacementPolicy(policy);
+
+    u32 readAheadDepth = runSettings.enableSdCacheReadAhead ? runSettings.sdCacheReadAheadDepth : 0;
+    sdc_setReadAheadDepth(readAheadDepth);
+
+    if (runSettings.enableSdCacheProfile)
+    {
+        f_mkdir(CACHE_DIRECTORY_PATH);
+        auto path = std::make_unique<char[]>(32);
+        mini_snprintf(path.get(), 32, SD_CACHE_PROFILE_PATH_FORMAT,
+            gRomHeader.gameCode & 0xFF, (gRomHeader.gameCode >> 8) & 0xFF,
+            (gRomHeader.gameCode >> 16) & 0xFF, gRomHeader.gameCode >> 24);
+        sdc_loadProfile(path.get(), gRomHeader.gameCode, crom_getRomSize(&gFile));
+    }
+
+#ifdef GBAR3_SDC_TRACE
+    f_mkdir(CACHE_DIRECTORY_PATH);
+    auto tracePath = std::make_unique<char[]>(32);
+    mini_snprintf(tracePath.get(), 32, SD_CACHE_TRACE_PATH_FORMAT,
+        gRomHeader.gameCode & 0xFF, (gRomHeader.gameCode >> 8) & 0xFF,
+        (gRomHeader.gameCode >> 16) & 0xFF, gRomHeader.gameCode >> 24);
+    sdc_startTrace(tracePath.get(), gRomHeader.gameCode, crom_getRomSize(&gFile), policy, readAheadDepth);
+#endif
+}
+
+static void setupSdCacheVictimPools(const DisplaySettings& displaySettings)
+{
+    // vram H and I hold sdc_romBlockToCacheBlock and the bios, vram C and D are only
+    // used for display capture and the border in center and mask mode
+    if (!displaySettings.enableCenterAndMask)
     {
-        gLogger->Log(LogLevel::Debug, "Loaded game specific settings from %s\n", path.get());
+        u32 size = sdc_addVictimPool((void*)VRAM_CD_LCDC_ADDRESS, VRAM_CD_SIZE);
+        gLogger->Log(LogLevel::Debug, "Sd cache victim pool in vram C and D: %d kB\n", size >> 10);
     }
 }
 
@@ -440,14 +589,12 @@ extern "C" void gbaRunnerMain(int argc, char* argv[])
     // if (Environment::SupportsAgbSemihosting())
         // mountAgbSemihosting();
 
-    gAppSettingsService.TryLoadAppSettings(SETTINGS_FILE_PATH);
-
     patch_resetSwiPatches();
     loadGbaBios();
     relocateGbaBios();
     applyBiosVmPatches();
     const char* romPath = argc > 1 ? argv[1] : DEFAULT_ROM_FILE_PATH;
-    loadGbaRom(romPath);
+    openGbaRom(romPath);
     char* romExtension = strrchr(romPath, '.');
     if (romExtension)
     {
@@ -456,9 +603,25 @@ extern "C" void gbaRunnerMain(int argc, char* argv[])
         romExtension[3] = 'v';
         romExtension[4] = '\0';
     }
-    loadGameSpecificSettings();
+    loadSettings();
+    loadGbaRom();
+    setupSdCache();
     handleSave(romPath);
     SelfModifyingPatches().ApplyPatches(gAppSettingsService.GetAppSettings().runSettings);
+    // the detection results of this boot are complete now
+    f_mkdir(CACHE_DIRECTORY_PATH);
+    gBootCacheService.Save();
+    // all patched rom blocks are known now
+    sdc_compactPatchPool();
+    if (sdc_loadWholeRom(crom_getRomSize(&gFile)))
+    {
+        gLogger->Log(LogLevel::Debug, "Whole rom loaded\n");
+    }
+    else
+    {
+        // fill the sd cache with the blocks of earlier sessions while the splash screen is animating
+        sdc_warmupFromProfile();
+    }
 
     waitSplashScreenAnimation();
     stopSplashScreenAnimation();
@@ -471,6 +634,9 @@ extern "C" void gbaRunnerMain(int argc, char* argv[])
     {
         gGbaBorderService.SetupBorder(displaySettings.borderImage, gRomHeader.gameCode);
     }
+    setupSdCacheVictimPools(displaySettings);
+    gLogger->Log(LogLevel::Debug, "Disk reads: %d, over ipc: %d\n",
+        gDiskCacheStats.readCount, gDiskCacheStats.ipcReadCount);
 
     // Do not clear ewram before we read argv
     memset((void*)0x02000000, 0, 256 * 1024);
@@ -6,13 +6,89 @@ typedef enum
     FS_IPC_CMD_DLDI_READ_SECTORS,
     FS_IPC_CMD_DLDI_WRITE_SECTORS,
     FS_IPC_CMD_DSI_SD_READ_SECTORS,
-    FS_IPC_CMD_DSI_SD_WRITE_SECTORS
+    FS_IPC_CMD_DSI_SD_WRITE_SECTORS,
+    FS_IPC_CMD_PROCESS_RING,
+    FS_IPC_CMD_DLDI_READV,
+    FS_IPC_CMD_DLDI_WRITEV,
+    FS_IPC_CMD_DSI_SD_READV,
+    FS_IPC_CMD_DSI_SD_WRITEV
 } FsIpcCommand;
 
+/// @brief A run of consecutive sectors of a scatter-gather command. For the READV and WRITEV
+///        commands, buffer points to an array of segments and count is the number of segments.
+typedef struct
+{
+    u32 sector;
+    u32 count;
+    void* buffer;
+} fs_ipc_segment_t;
+
+/// @brief Priorities of fs ipc commands, higher values are executed first.
+typedef enum
+{
+    /// @brief File system traffic, such as save, log and settings writes.
+    FS_IPC_PRIORITY_LOW,
+
+    /// @brief Speculative rom reads, such as read-ahead and profile warmup.
+    FS_IPC_PRIORITY_PREFETCH,
+
+    /// @brief Rom reads on which the emulation is stalled.
+    FS_IPC_PRIORITY_ROM_MISS,
+
+    FS_IPC_PRIORITY_HIGHEST = FS_IPC_PRIORITY_ROM_MISS
+} FsIpcPriority;
+
+/// @brief The number of sectors after which the arm7 checks for commands of a higher priority
+///        while executing a command that does not have the highest priority.
+#define FS_IPC_PREEMPTION_SECTOR_COUNT  16
+
 typedef struct alignas(32)
 {
     u32 cmd;
     void* buffer;
     u32 sector;
     u32 count;
+
+    /// @brief The FsIpcPriority of the command. Pending commands with a higher priority are
+    ///        executed first, commands with the same priority in submission order. Commands
+    ///        of different priorities must therefore not access the same sectors.
+    u32 priority;
+
+    /// @brief The sequence number of the command. The command is submitted once submitSequence
+    ///        of the ring is past it, and completed once completeSequences of its slot equals it.
+    u32 sequence;
 } fs_ipc_cmd_t;
+
+/// @brief The number of commands in the fs ipc ring, must be a power of 2.
+#define FS_IPC_RING_SIZE    8
+
+/// @brief Ring of fs ipc commands shared between the arm9 and the arm7. Every command has
+///        a sequence number and is put in any slot of which the previous command completed, such
+///        that a long command does not hold up the commands behind it. The arm9 submits commands by
+///        advancing submitSequence and sending the ring as an FS_IPC_CMD_PROCESS_RING message.
+///        The arm7 processes the submitted commands by priority and reports the completion of a
+///        command by storing its sequence number in completeSequences. Each part is written by only
+///        one of the cpus and has its own cache lines, such that the arm9 can flush or
+///        invalidate them separately.
+typedef struct alignas(32)
+{
+    /// @brief FS_IPC_CMD_PROCESS_RING, such that the ring can be sent like a command.
+    u32 cmd;
+
+    /// @brief The sequence number of the next command that will be submitted. Written by the arm9.
+    vu32 submitSequence;
+
+#ifdef GBAR3_FS_STATS
+    /// @brief The latency statistics the arm7 updates while processing the commands.
+    struct fs_ipc_stats_t* stats;
+#endif
+
+    /// @brief The sequence number of the most recently completed command of each slot. Written by the arm7.
+    alignas(32) vu32 completeSequences[FS_IPC_RING_SIZE];
+
+    /// @brief The commands, in the slots the arm9 picked for them.
+    fs_ipc_cmd_t commands[FS_IPC_RING_SIZE];
+} fs_ipc_ring_t;
+
+static_assert(sizeof(((fs_ipc_ring_t*)0)->completeSequences) % 32 == 0,
+    "completeSequences must fill whole cache lines");
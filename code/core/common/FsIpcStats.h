@@ -0,0 +1,67 @@
+#pragma once
+#include "FsIpcCommand.h"
+
+// Fs ipc latency statistics are only compiled in when building with GBAR3_FS_STATS (make FS_STATS=1).
+// The arm9 and the arm7 must be built with the same setting, since it changes the layout of fs_ipc_ring_t.
+
+/// @brief The number of buckets of the latency histograms. Bucket 0 counts latencies below 2 microseconds,
+///        bucket i counts latencies of [2^i, 2^(i+1)) microseconds and the last bucket all longer latencies.
+#define FS_STATS_BUCKET_COUNT       20
+
+/// @brief The number of fs ipc commands histograms are kept for. The device is part of the command.
+#define FS_STATS_COMMAND_COUNT      (FS_IPC_CMD_DSI_SD_WRITEV + 1)
+
+/// @brief The arm7 timer that runs freely at sys / 256 as the time base of the arm7 measurements.
+#define FS_STATS_ARM7_TIMER         2
+
+typedef enum
+{
+    /// @brief From the arrival of the ipc message at the arm7 until the arm7 starts the command.
+    FS_STATS_STAGE_QUEUE,
+
+    /// @brief From the start of the command until the driver completed it.
+    FS_STATS_STAGE_DRIVER,
+
+    /// @brief From the completion of the command until the arm9 observed the completion.
+    FS_STATS_STAGE_OBSERVE,
+
+    /// @brief From the arrival of the ipc message until the arm9 observed the completion.
+    FS_STATS_STAGE_TOTAL,
+
+    FS_STATS_STAGE_COUNT
+} FsStatsStage;
+
+typedef u32 fs_stats_histogram_t[FS_STATS_COMMAND_COUNT][FS_STATS_BUCKET_COUNT];
+
+/// @brief Fs ipc latency statistics shared between the arm9 and the arm7. The arm7 measures the queue
+///        and driver stages with its timer. The arm9 measures the observe stage with the scanline counter,
+///        which is the only clock both cpus can read, and keeps the histograms of the last two stages itself.
+typedef struct alignas(32) fs_ipc_stats_t
+{
+    /// @brief The scanline at which the command in each ring slot completed. Written by the arm7.
+    vu16 completeScanlines[FS_IPC_RING_SIZE];
+
+    /// @brief The time in microseconds from the arrival until the completion of the command
+    ///        in each ring slot. Written by the arm7.
+    vu32 serviceTimes[FS_IPC_RING_SIZE];
+
+    /// @brief Set by the arm7 when it is about to exit, to request the arm9 to dump the statistics.
+    vu8 dumpRequested;
+
+    /// @brief The histograms of the queue and driver stages. Written by the arm7.
+    alignas(32) fs_stats_histogram_t arm7Histograms[FS_STATS_STAGE_DRIVER + 1];
+
+    /// @brief Set by the arm9 once it dumped the statistics for the exit. Written by the arm9.
+    alignas(32) vu8 dumpComplete;
+} fs_ipc_stats_t;
+
+/// @brief Returns the histogram bucket of the given latency in microseconds.
+static inline u32 fs_statsGetBucket(u32 microseconds)
+{
+    if (microseconds < 2)
+    {
+        return 0;
+    }
+    u32 bucket = 31 - __builtin_clz(microseconds);
+    return bucket < FS_STATS_BUCKET_COUNT ? bucket : FS_STATS_BUCKET_COUNT - 1;
+}
@@ -8,6 +8,8 @@
 typedef struct
 {
     volatile u8 saveState;
+    /// @brief Set by the arm9 while it writes the save back to the save file over multiple frames.
+    volatile u8 isWriteBackActive;
     u8* saveData;
     u32 saveDataSize;
 } gba_save_shared_t;
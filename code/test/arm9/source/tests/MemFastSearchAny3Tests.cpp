@@ -0,0 +1,102 @@
+#include "common.h"
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "MemFastSearch.h"
+
+using namespace ::testing;
+
+#define TEST_DATA_WORD_COUNT    24
+
+static const u32 sSearchWords[3] = { 0x4D415253, 0x48534C46, 0x52504545 };
+
+static u32 sTestData[TEST_DATA_WORD_COUNT] alignas(32);
+
+/// @brief Fills sTestData with words that differ from all sSearchWords.
+static void clearTestData()
+{
+    for (u32 i = 0; i < TEST_DATA_WORD_COUNT; i++)
+    {
+        sTestData[i] = 0xA5A50000 + i;
+    }
+}
+
+TEST(MemFastSearchAny3Tests, MatchInEachPositionOfTheUnrolledLoopIsFound)
+{
+    // the unrolled loop checks 8 words per iteration, the second block checks
+    // that the match is found after the data pointer was advanced
+    for (u32 index = 0; index < 16; index++)
+    {
+        // Arrange
+        clearTestData();
+        sTestData[index] = sSearchWords[index % 3];
+
+        // Act
+        const u32* result = mem_fastSearchAny3(sTestData, TEST_DATA_WORD_COUNT * 4, sSearchWords);
+
+        // Assert
+        EXPECT_THAT(result, Eq(&sTestData[index])) << "match at word " << index;
+    }
+}
+
+TEST(MemFastSearchAny3Tests, MatchInTheTailWordsIsFound)
+{
+    // 2 blocks of 8 words are checked by the unrolled loop, the last 3 words one by one
+    const u32 wordCount = 19;
+    for (u32 index = 16; index < wordCount; index++)
+    {
+        // Arrange
+        clearTestData();
+        sTestData[index] = sSearchWords[index % 3];
+
+        // Act
+        const u32* result = mem_fastSearchAny3(sTestData, wordCount * 4, sSearchWords);
+
+        // Assert
+        EXPECT_THAT(result, Eq(&sTestData[index])) << "match at word " << index;
+    }
+}
+
+TEST(MemFastSearchAny3Tests, MatchInDataShorterThan32BytesIsFound)
+{
+    for (u32 wordCount = 1; wordCount < 8; wordCount++)
+    {
+        // Arrange
+        clearTestData();
+        sTestData[wordCount - 1] = sSearchWords[2];
+
+        // Act
+        const u32* result = mem_fastSearchAny3(sTestData, wordCount * 4, sSearchWords);
+
+        // Assert
+        EXPECT_THAT(result, Eq(&sTestData[wordCount - 1])) << "data of " << wordCount << " words";
+    }
+}
+
+TEST(MemFastSearchAny3Tests, FirstOfMultipleMatchesIsFound)
+{
+    // Arrange
+    clearTestData();
+    sTestData[5] = sSearchWords[1];
+    sTestData[3] = sSearchWords[0];
+
+    // Act
+    const u32* result = mem_fastSearchAny3(sTestData, TEST_DATA_WORD_COUNT * 4, sSearchWords);
+
+    // Assert
+    EXPECT_THAT(result, Eq(&sTestData[3]));
+}
+
+TEST(MemFastSearchAny3Tests, MatchBeyondTheDataIsNotFound)
+{
+    // Arrange
+    clearTestData();
+    sTestData[19] = sSearchWords[0];
+
+    // Act
+    const u32* shortResult = mem_fastSearchAny3(sTestData, 7 * 4, sSearchWords);
+    const u32* result = mem_fastSearchAny3(sTestData, 19 * 4, sSearchWords);
+
+    // Assert
+    EXPECT_THAT(shortResult, IsNull());
+    EXPECT_THAT(result, IsNull());
+}
@@ -0,0 +1,196 @@
+#include "common.h"
+#include <string.h>
+#include <vector>
+#include <libtwl/timer/timer.h>
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "SdCache/SdCacheDefs.h"
+#include "SdCache/Lz4.h"
+#include "Lz4Encoder.h"
+
+using namespace ::testing;
+
+#define TEST_BLOCK_COUNT            64
+#define TEST_GUARD_SIZE             32
+#define TEST_GUARD_VALUE            0xA5
+
+/// @brief The sd read bandwidth of a typical slot-1 flashcard, used to estimate the effective speed.
+#define TEST_SD_BANDWIDTH_KB_PER_SECOND     2048
+
+#define TIMER_FREQUENCY             33513982
+
+enum class BlockContent
+{
+    Zeros,
+    ThumbCode,
+    Text,
+    Random
+};
+
+static u32 nextRandom(u32& randomState)
+{
+    randomState = randomState * 1566083941u + 2531011u;
+    return randomState >> 16;
+}
+
+/// @brief Creates a rom block with content that compresses like the given kind of rom data.
+static std::vector<u8> createBlock(BlockContent content, u32 seed)
+{
+    static const u16 sThumbInstructions[] = { 0x2000, 0x4770, 0x3001, 0x6808, 0xB5F0, 0xBDF0, 0x1C20, 0x4288 };
+    static const char sText[] = "The quick brown fox jumps over the lazy dog. ";
+    std::vector<u8> block(SDC_BLOCK_SIZE);
+    u32 randomState = seed;
+    for (u32 i = 0; i < SDC_BLOCK_SIZE; i += 2)
+    {
+        u16 value;
+        switch (content)
+        {
+            case BlockContent::Zeros:
+            {
+                value = 0;
+                break;
+            }
+            case BlockContent::ThumbCode:
+            {
+                value = sThumbInstructions[nextRandom(randomState) & 7];
+                break;
+            }
+            case BlockContent::Text:
+            {
+                value = sText[i % (sizeof(sText) - 1)] | (sText[(i + 1) % (sizeof(sText) - 1)] << 8);
+                break;
+            }
+            case BlockContent::Random:
+            default:
+            {
+                value = nextRandom(randomState);
+                break;
+            }
+        }
+        block[i] = value & 0xFF;
+        block[i + 1] = value >> 8;
+    }
+    return block;
+}
+
+static std::vector<u8> compressBlock(const std::vector<u8>& block)
+{
+    std::vector<u8> compressed(SDC_BLOCK_SIZE * 2);
+    u32 length = lz4_compressBlock(block.data(), block.size(), compressed.data(), compressed.size());
+    compressed.resize(length);
+    return compressed;
+}
+
+static void startBenchmarkTimer()
+{
+    tmr_stop(2);
+    tmr_stop(3);
+    tmr_configure(2, TMCNT_H_CLK_SYS, 0, false);
+    tmr_configure(3, TMCNT_H_CLK_PREV_TMR_OVF, 0, false);
+    tmr_start(3);
+    tmr_start(2);
+}
+
+static u32 stopBenchmarkTimer()
+{
+    tmr_stop(2);
+    u32 ticks = tmr_getCounter(2) | (tmr_getCounter(3) << 16);
+    tmr_stop(3);
+    return ticks;
+}
+
+class Lz4Tests : public ::testing::TestWithParam<BlockContent> { };
+
+TEST_P(Lz4Tests, RoundTrip)
+{
+    // Arrange
+    auto block = createBlock(GetParam(), 0x1234567);
+    auto compressed = compressBlock(block);
+    std::vector<u8> decompressed(SDC_BLOCK_SIZE + TEST_GUARD_SIZE, TEST_GUARD_VALUE);
+
+    // Act
+    bool result = lz4_decompressBlock(compressed.data(), compressed.size(), decompressed.data(), SDC_BLOCK_SIZE);
+
+    // Assert
+    ASSERT_THAT(compressed.size(), Gt(0u));
+    ASSERT_THAT(result, Eq(true));
+    EXPECT_THAT(memcmp(decompressed.data(), block.data(), SDC_BLOCK_SIZE), Eq(0));
+    EXPECT_THAT(std::vector<u8>(decompressed.begin() + SDC_BLOCK_SIZE, decompressed.end()),
+        Each(Eq(TEST_GUARD_VALUE)));
+}
+
+TEST_P(Lz4Tests, TruncatedInputFailsWithinBounds)
+{
+    // Arrange
+    auto block = createBlock(GetParam(), 0x7654321);
+    auto compressed = compressBlock(block);
+    std::vector<u8> decompressed(SDC_BLOCK_SIZE + TEST_GUARD_SIZE, TEST_GUARD_VALUE);
+
+    for (u32 length = 0; length < compressed.size(); length += 1 + (compressed.size() >> 6))
+    {
+        // Act
+        bool result = lz4_decompressBlock(compressed.data(), length, decompressed.data(), SDC_BLOCK_SIZE);
+
+        // Assert
+        ASSERT_THAT(result, Eq(false));
+        ASSERT_THAT(std::vector<u8>(decompressed.begin() + SDC_BLOCK_SIZE, decompressed.end()),
+            Each(Eq(TEST_GUARD_VALUE)));
+    }
+}
+
+TEST_P(Lz4Tests, TooSmallDestinationFailsWithinBounds)
+{
+    // Arrange
+    auto block = createBlock(GetParam(), 0x89ABCDE);
+    auto compressed = compressBlock(block);
+    std::vector<u8> decompressed(SDC_BLOCK_SIZE, TEST_GUARD_VALUE);
+
+    // Act
+    bool result = lz4_decompressBlock(compressed.data(), compressed.size(),
+        decompressed.data(), SDC_BLOCK_SIZE - TEST_GUARD_SIZE);
+
+    // Assert
+    EXPECT_THAT(result, Eq(false));
+    EXPECT_THAT(std::vector<u8>(decompressed.end() - TEST_GUARD_SIZE, decompressed.end()),
+        Each(Eq(TEST_GUARD_VALUE)));
+}
+
+TEST_P(Lz4Tests, Benchmark)
+{
+    // Arrange
+    std::vector<std::vector<u8>> compressedBlocks;
+    u32 compressedSize = 0;
+    for (u32 i = 0; i < TEST_BLOCK_COUNT; i++)
+    {
+        auto compressed = compressBlock(createBlock(GetParam(), i));
+        compressedSize += compressed.size();
+        compressedBlocks.push_back(std::move(compressed));
+    }
+    std::vector<u8> decompressed(SDC_BLOCK_SIZE);
+    bool result = true;
+
+    // Act
+    startBenchmarkTimer();
+    for (const auto& compressed : compressedBlocks)
+    {
+        result &= lz4_decompressBlock(compressed.data(), compressed.size(), decompressed.data(), SDC_BLOCK_SIZE);
+    }
+    u32 ticks = stopBenchmarkTimer();
+
+    // Assert
+    // effective speed of a compressed rom: the payload is read from the sd card and then decoded,
+    // compared to reading the full block for a plain rom at TEST_SD_BANDWIDTH_KB_PER_SECOND
+    u32 romSize = TEST_BLOCK_COUNT * SDC_BLOCK_SIZE;
+    u32 decodeKbPerSecond = (u64)romSize * TIMER_FREQUENCY / ticks / 1024;
+    u64 readTicks = (u64)compressedSize * TIMER_FREQUENCY / (TEST_SD_BANDWIDTH_KB_PER_SECOND * 1024);
+    u32 effectiveKbPerSecond = (u64)romSize * TIMER_FREQUENCY / (readTicks + ticks) / 1024;
+    LOG_INFO("ratio: %d%%, decode: %d kB/s, effective: %d kB/s vs %d kB/s plain\n",
+        compressedSize * 100 / romSize, decodeKbPerSecond, effectiveKbPerSecond, TEST_SD_BANDWIDTH_KB_PER_SECOND);
+    EXPECT_THAT(result, Eq(true));
+}
+
+INSTANTIATE_TEST_SUITE_P(, Lz4Tests, Values(
+    BlockContent::Zeros,
+    BlockContent::ThumbCode,
+    BlockContent::Text,
+    BlockContent::Random));
@@ -0,0 +1,179 @@
+#include "common.h"
+#include <vector>
+#include <libtwl/timer/timer.h>
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "SdCache/SdCacheDefs.h"
+#include "SdCache/SdSectorTable.h"
+
+using namespace ::testing;
+
+#define TEST_DATA_START_SECTOR  0x2000
+#define TEST_ROM_BLOCK_COUNT    (8 * 1024 * 1024 / SDC_BLOCK_SIZE)
+
+enum class FragmentationLayout
+{
+    Contiguous,
+    FewFragments,
+    RandomFragments,
+    EveryClusterReversed
+};
+
+/// @brief Creates a synthetic FatFs link map for a file of the given number of rom blocks.
+static std::vector<u32> createLinkMap(FragmentationLayout layout, u32 sectorsPerCluster, u32 romBlockCount)
+{
+    u32 clusterCount = (romBlockCount * (SDC_BLOCK_SIZE / 512) + sectorsPerCluster - 1) / sectorsPerCluster;
+    std::vector<u32> linkMap;
+    u32 randomState = 0x1234567;
+    u32 nextCluster = 2;
+    u32 cluster = 0;
+    while (cluster < clusterCount)
+    {
+        u32 length;
+        switch (layout)
+        {
+            case FragmentationLayout::Contiguous:
+            {
+                length = clusterCount;
+                break;
+            }
+            case FragmentationLayout::FewFragments:
+            {
+                length = clusterCount / 4 + 1;
+                break;
+            }
+            case FragmentationLayout::RandomFragments:
+            {
+                randomState = randomState * 1566083941u + 2531011u;
+                length = 1 + ((randomState >> 16) & 0x3F);
+                break;
+            }
+            case FragmentationLayout::EveryClusterReversed:
+            default:
+            {
+                length = 1;
+                break;
+            }
+        }
+
+        if (length > clusterCount - cluster)
+        {
+            length = clusterCount - cluster;
+        }
+
+        linkMap.push_back(length);
+        if (layout == FragmentationLayout::EveryClusterReversed)
+        {
+            linkMap.push_back(2 + clusterCount - cluster);
+        }
+        else
+        {
+            linkMap.push_back(nextCluster);
+            nextCluster += length + 3;
+        }
+        cluster += length;
+    }
+    linkMap.push_back(0);
+    return linkMap;
+}
+
+static void startBenchmarkTimer()
+{
+    tmr_stop(2);
+    tmr_stop(3);
+    tmr_configure(2, TMCNT_H_CLK_SYS, 0, false);
+    tmr_configure(3, TMCNT_H_CLK_PREV_TMR_OVF, 0, false);
+    tmr_start(3);
+    tmr_start(2);
+}
+
+static u32 stopBenchmarkTimer()
+{
+    tmr_stop(2);
+    u32 ticks = tmr_getCounter(2) | (tmr_getCounter(3) << 16);
+    tmr_stop(3);
+    return ticks;
+}
+
+class SdSectorTableTests : public ::testing::TestWithParam<std::tuple<FragmentationLayout, u32>> { };
+
+TEST_P(SdSectorTableTests, TableMatchesLinkMapWalk)
+{
+    // Arrange
+    FragmentationLayout layout = std::get<0>(GetParam());
+    u32 sectorsPerCluster = std::get<1>(GetParam());
+    auto linkMap = createLinkMap(layout, sectorsPerCluster, TEST_ROM_BLOCK_COUNT);
+    std::vector<u32> table(TEST_ROM_BLOCK_COUNT);
+
+    // Act
+    bool result = sdc_buildSdSectorTable(linkMap.data(), sectorsPerCluster,
+        TEST_DATA_START_SECTOR, table.data(), TEST_ROM_BLOCK_COUNT);
+
+    // Assert
+    ASSERT_THAT(result, Eq(true));
+    for (u32 romBlock = 0; romBlock < TEST_ROM_BLOCK_COUNT; romBlock++)
+    {
+        ASSERT_THAT(table[romBlock], Eq(sdc_getSdSectorFromLinkMap(linkMap.data(),
+            sectorsPerCluster, TEST_DATA_START_SECTOR, romBlock)));
+    }
+}
+
+TEST_P(SdSectorTableTests, TruncatedLinkMapFails)
+{
+    // Arrange
+    FragmentationLayout layout = std::get<0>(GetParam());
+    u32 sectorsPerCluster = std::get<1>(GetParam());
+    auto linkMap = createLinkMap(layout, sectorsPerCluster, TEST_ROM_BLOCK_COUNT / 2);
+    std::vector<u32> table(TEST_ROM_BLOCK_COUNT);
+
+    // Act
+    bool result = sdc_buildSdSectorTable(linkMap.data(), sectorsPerCluster,
+        TEST_DATA_START_SECTOR, table.data(), TEST_ROM_BLOCK_COUNT);
+
+    // Assert
+    EXPECT_THAT(result, Eq(false));
+}
+
+TEST_P(SdSectorTableTests, Benchmark)
+{
+    // Arrange
+    FragmentationLayout layout = std::get<0>(GetParam());
+    u32 sectorsPerCluster = std::get<1>(GetParam());
+    auto linkMap = createLinkMap(layout, sectorsPerCluster, TEST_ROM_BLOCK_COUNT);
+    std::vector<u32> table(TEST_ROM_BLOCK_COUNT);
+    u32 checksum = 0;
+
+    // Act
+    startBenchmarkTimer();
+    sdc_buildSdSectorTable(linkMap.data(), sectorsPerCluster,
+        TEST_DATA_START_SECTOR, table.data(), TEST_ROM_BLOCK_COUNT);
+    u32 buildTicks = stopBenchmarkTimer();
+
+    startBenchmarkTimer();
+    for (u32 romBlock = 0; romBlock < TEST_ROM_BLOCK_COUNT; romBlock++)
+    {
+        checksum += sdc_getSdSectorFromLinkMap(linkMap.data(),
+            sectorsPerCluster, TEST_DATA_START_SECTOR, romBlock);
+    }
+    u32 walkTicks = stopBenchmarkTimer();
+
+    startBenchmarkTimer();
+    for (u32 romBlock = 0; romBlock < TEST_ROM_BLOCK_COUNT; romBlock++)
+    {
+        checksum -= ((volatile u32*)table.data())[romBlock];
+    }
+    u32 tableTicks = stopBenchmarkTimer();
+
+    // Assert
+    LOG_INFO("fragments: %d, build: %d, walk: %d, table: %d ticks for %d lookups\n",
+        (linkMap.size() - 1) / 2, buildTicks, walkTicks, tableTicks, TEST_ROM_BLOCK_COUNT);
+    EXPECT_THAT(checksum, Eq(0u));
+}
+
+INSTANTIATE_TEST_SUITE_P(, SdSectorTableTests, Combine(
+    Values(
+        FragmentationLayout::Contiguous,
+        FragmentationLayout::FewFragments,
+        FragmentationLayout::RandomFragments,
+        FragmentationLayout::EveryClusterReversed),
+    Values(1u, 8u, 64u)));
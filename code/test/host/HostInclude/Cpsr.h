@@ -0,0 +1,30 @@
+#pragma once
+// The host harness is single threaded, so irqs never have to be disabled.
+// The returned cpsr is always system mode with irqs enabled.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static inline u32 arm_getCpsr(void)
+{
+    return 0x1F;
+}
+
+static inline u32 arm_disableIrqs(void)
+{
+    return 0x1F;
+}
+
+static inline u32 arm_enableIrqs(void)
+{
+    return 0x1F;
+}
+
+static inline void arm_restoreIrqs(u32 oldCpsr)
+{
+}
+
+#ifdef __cplusplus
+}
+#endif
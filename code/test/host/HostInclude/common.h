@@ -0,0 +1,18 @@
+#pragma once
+// Replaces the arm9 common.h, such that the arm9 code can be built for the host.
+// The arm9 heap is replaced by the heap of the host.
+#include <nds/ndstypes.h>
+#include <stddef.h>
+
+typedef u16 bool16;
+
+#ifdef __cplusplus
+
+#include <new>
+#include "Logger/ILogger.h"
+
+constexpr std::align_val_t cache_align { 32 };
+
+extern ILogger* gLogger;
+
+#endif
@@ -0,0 +1,9 @@
+#pragma once
+// The host has no write buffer or caches that need maintenance. Cleaning and invalidating the
+// data cache still order the memory accesses, which the fs ipc ring relies on between the arm9
+// and the arm7 thread of HostArm7.cpp.
+
+static inline void ic_invalidateAll(void) { }
+static inline void dc_drainWriteBuffer(void) { }
+static inline void dc_flushRange(const void* ptr, u32 byteCount) { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+static inline void dc_invalidateRange(void* ptr, u32 byteCount) { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
@@ -0,0 +1,15 @@
+#pragma once
+// There is no fifo between the cpus on the host. HostStubs.cpp drops the messages and answers
+// every message the arm9 waits for with 0. HostArm7.cpp delivers the messages to the modelled arm7.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void ipc_sendWordDirect(u32 word);
+bool ipc_isRecvFifoEmpty(void);
+u32 ipc_recvWordDirect(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,18 @@
+#pragma once
+#include "ipcFifo.h"
+
+#define IPC_FIFO_MSG_CHANNEL_BITS   5
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*ipc_fifo_handler_t)(u32 channel, u32 data, void* arg);
+
+// Only defined by HostArm7.cpp, which runs the arm7 fs ipc service.
+void ipc_setChannelHandler(u32 channel, ipc_fifo_handler_t handler, void* arg);
+void ipc_sendFifoMessage(u32 channel, u32 data);
+
+#ifdef __cplusplus
+}
+#endif
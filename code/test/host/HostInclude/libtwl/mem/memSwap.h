@@ -0,0 +1,15 @@
+#pragma once
+
+static inline u8 mem_swapByte(u8 value, u8* ptr)
+{
+    u8 old = *ptr;
+    *ptr = value;
+    return old;
+}
+
+static inline u32 mem_swapWord(u32 value, u32* ptr)
+{
+    u32 old = *ptr;
+    *ptr = value;
+    return old;
+}
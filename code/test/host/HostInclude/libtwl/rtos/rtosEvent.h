@@ -0,0 +1,19 @@
+#pragma once
+// The arm7 threads are host threads, see HostArm7.cpp.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+    bool isSignaled;
+} rtos_event_t;
+
+void rtos_createEvent(rtos_event_t* event);
+void rtos_waitEvent(rtos_event_t* event, bool clearBeforeWait, bool clearAfterWait);
+void rtos_signalEvent(rtos_event_t* event);
+
+#ifdef __cplusplus
+}
+#endif
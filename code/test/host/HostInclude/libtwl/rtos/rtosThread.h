@@ -0,0 +1,21 @@
+#pragma once
+// The arm7 threads are host threads, see HostArm7.cpp. Priorities and stacks are ignored.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*rtos_thread_func_t)(void* arg);
+
+typedef struct
+{
+    rtos_thread_func_t entryPoint;
+    void* arg;
+} rtos_thread_t;
+
+void rtos_createThread(rtos_thread_t* thread, u8 priority, rtos_thread_func_t entryPoint, void* arg, u32* stack, u32 stackSize);
+void rtos_wakeupThread(rtos_thread_t* thread);
+
+#ifdef __cplusplus
+}
+#endif
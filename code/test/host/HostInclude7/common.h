@@ -0,0 +1,17 @@
+#pragma once
+// Replaces the arm7 common.h, such that the arm7 fs ipc service can be built for the host.
+// The drivers and the platform checks are defined by HostArm7.cpp.
+#include <nds/ndstypes.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool isDSiMode(void);
+int sdmmc_sdcard_readsectors(u32 sector, u32 count, void* buffer);
+int sdmmc_sdcard_writesectors(u32 sector, u32 count, void* buffer);
+
+#ifdef __cplusplus
+}
+#endif
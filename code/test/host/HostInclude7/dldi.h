@@ -0,0 +1,11 @@
+#pragma once
+// Replaces the arm7 dldi.h. The modelled dldi driver is defined by HostArm7.cpp.
+
+typedef bool (*FN_MEDIUM_STARTUP)(void);
+typedef bool (*FN_MEDIUM_READSECTORS)(u32 sector, u32 numSectors, void* buffer);
+typedef bool (*FN_MEDIUM_WRITESECTORS)(u32 sector, u32 numSectors, const void* buffer);
+
+extern u8 _dldi_start[16 * 1024];
+extern FN_MEDIUM_STARTUP _DLDI_startup_ptr;
+extern FN_MEDIUM_READSECTORS _DLDI_readSectors_ptr;
+extern FN_MEDIUM_WRITESECTORS _DLDI_writeSectors_ptr;
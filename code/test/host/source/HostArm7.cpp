@@ -0,0 +1,164 @@
+#include "common.h"
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <libtwl/ipc/ipcFifoSystem.h>
+#include <libtwl/rtos/rtosEvent.h>
+#include <libtwl/rtos/rtosThread.h>
+#include "dldi.h"
+#include "IpcServices/FsIpcService.h"
+#include "HostArm7.h"
+
+// Host model of the arm7 side of the fs ipc. The rtos threads are host threads and the fifo
+// messages of the arm9 are handled right away on the sending thread, like the fifo irq of the
+// arm7 interrupts whatever the arm7 is doing. Only the dldi device is modelled.
+
+struct IpcChannelHandler
+{
+    ipc_fifo_handler_t handler;
+    void* arg;
+};
+
+static IpcChannelHandler sIpcChannelHandlers[1 << IPC_FIFO_MSG_CHANNEL_BITS];
+
+/// @brief Guards the rtos events. Never destroyed, since the arm7 thread outlives main.
+static std::mutex* sRtosMutex = new std::mutex();
+static std::condition_variable* sRtosCondition = new std::condition_variable();
+
+static FsIpcService sFsIpcService;
+static HostArm7Card* volatile sCard;
+
+u8 _dldi_start[16 * 1024];
+
+static bool startupDldi(void)
+{
+    return true;
+}
+
+static bool readDldiSectors(u32 sector, u32 numSectors, void* buffer)
+{
+    sCard->ReadSectors(sector, numSectors, buffer);
+    return true;
+}
+
+static bool writeDldiSectors(u32 sector, u32 numSectors, const void* buffer)
+{
+    sCard->WriteSectors(sector, numSectors, buffer);
+    return true;
+}
+
+FN_MEDIUM_STARTUP _DLDI_startup_ptr = startupDldi;
+FN_MEDIUM_READSECTORS _DLDI_readSectors_ptr = readDldiSectors;
+FN_MEDIUM_WRITESECTORS _DLDI_writeSectors_ptr = writeDldiSectors;
+
+void hostarm7_start(HostArm7Card* card)
+{
+    static bool isStarted = false;
+    sCard = card;
+    if (!isStarted)
+    {
+        sFsIpcService.Start();
+        isStarted = true;
+    }
+}
+
+extern "C" bool isDSiMode(void)
+{
+    return false;
+}
+
+extern "C" int sdmmc_sd_startup()
+{
+    return 0;
+}
+
+extern "C" int sdmmc_sdcard_readsectors(u32 sector, u32 count, void* buffer)
+{
+    fprintf(stderr, "The dsi sd card is not modelled\n");
+    abort();
+}
+
+extern "C" int sdmmc_sdcard_writesectors(u32 sector, u32 count, void* buffer)
+{
+    fprintf(stderr, "The dsi sd card is not modelled\n");
+    abort();
+}
+
+extern "C" bool vm_yieldGbaIrqs(void)
+{
+    // there are no gba irqs, give the arm7 thread a chance to run instead
+    std::this_thread::yield();
+    return false;
+}
+
+extern "C" void ipc_setChannelHandler(u32 channel, ipc_fifo_handler_t handler, void* arg)
+{
+    sIpcChannelHandlers[channel] = { handler, arg };
+}
+
+extern "C" void ipc_sendWordDirect(u32 word)
+{
+    u32 channel = word & ((1 << IPC_FIFO_MSG_CHANNEL_BITS) - 1);
+    const auto& channelHandler = sIpcChannelHandlers[channel];
+    if (!channelHandler.handler)
+    {
+        fprintf(stderr, "No arm7 handler for ipc channel %u\n", channel);
+        abort();
+    }
+    channelHandler.handler(channel, word >> IPC_FIFO_MSG_CHANNEL_BITS, channelHandler.arg);
+}
+
+extern "C" bool ipc_isRecvFifoEmpty(void)
+{
+    return false;
+}
+
+extern "C" u32 ipc_recvWordDirect(void)
+{
+    return 0;
+}
+
+extern "C" void ipc_sendFifoMessage(u32 channel, u32 data)
+{
+    // responses to the arm9 are not modelled
+}
+
+extern "C" void rtos_createThread(rtos_thread_t* thread, u8 priority, rtos_thread_func_t entryPoint, void* arg, u32* stack, u32 stackSize)
+{
+    thread->entryPoint = entryPoint;
+    thread->arg = arg;
+}
+
+extern "C" void rtos_wakeupThread(rtos_thread_t* thread)
+{
+    // the thread runs until the process exits
+    std::thread(thread->entryPoint, thread->arg).detach();
+}
+
+extern "C" void rtos_createEvent(rtos_event_t* event)
+{
+    event->isSignaled = false;
+}
+
+extern "C" void rtos_waitEvent(rtos_event_t* event, bool clearBeforeWait, bool clearAfterWait)
+{
+    std::unique_lock lock(*sRtosMutex);
+    if (clearBeforeWait)
+    {
+        event->isSignaled = false;
+    }
+    sRtosCondition->wait(lock, [event] { return event->isSignaled; });
+    if (clearAfterWait)
+    {
+        event->isSignaled = false;
+    }
+}
+
+extern "C" void rtos_signalEvent(rtos_event_t* event)
+{
+    std::lock_guard lock(*sRtosMutex);
+    event->isSignaled = true;
+    sRtosCondition->notify_all();
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+/// @brief The sd card behind the dldi driver of the modelled arm7. The functions are
+///        called on the arm7 thread, once for every driver call of the fs ipc service.
+class HostArm7Card
+{
+public:
+    virtual ~HostArm7Card() = default;
+
+    virtual void ReadSectors(u32 sector, u32 count, void* buffer) = 0;
+    virtual void WriteSectors(u32 sector, u32 count, const void* buffer) = 0;
+};
+
+/// @brief Runs the arm7 fs ipc service on a host thread, such that the arm9 fs ipc (Fat/FsIpc.cpp)
+///        and the arm7 fs ipc service (IpcServices/FsIpcService.cpp) can be tested together.
+///        The service is started on the first call, later calls only replace the card.
+/// @param card The card to transfer the sectors of the dldi device to.
+void hostarm7_start(HostArm7Card* card);
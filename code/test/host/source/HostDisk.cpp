@@ -0,0 +1,143 @@
+#include "common.h"
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include "HostDisk.h"
+
+#define FAT32_RESERVED_SECTORS      32
+#define FAT32_FAT_COUNT             2
+#define FAT32_ROOT_CLUSTER          2
+
+static void storeWord(u8* dst, u16 value)
+{
+    dst[0] = value;
+    dst[1] = value >> 8;
+}
+
+static void storeDword(u8* dst, u32 value)
+{
+    storeWord(dst, value);
+    storeWord(dst + 2, value >> 16);
+}
+
+HostDisk::~HostDisk()
+{
+    Close();
+}
+
+bool HostDisk::Create(const std::string& path, u32 sectorCount, u32 sectorsPerCluster)
+{
+    Close();
+    _fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (_fd < 0 || ftruncate(_fd, (off_t)sectorCount * 512) != 0)
+    {
+        Close();
+        return false;
+    }
+    _sectorCount = sectorCount;
+
+    // an unpartitioned volume, the FAT size is rounded up such that it covers all clusters
+    u32 clusterCount = (sectorCount - FAT32_RESERVED_SECTORS) / sectorsPerCluster;
+    u32 fatSize = ((clusterCount + 2) * 4 + 511) / 512;
+    clusterCount = (sectorCount - FAT32_RESERVED_SECTORS - FAT32_FAT_COUNT * fatSize) / sectorsPerCluster;
+
+    u8 sector[512];
+    memset(sector, 0, sizeof(sector));
+    memcpy(sector, "\xEB\x58\x90" "GBAR3   ", 11);
+    storeWord(sector + 11, 512);
+    sector[13] = sectorsPerCluster;
+    storeWord(sector + 14, FAT32_RESERVED_SECTORS);
+    sector[16] = FAT32_FAT_COUNT;
+    sector[21] = 0xF8;
+    storeWord(sector + 24, 63);
+    storeWord(sector + 26, 255);
+    storeDword(sector + 32, sectorCount);
+    storeDword(sector + 36, fatSize);
+    storeDword(sector + 44, FAT32_ROOT_CLUSTER);
+    storeWord(sector + 48, 1);
+    storeWord(sector + 50, 6);
+    sector[64] = 0x80;
+    sector[66] = 0x29;
+    storeDword(sector + 67, 0x47424133);
+    memcpy(sector + 71, "NO NAME    FAT32   ", 19);
+    storeWord(sector + 510, 0xAA55);
+    if (!WriteSectors(sector, 0, 1) || !WriteSectors(sector, 6, 1))
+        return false;
+
+    // fs info
+    memset(sector, 0, sizeof(sector));
+    storeDword(sector, 0x41615252);
+    storeDword(sector + 484, 0x61417272);
+    storeDword(sector + 488, clusterCount - 1);
+    storeDword(sector + 492, FAT32_ROOT_CLUSTER + 1);
+    storeDword(sector + 508, 0xAA550000);
+    if (!WriteSectors(sector, 1, 1) || !WriteSectors(sector, 7, 1))
+        return false;
+
+    // the first sector of each FAT, with the media descriptor and the root directory cluster
+    memset(sector, 0, sizeof(sector));
+    storeDword(sector, 0x0FFFFFF8);
+    storeDword(sector + 4, 0x0FFFFFFF);
+    storeDword(sector + 8, 0x0FFFFFFF);
+    for (u32 i = 0; i < FAT32_FAT_COUNT; i++)
+    {
+        if (!WriteSectors(sector, FAT32_RESERVED_SECTORS + i * fatSize, 1))
+            return false;
+    }
+
+    // the root directory is already empty, since the sparse file reads as zeros
+    return true;
+}
+
+bool HostDisk::Open(const std::string& path)
+{
+    Close();
+    _fd = open(path.c_str(), O_RDWR);
+    if (_fd < 0)
+        return false;
+
+    off_t size = lseek(_fd, 0, SEEK_END);
+    _sectorCount = size < 0 ? 0 : size / 512;
+    return true;
+}
+
+void HostDisk::Close()
+{
+    if (_fd >= 0)
+    {
+        close(_fd);
+        _fd = -1;
+    }
+    _sectorCount = 0;
+}
+
+bool HostDisk::ReadSectors(void* buffer, u32 sector, u32 count)
+{
+    if (sector >= _sectorCount || count > _sectorCount - sector)
+        return false;
+
+    size_t length = (size_t)count * 512;
+    return pread(_fd, buffer, length, (off_t)sector * 512) == (ssize_t)length;
+}
+
+bool HostDisk::WriteSectors(const void* buffer, u32 sector, u32 count)
+{
+    if (sector >= _sectorCount || count > _sectorCount - sector)
+        return false;
+
+    if (_writeLimit != UINT32_MAX)
+    {
+        if (count > _writeLimit)
+        {
+            // the sectors beyond the limit are lost
+            count = _writeLimit;
+            _isWriteLimitReached = true;
+        }
+        _writeLimit -= count;
+        if (count == 0)
+            return true;
+    }
+
+    size_t length = (size_t)count * 512;
+    return pwrite(_fd, buffer, length, (off_t)sector * 512) == (ssize_t)length;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <string>
+
+/// @brief A disk image file on the host, accessed in 512 byte sectors.
+class HostDisk
+{
+    int _fd = -1;
+    u32 _sectorCount = 0;
+    u32 _writeLimit = UINT32_MAX;
+    bool _isWriteLimitReached = false;
+
+public:
+    HostDisk() { }
+    HostDisk(const HostDisk&) = delete;
+    HostDisk& operator=(const HostDisk&) = delete;
+    ~HostDisk();
+
+    /// @brief Creates a sparse image file of the given size and formats it as FAT32.
+    /// @param path The path of the image file, an existing file is overwritten.
+    /// @param sectorCount The size of the image in sectors.
+    /// @param sectorsPerCluster The cluster size in sectors, a power of 2.
+    /// @return True when successful.
+    bool Create(const std::string& path, u32 sectorCount, u32 sectorsPerCluster);
+
+    /// @brief Opens an existing image file, for example a dump of an sd card.
+    /// @param path The path of the image file.
+    /// @return True when successful.
+    bool Open(const std::string& path);
+
+    void Close();
+
+    bool ReadSectors(void* buffer, u32 sector, u32 count);
+    bool WriteSectors(const void* buffer, u32 sector, u32 count);
+
+    u32 GetSectorCount() const { return _sectorCount; }
+
+    /// @brief Simulates a power loss after the given number of sectors was written.
+    ///        Later writes are dropped, until ClearWriteLimit is called.
+    void SetWriteLimit(u32 sectorCount)
+    {
+        _writeLimit = sectorCount;
+        _isWriteLimitReached = false;
+    }
+
+    void ClearWriteLimit() { _writeLimit = UINT32_MAX; }
+
+    /// @brief Returns whether a write was dropped since the last call of SetWriteLimit.
+    bool IsWriteLimitReached() const { return _isWriteLimitReached; }
+};
@@ -0,0 +1,267 @@
+#include "common.h"
+#include <cstdio>
+#include <cstdlib>
+#include <unordered_map>
+#include <vector>
+#include "FsIpcCommand.h"
+#include "HostDisk.h"
+#include "HostFsIpc.h"
+
+// Commands are executed immediately, but complete at a simulated time. Like on the arm7, one
+// command is executed at a time. Pending commands with a higher priority are executed first and
+// commands below the highest priority yield to them every FS_IPC_PREEMPTION_SECTOR_COUNT sectors.
+
+struct PendingCommand
+{
+    const FsWaitToken* waitToken;
+    u32 priority;
+    u32 remainingSectorCount;
+    bool isStarted;
+};
+
+static HostDisk* sDisks[2];
+static HostFsIpcModel sModel;
+static HostFsIpcStats sStats;
+static double sNow;
+
+/// @brief The time up to which the arm7 was simulated.
+static double sArm7Time;
+
+/// @brief The pending commands in submission order.
+static std::vector<PendingCommand> sPendingCommands;
+static std::unordered_map<const FsWaitToken*, double> sTokenCompletionTimes;
+
+void hostfs_attach(FsDevice device, HostDisk* disk)
+{
+    sDisks[device] = disk;
+}
+
+void hostfs_setModel(const HostFsIpcModel& model)
+{
+    sModel = model;
+}
+
+void hostfs_advanceTime(double us)
+{
+    sNow += us;
+}
+
+const HostFsIpcStats& hostfs_getStats()
+{
+    return sStats;
+}
+
+void hostfs_resetStats()
+{
+    sStats = HostFsIpcStats();
+}
+
+static HostDisk* getDisk(FsDevice device)
+{
+    HostDisk* disk = sDisks[device];
+    if (!disk)
+    {
+        fprintf(stderr, "No disk attached to fs device %d\n", device);
+        abort();
+    }
+    return disk;
+}
+
+/// @brief Simulates the arm7 until the next chunk of the pending command with the highest priority completed.
+static void executeArm7Chunk()
+{
+    auto command = sPendingCommands.begin();
+    for (auto it = sPendingCommands.begin(); it != sPendingCommands.end(); ++it)
+    {
+        if (it->priority > command->priority)
+        {
+            command = it;
+        }
+    }
+
+    u32 chunkSectorCount = command->remainingSectorCount;
+    if (command->priority != FS_IPC_PRIORITY_HIGHEST && chunkSectorCount > FS_IPC_PREEMPTION_SECTOR_COUNT)
+    {
+        chunkSectorCount = FS_IPC_PREEMPTION_SECTOR_COUNT;
+    }
+    if (!command->isStarted)
+    {
+        sArm7Time += sModel.latencyUs;
+        command->isStarted = true;
+    }
+    sArm7Time += chunkSectorCount * 512 * 1000000.0 / (sModel.bandwidthKbPerSecond * 1024);
+    command->remainingSectorCount -= chunkSectorCount;
+    if (command->remainingSectorCount == 0)
+    {
+        sTokenCompletionTimes[command->waitToken] = sArm7Time;
+        sPendingCommands.erase(command);
+    }
+}
+
+/// @brief Submits a command at the current time.
+static void submitCommand(u32 sectorCount, FsPriority priority, const FsWaitToken* waitToken)
+{
+    // the arm7 sees the command at the first chunk boundary after now
+    while (!sPendingCommands.empty() && sArm7Time < sNow)
+    {
+        executeArm7Chunk();
+    }
+    if (sPendingCommands.empty() && sArm7Time < sNow)
+    {
+        sArm7Time = sNow;
+    }
+    sTokenCompletionTimes.erase(waitToken);
+    sPendingCommands.push_back({ waitToken, (u32)priority, sectorCount, false });
+}
+
+static void waitUntil(double time)
+{
+    if (time > sNow)
+    {
+        sStats.waitTimeUs += time - sNow;
+        sNow = time;
+    }
+}
+
+static void readSectors(FsDevice device, void* buffer, u32 sector, u32 count)
+{
+    if (!getDisk(device)->ReadSectors(buffer, sector, count))
+    {
+        fprintf(stderr, "Reading sectors %u-%u failed\n", sector, sector + count - 1);
+        abort();
+    }
+    sStats.sectorsRead += count;
+}
+
+static void writeSectors(FsDevice device, const void* buffer, u32 sector, u32 count)
+{
+    if (!getDisk(device)->WriteSectors(buffer, sector, count))
+    {
+        fprintf(stderr, "Writing sectors %u-%u failed\n", sector, sector + count - 1);
+        abort();
+    }
+    sStats.sectorsWritten += count;
+}
+
+static void waitForToken(FsWaitToken* waitToken)
+{
+    auto it = sTokenCompletionTimes.find(waitToken);
+    while (it == sTokenCompletionTimes.end() && !sPendingCommands.empty())
+    {
+        executeArm7Chunk();
+        it = sTokenCompletionTimes.find(waitToken);
+    }
+    if (it != sTokenCompletionTimes.end())
+    {
+        waitUntil(it->second);
+        sTokenCompletionTimes.erase(it);
+    }
+    waitToken->transactionComplete = true;
+}
+
+static void startTransaction(u32 sectorCount, FsPriority priority, FsWaitToken* waitToken)
+{
+    submitCommand(sectorCount, priority, waitToken);
+    waitToken->transactionComplete = false;
+}
+
+extern "C" void fs_readSectors(FsDevice device, void* buffer, u32 sector, u32 count)
+{
+    readSectors(device, buffer, sector, count);
+    sStats.readCommandCount++;
+    FsWaitToken waitToken;
+    startTransaction(count, FS_PRIORITY_LOW, &waitToken);
+    waitForToken(&waitToken);
+}
+
+extern "C" void fs_writeSectors(FsDevice device, const void* buffer, u32 sector, u32 count)
+{
+    writeSectors(device, buffer, sector, count);
+    sStats.writeCommandCount++;
+    FsWaitToken waitToken;
+    startTransaction(count, FS_PRIORITY_LOW, &waitToken);
+    waitForToken(&waitToken);
+}
+
+extern "C" void fs_readCacheAlignedSectorsAsync(FsDevice device, void* buffer, u32 sector, u32 count, FsPriority priority, FsWaitToken* waitToken)
+{
+    readSectors(device, buffer, sector, count);
+    sStats.readCommandCount++;
+    startTransaction(count, priority, waitToken);
+}
+
+extern "C" void fs_writeCacheAlignedSectorsAsync(FsDevice device, const void* buffer, u32 sector, u32 count, FsPriority priority, FsWaitToken* waitToken)
+{
+    writeSectors(device, buffer, sector, count);
+    sStats.writeCommandCount++;
+    startTransaction(count, priority, waitToken);
+}
+
+extern "C" void fs_readCacheAlignedSectorsVAsync(FsDevice device, const FsSegment* segments, u32 segmentCount, FsPriority priority, FsWaitToken* waitToken)
+{
+    u32 sectorCount = 0;
+    for (u32 i = 0; i < segmentCount; i++)
+    {
+        readSectors(device, segments[i].buffer, segments[i].sector, segments[i].count);
+        sectorCount += segments[i].count;
+    }
+    sStats.readCommandCount++;
+    startTransaction(sectorCount, priority, waitToken);
+}
+
+extern "C" void fs_writeCacheAlignedSectorsVAsync(FsDevice device, const FsSegment* segments, u32 segmentCount, FsPriority priority, FsWaitToken* waitToken)
+{
+    u32 sectorCount = 0;
+    for (u32 i = 0; i < segmentCount; i++)
+    {
+        writeSectors(device, segments[i].buffer, segments[i].sector, segments[i].count);
+        sectorCount += segments[i].count;
+    }
+    sStats.writeCommandCount++;
+    startTransaction(sectorCount, priority, waitToken);
+}
+
+extern "C" u32 fs_waitForCompletion(FsWaitToken* waitToken, bool keepIrqsDisabled)
+{
+    if (!waitToken)
+    {
+        while (!sPendingCommands.empty())
+        {
+            executeArm7Chunk();
+        }
+        waitUntil(sArm7Time);
+        return 0x1F;
+    }
+
+    if (!waitToken->transactionComplete)
+    {
+        waitForToken(waitToken);
+    }
+    return 0x1F;
+}
+
+extern "C" u32 fs_waitForCompletionOfCurrentTransaction(bool keepIrqsDisabled)
+{
+    return fs_waitForCompletion(nullptr, keepIrqsDisabled);
+}
+
+extern "C" bool fs_isTransactionComplete(FsWaitToken* waitToken)
+{
+    if (waitToken->transactionComplete)
+    {
+        return true;
+    }
+    // the arm7 keeps executing commands up to now
+    while (!sPendingCommands.empty() && sArm7Time < sNow)
+    {
+        executeArm7Chunk();
+    }
+    auto it = sTokenCompletionTimes.find(waitToken);
+    if (it == sTokenCompletionTimes.end() || it->second > sNow)
+    {
+        return false;
+    }
+    sTokenCompletionTimes.erase(it);
+    waitToken->transactionComplete = true;
+    return true;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "Fat/FsIpc.h"
+
+class HostDisk;
+
+/// @brief Parameters of the modelled arm7 and sd card behind the fs ipc.
+struct HostFsIpcModel
+{
+    /// @brief The fixed cost of a command in microseconds, including the arm7 round trip.
+    double latencyUs = 400;
+
+    /// @brief The transfer rate in kB/s.
+    double bandwidthKbPerSecond = 2048;
+};
+
+/// @brief Counters of the stubbed fs ipc.
+struct HostFsIpcStats
+{
+    u32 readCommandCount = 0;
+    u32 writeCommandCount = 0;
+    u64 sectorsRead = 0;
+    u64 sectorsWritten = 0;
+
+    /// @brief The simulated time the arm9 spent waiting for commands, in microseconds.
+    double waitTimeUs = 0;
+};
+
+/// @brief Attaches a disk image to the given fs device, or detaches it when disk is null.
+void hostfs_attach(FsDevice device, HostDisk* disk);
+
+void hostfs_setModel(const HostFsIpcModel& model);
+
+/// @brief Advances the simulated time, for example to model emulation between accesses.
+void hostfs_advanceTime(double us);
+
+const HostFsIpcStats& hostfs_getStats();
+void hostfs_resetStats();
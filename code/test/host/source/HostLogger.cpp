@@ -0,0 +1,16 @@
+#include "common.h"
+#include <stdio.h>
+
+/// @brief Logger that writes to stdout. The vendored googletest prints its results through gLogger.
+class StdoutLogger : public ILogger
+{
+public:
+    void LogV(LogLevel level, const char* fmt, va_list vlist) override
+    {
+        vprintf(fmt, vlist);
+    }
+};
+
+static StdoutLogger sStdoutLogger;
+
+ILogger* gLogger = &sStdoutLogger;
@@ -0,0 +1,124 @@
+#include "common.h"
+#include <stdio.h>
+#include <string.h>
+#include "Fat/ff.h"
+#include "Core/Environment.h"
+#include "MemFastSearch.h"
+#include "VirtualMachine/VMNestedIrq.h"
+#include "MemoryEmulator/RomDefs.h"
+#include "SdCache/SdCache.h"
+#include "Save/Save.h"
+#include "Save/SaveSwi.h"
+#include "Save/SaveEeprom.h"
+#include "Save/SaveFlash.h"
+#include "Save/SaveSram.h"
+#include "HostFsIpc.h"
+#include "HostStubs.h"
+
+/// @brief The duration of a frame in microseconds.
+#define HOST_FRAME_TIME_US  16743
+
+// Definitions of the arm9 state and functions that live in assembly or
+// in modules that are not part of the host build.
+
+u32 Environment::_flags;
+
+u8 sdc_cache[SDC_BLOCK_COUNT][SDC_BLOCK_SIZE] alignas(32);
+FIL gFile;
+u32 gRomLinearSize = ROM_LINEAR_MAX_SIZE;
+vu32 vm_nestedIrqLevel;
+void* sav_swiTable[16];
+u32 emu_vblankIrqSkipSaveCheckInstruction;
+
+extern "C" void vm_enableNestedIrqs(void)
+{
+    vm_nestedIrqLevel++;
+}
+
+extern "C" void vm_disableNestedIrqs(void)
+{
+    vm_nestedIrqLevel--;
+}
+
+void host_storeSram8(u32 saveAddress, u8 data)
+{
+    saveAddress &= 0x7FFF;
+    if (gSaveData[saveAddress] == data)
+    {
+        return;
+    }
+    gSaveData[saveAddress] = data;
+    gGbaSaveShared.saveState = GBA_SAVE_STATE_DIRTY;
+    gSaveSramDirtySectors[saveAddress >> 9] = 1;
+    emu_vblankIrqSkipSaveCheckInstruction = 0;
+}
+
+u32 host_runSaveWriteBack()
+{
+    gGbaSaveShared.saveState = GBA_SAVE_STATE_WRITE;
+    u32 frameCount = 0;
+    do
+    {
+        sav_updateWriteBack();
+        hostfs_advanceTime(HOST_FRAME_TIME_US);
+        frameCount++;
+    } while (gGbaSaveShared.isWriteBackActive);
+    return frameCount;
+}
+
+extern "C" void logAddress(u32 address)
+{
+}
+
+extern "C" void ipc_sendWordDirect(u32 word)
+{
+}
+
+extern "C" bool ipc_isRecvFifoEmpty(void)
+{
+    return false;
+}
+
+extern "C" u32 ipc_recvWordDirect(void)
+{
+    return 0;
+}
+
+extern "C" const u32* mem_fastSearch16(const u32* data, u32 dataLength, const u32* pattern)
+{
+    for (u32 i = 0; i + 4 <= dataLength / 4; i++)
+    {
+        if (memcmp(&data[i], pattern, 16) == 0)
+        {
+            return &data[i];
+        }
+    }
+    return nullptr;
+}
+
+extern "C" const u32* mem_fastSearchAny3(const u32* data, u32 dataLength, const u32* words)
+{
+    for (u32 i = 0; i < dataLength / 4; i++)
+    {
+        if (data[i] == words[0] || data[i] == words[1] || data[i] == words[2])
+        {
+            return &data[i];
+        }
+    }
+    return nullptr;
+}
+
+// The save patches modify the linear rom in DS memory. The host build only identifies save types.
+
+bool eeprom_patchV111(const SaveTypeInfo* saveTypeInfo, FIL* romFile, u32 tagRomAddress, u8* tempBuffer) { return true; }
+bool eeprom_patchV120(const SaveTypeInfo* saveTypeInfo, FIL* romFile, u32 tagRomAddress, u8* tempBuffer) { return true; }
+bool eeprom_patchV124(const SaveTypeInfo* saveTypeInfo, FIL* romFile, u32 tagRomAddress, u8* tempBuffer) { return true; }
+bool eeprom_patchV126(const SaveTypeInfo* saveTypeInfo, FIL* romFile, u32 tagRomAddress, u8* tempBuffer) { return true; }
+bool sram_patchV110(const SaveTypeInfo* saveTypeInfo, FIL* romFile, u32 tagRomAddress, u8* tempBuffer) { return true; }
+bool sram_patchV111(const SaveTypeInfo* saveTypeInfo, FIL* romFile, u32 tagRomAddress, u8* tempBuffer) { return true; }
+bool flash_patchV120(const SaveTypeInfo* saveTypeInfo, FIL* romFile, u32 tagRomAddress, u8* tempBuffer) { return true; }
+bool flash_patchV123(const SaveTypeInfo* saveTypeInfo, FIL* romFile, u32 tagRomAddress, u8* tempBuffer) { return true; }
+bool flash_patchV126(const SaveTypeInfo* saveTypeInfo, FIL* romFile, u32 tagRomAddress, u8* tempBuffer) { return true; }
+bool flash_patch512V130(const SaveTypeInfo* saveTypeInfo, FIL* romFile, u32 tagRomAddress, u8* tempBuffer) { return true; }
+bool flash_patch1MV102(const SaveTypeInfo* saveTypeInfo, FIL* romFile, u32 tagRomAddress, u8* tempBuffer) { return true; }
+bool flash_patch1MV103(const SaveTypeInfo* saveTypeInfo, FIL* romFile, u32 tagRomAddress, u8* tempBuffer) { return true; }
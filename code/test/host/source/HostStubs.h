@@ -0,0 +1,9 @@
+#pragma once
+
+/// @brief Writes a byte of an sram save like memu_store8Sram does.
+void host_storeSram8(u32 saveAddress, u8 data);
+
+/// @brief Requests a write-back of the save like the arm7 does, and calls sav_updateWriteBack
+///        every frame like the vblank irq does until the write-back completed.
+/// @return The number of frames the write-back took.
+u32 host_runSaveWriteBack();
@@ -0,0 +1,75 @@
+#include "common.h"
+#include <stdlib.h>
+#include "Fat/ff.h"
+#include "Fat/diskio.h"
+#include "HostFsIpc.h"
+#include "HostVolume.h"
+
+HostVolume::~HostVolume()
+{
+    Unmount();
+}
+
+bool HostVolume::Create(const std::string& path, u32 sizeMb, u32 sectorsPerCluster)
+{
+    Unmount();
+    return _disk.Create(path, sizeMb * 2048, sectorsPerCluster) && Mount();
+}
+
+bool HostVolume::Open(const std::string& path)
+{
+    Unmount();
+    return _disk.Open(path) && Mount();
+}
+
+bool HostVolume::Mount()
+{
+    hostfs_attach(FS_DEVICE_DLDI, &_disk);
+    if (f_mount(&_fatFs, "fat:", 1) != FR_OK)
+        return false;
+
+    f_chdrive("fat:");
+    disk_setFatRegion(_fatFs.pdrv, _fatFs.fatbase, _fatFs.fsize * _fatFs.n_fats);
+    _isMounted = true;
+    return true;
+}
+
+void HostVolume::Unmount()
+{
+    if (!_isMounted)
+        return;
+
+    disk_ioctl(_fatFs.pdrv, CTRL_SYNC, nullptr);
+    f_mount(nullptr, "fat:", 0);
+    hostfs_attach(FS_DEVICE_DLDI, nullptr);
+    _isMounted = false;
+}
+
+bool HostVolume::WriteFile(const char* path, const void* data, u32 size)
+{
+    FIL file;
+    if (f_open(&file, path, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK)
+        return false;
+
+    UINT bytesWritten = 0;
+    bool result = f_write(&file, data, size, &bytesWritten) == FR_OK && bytesWritten == size;
+    return f_close(&file) == FR_OK && result;
+}
+
+bool HostVolume::ReadFile(const char* path, std::vector<u8>& data)
+{
+    FIL file;
+    if (f_open(&file, path, FA_OPEN_EXISTING | FA_READ) != FR_OK)
+        return false;
+
+    data.resize(f_size(&file));
+    UINT bytesRead = 0;
+    bool result = f_read(&file, data.data(), data.size(), &bytesRead) == FR_OK && bytesRead == data.size();
+    return f_close(&file) == FR_OK && result;
+}
+
+std::string host_getTempImagePath(const char* name)
+{
+    const char* tempDir = getenv("TMPDIR");
+    return std::string(tempDir ? tempDir : "/tmp") + "/gbar3-" + name + ".img";
+}
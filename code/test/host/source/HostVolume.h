@@ -0,0 +1,37 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "Fat/ff.h"
+#include "HostDisk.h"
+
+/// @brief A FAT32 disk image that is attached to the dldi fs device and mounted as "fat:".
+class HostVolume
+{
+    HostDisk _disk;
+    FATFS _fatFs;
+    bool _isMounted = false;
+
+public:
+    ~HostVolume();
+
+    /// @brief Creates and mounts a new image at the given path.
+    bool Create(const std::string& path, u32 sizeMb = 64, u32 sectorsPerCluster = 64);
+
+    /// @brief Mounts an existing image at the given path.
+    bool Open(const std::string& path);
+
+    /// @brief Writes back all cached sectors and unmounts the volume.
+    void Unmount();
+
+    bool WriteFile(const char* path, const void* data, u32 size);
+    bool ReadFile(const char* path, std::vector<u8>& data);
+
+    HostDisk& GetDisk() { return _disk; }
+    const FATFS& GetFatFs() const { return _fatFs; }
+
+private:
+    bool Mount();
+};
+
+/// @brief Returns a path for a temporary disk image with the given name.
+std::string host_getTempImagePath(const char* name);
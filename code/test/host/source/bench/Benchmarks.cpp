@@ -0,0 +1,309 @@
+#include "common.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "Fat/ff.h"
+#include "Fat/diskio.h"
+#include "SdCache/SdCache.h"
+#include "SdCache/CompressedRom.h"
+#include "Save/Save.h"
+#include "Save/SaveTagScanner.h"
+#include "Application/Settings/AppSettingsService.h"
+#include "Application/BootCacheService.h"
+#include "GbaHeader.h"
+#include "HostFsIpc.h"
+#include "HostStubs.h"
+#include "HostVolume.h"
+
+// Benchmarks of the file access of the arm9 against a disk image. The time the arm9
+// waits for the fs ipc is simulated with the latency model of HostFsIpc, the host
+// time only shows the cpu cost of the arm9 code on the host.
+
+#define BENCH_ROM_PATH          "fat:/rom.gba"
+#define BENCH_SAVE_PATH         "fat:/rom.sav"
+#define BENCH_BIOS_PATH         "fat:/_gba/bios.bin"
+#define BENCH_SETTINGS_PATH     "fat:/_gba/gbarunner3.json"
+#define BENCH_GAME_CONFIG_PATH  "fat:/_gba/configs/ABCD00.json"
+#define BENCH_CACHE_DIR_PATH    "fat:/_gba/cache"
+#define BENCH_BOOT_CACHE_PATH   BENCH_CACHE_DIR_PATH "/ABCD00.boot"
+#define BENCH_ROM_SIZE          (16 * 1024 * 1024)
+#define BENCH_TAGLESS_ROM_PATH  "fat:/tagless.gba"
+/// @brief The size of the part of the rom that gbaRunnerMain loads into memory, like ROM_LINEAR_SIZE.
+#define BENCH_LINEAR_ROM_SIZE   (2 * 1024 * 1024)
+#define BENCH_MISS_COUNT        20000
+#define BENCH_FLUSH_COUNT       100
+#define BENCH_LOG_PATH          "fat:/_gba/log.bin"
+#define BENCH_LOG_SECTOR_COUNT  256
+#define BENCH_LOG_WRITE_COUNT   200
+#define BENCH_LOG_MISS_COUNT    8
+
+extern FIL gFile;
+
+static HostVolume sVolume;
+static u8 sTempBuffer[SAVE_TAG_SCANNER_TEMP_BUFFER_SIZE] alignas(32);
+static u8 sLinearRom[BENCH_LINEAR_ROM_SIZE] alignas(32);
+
+/// @brief Measures the host time and the fs ipc activity of a piece of code.
+class BenchmarkScope
+{
+    const char* _name;
+    u32 _iterations;
+    std::chrono::steady_clock::time_point _start;
+
+public:
+    BenchmarkScope(const char* name, u32 iterations)
+        : _name(name), _iterations(iterations)
+    {
+        hostfs_resetStats();
+        memset(&gDiskCacheStats, 0, sizeof(gDiskCacheStats));
+        _start = std::chrono::steady_clock::now();
+    }
+
+    ~BenchmarkScope()
+    {
+        double hostUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - _start).count();
+        const auto& stats = hostfs_getStats();
+        printf("%s (%u iterations)\n", _name, _iterations);
+        printf("  simulated wait: %.1f us/iteration\n", stats.waitTimeUs / _iterations);
+        printf("  host time: %.2f us/iteration\n", hostUs / _iterations);
+        printf("  ipc reads: %u (%llu sectors), ipc writes: %u (%llu sectors)\n",
+            stats.readCommandCount, (unsigned long long)stats.sectorsRead,
+            stats.writeCommandCount, (unsigned long long)stats.sectorsWritten);
+        printf("  disk_read calls: %u, sent to the arm7: %u\n\n",
+            gDiskCacheStats.readCount, gDiskCacheStats.ipcReadCount);
+    }
+};
+
+static bool createBootFiles()
+{
+    static u8 bios[16 * 1024];
+    const char* settings = "{\"runSettings\": {\"sdCacheReadAheadDepth\": 2}}";
+    std::vector<u32> rom(BENCH_ROM_SIZE / 4);
+    for (u32 i = 0; i < rom.size(); i++)
+    {
+        rom[i] = i * 4;
+    }
+    if (!sVolume.WriteFile(BENCH_TAGLESS_ROM_PATH, rom.data(), BENCH_ROM_SIZE))
+    {
+        return false;
+    }
+    // a flash save tag near the end, such that the whole rom is scanned
+    memcpy((u8*)rom.data() + BENCH_ROM_SIZE - 0x1000, "FLASH1M_V103", 12);
+
+    return f_mkdir("fat:/_gba") == FR_OK &&
+        sVolume.WriteFile(BENCH_BIOS_PATH, bios, sizeof(bios)) &&
+        sVolume.WriteFile(BENCH_SETTINGS_PATH, settings, strlen(settings)) &&
+        sVolume.WriteFile(BENCH_ROM_PATH, rom.data(), BENCH_ROM_SIZE) &&
+        sVolume.WriteFile(BENCH_LOG_PATH, rom.data(), BENCH_LOG_SECTOR_COUNT * 512);
+}
+
+static void openRom(const char* path = BENCH_ROM_PATH)
+{
+    f_close(&gFile);
+    memset(&gFile, 0, sizeof(gFile));
+    f_open(&gFile, path, FA_OPEN_EXISTING | FA_READ);
+    crom_open(&gFile);
+}
+
+/// @brief The file accesses of gbaRunnerMain from mounting to the initialization of the save.
+///        The first boot of a rom detects everything and writes the boot cache, later boots use it.
+static void benchmarkBootFileAccess(const char* name)
+{
+    sVolume.Unmount();
+    BenchmarkScope scope(name, 1);
+    sVolume.Open(host_getTempImagePath("Benchmarks"));
+    JsonAppSettingsSerializer serializer;
+    AppSettingsService appSettingsService(&serializer);
+
+    FIL biosFile;
+    UINT bytesRead = 0;
+    f_open(&biosFile, BENCH_BIOS_PATH, FA_OPEN_EXISTING | FA_READ);
+    f_read(&biosFile, sTempBuffer, 16 * 1024, &bytesRead);
+    f_close(&biosFile);
+
+    openRom();
+    GbaHeader romHeader;
+    crom_read(&gFile, 0, &romHeader, sizeof(romHeader));
+    const char* settingsPaths[BOOT_CACHE_SETTINGS_FILE_COUNT] = { BENCH_SETTINGS_PATH, BENCH_GAME_CONFIG_PATH };
+    gBootCacheService.Open(BENCH_BOOT_CACHE_PATH, romHeader, crom_getRomSize(&gFile), settingsPaths);
+    if (!gBootCacheService.TryRestoreAppSettings(appSettingsService.GetAppSettings()))
+    {
+        appSettingsService.TryLoadAppSettings(BENCH_SETTINGS_PATH);
+        appSettingsService.TryLoadAppSettings(BENCH_GAME_CONFIG_PATH);
+        gBootCacheService.StoreAppSettings(appSettingsService.GetAppSettings());
+    }
+    crom_read(&gFile, 0, sLinearRom, BENCH_LINEAR_ROM_SIZE);
+    sdc_init(nullptr, 0);
+
+    u32 tagRomAddress;
+    const SaveTypeInfo* saveTypeInfo;
+    if (!gBootCacheService.TryGetSaveType(saveTypeInfo, tagRomAddress))
+    {
+        saveTypeInfo = SaveTagScanner().FindSaveTag(
+            &gFile, sLinearRom, BENCH_LINEAR_ROM_SIZE, sTempBuffer, tagRomAddress);
+        gBootCacheService.StoreSaveType(saveTypeInfo, tagRomAddress);
+    }
+    sav_initializeSave(saveTypeInfo, BENCH_SAVE_PATH);
+    f_mkdir(BENCH_CACHE_DIR_PATH);
+    gBootCacheService.Save();
+}
+
+/// @brief Scanning a rom with a late or without a save tag, after the linear part of the rom was loaded.
+static void benchmarkSaveTagScan(const char* romPath, bool scanLoadedRom)
+{
+    openRom(romPath);
+    crom_read(&gFile, 0, sLinearRom, BENCH_LINEAR_ROM_SIZE);
+    char name[96];
+    snprintf(name, sizeof(name), "save tag scan, %s, %s",
+        strcmp(romPath, BENCH_ROM_PATH) == 0 ? "tag at the end" : "no tag",
+        scanLoadedRom ? "loaded part in place" : "whole rom from the file");
+    BenchmarkScope scope(name, 1);
+    u32 tagRomAddress;
+    SaveTagScanner().FindSaveTag(&gFile, scanLoadedRom ? sLinearRom : nullptr,
+        scanLoadedRom ? BENCH_LINEAR_ROM_SIZE : 0, sTempBuffer, tagRomAddress);
+}
+
+/// @brief Random accesses to a rom that is larger than the sd cache, such that most accesses miss.
+static void benchmarkCacheMissService(u32 readAheadDepth)
+{
+    openRom();
+    sdc_init(nullptr, 0);
+    sdc_setReadAheadDepth(readAheadDepth);
+    u32 randomState = 0x1234567;
+    char name[64];
+    snprintf(name, sizeof(name), "cache miss service, read-ahead depth %u", readAheadDepth);
+    BenchmarkScope scope(name, BENCH_MISS_COUNT);
+    for (u32 i = 0; i < BENCH_MISS_COUNT; i++)
+    {
+        // runs of sequential accesses at random positions
+        if ((i & 7) == 0)
+        {
+            randomState = randomState * 1566083941u + 2531011u;
+        }
+        u32 romBlock = ((randomState >> 8) + (i & 7)) % (BENCH_ROM_SIZE >> SDC_BLOCK_SHIFT);
+        sdc_getRomBlock(0x08000000 + (romBlock << SDC_BLOCK_SHIFT));
+        hostfs_advanceTime(500);
+    }
+}
+
+/// @brief Writing back a few bytes of an sram save from the vblank irq, and of a flash save.
+static void benchmarkSaveFlush()
+{
+    sav_initializeSave(nullptr, BENCH_SAVE_PATH);
+    u32 frameCount = 0;
+    {
+        BenchmarkScope scope("sram write-back, 16 bytes", BENCH_FLUSH_COUNT);
+        for (u32 i = 0; i < BENCH_FLUSH_COUNT; i++)
+        {
+            for (u32 j = 0; j < 16; j++)
+            {
+                host_storeSram8((i * 997 + j) & 0x7FFF, ~(i + j));
+            }
+            frameCount += host_runSaveWriteBack();
+        }
+    }
+    printf("  vblanks until written: %.2f/iteration\n\n", (double)frameCount / BENCH_FLUSH_COUNT);
+    {
+        BenchmarkScope scope("save flush, 16 bytes", BENCH_FLUSH_COUNT);
+        for (u32 i = 0; i < BENCH_FLUSH_COUNT; i++)
+        {
+            for (u32 j = 0; j < 16; j++)
+            {
+                sav_fill((i * 997 + j) & 0x7FFF, i + j, 1);
+            }
+            sav_flushSaveFile();
+        }
+    }
+}
+
+/// @brief Rom misses while a large low priority write, like a save flush or a log write, is in flight.
+///        Reports the worst-case miss latency, with the write submitted at the lowest priority and,
+///        for comparison, with the write in fifo order with the misses.
+static void benchmarkMissDuringWrite(FsPriority writePriority)
+{
+    static u8 writeBuffer[BENCH_LOG_SECTOR_COUNT * 512] alignas(32);
+    FIL logFile;
+    f_open(&logFile, BENCH_LOG_PATH, FA_OPEN_EXISTING | FA_READ);
+    // the file was written in one go on a fresh volume, so it is contiguous
+    u32 logSector = logFile.obj.fs->database + (logFile.obj.sclust - 2) * logFile.obj.fs->csize;
+    FsDevice device = logFile.obj.fs->pdrv == DEV_FAT ? FS_DEVICE_DLDI : FS_DEVICE_DSI_SD;
+    f_close(&logFile);
+
+    openRom();
+    sdc_init(nullptr, 0);
+    sdc_setReadAheadDepth(0);
+    u32 randomState = 0x7654321;
+    double maxMissWaitUs = 0;
+    char name[64];
+    snprintf(name, sizeof(name), "rom miss during a %u kB write, %s",
+        BENCH_LOG_SECTOR_COUNT / 2, writePriority == FS_PRIORITY_LOW ? "low priority" : "fifo");
+    {
+        BenchmarkScope scope(name, BENCH_LOG_WRITE_COUNT * BENCH_LOG_MISS_COUNT);
+        for (u32 i = 0; i < BENCH_LOG_WRITE_COUNT; i++)
+        {
+            FsWaitToken writeWaitToken;
+            fs_writeCacheAlignedSectorsAsync(device, writeBuffer, logSector,
+                BENCH_LOG_SECTOR_COUNT, writePriority, &writeWaitToken);
+            for (u32 j = 0; j < BENCH_LOG_MISS_COUNT; j++)
+            {
+                randomState = randomState * 1566083941u + 2531011u;
+                u32 romBlock = (randomState >> 8) % (BENCH_ROM_SIZE >> SDC_BLOCK_SHIFT);
+                double waitTimeUs = hostfs_getStats().waitTimeUs;
+                sdc_getRomBlock(0x08000000 + (romBlock << SDC_BLOCK_SHIFT));
+                waitTimeUs = hostfs_getStats().waitTimeUs - waitTimeUs;
+                if (waitTimeUs > maxMissWaitUs)
+                {
+                    maxMissWaitUs = waitTimeUs;
+                }
+                hostfs_advanceTime(500);
+            }
+            fs_waitForCompletion(&writeWaitToken, false);
+        }
+    }
+    printf("  worst-case miss wait: %.1f us\n\n", maxMissWaitUs);
+}
+
+int main(int argc, char* argv[])
+{
+    HostFsIpcModel model;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (!strcmp(argv[i], "--latency"))
+        {
+            model.latencyUs = atof(argv[i + 1]);
+        }
+        else if (!strcmp(argv[i], "--bandwidth"))
+        {
+            model.bandwidthKbPerSecond = atof(argv[i + 1]);
+        }
+        else
+        {
+            printf("usage: HostBench [--latency <us>] [--bandwidth <kB/s>]\n");
+            return 1;
+        }
+    }
+    hostfs_setModel(model);
+    printf("fs ipc model: %.0f us latency, %.0f kB/s\n\n", model.latencyUs, model.bandwidthKbPerSecond);
+
+    if (!sVolume.Create(host_getTempImagePath("Benchmarks"), 256) || !createBootFiles())
+    {
+        printf("Creating the disk image failed\n");
+        return 1;
+    }
+
+    benchmarkBootFileAccess("boot file access, first boot");
+    benchmarkBootFileAccess("boot file access, boot cache");
+    benchmarkSaveTagScan(BENCH_ROM_PATH, false);
+    benchmarkSaveTagScan(BENCH_ROM_PATH, true);
+    benchmarkSaveTagScan(BENCH_TAGLESS_ROM_PATH, true);
+    benchmarkCacheMissService(0);
+    benchmarkCacheMissService(2);
+    benchmarkSaveFlush();
+    benchmarkMissDuringWrite(FS_PRIORITY_LOW);
+    benchmarkMissDuringWrite(FS_PRIORITY_ROM_MISS);
+    f_close(&gSaveFile);
+    f_close(&gFile);
+    return 0;
+}
@@ -0,0 +1,152 @@
+#include "common.h"
+#include <memory>
+#include <string.h>
+#include <vector>
+#include "gtest/gtest.h"
+#include "Application/BootCacheService.h"
+#include "Application/Settings/AppSettings.h"
+#include "Save/SaveTagScanner.h"
+#include "HostVolume.h"
+
+#define TEST_BOOT_CACHE_PATH        "fat:/ABCD00.boot"
+#define TEST_SETTINGS_PATH          "fat:/settings.json"
+#define TEST_GAME_SETTINGS_PATH     "fat:/ABCD00.json"
+
+static const u32 sTestSignature[4] = { 0xE92D1FF0u, 0xE8B0000Fu, 0xE1A03203u, 0xE0822001u };
+
+class BootCacheServiceTests : public ::testing::Test
+{
+protected:
+    HostVolume _volume;
+    GbaHeader _romHeader;
+    std::vector<u32> _rom = std::vector<u32>(64 * 1024 / 4);
+    const char* _settingsPaths[BOOT_CACHE_SETTINGS_FILE_COUNT] = { TEST_SETTINGS_PATH, TEST_GAME_SETTINGS_PATH };
+
+    void SetUp() override
+    {
+        ASSERT_TRUE(_volume.Create(host_getTempImagePath("BootCacheServiceTests")));
+        memset(&_romHeader, 0, sizeof(_romHeader));
+        _romHeader.gameCode = GAMECODE("ABCD");
+        _romHeader.headerChecksum = 0x5A;
+        ASSERT_TRUE(_volume.WriteFile(TEST_SETTINGS_PATH, "{}", 2));
+    }
+
+    std::unique_ptr<BootCacheService> OpenBootCache()
+    {
+        auto bootCacheService = std::make_unique<BootCacheService>();
+        bootCacheService->Open(TEST_BOOT_CACHE_PATH, _romHeader, 16 * 1024 * 1024, _settingsPaths);
+        return bootCacheService;
+    }
+
+    void PlaceSignature(u32 offset)
+    {
+        memcpy(&_rom[offset / 4], sTestSignature, sizeof(sTestSignature));
+    }
+
+    /// @brief Boots once with a detected save type, settings and a signature search and saves the cache.
+    void CreateBootCache(u32 signatureOffset)
+    {
+        PlaceSignature(signatureOffset);
+        auto bootCacheService = OpenBootCache();
+        AppSettings appSettings;
+        appSettings.displaySettings.gbaScreenBrightness = 8;
+        appSettings.runSettings.jitPatchAddresses = std::make_unique<u32[]>(2);
+        appSettings.runSettings.jitPatchAddresses[0] = 0x080000C0;
+        appSettings.runSettings.jitPatchAddresses[1] = 0x08001234;
+        appSettings.runSettings.jitPatchAddressCount = 2;
+        appSettings.runSettings.sdCacheReplacementPolicy = SdCacheReplacementPolicy::SegmentedLru;
+        bootCacheService->StoreAppSettings(appSettings);
+        bootCacheService->StoreSaveType(SaveTagScanner::GetSaveTypeInfo(1), 0x1234);
+        bootCacheService->FindSignature16(_rom.data(), _rom.size() * 4, sTestSignature);
+        bootCacheService->Save();
+    }
+};
+
+TEST_F(BootCacheServiceTests, StartsEmptyWithoutFile)
+{
+    // given
+    AppSettings appSettings;
+    const SaveTypeInfo* saveTypeInfo;
+    u32 tagRomAddress;
+
+    // when
+    auto bootCacheService = OpenBootCache();
+
+    // then
+    EXPECT_FALSE(bootCacheService->TryRestoreAppSettings(appSettings));
+    EXPECT_FALSE(bootCacheService->TryGetSaveType(saveTypeInfo, tagRomAddress));
+}
+
+TEST_F(BootCacheServiceTests, RestoresDetectionResultsOnWarmBoot)
+{
+    // given
+    CreateBootCache(0x800);
+    // a search would find this earlier copy instead of the cached offset
+    PlaceSignature(0x100);
+    AppSettings appSettings;
+    const SaveTypeInfo* saveTypeInfo;
+    u32 tagRomAddress;
+
+    // when
+    auto bootCacheService = OpenBootCache();
+    bool settingsResult = bootCacheService->TryRestoreAppSettings(appSettings);
+    bool saveTypeResult = bootCacheService->TryGetSaveType(saveTypeInfo, tagRomAddress);
+    const u32* signature = bootCacheService->FindSignature16(_rom.data(), _rom.size() * 4, sTestSignature);
+
+    // then
+    ASSERT_TRUE(settingsResult);
+    EXPECT_EQ(appSettings.displaySettings.gbaScreenBrightness, 8);
+    EXPECT_EQ(appSettings.runSettings.sdCacheReplacementPolicy, SdCacheReplacementPolicy::SegmentedLru);
+    ASSERT_EQ(appSettings.runSettings.jitPatchAddressCount, 2u);
+    EXPECT_EQ(appSettings.runSettings.jitPatchAddresses[1], 0x08001234u);
+    ASSERT_TRUE(saveTypeResult);
+    EXPECT_EQ(saveTypeInfo, SaveTagScanner::GetSaveTypeInfo(1));
+    EXPECT_EQ(tagRomAddress, 0x1234u);
+    EXPECT_EQ(signature, &_rom[0x800 / 4]);
+}
+
+TEST_F(BootCacheServiceTests, SearchesAgainWhenCachedSignatureMoved)
+{
+    // given
+    CreateBootCache(0x800);
+    memset(&_rom[0x800 / 4], 0, sizeof(sTestSignature));
+    PlaceSignature(0x400);
+
+    // when
+    auto bootCacheService = OpenBootCache();
+    const u32* signature = bootCacheService->FindSignature16(_rom.data(), _rom.size() * 4, sTestSignature);
+
+    // then
+    EXPECT_EQ(signature, &_rom[0x400 / 4]);
+}
+
+TEST_F(BootCacheServiceTests, DiscardsCacheWhenSettingsFileChanged)
+{
+    // given
+    CreateBootCache(0x800);
+    ASSERT_TRUE(_volume.WriteFile(TEST_GAME_SETTINGS_PATH, "{}", 2));
+    AppSettings appSettings;
+    const SaveTypeInfo* saveTypeInfo;
+    u32 tagRomAddress;
+
+    // when
+    auto bootCacheService = OpenBootCache();
+
+    // then
+    EXPECT_FALSE(bootCacheService->TryRestoreAppSettings(appSettings));
+    EXPECT_FALSE(bootCacheService->TryGetSaveType(saveTypeInfo, tagRomAddress));
+}
+
+TEST_F(BootCacheServiceTests, DiscardsCacheOfDifferentRom)
+{
+    // given
+    CreateBootCache(0x800);
+    _romHeader.headerChecksum = 0xA5;
+    AppSettings appSettings;
+
+    // when
+    auto bootCacheService = OpenBootCache();
+
+    // then
+    EXPECT_FALSE(bootCacheService->TryRestoreAppSettings(appSettings));
+}
@@ -0,0 +1,168 @@
+#include "common.h"
+#include <string.h>
+#include <vector>
+#include "gtest/gtest.h"
+#include "Fat/ff.h"
+#include "Fat/diskio.h"
+#include "HostFsIpc.h"
+#include "HostVolume.h"
+
+class DiskIoTests : public ::testing::Test
+{
+protected:
+    HostVolume _volume;
+
+    void SetUp() override
+    {
+        ASSERT_TRUE(_volume.Create(host_getTempImagePath("DiskIoTests")));
+        hostfs_resetStats();
+        memset(&gDiskCacheStats, 0, sizeof(gDiskCacheStats));
+    }
+
+    /// @brief Returns a sector in the data area that is not used by FatFs.
+    DWORD GetFreeDataSector(u32 index) const
+    {
+        return _volume.GetFatFs().database + 0x10000 + index;
+    }
+
+    static void FillSector(u8* sector, u32 seed)
+    {
+        for (u32 i = 0; i < 512; i++)
+        {
+            sector[i] = seed + i * 7;
+        }
+    }
+};
+
+TEST_F(DiskIoTests, FileContentsSurviveRemount)
+{
+    // given
+    std::vector<u8> data(100 * 1024 + 123);
+    for (u32 i = 0; i < data.size(); i++)
+    {
+        data[i] = i ^ (i >> 8);
+    }
+
+    // when
+    ASSERT_TRUE(_volume.WriteFile("fat:/test.bin", data.data(), data.size()));
+    _volume.Unmount();
+    ASSERT_TRUE(_volume.Open(host_getTempImagePath("DiskIoTests")));
+    std::vector<u8> readData;
+    ASSERT_TRUE(_volume.ReadFile("fat:/test.bin", readData));
+
+    // then
+    EXPECT_EQ(data, readData);
+}
+
+TEST_F(DiskIoTests, SingleSectorWriteIsHeldUntilSync)
+{
+    // given
+    u8 sector[512];
+    u8 diskSector[512];
+    FillSector(sector, 1);
+    DWORD sectorNumber = GetFreeDataSector(0);
+
+    // when
+    ASSERT_EQ(disk_write(DEV_FAT, sector, sectorNumber, 1), RES_OK);
+    u32 writesBeforeSync = hostfs_getStats().writeCommandCount;
+    ASSERT_EQ(disk_ioctl(DEV_FAT, CTRL_SYNC, nullptr), RES_OK);
+
+    // then
+    EXPECT_EQ(writesBeforeSync, 0u);
+    EXPECT_EQ(hostfs_getStats().writeCommandCount, 1u);
+    ASSERT_TRUE(_volume.GetDisk().ReadSectors(diskSector, sectorNumber, 1));
+    EXPECT_EQ(memcmp(sector, diskSector, 512), 0);
+}
+
+TEST_F(DiskIoTests, RepeatedSingleSectorReadsAreServedFromTheCache)
+{
+    // given
+    u8 sector[512];
+
+    // when
+    ASSERT_EQ(disk_read(DEV_FAT, sector, _volume.GetFatFs().fatbase, 1), RES_OK);
+    ASSERT_EQ(disk_read(DEV_FAT, sector, _volume.GetFatFs().fatbase, 1), RES_OK);
+
+    // then
+    EXPECT_EQ(gDiskCacheStats.readCount, 2u);
+    EXPECT_EQ(gDiskCacheStats.ipcReadCount, 1u);
+    EXPECT_EQ(hostfs_getStats().readCommandCount, 1u);
+}
+
+TEST_F(DiskIoTests, MultiSectorReadReturnsDirtyCachedSectors)
+{
+    // given
+    u8 sector[512];
+    u8 sectors[4 * 512];
+    FillSector(sector, 2);
+    DWORD firstSector = GetFreeDataSector(0);
+    ASSERT_EQ(disk_write(DEV_FAT, sector, firstSector + 1, 1), RES_OK);
+
+    // when
+    ASSERT_EQ(disk_read(DEV_FAT, sectors, firstSector, 4), RES_OK);
+
+    // then
+    EXPECT_EQ(memcmp(sectors + 512, sector, 512), 0);
+}
+
+TEST_F(DiskIoTests, MultiSectorWriteSupersedesCachedSector)
+{
+    // given
+    u8 sector[512];
+    u8 sectors[2 * 512];
+    u8 diskSectors[2 * 512];
+    FillSector(sector, 3);
+    FillSector(sectors, 4);
+    FillSector(sectors + 512, 5);
+    DWORD firstSector = GetFreeDataSector(0);
+    ASSERT_EQ(disk_write(DEV_FAT, sector, firstSector, 1), RES_OK);
+
+    // when
+    ASSERT_EQ(disk_write(DEV_FAT, sectors, firstSector, 2), RES_OK);
+    ASSERT_EQ(disk_ioctl(DEV_FAT, CTRL_SYNC, nullptr), RES_OK);
+    ASSERT_EQ(disk_read(DEV_FAT, sector, firstSector, 1), RES_OK);
+
+    // then
+    ASSERT_TRUE(_volume.GetDisk().ReadSectors(diskSectors, firstSector, 2));
+    EXPECT_EQ(memcmp(sectors, diskSectors, sizeof(sectors)), 0);
+    EXPECT_EQ(memcmp(sectors, sector, 512), 0);
+}
+
+TEST_F(DiskIoTests, FatSectorsAreKeptWhileStreamingOtherSectors)
+{
+    // given
+    u8 sector[512];
+    ASSERT_EQ(disk_read(DEV_FAT, sector, _volume.GetFatFs().fatbase, 1), RES_OK);
+
+    // when
+    for (u32 i = 0; i < 64; i++)
+    {
+        ASSERT_EQ(disk_read(DEV_FAT, sector, GetFreeDataSector(i), 1), RES_OK);
+    }
+    u32 ipcReadCount = gDiskCacheStats.ipcReadCount;
+    ASSERT_EQ(disk_read(DEV_FAT, sector, _volume.GetFatFs().fatbase, 1), RES_OK);
+
+    // then
+    EXPECT_EQ(gDiskCacheStats.ipcReadCount, ipcReadCount);
+}
+
+TEST_F(DiskIoTests, EvictedDirtySectorIsWrittenBack)
+{
+    // given
+    u8 sector[512];
+    u8 diskSector[512];
+    FillSector(sector, 6);
+    DWORD sectorNumber = GetFreeDataSector(0);
+    ASSERT_EQ(disk_write(DEV_FAT, sector, sectorNumber, 1), RES_OK);
+
+    // when
+    u8 otherSector[512];
+    for (u32 i = 1; i <= 64; i++)
+    {
+        ASSERT_EQ(disk_read(DEV_FAT, otherSector, GetFreeDataSector(i), 1), RES_OK);
+    }
+
+    // then
+    ASSERT_TRUE(_volume.GetDisk().ReadSectors(diskSector, sectorNumber, 1));
+    EXPECT_EQ(memcmp(sector, diskSector, 512), 0);
+}
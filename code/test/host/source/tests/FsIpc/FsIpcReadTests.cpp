@@ -0,0 +1,122 @@
+#include "common.h"
+#include <mutex>
+#include <vector>
+#include <sys/mman.h>
+#include "gtest/gtest.h"
+#include "Fat/FsIpc.h"
+#include "HostArm7.h"
+
+// These tests run the arm9 fs ipc against the arm7 fs ipc service on a host thread, see HostArm7.cpp.
+
+/// @brief The address of the memory that stands in for main memory, the arm9 only lets
+///        the arm7 access buffers in main memory directly.
+#define MAIN_MEMORY_ADDRESS     0x02000000
+#define MAIN_MEMORY_SIZE        0x10000
+
+#define READ_SECTOR             0x300
+#define READ_SECTOR_COUNT       5
+
+/// @brief The offset of the read buffer from a cache line, word aligned, such that the arm7
+///        could transfer to the buffer without staging.
+#define BUFFER_LINE_OFFSET      4
+
+#define NEIGHBOUR_VALUE         0x5A
+
+/// @brief A card that writes the memory around the read buffer during every read, like an irq
+///        handler of the arm9 could, and records which memory the reads were written to.
+class NeighbourWritingCard : public HostArm7Card
+{
+    std::mutex _mutex;
+    std::vector<std::pair<u8*, u32>> _destinations;
+
+public:
+    u8* bufferStart = nullptr;
+    u8* bufferEnd = nullptr;
+
+    /// @brief Fills every word of a read sector with its sector number.
+    void ReadSectors(u32 sector, u32 count, void* buffer) override
+    {
+        std::lock_guard lock(_mutex);
+        bufferStart[-1] = NEIGHBOUR_VALUE;
+        bufferEnd[0] = NEIGHBOUR_VALUE;
+        for (u32 i = 0; i < count; i++)
+        {
+            u32* words = (u32*)buffer + i * 128;
+            for (u32 j = 0; j < 128; j++)
+            {
+                words[j] = sector + i;
+            }
+        }
+        _destinations.emplace_back((u8*)buffer, 512 * count);
+    }
+
+    void WriteSectors(u32 sector, u32 count, const void* buffer) override { }
+
+    /// @brief Returns the start and length of the memory of every read in the order of the reads.
+    std::vector<std::pair<u8*, u32>> GetDestinations()
+    {
+        std::lock_guard lock(_mutex);
+        return _destinations;
+    }
+};
+
+class FsIpcReadTests : public ::testing::Test
+{
+protected:
+    NeighbourWritingCard _card;
+    u8* _mainMemory = nullptr;
+
+    void SetUp() override
+    {
+        void* mainMemory = mmap((void*)MAIN_MEMORY_ADDRESS, MAIN_MEMORY_SIZE, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+        ASSERT_EQ(mainMemory, (void*)MAIN_MEMORY_ADDRESS);
+        _mainMemory = (u8*)mainMemory;
+        hostarm7_start(&_card);
+    }
+
+    void TearDown() override
+    {
+        fs_waitForCompletion(nullptr, false);
+        if (_mainMemory)
+        {
+            munmap(_mainMemory, MAIN_MEMORY_SIZE);
+        }
+    }
+};
+
+TEST_F(FsIpcReadTests, ReadToUnalignedBufferDoesNotWriteCacheLinesSharedWithNeighbouringMemory)
+{
+    // Arrange
+    u8* buffer = _mainMemory + 0x1000 + BUFFER_LINE_OFFSET;
+    memset(_mainMemory, 0, MAIN_MEMORY_SIZE);
+    _card.bufferStart = buffer;
+    _card.bufferEnd = buffer + READ_SECTOR_COUNT * 512;
+
+    // Act
+    fs_readSectors(FS_DEVICE_DLDI, buffer, READ_SECTOR, READ_SECTOR_COUNT);
+
+    // Assert
+    EXPECT_EQ(buffer[-1], NEIGHBOUR_VALUE);
+    EXPECT_EQ(buffer[READ_SECTOR_COUNT * 512], NEIGHBOUR_VALUE);
+    for (u32 i = 0; i < READ_SECTOR_COUNT; i++)
+    {
+        u32 word;
+        memcpy(&word, buffer + 512 * i, 4);
+        EXPECT_EQ(word, (u32)(READ_SECTOR + i)) << "first word of sector " << i;
+        memcpy(&word, buffer + 512 * i + 508, 4);
+        EXPECT_EQ(word, (u32)(READ_SECTOR + i)) << "last word of sector " << i;
+    }
+    for (auto [destination, length] : _card.GetDestinations())
+    {
+        if (destination < _mainMemory || destination >= _mainMemory + MAIN_MEMORY_SIZE)
+        {
+            // bounced through a temp buffer
+            continue;
+        }
+        u8* firstLine = (u8*)((uintptr_t)destination & ~31);
+        u8* lastLineEnd = (u8*)(((uintptr_t)destination + length + 31) & ~31);
+        EXPECT_GE(firstLine, buffer) << "the arm7 wrote a cache line shared with the memory before the buffer";
+        EXPECT_LE(lastLineEnd, buffer + READ_SECTOR_COUNT * 512) << "the arm7 wrote a cache line shared with the memory after the buffer";
+    }
+}
@@ -0,0 +1,177 @@
+#include "common.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+#include "gtest/gtest.h"
+#include "Fat/FsIpc.h"
+#include "FsIpcCommand.h"
+#include "HostArm7.h"
+
+// These tests run the arm9 fs ipc against the arm7 fs ipc service on a host thread, see HostArm7.cpp.
+
+/// @brief The number of sectors of the long low priority write. The arm7 transfers it
+///        in chunks of FS_IPC_PREEMPTION_SECTOR_COUNT sectors.
+#define LONG_WRITE_SECTOR_COUNT     512
+#define LONG_WRITE_SECTOR           0x1000
+
+/// @brief How long a write waits to be released before the test is considered stuck.
+#define WRITE_RELEASE_TIMEOUT       std::chrono::seconds(2)
+
+/// @brief A card of which the writes only make progress when the test releases them,
+///        such that a write stays pending for as long as the test needs.
+class GatedCard : public HostArm7Card
+{
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    u32 _releasedWriteCount = 0;
+    bool _isOpen = false;
+    bool _hasTimedOut = false;
+    std::vector<u32> _transferredSectors;
+
+public:
+    /// @brief Fills every read sector with its sector number.
+    void ReadSectors(u32 sector, u32 count, void* buffer) override
+    {
+        std::lock_guard lock(_mutex);
+        for (u32 i = 0; i < count; i++)
+        {
+            u32* words = (u32*)buffer + i * 128;
+            for (u32 j = 0; j < 128; j++)
+            {
+                words[j] = sector + i;
+            }
+        }
+        _transferredSectors.push_back(sector);
+    }
+
+    void WriteSectors(u32 sector, u32 count, const void* buffer) override
+    {
+        std::unique_lock lock(_mutex);
+        if (!_condition.wait_for(lock, WRITE_RELEASE_TIMEOUT, [this] { return _isOpen || _releasedWriteCount != 0; }))
+        {
+            // the arm9 waits for the write to complete, let it finish to report the failure
+            _hasTimedOut = true;
+            _isOpen = true;
+        }
+        if (!_isOpen)
+        {
+            _releasedWriteCount--;
+        }
+        _transferredSectors.push_back(sector);
+    }
+
+    /// @brief Lets one more driver call of a write complete.
+    void ReleaseWrite()
+    {
+        std::lock_guard lock(_mutex);
+        _releasedWriteCount++;
+        _condition.notify_all();
+    }
+
+    /// @brief Lets all writes complete from now on.
+    void Open()
+    {
+        std::lock_guard lock(_mutex);
+        _isOpen = true;
+        _condition.notify_all();
+    }
+
+    bool HasTimedOut()
+    {
+        std::lock_guard lock(_mutex);
+        return _hasTimedOut;
+    }
+
+    /// @brief Returns the first sector of every driver call in the order of the calls.
+    std::vector<u32> GetTransferredSectors()
+    {
+        std::lock_guard lock(_mutex);
+        return _transferredSectors;
+    }
+};
+
+class FsIpcRingTests : public ::testing::Test
+{
+protected:
+    GatedCard _card;
+
+    alignas(32) static inline u8 sWriteBuffer[LONG_WRITE_SECTOR_COUNT * 512];
+    alignas(32) static inline u8 sReadBuffers[3 * FS_IPC_RING_SIZE][512];
+
+    void SetUp() override
+    {
+        hostarm7_start(&_card);
+    }
+
+    void TearDown() override
+    {
+        _card.Open();
+        fs_waitForCompletion(nullptr, false);
+        EXPECT_FALSE(_card.HasTimedOut());
+    }
+
+    void StartLongWrite(FsWaitToken* waitToken)
+    {
+        fs_writeCacheAlignedSectorsAsync(FS_DEVICE_DLDI, sWriteBuffer, LONG_WRITE_SECTOR,
+            LONG_WRITE_SECTOR_COUNT, FS_PRIORITY_LOW, waitToken);
+    }
+
+    void StartRead(u32 bufferIndex, u32 sector, FsPriority priority, FsWaitToken* waitToken)
+    {
+        fs_readCacheAlignedSectorsAsync(FS_DEVICE_DLDI, sReadBuffers[bufferIndex], sector, 1, priority, waitToken);
+    }
+};
+
+TEST_F(FsIpcRingTests, RomMissReadsDoNotWaitForALongLowPriorityWrite)
+{
+    FsWaitToken writeWaitToken;
+    StartLongWrite(&writeWaitToken);
+
+    // more misses than slots, the write keeps its slot all the time
+    for (u32 i = 0; i < 3 * FS_IPC_RING_SIZE; i++)
+    {
+        FsWaitToken readWaitToken;
+        StartRead(i, 0x100 + i, FS_PRIORITY_ROM_MISS, &readWaitToken);
+        // the arm7 checks for the miss after the next chunk of the write
+        _card.ReleaseWrite();
+        fs_waitForCompletion(&readWaitToken, false);
+
+        EXPECT_EQ(*(const u32*)sReadBuffers[i], 0x100 + i);
+        EXPECT_FALSE(fs_isTransactionComplete(&writeWaitToken)) << "miss " << i << " waited for the write";
+    }
+
+    _card.Open();
+    fs_waitForCompletion(&writeWaitToken, false);
+    EXPECT_FALSE(_card.HasTimedOut());
+}
+
+TEST_F(FsIpcRingTests, CommandsWithTheSamePriorityExecuteInSubmissionOrder)
+{
+    fs_waitForCompletion(nullptr, false);
+    FsWaitToken writeWaitToken;
+    StartLongWrite(&writeWaitToken);
+    FsWaitToken missWaitTokens[2];
+    StartRead(0, 0x100, FS_PRIORITY_ROM_MISS, &missWaitTokens[0]);
+    StartRead(1, 0x101, FS_PRIORITY_ROM_MISS, &missWaitTokens[1]);
+    FsWaitToken lowWaitTokens[3];
+    StartRead(2, 0x200, FS_PRIORITY_LOW, &lowWaitTokens[0]);
+    _card.ReleaseWrite();
+    fs_waitForCompletion(&missWaitTokens[0], false);
+    fs_waitForCompletion(&missWaitTokens[1], false);
+
+    // the freed slots of the misses are reused, so the slots are not in submission order anymore
+    StartRead(3, 0x201, FS_PRIORITY_LOW, &lowWaitTokens[1]);
+    StartRead(4, 0x202, FS_PRIORITY_LOW, &lowWaitTokens[2]);
+    EXPECT_GT(lowWaitTokens[0].slot, lowWaitTokens[1].slot);
+    EXPECT_GT(lowWaitTokens[0].slot, lowWaitTokens[2].slot);
+
+    _card.Open();
+    fs_waitForCompletion(nullptr, false);
+    std::vector<u32> sectors = _card.GetTransferredSectors();
+    ASSERT_GE(sectors.size(), 4u);
+    EXPECT_EQ(sectors[sectors.size() - 3], 0x200u);
+    EXPECT_EQ(sectors[sectors.size() - 2], 0x201u);
+    EXPECT_EQ(sectors[sectors.size() - 1], 0x202u);
+    EXPECT_EQ(sectors[sectors.size() - 4], (u32)(LONG_WRITE_SECTOR + LONG_WRITE_SECTOR_COUNT - FS_IPC_PREEMPTION_SECTOR_COUNT));
+}
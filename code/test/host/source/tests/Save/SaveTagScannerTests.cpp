@@ -0,0 +1,193 @@
+#include "common.h"
+#include <string.h>
+#include <vector>
+#include "gtest/gtest.h"
+#include "Fat/ff.h"
+#include "SdCache/CompressedRom.h"
+#include "Save/SaveTagScanner.h"
+#include "HostFsIpc.h"
+#include "HostVolume.h"
+
+#define TEST_ROM_PATH   "fat:/rom.gba"
+
+class SaveTagScannerTests : public ::testing::Test
+{
+protected:
+    HostVolume _volume;
+    FIL _romFile;
+    std::vector<u8> _tempBuffer = std::vector<u8>(SAVE_TAG_SCANNER_TEMP_BUFFER_SIZE);
+
+    void SetUp() override
+    {
+        ASSERT_TRUE(_volume.Create(host_getTempImagePath("SaveTagScannerTests")));
+        memset(&_romFile, 0, sizeof(_romFile));
+    }
+
+    void TearDown() override
+    {
+        f_close(&_romFile);
+    }
+
+    std::vector<u8> _rom;
+
+    void CreateRom(u32 romSize, const char* tag, u32 tagOffset)
+    {
+        std::vector<u8>& rom = _rom;
+        rom.assign(romSize, 0);
+        if (tag)
+        {
+            memcpy(&rom[tagOffset], tag, strlen(tag));
+        }
+        ASSERT_TRUE(_volume.WriteFile(TEST_ROM_PATH, rom.data(), rom.size()));
+        ASSERT_EQ(f_open(&_romFile, TEST_ROM_PATH, FA_OPEN_EXISTING | FA_READ), FR_OK);
+        crom_open(&_romFile);
+    }
+};
+
+TEST_F(SaveTagScannerTests, FindsTagInFirstHalfBuffer)
+{
+    // given
+    CreateRom(1024 * 1024, "SRAM_V113", 0x1234);
+
+    // when
+    u32 tagRomAddress;
+    auto saveTypeInfo = SaveTagScanner().FindSaveTag(&_romFile, nullptr, 0, _tempBuffer.data(), tagRomAddress);
+
+    // then
+    ASSERT_NE(saveTypeInfo, nullptr);
+    EXPECT_EQ(saveTypeInfo->type, SAVE_TYPE_SRAM_V113);
+    EXPECT_EQ(tagRomAddress, 0x1234u);
+}
+
+TEST_F(SaveTagScannerTests, FindsTagNearEndOfRom)
+{
+    // given
+    CreateRom(2 * 1024 * 1024, "FLASH1M_V103", 2 * 1024 * 1024 - 0x100);
+
+    // when
+    u32 tagRomAddress;
+    auto saveTypeInfo = SaveTagScanner().FindSaveTag(&_romFile, nullptr, 0, _tempBuffer.data(), tagRomAddress);
+
+    // then
+    ASSERT_NE(saveTypeInfo, nullptr);
+    EXPECT_EQ(saveTypeInfo->type, SAVE_TYPE_FLASH1M_V103);
+    EXPECT_EQ(saveTypeInfo->size, 128u * 1024);
+    EXPECT_EQ(tagRomAddress, 2u * 1024 * 1024 - 0x100);
+}
+
+TEST_F(SaveTagScannerTests, ReturnsNullWithoutTag)
+{
+    // given
+    CreateRom(1024 * 1024, nullptr, 0);
+
+    // when
+    u32 tagRomAddress;
+    auto saveTypeInfo = SaveTagScanner().FindSaveTag(&_romFile, nullptr, 0, _tempBuffer.data(), tagRomAddress);
+
+    // then
+    EXPECT_EQ(saveTypeInfo, nullptr);
+}
+
+TEST_F(SaveTagScannerTests, FindsTagInLoadedRomWithoutReadingIt)
+{
+    // given
+    CreateRom(4 * 1024 * 1024, "EEPROM_V124", 0x80000);
+    hostfs_resetStats();
+
+    // when
+    u32 tagRomAddress;
+    auto saveTypeInfo = SaveTagScanner().FindSaveTag(&_romFile, _rom.data(), 2 * 1024 * 1024, _tempBuffer.data(), tagRomAddress);
+
+    // then
+    ASSERT_NE(saveTypeInfo, nullptr);
+    EXPECT_EQ(saveTypeInfo->type, SAVE_TYPE_EEPROM_V124);
+    EXPECT_EQ(tagRomAddress, 0x80000u);
+    EXPECT_EQ(hostfs_getStats().sectorsRead, 0u);
+}
+
+TEST_F(SaveTagScannerTests, FindsTagAcrossEndOfLoadedRom)
+{
+    // given
+    CreateRom(4 * 1024 * 1024, "FLASH512_V131", 2 * 1024 * 1024 - 8);
+
+    // when
+    u32 tagRomAddress;
+    auto saveTypeInfo = SaveTagScanner().FindSaveTag(&_romFile, _rom.data(), 2 * 1024 * 1024, _tempBuffer.data(), tagRomAddress);
+
+    // then
+    ASSERT_NE(saveTypeInfo, nullptr);
+    EXPECT_EQ(saveTypeInfo->type, SAVE_TYPE_FLASH512_V131);
+    EXPECT_EQ(tagRomAddress, 2u * 1024 * 1024 - 8);
+}
+
+TEST_F(SaveTagScannerTests, FindsTagAcrossReads)
+{
+    // given
+    // the first read ends 512 bytes before the size of the temp buffer
+    const u32 tagOffset = 2 * 1024 * 1024 + SAVE_TAG_SCANNER_TEMP_BUFFER_SIZE - 512 - 4;
+    CreateRom(4 * 1024 * 1024, "SRAM_F_V102", tagOffset);
+
+    // when
+    u32 tagRomAddress;
+    auto saveTypeInfo = SaveTagScanner().FindSaveTag(&_romFile, _rom.data(), 2 * 1024 * 1024, _tempBuffer.data(), tagRomAddress);
+
+    // then
+    ASSERT_NE(saveTypeInfo, nullptr);
+    EXPECT_EQ(saveTypeInfo->type, SAVE_TYPE_SRAM_F_V102);
+    EXPECT_EQ(tagRomAddress, tagOffset);
+}
+
+TEST_F(SaveTagScannerTests, SkipsIncompleteTag)
+{
+    // given
+    CreateRom(1024 * 1024, "SRAM_V112", 0x4000);
+    memcpy(&_rom[0x1000], "SRAM_X", 6);
+    memcpy(&_rom[0x2000], "EEPROM_V1", 9);
+
+    // when
+    u32 tagRomAddress;
+    auto saveTypeInfo = SaveTagScanner().FindSaveTag(&_romFile, _rom.data(), _rom.size(), _tempBuffer.data(), tagRomAddress);
+
+    // then
+    ASSERT_NE(saveTypeInfo, nullptr);
+    EXPECT_EQ(saveTypeInfo->type, SAVE_TYPE_SRAM_V112);
+    EXPECT_EQ(tagRomAddress, 0x4000u);
+}
+
+TEST_F(SaveTagScannerTests, ConfirmsTagAtDetectedAddress)
+{
+    // given
+    const u32 tagOffset = 3 * 1024 * 1024 + 0x100;
+    CreateRom(4 * 1024 * 1024, "FLASH_V126", tagOffset);
+    u32 tagRomAddress;
+    auto saveTypeInfo = SaveTagScanner().FindSaveTag(&_romFile, _rom.data(), 2 * 1024 * 1024, _tempBuffer.data(), tagRomAddress);
+    ASSERT_NE(saveTypeInfo, nullptr);
+
+    // when
+    bool isInFile = SaveTagScanner::IsSaveTagAt(&_romFile, _rom.data(), 2 * 1024 * 1024, saveTypeInfo, tagRomAddress);
+    bool isInLoadedRom = SaveTagScanner::IsSaveTagAt(&_romFile, _rom.data(), _rom.size(), saveTypeInfo, tagRomAddress);
+
+    // then
+    EXPECT_TRUE(isInFile);
+    EXPECT_TRUE(isInLoadedRom);
+}
+
+TEST_F(SaveTagScannerTests, RejectsTagThatIsNotAtCachedAddress)
+{
+    // given
+    CreateRom(1024 * 1024, "FLASH_V123", 0x1000);
+    u32 tagRomAddress;
+    auto saveTypeInfo = SaveTagScanner().FindSaveTag(&_romFile, nullptr, 0, _tempBuffer.data(), tagRomAddress);
+    ASSERT_NE(saveTypeInfo, nullptr);
+    f_close(&_romFile);
+    // a different rom with the same header and size, of which the tag has a different version and moved
+    CreateRom(1024 * 1024, "FLASH_V126", 0x1000);
+
+    // when
+    bool isAtCachedAddress = SaveTagScanner::IsSaveTagAt(&_romFile, nullptr, 0, saveTypeInfo, tagRomAddress);
+    bool isInLoadedRomAtCachedAddress = SaveTagScanner::IsSaveTagAt(&_romFile, _rom.data(), _rom.size(), saveTypeInfo, tagRomAddress);
+
+    // then
+    EXPECT_FALSE(isAtCachedAddress);
+    EXPECT_FALSE(isInLoadedRomAtCachedAddress);
+}
@@ -0,0 +1,315 @@
+#include "common.h"
+#include <string.h>
+#include <vector>
+#include "gtest/gtest.h"
+#include "Fat/ff.h"
+#include "Save/Save.h"
+#include "HostFsIpc.h"
+#include "HostStubs.h"
+#include "HostVolume.h"
+
+#define TEST_SAVE_PATH  "fat:/game.sav"
+
+class SaveTests : public ::testing::Test
+{
+protected:
+    HostVolume _volume;
+
+    void SetUp() override
+    {
+        ASSERT_TRUE(_volume.Create(host_getTempImagePath("SaveTests")));
+    }
+
+    void TearDown() override
+    {
+        f_close(&gSaveFile);
+    }
+
+    void Remount()
+    {
+        f_close(&gSaveFile);
+        _volume.Unmount();
+        ASSERT_TRUE(_volume.Open(host_getTempImagePath("SaveTests")));
+    }
+
+    /// @brief Simulates a power loss, in which the sectors that were not yet written are lost.
+    void PowerCycle()
+    {
+        _volume.Unmount();
+        _volume.GetDisk().ClearWriteLimit();
+        ASSERT_TRUE(_volume.Open(host_getTempImagePath("SaveTests")));
+    }
+};
+
+TEST_F(SaveTests, NewSaveFileIsFilled)
+{
+    // when
+    sav_initializeSave(nullptr, TEST_SAVE_PATH);
+    Remount();
+
+    // then
+    std::vector<u8> save;
+    ASSERT_TRUE(_volume.ReadFile(TEST_SAVE_PATH, save));
+    EXPECT_EQ(save, std::vector<u8>(32 * 1024, SAVE_DATA_FILL));
+}
+
+TEST_F(SaveTests, ShortSaveFileIsExtendedAndLoaded)
+{
+    // given
+    std::vector<u8> initialSave(1000);
+    for (u32 i = 0; i < initialSave.size(); i++)
+    {
+        initialSave[i] = i;
+    }
+    ASSERT_TRUE(_volume.WriteFile(TEST_SAVE_PATH, initialSave.data(), initialSave.size()));
+
+    // when
+    sav_initializeSave(nullptr, TEST_SAVE_PATH);
+
+    // then
+    EXPECT_EQ(memcmp(gSaveData, initialSave.data(), initialSave.size()), 0);
+    EXPECT_EQ(gSaveData[initialSave.size()], SAVE_DATA_FILL);
+    EXPECT_EQ(f_size(&gSaveFile), 32u * 1024);
+}
+
+TEST_F(SaveTests, WrittenSaveSurvivesRemount)
+{
+    // given
+    sav_initializeSave(nullptr, TEST_SAVE_PATH);
+    for (u32 i = 0; i < gGbaSaveShared.saveDataSize; i++)
+    {
+        host_storeSram8(i, i * 13);
+    }
+
+    // when
+    host_runSaveWriteBack();
+    Remount();
+
+    // then
+    std::vector<u8> save;
+    ASSERT_TRUE(_volume.ReadFile(TEST_SAVE_PATH, save));
+    ASSERT_EQ(save.size(), 32u * 1024);
+    EXPECT_EQ(memcmp(save.data(), gSaveData, save.size()), 0);
+}
+
+TEST_F(SaveTests, SramWriteBackWritesDirtySectorsWithoutWaiting)
+{
+    // given
+    const u32 skipSaveCheckInstruction = 0xEA000000; // b emu_vblankIrqReturn
+    emu_vblankIrqSkipSaveCheckInstruction = skipSaveCheckInstruction;
+    sav_initializeSave(nullptr, TEST_SAVE_PATH);
+    hostfs_resetStats();
+
+    // when
+    host_storeSram8(0x10, 0x12);
+    host_storeSram8(0x4321, 0x34);
+    gGbaSaveShared.saveState = GBA_SAVE_STATE_WRITE;
+    sav_updateWriteBack();
+
+    // then
+    // the vblank irq only submits the write-back
+    EXPECT_TRUE(gGbaSaveShared.isWriteBackActive);
+    EXPECT_EQ(gGbaSaveShared.saveState, GBA_SAVE_STATE_CLEAN);
+    EXPECT_EQ(hostfs_getStats().waitTimeUs, 0);
+    // the sectors are written to the journal and in place, and the journal header commits them
+    EXPECT_EQ(hostfs_getStats().sectorsWritten, 2 * 2u + 1u);
+
+    // when
+    // the game keeps writing during the write-back
+    host_storeSram8(0x10, 0x56);
+    while (gGbaSaveShared.isWriteBackActive)
+    {
+        hostfs_advanceTime(1000);
+        sav_updateWriteBack();
+    }
+
+    // then
+    // the new write is not lost, the save check stays enabled for it
+    EXPECT_EQ(gGbaSaveShared.saveState, GBA_SAVE_STATE_DIRTY);
+    EXPECT_NE(emu_vblankIrqSkipSaveCheckInstruction, skipSaveCheckInstruction);
+    host_runSaveWriteBack();
+    EXPECT_EQ(gGbaSaveShared.saveState, GBA_SAVE_STATE_CLEAN);
+    EXPECT_EQ(emu_vblankIrqSkipSaveCheckInstruction, skipSaveCheckInstruction);
+    EXPECT_EQ(hostfs_getStats().waitTimeUs, 0);
+    Remount();
+    std::vector<u8> save;
+    ASSERT_TRUE(_volume.ReadFile(TEST_SAVE_PATH, save));
+    EXPECT_EQ(save[0x10], 0x56);
+    EXPECT_EQ(save[0x4321], 0x34);
+}
+
+TEST_F(SaveTests, FlushedSaveBytesSurviveRemount)
+{
+    // given
+    sav_initializeSave(nullptr, TEST_SAVE_PATH);
+
+    // when
+    sav_fill(0x10, 0x12, 1);
+    sav_fill(0x7FFF, 0x34, 1);
+    sav_flushSaveFile();
+    Remount();
+
+    // then
+    std::vector<u8> save;
+    ASSERT_TRUE(_volume.ReadFile(TEST_SAVE_PATH, save));
+    EXPECT_EQ(save[0x10], 0x12);
+    EXPECT_EQ(save[0x7FFF], 0x34);
+}
+
+TEST_F(SaveTests, FlushWritesOnlyDirtySectorsOfFlashSave)
+{
+    // given
+    const SaveTypeInfo saveTypeInfo = { "FLASH1M_V103", 12, SAVE_TYPE_FLASH1M_V103, 128 * 1024, nullptr };
+    sav_initializeSave(&saveTypeInfo, TEST_SAVE_PATH);
+    hostfs_resetStats();
+
+    // when
+    // erasing a flash sector, followed by a byte in another sector
+    std::vector<u8> sector(4096);
+    for (u32 i = 0; i < sector.size(); i++)
+    {
+        sector[i] = i;
+    }
+    sav_write(0x1F000, sector.data(), sector.size());
+    sav_fill(0x100, 0x56, 1);
+    sav_fill(0x200, SAVE_DATA_FILL, 1);
+    sav_flushSaveFile();
+
+    // then
+    // the sectors are written to the journal and in place, and the journal header commits them
+    EXPECT_EQ(hostfs_getStats().sectorsWritten, 2 * (8u + 1u) + 1u);
+    u8 readByte;
+    sav_read(0x1F001, &readByte, 1);
+    EXPECT_EQ(readByte, 1);
+    Remount();
+    std::vector<u8> save;
+    ASSERT_TRUE(_volume.ReadFile(TEST_SAVE_PATH, save));
+    ASSERT_EQ(save.size(), 128u * 1024);
+    EXPECT_EQ(save[0x100], 0x56);
+    EXPECT_EQ(save[0x1F000 + 0x123], 0x23);
+    EXPECT_EQ(save[0x1FFFF], 0xFF);
+    EXPECT_EQ(save[0x1F000], 0);
+}
+
+TEST_F(SaveTests, SpanWriteMarksOnlyChangedSectorsDirty)
+{
+    // given
+    const u32 skipSaveCheckInstruction = 0xEA000000; // b emu_vblankIrqReturn
+    emu_vblankIrqSkipSaveCheckInstruction = skipSaveCheckInstruction;
+    const SaveTypeInfo saveTypeInfo = { "FLASH1M_V103", 12, SAVE_TYPE_FLASH1M_V103, 128 * 1024, nullptr };
+    sav_initializeSave(&saveTypeInfo, TEST_SAVE_PATH);
+    std::vector<u8> sectors(4096, SAVE_DATA_FILL);
+    sectors[0x345] = 0x12;
+    hostfs_resetStats();
+
+    // when
+    // erasing an erased flash sector, followed by programming a sector in which one byte changes
+    sav_fill(0x1F000, SAVE_DATA_FILL, 4096);
+    u8 eraseSaveState = gGbaSaveShared.saveState;
+    sav_write(0x3000, sectors.data(), sectors.size());
+    u8 programSaveState = gGbaSaveShared.saveState;
+    u32 programSkipSaveCheckInstruction = emu_vblankIrqSkipSaveCheckInstruction;
+    u64 programSectorsWritten = hostfs_getStats().sectorsWritten;
+    host_runSaveWriteBack();
+
+    // then
+    // the flash writes are only written to the save file by the write-back that the arm7 schedules
+    EXPECT_EQ(eraseSaveState, GBA_SAVE_STATE_CLEAN);
+    EXPECT_EQ(programSaveState, GBA_SAVE_STATE_DIRTY);
+    EXPECT_EQ(programSkipSaveCheckInstruction, 0u);
+    EXPECT_EQ(programSectorsWritten, 0u);
+    EXPECT_EQ(hostfs_getStats().sectorsWritten, 2 * 1u + 1u);
+    EXPECT_EQ(emu_vblankIrqSkipSaveCheckInstruction, skipSaveCheckInstruction);
+    Remount();
+    std::vector<u8> save;
+    ASSERT_TRUE(_volume.ReadFile(TEST_SAVE_PATH, save));
+    EXPECT_EQ(save[0x3345], 0x12);
+}
+
+TEST_F(SaveTests, SpanReadAndCompareUseTheMirror)
+{
+    // given
+    const u8 data[] = { 1, 2, 3, 4 };
+    const u8 expected[] = { 1, 2, 7, 4 };
+    sav_initializeSave(nullptr, TEST_SAVE_PATH);
+    sav_write(0x7FFE, data, sizeof(data));
+
+    // when
+    u8 readData[4];
+    sav_read(0x7FFE, readData, sizeof(readData));
+    u32 equalResult = sav_compare(0x7FFE, data, 2);
+    u32 differentResult = sav_compare(0x7FFE, expected, sizeof(expected));
+
+    // then
+    // the bytes beyond the 32 kB sram save are not stored and read as SAVE_DATA_FILL
+    EXPECT_EQ(readData[0], 1);
+    EXPECT_EQ(readData[1], 2);
+    EXPECT_EQ(readData[2], SAVE_DATA_FILL);
+    EXPECT_EQ(readData[3], SAVE_DATA_FILL);
+    EXPECT_EQ(equalResult, 2u);
+    EXPECT_EQ(differentResult, 2u);
+}
+
+TEST_F(SaveTests, PowerLossDuringFlushLeavesOldOrNewSave)
+{
+    // given
+    const u32 saveSize = 128 * 1024;
+    const u32 dirtySectors[] = { 0, 1, 2, 40, 41, 255 };
+    const SaveTypeInfo saveTypeInfo = { "FLASH1M_V103", 12, SAVE_TYPE_FLASH1M_V103, saveSize, nullptr };
+    sav_initializeSave(&saveTypeInfo, TEST_SAVE_PATH);
+    std::vector<u8> committedSave(gSaveData, gSaveData + saveSize);
+
+    // when
+    // a power loss after every possible number of written sectors, until the flush completes
+    for (u32 writeLimit = 0;; writeLimit++)
+    {
+        std::vector<u8> newSave = committedSave;
+        for (u32 sector : dirtySectors)
+        {
+            for (u32 i = 0; i < 512; i++)
+            {
+                newSave[sector * 512 + i] = writeLimit * 31 + i;
+            }
+            sav_write(sector * 512, &newSave[sector * 512], 512);
+        }
+        _volume.GetDisk().SetWriteLimit(writeLimit);
+        sav_flushSaveFile();
+        bool isInterrupted = _volume.GetDisk().IsWriteLimitReached();
+        PowerCycle();
+        sav_initializeSave(&saveTypeInfo, TEST_SAVE_PATH);
+
+        // then
+        std::vector<u8> loadedSave(gSaveData, gSaveData + saveSize);
+        ASSERT_TRUE(loadedSave == committedSave || loadedSave == newSave)
+            << "torn save after a power loss after " << writeLimit << " sectors";
+        if (!isInterrupted)
+        {
+            ASSERT_EQ(loadedSave, newSave);
+            break;
+        }
+        committedSave = loadedSave;
+    }
+
+    // the save file itself is complete after the recovery
+    Remount();
+    std::vector<u8> save;
+    ASSERT_TRUE(_volume.ReadFile(TEST_SAVE_PATH, save));
+    EXPECT_EQ(save, std::vector<u8>(gSaveData, gSaveData + saveSize));
+}
+
+TEST_F(SaveTests, ReplacedSaveFileIsNotOverwrittenByJournal)
+{
+    // given
+    sav_initializeSave(nullptr, TEST_SAVE_PATH);
+    sav_fill(0x10, 0x12, 1);
+    sav_flushSaveFile();
+    Remount();
+    std::vector<u8> otherSave(32 * 1024, 0x5A);
+    ASSERT_TRUE(_volume.WriteFile(TEST_SAVE_PATH, otherSave.data(), otherSave.size()));
+
+    // when
+    sav_initializeSave(nullptr, TEST_SAVE_PATH);
+
+    // then
+    EXPECT_EQ(memcmp(gSaveData, otherSave.data(), otherSave.size()), 0);
+}
@@ -0,0 +1,206 @@
+#include "common.h"
+#include <string.h>
+#include <vector>
+#include "gtest/gtest.h"
+#include "Fat/ff.h"
+#include "SdCache/SdCache.h"
+#include "SdCache/CompressedRom.h"
+#include "HostFsIpc.h"
+#include "HostVolume.h"
+
+#define TEST_ROM_PATH       "fat:/rom.gba"
+#define TEST_FILLER_PATH    "fat:/filler.bin"
+#define TEST_ROM_SIZE       (4 * 1024 * 1024)
+
+extern FIL gFile;
+
+class SdCacheTests : public ::testing::Test
+{
+protected:
+    HostVolume _volume;
+
+    void SetUp() override
+    {
+        ASSERT_TRUE(_volume.Create(host_getTempImagePath("SdCacheTests")));
+        hostfs_resetStats();
+    }
+
+    void TearDown() override
+    {
+        f_close(&gFile);
+    }
+
+    /// @brief Creates a rom where each word holds its offset in the rom. When fragmentChunkSize is
+    ///        non-zero, the rom is written in chunks of that size, interleaved with another file.
+    void CreateRom(u32 fragmentChunkSize)
+    {
+        std::vector<u32> rom(TEST_ROM_SIZE / 4);
+        for (u32 i = 0; i < rom.size(); i++)
+        {
+            rom[i] = i * 4;
+        }
+
+        u32 chunkSize = fragmentChunkSize ? fragmentChunkSize : TEST_ROM_SIZE;
+        FIL romFile;
+        FIL fillerFile;
+        ASSERT_EQ(f_open(&romFile, TEST_ROM_PATH, FA_CREATE_ALWAYS | FA_WRITE), FR_OK);
+        ASSERT_EQ(f_open(&fillerFile, TEST_FILLER_PATH, FA_CREATE_ALWAYS | FA_WRITE), FR_OK);
+        for (u32 offset = 0; offset < TEST_ROM_SIZE; offset += chunkSize)
+        {
+            UINT bytesWritten = 0;
+            ASSERT_EQ(f_write(&romFile, (const u8*)rom.data() + offset, chunkSize, &bytesWritten), FR_OK);
+            ASSERT_EQ(f_sync(&romFile), FR_OK);
+            if (fragmentChunkSize)
+            {
+                ASSERT_EQ(f_write(&fillerFile, rom.data(), chunkSize, &bytesWritten), FR_OK);
+                ASSERT_EQ(f_sync(&fillerFile), FR_OK);
+            }
+        }
+        ASSERT_EQ(f_close(&fillerFile), FR_OK);
+        ASSERT_EQ(f_close(&romFile), FR_OK);
+    }
+
+    void OpenRom()
+    {
+        memset(&gFile, 0, sizeof(gFile));
+        ASSERT_EQ(f_open(&gFile, TEST_ROM_PATH, FA_OPEN_EXISTING | FA_READ), FR_OK);
+        crom_open(&gFile);
+        sdc_init(nullptr, 0);
+        hostfs_resetStats();
+    }
+
+    static void ExpectBlockContents(u32 romBlock)
+    {
+        const u32* block = (const u32*)sdc_getRomBlock(0x08000000 + (romBlock << SDC_BLOCK_SHIFT));
+        ASSERT_NE(block, nullptr);
+        EXPECT_EQ(block[0], romBlock << SDC_BLOCK_SHIFT);
+        EXPECT_EQ(block[SDC_BLOCK_SIZE / 4 - 1], (romBlock << SDC_BLOCK_SHIFT) + SDC_BLOCK_SIZE - 4);
+    }
+};
+
+TEST_F(SdCacheTests, LoadsEveryBlockOfContiguousRom)
+{
+    // given
+    CreateRom(0);
+    OpenRom();
+
+    // when, then
+    for (u32 romBlock = 0; romBlock < TEST_ROM_SIZE / SDC_BLOCK_SIZE; romBlock++)
+    {
+        ExpectBlockContents(romBlock);
+    }
+}
+
+TEST_F(SdCacheTests, LoadsEveryBlockOfFragmentedRom)
+{
+    // given
+    CreateRom(64 * 1024);
+    OpenRom();
+
+    // when, then
+    for (u32 romBlock = 0; romBlock < TEST_ROM_SIZE / SDC_BLOCK_SIZE; romBlock++)
+    {
+        ExpectBlockContents(romBlock);
+    }
+}
+
+TEST_F(SdCacheTests, LoadsBlocksInRandomOrderAfterEvictions)
+{
+    // given
+    CreateRom(64 * 1024);
+    OpenRom();
+    u32 randomState = 0x1234567;
+
+    // when, then
+    for (u32 i = 0; i < 4096; i++)
+    {
+        randomState = randomState * 1566083941u + 2531011u;
+        ExpectBlockContents((randomState >> 8) % (TEST_ROM_SIZE / SDC_BLOCK_SIZE));
+    }
+}
+
+TEST_F(SdCacheTests, ReadAheadReducesWaitTimeForSequentialMisses)
+{
+    // given
+    // the emulation between the accesses leaves the sd card idle for longer than a block read takes
+    CreateRom(0);
+    OpenRom();
+    const u32 blockCount = 256;
+    for (u32 romBlock = 0; romBlock < blockCount; romBlock++)
+    {
+        ExpectBlockContents(romBlock);
+        hostfs_advanceTime(5000);
+    }
+    double waitTimeWithoutReadAhead = hostfs_getStats().waitTimeUs;
+
+    // when
+    OpenRom();
+    sdc_setReadAheadDepth(2);
+    for (u32 romBlock = 0; romBlock < blockCount; romBlock++)
+    {
+        ExpectBlockContents(romBlock);
+        hostfs_advanceTime(5000);
+    }
+
+    // then
+    EXPECT_LT(hostfs_getStats().waitTimeUs, waitTimeWithoutReadAhead / 2);
+}
+
+TEST_F(SdCacheTests, ReadAheadDoesNotReplacePinnedBlocks)
+{
+    // given
+    // every cache block holds a pinned rom block
+    CreateRom(0);
+    OpenRom();
+    const u32 cacheBlockCount = sdc_getCacheBlockCount();
+    for (u32 romBlock = 0; romBlock < cacheBlockCount; romBlock++)
+    {
+        ExpectBlockContents(romBlock);
+        sdc_romBlockPinCount[romBlock] = 1;
+    }
+    sdc_setReadAheadDepth(2);
+    u32 issuedCount = gSdcReadAheadStats.issuedCount;
+
+    // when
+    // a sequential miss, which has to replace a pinned block itself
+    ExpectBlockContents(cacheBlockCount);
+
+    // then
+    EXPECT_EQ(gSdcReadAheadStats.issuedCount, issuedCount);
+    for (u32 romBlock = 0; romBlock < cacheBlockCount; romBlock++)
+    {
+        sdc_romBlockPinCount[romBlock] = 0;
+    }
+}
+
+TEST_F(SdCacheTests, MissDoesNotWaitForLowPriorityWrite)
+{
+    // given
+    // a large write to the start of the rom file, with the data it already holds
+    const u32 writeSectorCount = 256;
+    CreateRom(0);
+    OpenRom();
+    static u32 writeBuffer[writeSectorCount * 512 / 4] alignas(32);
+    for (u32 i = 0; i < writeSectorCount * 512 / 4; i++)
+    {
+        writeBuffer[i] = i * 4;
+    }
+    u32 romSector = gFile.obj.fs->database + (gFile.obj.sclust - 2) * gFile.obj.fs->csize;
+    FsWaitToken writeWaitToken;
+    fs_writeCacheAlignedSectorsAsync(FS_DEVICE_DLDI, writeBuffer, romSector,
+        writeSectorCount, FS_PRIORITY_ROM_MISS, &writeWaitToken);
+    ExpectBlockContents(512);
+    fs_waitForCompletion(&writeWaitToken, false);
+    double fifoWaitTime = hostfs_getStats().waitTimeUs;
+
+    // when
+    OpenRom();
+    fs_writeCacheAlignedSectorsAsync(FS_DEVICE_DLDI, writeBuffer, romSector,
+        writeSectorCount, FS_PRIORITY_LOW, &writeWaitToken);
+    ExpectBlockContents(512);
+    double missWaitTime = hostfs_getStats().waitTimeUs;
+    fs_waitForCompletion(&writeWaitToken, false);
+
+    // then
+    EXPECT_LT(missWaitTime, fifoWaitTime / 4);
+}
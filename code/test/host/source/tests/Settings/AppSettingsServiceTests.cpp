@@ -0,0 +1,56 @@
+#include "common.h"
+#include <string.h>
+#include "gtest/gtest.h"
+#include "Application/Settings/AppSettingsService.h"
+#include "HostVolume.h"
+
+#define TEST_SETTINGS_PATH  "fat:/settings.json"
+
+class AppSettingsServiceTests : public ::testing::Test
+{
+protected:
+    HostVolume _volume;
+
+    void SetUp() override
+    {
+        ASSERT_TRUE(_volume.Create(host_getTempImagePath("AppSettingsServiceTests")));
+    }
+};
+
+TEST_F(AppSettingsServiceTests, LoadsSettingsFromFile)
+{
+    // given
+    const char* json =
+        "{\"displaySettings\": {\"gbaScreen\": \"bottom\", \"gbaScreenBrightness\": 8},"
+        " \"runSettings\": {\"sdCacheReplacementPolicy\": \"slru\", \"sdCacheReadAheadDepth\": 4,"
+        " \"jitPatchAddresses\": [\"0x080000C0\"]}}";
+    ASSERT_TRUE(_volume.WriteFile(TEST_SETTINGS_PATH, json, strlen(json)));
+    JsonAppSettingsSerializer serializer;
+    AppSettingsService appSettingsService(&serializer);
+
+    // when
+    bool result = appSettingsService.TryLoadAppSettings(TEST_SETTINGS_PATH);
+
+    // then
+    ASSERT_TRUE(result);
+    const auto& appSettings = appSettingsService.GetAppSettings();
+    EXPECT_EQ(appSettings.displaySettings.gbaScreen, GbaScreen::Bottom);
+    EXPECT_EQ(appSettings.displaySettings.gbaScreenBrightness, 8);
+    EXPECT_EQ(appSettings.runSettings.sdCacheReplacementPolicy, SdCacheReplacementPolicy::SegmentedLru);
+    EXPECT_EQ(appSettings.runSettings.sdCacheReadAheadDepth, 4);
+    ASSERT_EQ(appSettings.runSettings.jitPatchAddressCount, 1u);
+    EXPECT_EQ(appSettings.runSettings.jitPatchAddresses[0], 0x080000C0u);
+}
+
+TEST_F(AppSettingsServiceTests, FailsWithoutFile)
+{
+    // given
+    JsonAppSettingsSerializer serializer;
+    AppSettingsService appSettingsService(&serializer);
+
+    // when
+    bool result = appSettingsService.TryLoadAppSettings(TEST_SETTINGS_PATH);
+
+    // then
+    EXPECT_FALSE(result);
+}
@@ -0,0 +1,17 @@
+#pragma once
+// Minimal stand-in for the libnds types, such that arm9 sources without
+// hardware dependencies, like the LZ4 decoder, can be built for the host.
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef volatile u8 vu8;
+typedef volatile u16 vu16;
+typedef volatile u32 vu32;
+
+#define ITCM_CODE
@@ -0,0 +1,145 @@
+#include <cstring>
+#include "Lz4Encoder.h"
+
+#define LZ4_MIN_MATCH       4
+#define LZ4_LAST_LITERALS   5   // the last 5 bytes are always literals
+#define LZ4_MF_LIMIT        12  // the last match must start at least 12 bytes before the end
+#define LZ4_MAX_OFFSET      0xFFFF
+#define LZ4_HASH_BITS       12
+
+namespace
+{
+    /// @brief Writes LZ4 output while checking the capacity of the destination.
+    class Lz4Writer
+    {
+        uint8_t* _dst;
+        uint32_t _capacity;
+        uint32_t _length = 0;
+        bool _overflow = false;
+
+    public:
+        Lz4Writer(uint8_t* dst, uint32_t capacity)
+            : _dst(dst), _capacity(capacity) { }
+
+        void WriteByte(uint8_t value)
+        {
+            if (_length >= _capacity)
+            {
+                _overflow = true;
+                return;
+            }
+            _dst[_length++] = value;
+        }
+
+        void WriteBytes(const uint8_t* src, uint32_t length)
+        {
+            if (length > _capacity - _length)
+            {
+                _overflow = true;
+                _length = _capacity;
+                return;
+            }
+            memcpy(_dst + _length, src, length);
+            _length += length;
+        }
+
+        void WriteLengthExtension(uint32_t length)
+        {
+            while (length >= 255)
+            {
+                WriteByte(255);
+                length -= 255;
+            }
+            WriteByte(length);
+        }
+
+        uint32_t GetLength() const { return _overflow ? 0 : _length; }
+    };
+}
+
+static uint32_t read32(const uint8_t* src)
+{
+    uint32_t value;
+    memcpy(&value, src, sizeof(value));
+    return value;
+}
+
+static uint32_t hash(uint32_t sequence)
+{
+    return (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+static void writeSequence(Lz4Writer& writer, const uint8_t* literals, uint32_t literalLength,
+    uint32_t offset, uint32_t matchLength)
+{
+    uint32_t literalToken = literalLength >= 15 ? 15 : literalLength;
+    uint32_t matchToken = 0;
+    if (offset != 0)
+    {
+        matchToken = matchLength - LZ4_MIN_MATCH >= 15 ? 15 : matchLength - LZ4_MIN_MATCH;
+    }
+    writer.WriteByte((literalToken << 4) | matchToken);
+    if (literalToken == 15)
+    {
+        writer.WriteLengthExtension(literalLength - 15);
+    }
+    writer.WriteBytes(literals, literalLength);
+    if (offset == 0)
+    {
+        // last sequence
+        return;
+    }
+    writer.WriteByte(offset & 0xFF);
+    writer.WriteByte(offset >> 8);
+    if (matchToken == 15)
+    {
+        writer.WriteLengthExtension(matchLength - LZ4_MIN_MATCH - 15);
+    }
+}
+
+uint32_t lz4_compressBlock(const uint8_t* src, uint32_t srcLength, uint8_t* dst, uint32_t dstCapacity)
+{
+    Lz4Writer writer(dst, dstCapacity);
+    // static to keep it off the small stack when running on the DS
+    static int32_t hashTable[1 << LZ4_HASH_BITS];
+    for (auto& entry : hashTable)
+    {
+        entry = -1;
+    }
+
+    uint32_t anchor = 0;
+    uint32_t position = 0;
+    while (position + LZ4_MF_LIMIT < srcLength)
+    {
+        uint32_t sequence = read32(src + position);
+        uint32_t hashValue = hash(sequence);
+        int32_t candidate = hashTable[hashValue];
+        hashTable[hashValue] = position;
+        if (candidate < 0 || position - candidate > LZ4_MAX_OFFSET || read32(src + candidate) != sequence)
+        {
+            position++;
+            continue;
+        }
+
+        uint32_t matchStart = candidate;
+        while (position > anchor && matchStart > 0 && src[position - 1] == src[matchStart - 1])
+        {
+            position--;
+            matchStart--;
+        }
+
+        uint32_t matchLength = LZ4_MIN_MATCH;
+        while (position + matchLength < srcLength - LZ4_LAST_LITERALS &&
+            src[position + matchLength] == src[matchStart + matchLength])
+        {
+            matchLength++;
+        }
+
+        writeSequence(writer, src + anchor, position - anchor, position - matchStart, matchLength);
+        position += matchLength;
+        anchor = position;
+    }
+
+    writeSequence(writer, src + anchor, srcLength - anchor, 0, 0);
+    return writer.GetLength();
+}
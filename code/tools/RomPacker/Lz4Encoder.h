@@ -0,0 +1,10 @@
+#pragma once
+#include <cstdint>
+
+/// @brief Compresses data into a raw LZ4 block (without frame header) using greedy matching.
+/// @param src The data to compress. At most 64 kB.
+/// @param srcLength The length of the data in bytes.
+/// @param dst The destination buffer.
+/// @param dstCapacity The size of the destination buffer in bytes.
+/// @return The compressed length in bytes, or 0 if the compressed data does not fit in dstCapacity.
+uint32_t lz4_compressBlock(const uint8_t* src, uint32_t srcLength, uint8_t* dst, uint32_t dstCapacity);
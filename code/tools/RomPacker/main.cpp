@@ -0,0 +1,159 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+
+#define CROM_HOST_TOOL
+#include "SdCache/CompressedRom.h"
+#include "Lz4Encoder.h"
+
+extern "C" bool lz4_decompressBlock(const u8* src, u32 srcLength, u8* dst, u32 dstLength);
+
+/// @brief The sd read bandwidth of a typical slot-1 flashcard, used for the speed estimate.
+#define ESTIMATE_SD_BANDWIDTH_KB_PER_SECOND   2048
+
+static bool tryLoadFile(const char* path, std::vector<u8>& data)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+    {
+        fprintf(stderr, "Could not open %s\n", path);
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    data.resize(size);
+    bool result = size > 0 && fread(data.data(), 1, size, file) == (size_t)size;
+    fclose(file);
+    if (!result)
+    {
+        fprintf(stderr, "Could not read %s\n", path);
+    }
+    return result;
+}
+
+/// @brief Compresses the rom into a container with independently compressed blocks.
+static std::vector<u8> packRom(const std::vector<u8>& rom)
+{
+    CompressedRomHeader header;
+    header.magic = CROM_MAGIC;
+    header.version = CROM_VERSION;
+    header.blockShift = SDC_BLOCK_SHIFT;
+    header.romSize = rom.size();
+    header.blockCount = (rom.size() + SDC_BLOCK_SIZE - 1) >> SDC_BLOCK_SHIFT;
+
+    std::vector<u32> blockOffsets(header.blockCount + 1);
+    std::vector<u8> payloads;
+    u32 payloadStart = sizeof(CompressedRomHeader) + blockOffsets.size() * sizeof(u32);
+    for (u32 i = 0; i < header.blockCount; i++)
+    {
+        u8 block[SDC_BLOCK_SIZE];
+        u32 blockLength = std::min<u32>(SDC_BLOCK_SIZE, rom.size() - i * SDC_BLOCK_SIZE);
+        memset(block, 0xFF, sizeof(block));
+        memcpy(block, &rom[i * SDC_BLOCK_SIZE], blockLength);
+
+        // a payload of exactly SDC_BLOCK_SIZE bytes marks an uncompressed block
+        u8 compressed[SDC_BLOCK_SIZE];
+        u32 compressedLength = lz4_compressBlock(block, SDC_BLOCK_SIZE, compressed, SDC_BLOCK_SIZE - 1);
+        blockOffsets[i] = payloadStart + payloads.size();
+        if (compressedLength == 0)
+        {
+            payloads.insert(payloads.end(), block, block + SDC_BLOCK_SIZE);
+        }
+        else
+        {
+            payloads.insert(payloads.end(), compressed, compressed + compressedLength);
+        }
+    }
+    blockOffsets[header.blockCount] = payloadStart + payloads.size();
+
+    std::vector<u8> container(payloadStart);
+    memcpy(container.data(), &header, sizeof(header));
+    memcpy(container.data() + sizeof(header), blockOffsets.data(), blockOffsets.size() * sizeof(u32));
+    container.insert(container.end(), payloads.begin(), payloads.end());
+    return container;
+}
+
+/// @brief Decodes every block of the container with the decoder used on the DS and compares it to the rom.
+static bool verifyContainer(const std::vector<u8>& container, const std::vector<u8>& rom)
+{
+    const auto* header = reinterpret_cast<const CompressedRomHeader*>(container.data());
+    const auto* blockOffsets = reinterpret_cast<const u32*>(container.data() + sizeof(CompressedRomHeader));
+    for (u32 i = 0; i < header->blockCount; i++)
+    {
+        u8 block[SDC_BLOCK_SIZE];
+        const u8* payload = &container[blockOffsets[i]];
+        u32 payloadLength = blockOffsets[i + 1] - blockOffsets[i];
+        if (payloadLength == SDC_BLOCK_SIZE)
+        {
+            memcpy(block, payload, SDC_BLOCK_SIZE);
+        }
+        else if (!lz4_decompressBlock(payload, payloadLength, block, SDC_BLOCK_SIZE))
+        {
+            fprintf(stderr, "Block %u could not be decoded\n", i);
+            return false;
+        }
+
+        u32 blockLength = std::min<u32>(SDC_BLOCK_SIZE, rom.size() - i * SDC_BLOCK_SIZE);
+        if (memcmp(block, &rom[i * SDC_BLOCK_SIZE], blockLength) != 0)
+        {
+            fprintf(stderr, "Block %u does not match the rom\n", i);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3)
+    {
+        printf("Packs a gba rom into a container of independently LZ4 compressed 4 kB blocks.\n");
+        printf("Usage: %s <input.gba> <output.gbz>\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<u8> rom;
+    if (!tryLoadFile(argv[1], rom))
+    {
+        return 1;
+    }
+    if (rom.size() > SDC_ROM_BLOCK_COUNT * SDC_BLOCK_SIZE)
+    {
+        fprintf(stderr, "%s is larger than 32 MB\n", argv[1]);
+        return 1;
+    }
+
+    auto container = packRom(rom);
+    if (!verifyContainer(container, rom))
+    {
+        return 1;
+    }
+
+    FILE* file = fopen(argv[2], "wb");
+    if (!file || fwrite(container.data(), 1, container.size(), file) != container.size())
+    {
+        fprintf(stderr, "Could not write %s\n", argv[2]);
+        if (file)
+        {
+            fclose(file);
+        }
+        return 1;
+    }
+    fclose(file);
+
+    u32 blockCount = (rom.size() + SDC_BLOCK_SIZE - 1) >> SDC_BLOCK_SHIFT;
+    u32 payloadBytes = container.size() - sizeof(CompressedRomHeader) - (blockCount + 1) * sizeof(u32);
+    printf("%s: %zu -> %zu bytes (%u%%)\n", argv[2], rom.size(), container.size(),
+        (u32)((uint64_t)container.size() * 100 / rom.size()));
+    printf("average block payload: %u bytes, estimated effective read speed at %u kB/s: %u kB/s\n",
+        payloadBytes / blockCount, ESTIMATE_SD_BANDWIDTH_KB_PER_SECOND,
+        (u32)((uint64_t)ESTIMATE_SD_BANDWIDTH_KB_PER_SECOND * blockCount * SDC_BLOCK_SIZE / payloadBytes));
+    return 0;
+}
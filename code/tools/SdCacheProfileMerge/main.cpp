@@ -0,0 +1,136 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef volatile u8 vu8;
+
+#include "SdCache/SdCacheProfile.h"
+
+/// @brief A hot block profile loaded from a file.
+struct Profile
+{
+    SdcProfileHeader header;
+    std::vector<u16> accessCounts;
+};
+
+static bool tryLoadProfile(const char* path, Profile& profile)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+    {
+        fprintf(stderr, "Could not open %s\n", path);
+        return false;
+    }
+
+    bool result = false;
+    if (fread(&profile.header, sizeof(SdcProfileHeader), 1, file) != 1 ||
+        profile.header.magic != SDC_PROFILE_MAGIC ||
+        profile.header.version != SDC_PROFILE_VERSION ||
+        profile.header.romBlockCount > SDC_ROM_BLOCK_COUNT)
+    {
+        fprintf(stderr, "%s is not a valid sd cache profile\n", path);
+    }
+    else
+    {
+        profile.accessCounts.resize(profile.header.romBlockCount);
+        if (fread(profile.accessCounts.data(), sizeof(u16), profile.accessCounts.size(), file) != profile.accessCounts.size())
+        {
+            fprintf(stderr, "%s is truncated\n", path);
+        }
+        else
+        {
+            result = true;
+        }
+    }
+
+    fclose(file);
+    return result;
+}
+
+static bool trySaveProfile(const char* path, const Profile& profile)
+{
+    FILE* file = fopen(path, "wb");
+    if (!file)
+    {
+        fprintf(stderr, "Could not create %s\n", path);
+        return false;
+    }
+
+    bool result = fwrite(&profile.header, sizeof(SdcProfileHeader), 1, file) == 1 &&
+        fwrite(profile.accessCounts.data(), sizeof(u16), profile.accessCounts.size(), file) == profile.accessCounts.size();
+    fclose(file);
+    return result;
+}
+
+/// @brief Adds the counts of the source profile to the destination profile.
+///        All counts are halved when a sum does not fit, to keep the ratios between blocks.
+static void mergeProfile(Profile& destination, const Profile& source)
+{
+    std::vector<u32> sums(destination.accessCounts.size());
+    u32 maxSum = 0;
+    for (size_t i = 0; i < sums.size(); i++)
+    {
+        sums[i] = destination.accessCounts[i] + source.accessCounts[i];
+        if (sums[i] > maxSum)
+        {
+            maxSum = sums[i];
+        }
+    }
+
+    u32 shift = 0;
+    while ((maxSum >> shift) > 0xFFFF)
+    {
+        shift++;
+    }
+
+    for (size_t i = 0; i < sums.size(); i++)
+    {
+        destination.accessCounts[i] = sums[i] >> shift;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        printf("Merges sd cache profiles of several sessions of the same game.\n");
+        printf("Usage: %s <output.bin> <input.bin> [input.bin ...]\n", argv[0]);
+        return 1;
+    }
+
+    Profile merged;
+    if (!tryLoadProfile(argv[2], merged))
+    {
+        return 1;
+    }
+
+    for (int i = 3; i < argc; i++)
+    {
+        Profile profile;
+        if (!tryLoadProfile(argv[i], profile))
+        {
+            return 1;
+        }
+
+        if (profile.header.gameCode != merged.header.gameCode ||
+            profile.header.blockShift != merged.header.blockShift ||
+            profile.header.romBlockCount != merged.header.romBlockCount)
+        {
+            fprintf(stderr, "%s belongs to a different rom than %s\n", argv[i], argv[2]);
+            return 1;
+        }
+
+        mergeProfile(merged, profile);
+    }
+
+    if (!trySaveProfile(argv[1], merged))
+    {
+        return 1;
+    }
+
+    return 0;
+}
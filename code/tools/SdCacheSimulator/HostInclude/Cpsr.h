@@ -0,0 +1,33 @@
+#pragma once
+// The simulator is single threaded, so irqs never have to be disabled.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief The simulated cpsr. The mode bits are set to irq mode while
+///        replaying trace records that were made in an irq handler.
+extern u32 gSimCpsr;
+
+static inline u32 arm_getCpsr(void)
+{
+    return gSimCpsr;
+}
+
+static inline u32 arm_disableIrqs(void)
+{
+    return gSimCpsr;
+}
+
+static inline u32 arm_enableIrqs(void)
+{
+    return gSimCpsr;
+}
+
+static inline void arm_restoreIrqs(u32 oldCpsr)
+{
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,4 @@
+#pragma once
+
+#define DEV_FAT     0
+#define DEV_SD      1
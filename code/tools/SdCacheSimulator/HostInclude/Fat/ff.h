@@ -0,0 +1,48 @@
+#pragma once
+// The subset of FatFs used by the sd cache. The simulated rom file is stored
+// in a single fragment, such that sd sectors follow directly from file offsets.
+
+typedef u32 DWORD;
+typedef u32 UINT;
+typedef u32 FSIZE_t;
+
+typedef enum
+{
+    FR_OK = 0,
+    FR_DISK_ERR,
+    FR_NOT_ENOUGH_CORE = 17
+} FRESULT;
+
+typedef struct
+{
+    u8 pdrv;
+    u32 csize;
+    DWORD database;
+} FATFS;
+
+typedef struct
+{
+    FATFS* fs;
+    FSIZE_t objsize;
+} FFOBJID;
+
+typedef struct
+{
+    FFOBJID obj;
+    FSIZE_t fptr;
+    DWORD clust;
+    DWORD* cltbl;
+} FIL;
+
+#define CREATE_LINKMAP  ((FSIZE_t)0 - 1)
+#define f_size(fp)      ((fp)->obj.objsize)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+FRESULT f_lseek(FIL* fp, FSIZE_t ofs);
+
+#ifdef __cplusplus
+}
+#endif
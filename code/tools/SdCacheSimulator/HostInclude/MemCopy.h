@@ -0,0 +1,5 @@
+#pragma once
+#include <string.h>
+
+static inline void mem_copy32(const void* src, void* dst, u32 byteCount) { memcpy(dst, src, byteCount); }
+static inline void mem_copy16(const void* src, void* dst, u32 byteCount) { memcpy(dst, src, byteCount); }
@@ -0,0 +1,6 @@
+#pragma once
+// Replaces the arm9 common.h, which pulls in the logger and the heap of the arm9.
+#include <nds/ndstypes.h>
+#include <stddef.h>
+
+typedef u16 bool16;
@@ -0,0 +1,7 @@
+#pragma once
+// The host has no write buffer or caches that need maintenance.
+
+static inline void ic_invalidateAll(void) { }
+static inline void dc_drainWriteBuffer(void) { }
+static inline void dc_flushRange(const void* ptr, u32 byteCount) { }
+static inline void dc_invalidateRange(void* ptr, u32 byteCount) { }
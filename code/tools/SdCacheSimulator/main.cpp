@@ -0,0 +1,478 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "common.h"
+#include "Cpsr.h"
+#include "Fat/ff.h"
+#include "Fat/diskio.h"
+#include "Fat/FsIpc.h"
+#include "VirtualMachine/VMNestedIrq.h"
+#include "SdCache/SdCache.h"
+#include "SdCache/SdCacheProfile.h"
+#include "SdCache/SdCacheStats.h"
+#include "SdCache/SdCacheTrace.h"
+#include "SdCache/CompressedRom.h"
+
+/// @brief The duration of a scanline in microseconds, the time unit of trace records.
+#define SCANLINE_US                 63.5
+
+/// @brief The first sd sector of the simulated rom file.
+#define ROM_FILE_FIRST_SECTOR       0x4000
+
+#define SECTORS_PER_CLUSTER         64
+
+/// @brief Parameters of the modelled sd card and fs ipc.
+struct SdModel
+{
+    /// @brief The fixed cost of a transaction in microseconds, including the arm7 round trip.
+    double latencyUs = 400;
+
+    /// @brief The transfer rate in kB/s.
+    double bandwidthKbPerSecond = 2048;
+
+    /// @brief The cpu time in microseconds of copying one cache block to or from a victim pool.
+    ///        The copies are done in the miss path, so the game waits for them.
+    double blockCopyUs = 40;
+};
+
+/// @brief The results of replaying a trace against one cache configuration.
+struct SimResult
+{
+    u32 fastPathHitCount = 0;
+    u32 softMissCount = 0;
+    u32 hardMissCount = 0;
+    u32 victimHitCount = 0;
+    u32 demotionCount = 0;
+    u32 transactionCount = 0;
+    u64 bytesRead = 0;
+    double stallUs = 0;
+    u32 dataErrorCount = 0;
+};
+
+u8 sdc_cache[SDC_BLOCK_COUNT][SDC_BLOCK_SIZE] __attribute__((aligned(32)));
+FIL gFile;
+u32 gSimCpsr;
+vu32 vm_nestedIrqLevel;
+
+static FATFS sFatFs;
+static SdModel sSdModel;
+static SimResult sResult;
+static double sNow;
+static double sBusyUntil;
+static std::unordered_map<const FsWaitToken*, double> sTokenCompletionTimes;
+static std::unordered_map<const FsWaitToken*, FsPriority> sTokenPriorities;
+static bool sDemandReadWaited;
+static std::vector<u32> sVictimPool;
+
+// the sd cache is built with GBAR3_SDC_STATS to count the victim pool copies
+SdcStats gSdcStats;
+vu8 gSdcStatsIsSaveWriteActive;
+u16 gSdcStatsRomBlockMissCounts[SDC_ROM_BLOCK_COUNT];
+
+extern "C" u32 sdc_statsGetTime(void)
+{
+    return (u32)(sNow / SCANLINE_US);
+}
+
+extern "C" void vm_enableNestedIrqs(void)
+{
+    vm_nestedIrqLevel++;
+}
+
+extern "C" void vm_disableNestedIrqs(void)
+{
+    vm_nestedIrqLevel--;
+}
+
+extern "C" void logAddress(u32 address)
+{
+}
+
+extern "C" void sdc_profileRecordAccess(u32 romBlock)
+{
+}
+
+extern "C" FRESULT f_lseek(FIL* fp, FSIZE_t ofs)
+{
+    u32 clusterSize = SECTORS_PER_CLUSTER * 512;
+    if (ofs == CREATE_LINKMAP)
+    {
+        if (fp->cltbl[0] < 4)
+        {
+            fp->cltbl[0] = 4;
+            return FR_NOT_ENOUGH_CORE;
+        }
+        fp->cltbl[0] = 4;
+        fp->cltbl[1] = (f_size(fp) + clusterSize - 1) / clusterSize;
+        fp->cltbl[2] = 2;
+        fp->cltbl[3] = 0;
+        return FR_OK;
+    }
+
+    fp->fptr = ofs;
+    fp->clust = 2 + (ofs == 0 ? 0 : (ofs - 1) / clusterSize);
+    return FR_OK;
+}
+
+extern "C" bool crom_isCompressed(void)
+{
+    return false;
+}
+
+extern "C" u32 crom_getRomSize(FIL* file)
+{
+    return f_size(file);
+}
+
+extern "C" u32 crom_getBlockPayload(u32 romBlock, u32* fileOffset)
+{
+    return 0;
+}
+
+extern "C" bool crom_decodeBlock(const u8* payload, u32 length, u8* dst)
+{
+    return false;
+}
+
+static double getTransferTimeUs(u32 sectorCount)
+{
+    return sSdModel.latencyUs + sectorCount * 512 * 1000000.0 / (sSdModel.bandwidthKbPerSecond * 1024);
+}
+
+/// @brief Waits until the given time, counting the wait as a stall of the emulated game.
+static void waitUntil(double time)
+{
+    if (time > sNow)
+    {
+        sResult.stallUs += time - sNow;
+        sNow = time;
+    }
+}
+
+/// @brief Fills each word with its offset in the rom file, such that the mapping of the cache can be verified.
+static void fillSectors(void* buffer, u32 sector, u32 count)
+{
+    u32* words = (u32*)buffer;
+    u32 fileOffset = (sector - ROM_FILE_FIRST_SECTOR) * 512;
+    for (u32 i = 0; i < count * 512 / 4; i++)
+    {
+        words[i] = fileOffset + i * 4;
+    }
+}
+
+static void startTransaction(u32 sectorCount, FsPriority priority, FsWaitToken* waitToken)
+{
+    // the arm7 handles one transaction at a time
+    double start = sBusyUntil > sNow ? sBusyUntil : sNow;
+    sBusyUntil = start + getTransferTimeUs(sectorCount);
+    sTokenCompletionTimes[waitToken] = sBusyUntil;
+    sTokenPriorities[waitToken] = priority;
+    waitToken->transactionComplete = false;
+    sResult.transactionCount++;
+    sResult.bytesRead += sectorCount * 512;
+}
+
+extern "C" void fs_readCacheAlignedSectorsAsync(FsDevice device, void* buffer, u32 sector, u32 count, FsPriority priority, FsWaitToken* waitToken)
+{
+    fillSectors(buffer, sector, count);
+    startTransaction(count, priority, waitToken);
+}
+
+extern "C" void fs_readCacheAlignedSectorsVAsync(FsDevice device, const FsSegment* segments, u32 segmentCount, FsPriority priority, FsWaitToken* waitToken)
+{
+    u32 sectorCount = 0;
+    for (u32 i = 0; i < segmentCount; i++)
+    {
+        fillSectors(segments[i].buffer, segments[i].sector, segments[i].count);
+        sectorCount += segments[i].count;
+    }
+    startTransaction(sectorCount, priority, waitToken);
+}
+
+extern "C" u32 fs_waitForCompletion(FsWaitToken* waitToken, bool keepIrqsDisabled)
+{
+    waitUntil(sTokenCompletionTimes[waitToken]);
+    waitToken->transactionComplete = true;
+    if (sTokenPriorities[waitToken] == FS_PRIORITY_ROM_MISS)
+    {
+        // waiting for read-ahead is a soft miss
+        sDemandReadWaited = true;
+    }
+    return gSimCpsr;
+}
+
+extern "C" u32 fs_waitForCompletionOfCurrentTransaction(bool keepIrqsDisabled)
+{
+    waitUntil(sBusyUntil);
+    return gSimCpsr;
+}
+
+static bool tryLoadTrace(const char* path, SdcTraceHeader& header, std::vector<SdcTraceRecord>& records)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+    {
+        fprintf(stderr, "Could not open %s\n", path);
+        return false;
+    }
+
+    bool result = false;
+    if (fread(&header, sizeof(SdcTraceHeader), 1, file) != 1 ||
+        header.magic != SDC_TRACE_MAGIC || header.version != SDC_TRACE_VERSION)
+    {
+        fprintf(stderr, "%s is not a valid sd cache trace\n", path);
+    }
+    else
+    {
+        records.resize(header.recordCount);
+        if (fread(records.data(), sizeof(SdcTraceRecord), records.size(), file) != records.size())
+        {
+            fprintf(stderr, "%s is truncated\n", path);
+        }
+        else
+        {
+            result = true;
+        }
+    }
+
+    fclose(file);
+    return result;
+}
+
+static SimResult simulate(const SdcTraceHeader& header, const std::vector<SdcTraceRecord>& records,
+    SdcPolicyType policy, u32 readAheadDepth)
+{
+    sResult = SimResult();
+    sNow = 0;
+    sBusyUntil = 0;
+    sTokenCompletionTimes.clear();
+    sTokenPriorities.clear();
+    gSimCpsr = 0x1F;
+
+    sFatFs.pdrv = DEV_FAT;
+    sFatFs.csize = SECTORS_PER_CLUSTER;
+    sFatFs.database = ROM_FILE_FIRST_SECTOR;
+    memset(&gFile, 0, sizeof(gFile));
+    gFile.obj.fs = &sFatFs;
+    gFile.obj.objsize = header.romSize;
+
+    memset(&gSdcStats, 0, sizeof(gSdcStats));
+    sdc_init(nullptr, 0);
+    if (!sVictimPool.empty())
+    {
+        sdc_addVictimPool(sVictimPool.data(), sVictimPool.size() * sizeof(u32));
+    }
+    sdc_setReplacementPolicy(policy);
+    sdc_setReadAheadDepth(readAheadDepth);
+
+    u32 romFileBlockCount = (header.romSize + SDC_BLOCK_SIZE - 1) >> SDC_BLOCK_SHIFT;
+    for (const auto& record : records)
+    {
+        sNow += record.gap * SCANLINE_US;
+        u32 romBlock = ((record.romAddress << 7) >> 7) >> SDC_BLOCK_SHIFT;
+        if (sdc_romBlockToCacheBlock[romBlock])
+        {
+            // would have been handled by the assembly fast path
+            sResult.fastPathHitCount++;
+            continue;
+        }
+
+        gSimCpsr = (record.flags & SDC_TRACE_FLAG_IRQ) ? 0x12 : 0x1F;
+        sDemandReadWaited = false;
+        u32 copyCount = gSdcStats.demotionCount + gSdcStats.victimHitCount;
+        const u32* block = (const u32*)sdc_loadRomBlockDirect(record.romAddress);
+        // a victim hit copies the block back, exchanging it with a demoted block counts twice
+        waitUntil(sNow + (gSdcStats.demotionCount + gSdcStats.victimHitCount - copyCount) * sSdModel.blockCopyUs);
+        if (sDemandReadWaited)
+        {
+            sResult.hardMissCount++;
+        }
+        else
+        {
+            sResult.softMissCount++;
+        }
+
+        if (romBlock < romFileBlockCount && block[0] != romBlock * SDC_BLOCK_SIZE)
+        {
+            sResult.dataErrorCount++;
+        }
+    }
+
+    sResult.victimHitCount = gSdcStats.victimHitCount;
+    sResult.demotionCount = gSdcStats.demotionCount;
+    return sResult;
+}
+
+static const char* getPolicyName(SdcPolicyType policy)
+{
+    switch (policy)
+    {
+        case SDC_POLICY_RANDOM:
+            return "random";
+        case SDC_POLICY_CLOCK:
+            return "clock";
+        case SDC_POLICY_SEGMENTED_LRU:
+            return "slru";
+    }
+    return "?";
+}
+
+static bool tryParsePolicy(const char* name, std::vector<SdcPolicyType>& policies)
+{
+    if (!strcmp(name, "all"))
+    {
+        policies = { SDC_POLICY_RANDOM, SDC_POLICY_CLOCK, SDC_POLICY_SEGMENTED_LRU };
+        return true;
+    }
+    for (SdcPolicyType policy : { SDC_POLICY_RANDOM, SDC_POLICY_CLOCK, SDC_POLICY_SEGMENTED_LRU })
+    {
+        if (!strcmp(name, getPolicyName(policy)))
+        {
+            policies = { policy };
+            return true;
+        }
+    }
+    return false;
+}
+
+static std::vector<u32> parseList(const char* list)
+{
+    std::vector<u32> values;
+    std::string text = list;
+    size_t start = 0;
+    while (start <= text.size())
+    {
+        size_t end = text.find(',', start);
+        if (end == std::string::npos)
+        {
+            end = text.size();
+        }
+        values.push_back(strtoul(text.substr(start, end - start).c_str(), nullptr, 0));
+        start = end + 1;
+    }
+    return values;
+}
+
+static void printUsage()
+{
+    fprintf(stderr,
+        "Usage: SdCacheSimulator [options] <trace.trc>\n"
+        "Replays an sd cache trace (/_gba/cache/<gamecode>.trc, recorded with SDC_TRACE=1)\n"
+        "against the sd cache of this build, which has %u blocks of %u bytes.\n"
+        "  --policy random|clock|slru|all   replacement policies to simulate (default all)\n"
+        "  --read-ahead <n,n,...>           read-ahead depths to simulate (default 0,2,4)\n"
+        "  --latency <us>                   fixed cost of an sd transaction (default 400)\n"
+        "  --bandwidth <kB/s>               sd transfer rate (default 2048)\n"
+        "  --victim <kB>                    size of the victim pool (default 0)\n"
+        "  --copy <us>                      cpu time of a victim pool block copy (default 40)\n",
+        SDC_BLOCK_COUNT, SDC_BLOCK_SIZE);
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<SdcPolicyType> policies = { SDC_POLICY_RANDOM, SDC_POLICY_CLOCK, SDC_POLICY_SEGMENTED_LRU };
+    std::vector<u32> readAheadDepths = { 0, 2, 4 };
+    const char* tracePath = nullptr;
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--policy") && hasValue)
+        {
+            if (!tryParsePolicy(argv[++i], policies))
+            {
+                printUsage();
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "--read-ahead") && hasValue)
+        {
+            readAheadDepths = parseList(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--latency") && hasValue)
+        {
+            sSdModel.latencyUs = atof(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--bandwidth") && hasValue)
+        {
+            sSdModel.bandwidthKbPerSecond = atof(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--victim") && hasValue)
+        {
+            sVictimPool.resize(strtoul(argv[++i], nullptr, 0) * 1024 / sizeof(u32));
+        }
+        else if (!strcmp(argv[i], "--copy") && hasValue)
+        {
+            sSdModel.blockCopyUs = atof(argv[++i]);
+        }
+        else if (argv[i][0] != '-' && !tracePath)
+        {
+            tracePath = argv[i];
+        }
+        else
+        {
+            printUsage();
+            return 1;
+        }
+    }
+
+    if (!tracePath)
+    {
+        printUsage();
+        return 1;
+    }
+
+    SdcTraceHeader header;
+    std::vector<SdcTraceRecord> records;
+    if (!tryLoadTrace(tracePath, header, records))
+    {
+        return 1;
+    }
+
+    u32 recordedHardMissCount = 0;
+    double recordedTimeUs = 0;
+    for (const auto& record : records)
+    {
+        recordedHardMissCount += (record.flags & SDC_TRACE_FLAG_HARD_MISS) ? 1 : 0;
+        recordedTimeUs += record.gap * SCANLINE_US;
+    }
+
+    printf("trace: %c%c%c%c, %u records (%u dropped), %.1f s, rom %u kB\n",
+        header.gameCode & 0xFF, (header.gameCode >> 8) & 0xFF, (header.gameCode >> 16) & 0xFF, header.gameCode >> 24,
+        header.recordCount, header.droppedCount, recordedTimeUs / 1000000, header.romSize / 1024);
+    printf("recorded with %u blocks of %u bytes, %s, read-ahead %u: %u hard misses\n",
+        header.cacheBlockCount, 1u << header.blockShift, getPolicyName((SdcPolicyType)header.policy),
+        header.readAheadDepth, recordedHardMissCount);
+    printf("simulating %u blocks of %u bytes, victim pool %u kB, sd latency %.0f us, bandwidth %.0f kB/s, block copy %.0f us\n\n",
+        SDC_BLOCK_COUNT, SDC_BLOCK_SIZE, (u32)(sVictimPool.size() * sizeof(u32) / 1024),
+        sSdModel.latencyUs, sSdModel.bandwidthKbPerSecond, sSdModel.blockCopyUs);
+    printf("policy  read-ahead  fast hits  soft misses  hard misses  victim hits  demotions  hit ratio  kB read  stall ms  us/miss\n");
+
+    bool hasDataErrors = false;
+    for (SdcPolicyType policy : policies)
+    {
+        for (u32 readAheadDepth : readAheadDepths)
+        {
+            SimResult result = simulate(header, records, policy, readAheadDepth);
+            // hits are the accesses that did not have to wait for a read from the sd card
+            double hitRatio = records.empty() ? 0 :
+                100.0 * (result.fastPathHitCount + result.softMissCount) / records.size();
+            // the average stall of the accesses that missed the fast path, including the victim pool copies
+            u32 missCount = result.softMissCount + result.hardMissCount;
+            printf("%-6s  %10u  %9u  %11u  %11u  %11u  %9u  %8.2f%%  %7llu  %8.1f  %7.1f\n",
+                getPolicyName(policy), readAheadDepth, result.fastPathHitCount, result.softMissCount,
+                result.hardMissCount, result.victimHitCount, result.demotionCount, hitRatio,
+                (unsigned long long)(result.bytesRead / 1024), result.stallUs / 1000,
+                missCount ? result.stallUs / missCount : 0);
+            if (result.dataErrorCount != 0)
+            {
+                fprintf(stderr, "%u blocks with wrong data\n", result.dataErrorCount);
+                hasDataErrors = true;
+            }
+        }
+    }
+
+    return hasDataErrors ? 1 : 0;
+}